@@ -0,0 +1,242 @@
+//Measures the rate at which unix IDs can be allocated when several servers,
+//each with several request threads, create accounts at once. The shared
+//counter is simulated in memory, with a fixed delay standing in for each
+//database round trip.
+//
+//Two schemes are compared:
+//  per-ID: read the counter, query ByUnixID for the candidate, then advance
+//          the counter by one and write the placeholder record in a single
+//          transaction conditioned on the counter's old value, retrying
+//          whenever another server got there first
+//  leased: UnixIDAllocator, which advances the counter by a whole block with
+//          a single unconditional-in-practice update, followed for each ID by
+//          the ByUnixID query and the placeholder PutItem which
+//          PersistentStore::allocateUnixID still makes
+//
+//Usage: unix-id-allocation-benchmark [servers] [threads per server]
+//                                    [IDs per thread] [round trip microseconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <UnixIDAllocator.h>
+
+namespace{
+
+const unsigned int minID=10000;
+const unsigned int maxID=1u<<24;
+
+///A stand-in for the next ID record in the database
+class SimulatedCounter{
+public:
+	explicit SimulatedCounter(std::chrono::microseconds roundTrip):
+	roundTrip(roundTrip),value(minID),updates(0),conflicts(0){}
+
+	unsigned int read(){
+		std::this_thread::sleep_for(roundTrip);
+		std::lock_guard<std::mutex> lock(mutex);
+		return value;
+	}
+	///Set the counter if it still has an expected value
+	bool compareAndSet(unsigned int expected, unsigned int next){
+		std::this_thread::sleep_for(roundTrip);
+		std::lock_guard<std::mutex> lock(mutex);
+		updates++;
+		if(value!=expected){
+			conflicts++;
+			return false;
+		}
+		value=next;
+		return true;
+	}
+	///Advance the counter if that keeps it within range
+	///\return the new value, or zero if the range is exhausted
+	unsigned int add(unsigned int amount){
+		std::this_thread::sleep_for(roundTrip);
+		std::lock_guard<std::mutex> lock(mutex);
+		updates++;
+		if(value>maxID-amount)
+			return 0;
+		value+=amount;
+		return value;
+	}
+
+	void reset(){
+		std::lock_guard<std::mutex> lock(mutex);
+		value=minID;
+		updates=0;
+		conflicts=0;
+	}
+	unsigned long getUpdates() const{ return updates; }
+	unsigned long getConflicts() const{ return conflicts; }
+
+private:
+	const std::chrono::microseconds roundTrip;
+	std::mutex mutex;
+	unsigned int value;
+	std::atomic<unsigned long> updates;
+	std::atomic<unsigned long> conflicts;
+};
+
+///A stand-in for the per-ID requests made against the table which holds the
+///allocated IDs. No IDs are assigned explicitly, so every candidate is free.
+class SimulatedIDTable{
+public:
+	explicit SimulatedIDTable(std::chrono::microseconds roundTrip):
+	roundTrip(roundTrip),requests(0){}
+
+	///Query the ByUnixID index for an ID
+	bool available(unsigned int){
+		std::this_thread::sleep_for(roundTrip);
+		requests++;
+		return true;
+	}
+	///Write the placeholder record which claims an ID
+	void reserve(unsigned int){
+		std::this_thread::sleep_for(roundTrip);
+		requests++;
+	}
+
+	void reset(){ requests=0; }
+	unsigned long getRequests() const{ return requests; }
+
+private:
+	const std::chrono::microseconds roundTrip;
+	std::atomic<unsigned long> requests;
+};
+
+class SimulatedLeaseSource : public UnixIDAllocator::LeaseSource{
+public:
+	explicit SimulatedLeaseSource(SimulatedCounter& counter):counter(counter){}
+	bool lease(unsigned int size, unsigned int& first, unsigned int& end) override{
+		end=counter.add(size);
+		if(!end)
+			return false;
+		first=end-size;
+		return true;
+	}
+	bool giveBack(unsigned int first, unsigned int end) override{
+		return counter.compareAndSet(end,first);
+	}
+private:
+	SimulatedCounter& counter;
+};
+
+struct Result{
+	double seconds;
+	unsigned long ids;
+	bool unique;
+};
+
+///Run allocations on many threads at once and check that no ID was issued
+///twice
+template<typename Allocate>
+Result run(unsigned int servers, unsigned int threads, unsigned int perThread, Allocate allocate){
+	std::mutex resultMutex;
+	std::multiset<unsigned int> issued;
+	std::vector<std::thread> workers;
+	auto start=std::chrono::steady_clock::now();
+	for(unsigned int s=0; s<servers; s++){
+		for(unsigned int t=0; t<threads; t++){
+			workers.emplace_back([&,s]{
+				std::vector<unsigned int> ids;
+				ids.reserve(perThread);
+				for(unsigned int i=0; i<perThread; i++)
+					ids.push_back(allocate(s));
+				std::lock_guard<std::mutex> lock(resultMutex);
+				issued.insert(ids.begin(),ids.end());
+			});
+		}
+	}
+	for(auto& worker : workers)
+		worker.join();
+	auto end=std::chrono::steady_clock::now();
+	Result result;
+	result.seconds=std::chrono::duration_cast<std::chrono::duration<double>>(end-start).count();
+	result.ids=issued.size();
+	result.unique=std::set<unsigned int>(issued.begin(),issued.end()).size()==issued.size();
+	return result;
+}
+
+void report(const std::string& name, const Result& result, const SimulatedCounter& counter, const SimulatedIDTable& table){
+	std::cout << std::left << std::setw(16) << name << std::right
+	          << std::setw(10) << result.ids << " IDs in "
+	          << std::fixed << std::setprecision(3) << std::setw(8) << result.seconds << " s: "
+	          << std::setprecision(0) << std::setw(10) << result.ids/result.seconds << " IDs/s, "
+	          << std::setw(8) << counter.getUpdates() << " counter updates, "
+	          << std::setw(8) << counter.getConflicts() << " conflicts, "
+	          << std::setw(8) << table.getRequests() << " ID table requests"
+	          << (result.unique?"":" DUPLICATE IDS ISSUED") << std::endl;
+}
+
+unsigned int parseArg(int argc, char* argv[], int index, unsigned int defaultValue){
+	if(argc<=index)
+		return defaultValue;
+	return std::strtoul(argv[index],nullptr,10);
+}
+
+}
+
+int main(int argc, char* argv[]){
+	const unsigned int servers=parseArg(argc,argv,1,4);
+	const unsigned int threads=parseArg(argc,argv,2,8);
+	const unsigned int perThread=parseArg(argc,argv,3,200);
+	const std::chrono::microseconds roundTrip(parseArg(argc,argv,4,500));
+	std::cout << servers << " servers with " << threads << " threads each, allocating "
+	          << perThread << " IDs per thread, " << roundTrip.count()
+	          << " us per database round trip" << std::endl;
+
+	SimulatedCounter counter(roundTrip);
+	SimulatedIDTable table(roundTrip);
+	bool allUnique=true;
+
+	{
+		auto result=run(servers,threads,perThread,[&](unsigned int){
+			while(true){
+				unsigned int id=counter.read();
+				if(!table.available(id))
+					continue;
+				//the transaction which advances the counter also writes the
+				//placeholder record, so it is a single round trip
+				if(counter.compareAndSet(id,id+1))
+					return id;
+			}
+		});
+		report("per-ID",result,counter,table);
+		allUnique&=result.unique;
+	}
+
+	for(unsigned int blockSize : {1u,4u,16u,64u,256u}){
+		counter.reset();
+		table.reset();
+		SimulatedLeaseSource source(counter);
+		std::vector<std::unique_ptr<UnixIDAllocator>> allocators;
+		for(unsigned int s=0; s<servers; s++)
+			allocators.emplace_back(new UnixIDAllocator(source,blockSize));
+		auto result=run(servers,threads,perThread,[&](unsigned int server){
+			while(true){
+				unsigned int id=allocators[server]->next();
+				if(!id)
+					throw std::runtime_error("ID range exhausted");
+				if(!table.available(id))
+					continue;
+				table.reserve(id);
+				return id;
+			}
+		});
+		report("leased ("+std::to_string(blockSize)+")",result,counter,table);
+		allUnique&=result.unique;
+	}
+
+	return allUnique?0:1;
+}
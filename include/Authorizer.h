@@ -0,0 +1,109 @@
+#ifndef CONNECT_AUTHORIZER_H
+#define CONNECT_AUTHORIZER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <libcuckoo/cuckoohash_map.hh>
+
+#include <bounded_cache.h>
+#include <Entities.h>
+
+class PersistentStore;
+
+///Decides whether users may act on groups, remembering each decision so that
+///repeated checks of the same user, group, and action are a single lookup.
+///Decisions depend only on the user's memberships (superusers are allowed
+///everything, and this is applied to each check without being remembered).
+///Each user has a generation number, which is advanced whenever the user or
+///any of the user's memberships changes, and a remembered decision is only
+///used if it was made during the user's current generation, so invalidation
+///never needs to find the decisions which it makes obsolete.
+///Decisions also expire as soon as the earliest of the cached membership
+///records from which they are made does.
+class Authorizer{
+public:
+	///The kinds of actions which are authorized by group membership
+	enum Action{
+		///Acting as a member of a group, such as requesting subgroups: allowed
+		///to active members and admins of the group, and to admins of any
+		///enclosing group
+		Participate,
+		///Administering a group, its members, and its subgroups: allowed to
+		///admins of the group and of any enclosing group
+		Administer
+	};
+
+	///The outcome of an authorization check
+	struct Decision{
+		Decision():allowed(false),complete(true){}
+		///Whether the action is allowed
+		bool allowed;
+		///Whether all of the memberships on which the decision depends could 
+		///be read. An incomplete decision may wrongly deny the action, so it 
+		///should be reported as a failure rather than as a refusal, and it is 
+		///not remembered. 
+		bool complete;
+		///The group, either the one checked or the nearest enclosing one, of
+		///which the user is an admin, or empty if there is none
+		std::string adminGroup;
+		explicit operator bool() const{ return allowed; }
+	};
+
+	///\param store the source of membership information
+	explicit Authorizer(PersistentStore& store);
+	Authorizer(const Authorizer&)=delete;
+	Authorizer& operator=(const Authorizer&)=delete;
+
+	///Check whether a user may perform an action on a group
+	///\param user the user attempting the action
+	///\param groupName the canonical name of the group acted upon
+	///\param action the kind of action
+	Decision check(const User& user, const std::string& groupName, Action action);
+
+	///Discard all of the decisions made for a user, because the user or the
+	///user's memberships have changed
+	void invalidate(const std::string& uID);
+
+	///\return the number of checks answered from remembered decisions
+	std::size_t hits() const{ return hitCount.load(); }
+	///\return the number of checks which required a new decision
+	std::size_t misses() const{ return missCount.load(); }
+
+	///A remembered decision, along with the generation of the user's data
+	///from which it was made
+	struct Entry{
+		Decision decision;
+		uint64_t generation;
+		std::chrono::steady_clock::time_point expiration;
+	};
+	using DecisionCache=bounded_cache<std::string,Entry>;
+	///\return the cache of decisions, so that its memory use can be managed
+	///        along with the store's other caches
+	DecisionCache& decisionCache(){ return decisions; }
+
+private:
+	PersistentStore& store;
+	///Remembered decisions, keyed by action, user ID, and group name
+	DecisionCache decisions;
+	///The current generation of each user whose decisions have ever been
+	///invalidated. Users not present are in generation zero.
+	cuckoohash_map<std::string,uint64_t> generations;
+	std::atomic<std::size_t> hitCount, missCount;
+
+	///\return the current generation of a user's decisions
+	uint64_t generationOf(const std::string& uID) const;
+	///Make a decision without consulting remembered decisions
+	///\param expiration set to the time after which the decision should no 
+	///                  longer be used, when the first of the records from 
+	///                  which it was made expires
+	Decision decide(const std::string& uID, const std::string& groupName, Action action, 
+	                std::chrono::steady_clock::time_point& expiration);
+};
+
+///The approximate amount of memory used by a remembered decision
+std::size_t memory_footprint(const Authorizer::Entry& entry);
+
+#endif //CONNECT_AUTHORIZER_H
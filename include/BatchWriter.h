@@ -0,0 +1,72 @@
+#ifndef CONNECT_BATCH_WRITER_H
+#define CONNECT_BATCH_WRITER_H
+
+#include <string>
+#include <vector>
+
+#include <aws/core/Aws.h>
+#include <aws/dynamodb/model/WriteRequest.h>
+
+#include <StorageEngine.h>
+#include <ThreadPool.h>
+
+///Applies many puts and deletes to a table using BatchWriteItem.
+///Writes are divided into batches of the largest size DynamoDB allows, which
+///are submitted concurrently on a thread pool. Items which the database leaves
+///unprocessed (typically because the table's capacity is exhausted) are
+///resubmitted a limited number of times, after waiting as the storage engine
+///directs.
+class BatchWriter{
+public:
+	using Item=Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>;
+
+	///The maximum number of writes DynamoDB allows in one BatchWriteItem request
+	static const std::size_t batchLimit;
+	///The number of times a batch is submitted before its unprocessed items
+	///are considered to have failed
+	static const unsigned int attemptLimit;
+
+	///\param engine the database to which to write
+	///\param pool the threads on which to submit batches. Tasks running on
+	///            this pool must never wait for a batch write, or it may
+	///            deadlock.
+	BatchWriter(StorageEngine& engine, ThreadPool& pool):
+	engine(engine),pool(pool){}
+
+	///Perform a set of writes. Note that the writes are not atomic as a group,
+	///and no two may refer to the same item.
+	///\param tableName the table to which to write
+	///\param writes the puts and deletes to perform
+	///\return whether each write, in the same order as writes, was performed
+	std::vector<bool> write(const std::string& tableName,
+	                        const std::vector<Aws::DynamoDB::Model::WriteRequest>& writes);
+
+	///Delete a set of items
+	///\param tableName the table from which to delete
+	///\param keys the complete primary keys of the items to delete
+	///\return whether each item, in the same order as keys, was deleted
+	std::vector<bool> remove(const std::string& tableName, const std::vector<Item>& keys);
+
+	///\return a write request which puts an item
+	static Aws::DynamoDB::Model::WriteRequest put(const Item& item);
+	///\return a write request which deletes the item with a key
+	static Aws::DynamoDB::Model::WriteRequest erase(const Item& key);
+
+private:
+	StorageEngine& engine;
+	ThreadPool& pool;
+
+	///Submit one batch until all of its items are processed or the attempt
+	///limit is reached
+	///\param tableName the table to which to write
+	///\param writes all of the writes being performed
+	///\param begin the index of the first write in this batch
+	///\param end the index after the last write in this batch
+	///\param done the success flags for all writes, of which this batch's
+	///            range will be set
+	void writeBatch(const std::string& tableName,
+	                const std::vector<Aws::DynamoDB::Model::WriteRequest>& writes,
+	                std::size_t begin, std::size_t end, std::vector<char>& done);
+};
+
+#endif //CONNECT_BATCH_WRITER_H
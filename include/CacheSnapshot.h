@@ -0,0 +1,56 @@
+#ifndef CONNECT_CACHE_SNAPSHOT_H
+#define CONNECT_CACHE_SNAPSHOT_H
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <Entities.h>
+
+///The contents of the PersistentStore caches, in a form which can be saved to
+///a file so that a restarted server need not begin with empty caches
+struct CacheSnapshot{
+	CacheSnapshot():usersComplete(false),groupsComplete(false),groupRequestsComplete(false){}
+
+	std::vector<User> users;
+	///Summaries of all users, for listings, if usersComplete
+	std::vector<UserSummary> userSummaries;
+	///Whether userSummaries contains every user
+	bool usersComplete;
+	std::vector<Group> groups;
+	///Whether groups contains every group
+	bool groupsComplete;
+	std::vector<GroupRequest> groupRequests;
+	///Whether groupRequests contains every group request
+	bool groupRequestsComplete;
+	std::vector<GroupMembership> memberships;
+	///Users for which memberships contains all of their memberships
+	std::vector<std::string> completeUserMemberships;
+	///Groups for which memberships contains all of their members
+	std::vector<std::string> completeGroupMemberships;
+	///Owner name, attribute name, and attribute value
+	using Attribute=std::tuple<std::string,std::string,std::string>;
+	std::vector<Attribute> userAttributes;
+	std::vector<Attribute> groupAttributes;
+
+	///\return the total number of records of all kinds
+	std::size_t size() const;
+};
+
+///Write a snapshot to a file.
+///The file is written under a temporary name and then renamed, so that an
+///existing snapshot is replaced only by a complete new one.
+///\param path the file to write
+///\param snapshot the data to write
+///\throws std::runtime_error if the file cannot be written
+void writeCacheSnapshot(const std::string& path, const CacheSnapshot& snapshot);
+
+///Read a snapshot written by writeCacheSnapshot.
+///The file is memory mapped and decoded in place.
+///\param path the file to read
+///\return the snapshot's contents
+///\throws std::runtime_error if the file cannot be read, was written by an
+///        incompatible version, or is corrupt
+CacheSnapshot readCacheSnapshot(const std::string& path);
+
+#endif //CONNECT_CACHE_SNAPSHOT_H
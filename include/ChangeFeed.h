@@ -0,0 +1,156 @@
+#ifndef CONNECT_CHANGE_FEED_H
+#define CONNECT_CHANGE_FEED_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <aws/core/Aws.h>
+#include <aws/core/auth/AWSCredentialsProvider.h>
+#include <aws/dynamodb/DynamoDBClient.h>
+
+///A notification that stored data has been modified, so that any copies cached
+///by other server instances must be discarded
+struct ChangeEvent{
+	enum Kind{
+		///A user record was created, modified, or deleted
+		UserChanged,
+		///A user's membership in a group was set or removed
+		MembershipChanged,
+		///Any of a user's secondary attributes was set or removed
+		UserAttributeChanged,
+		///A group or group request was created, modified, approved, or deleted
+		GroupChanged,
+		///Any of a group's secondary attributes was set or removed
+		GroupAttributeChanged
+	};
+
+	ChangeEvent()=default;
+	ChangeEvent(Kind kind, std::string subject, std::string detail=""):
+	kind(kind),subject(std::move(subject)),detail(std::move(detail)){}
+
+	Kind kind;
+	///The user's unix name or the group's name
+	std::string subject;
+	///For membership changes, the name of the group. Otherwise unused.
+	std::string detail;
+	///The identity of the server instance which made the change
+	std::string origin;
+
+	static std::string to_string(Kind kind);
+	///\throws std::runtime_error if the string is not a valid kind
+	static Kind from_string(const std::string& kind);
+};
+
+///A channel through which server instances sharing a database tell each other
+///about the changes they make.
+///Each instance publishes the changes it makes, and periodically polls for the
+///changes made by all other instances. Implementations must be safe for
+///concurrent publishing from many threads; polling is done by one thread.
+class ChangeFeed{
+public:
+	ChangeFeed();
+	virtual ~ChangeFeed(){}
+
+	///Announce a change to all other instances
+	///\param event the change. Its origin will be filled in by the feed.
+	///\return whether the change was successfully published
+	virtual bool publish(ChangeEvent event)=0;
+
+	///Collect changes published by other instances since the previous call.
+	///Changes published by this instance are not returned.
+	virtual std::vector<ChangeEvent> poll()=0;
+
+	///\return a name which identifies this instance among all which share the feed
+	const std::string& getOrigin() const{ return origin; }
+
+	///\return a brief, human-readable description of the feed's state
+	virtual std::string describe() const;
+
+protected:
+	const std::string origin;
+	std::atomic<size_t> published, received;
+};
+
+///A feed which connects instances within a single process, intended for
+///testing and for running several stores side by side.
+class LoopbackChangeFeed : public ChangeFeed{
+public:
+	///The shared medium to which a group of loopback feeds is connected
+	class Hub;
+
+	///\param hub the hub to connect to; all feeds constructed with the same
+	///           hub receive each other's changes
+	explicit LoopbackChangeFeed(std::shared_ptr<Hub> hub);
+	~LoopbackChangeFeed();
+
+	bool publish(ChangeEvent event) override;
+	std::vector<ChangeEvent> poll() override;
+
+	///Create a new, independent hub
+	static std::shared_ptr<Hub> makeHub();
+
+private:
+	struct Inbox{
+		std::mutex mut;
+		std::vector<ChangeEvent> events;
+	};
+	std::shared_ptr<Hub> hub;
+	std::shared_ptr<Inbox> inbox;
+	friend class Hub;
+};
+
+///A feed stored in a DynamoDB table, which all instances append to and read
+///from.
+///The table is divided into a fixed number of shards (the hash key), within
+///which events are ordered by a position (the range key) beginning with the
+///time at which they were published. Each reader remembers how far it has
+///read in each shard. Since instances' clocks may not agree perfectly, each
+///read looks back somewhat before the last position seen, and events already
+///seen are recognized by their positions and skipped.
+///Events are marked to expire after a time, so that if the table's time to
+///live feature is enabled (which is attempted when the table is created) it
+///does not grow without bound.
+class DynamoDBChangeFeed : public ChangeFeed{
+public:
+	///\param credentials the credentials to use to access the database
+	///\param clientConfig the configuration to use to connect to the database
+	///\param tableName the name of the table to use, which will be created if
+	///                 it does not exist
+	DynamoDBChangeFeed(const Aws::Auth::AWSCredentials& credentials,
+	                   const Aws::Client::ClientConfiguration& clientConfig,
+	                   std::string tableName="CONNECT_changes");
+
+	bool publish(ChangeEvent event) override;
+	std::vector<ChangeEvent> poll() override;
+	std::string describe() const override;
+
+private:
+	///The number of shards into which events are divided
+	const static unsigned int shards;
+	///How far before the last position seen each read begins
+	const static std::chrono::milliseconds clockSkewAllowance;
+	///How long events are retained
+	const static std::chrono::hours retention;
+
+	Aws::DynamoDB::DynamoDBClient dbClient;
+	const std::string tableName;
+	///Distinguishes events published by this instance in the same microsecond
+	std::atomic<unsigned long> sequence;
+	///The latest position seen in each shard
+	std::vector<std::string> lastPositions;
+	///The positions of events already seen in each shard which may be seen 
+	///again due to the look back
+	std::vector<std::set<std::string>> recentlySeen;
+	std::atomic<size_t> pollFailures;
+
+	void initializeTable();
+	///\return a position for an event published at the given time
+	std::string makePosition(std::chrono::system_clock::time_point time);
+};
+
+#endif //CONNECT_CHANGE_FEED_H
@@ -40,6 +40,32 @@ bool operator==(const User& u1, const User& u2);
 bool operator!=(const User& u1, const User& u2);
 std::ostream& operator<<(std::ostream& os, const User& u);
 
+///The public parts of a user account, as shown in listings. This omits the
+///user's credentials (token, SSH keys, etc.), which are both sensitive and
+///comparatively large.
+struct UserSummary{
+	UserSummary():valid(false),unixID(0),superuser(false),serviceAccount(false){}
+	explicit UserSummary(const User& user):
+	valid(user.valid),unixName(user.unixName),name(user.name),email(user.email),
+	phone(user.phone),institution(user.institution),joinDate(user.joinDate),
+	lastUseTime(user.lastUseTime),unixID(user.unixID),superuser(user.superuser),
+	serviceAccount(user.serviceAccount){}
+
+	bool valid;
+	std::string unixName;
+	std::string name;
+	std::string email;
+	std::string phone;
+	std::string institution;
+	std::string joinDate;
+	std::string lastUseTime;
+	unsigned int unixID;
+	bool superuser;
+	bool serviceAccount;
+
+	explicit operator bool() const{ return valid; }
+};
+
 struct GroupRequest;
 
 struct Group{
@@ -36,6 +36,8 @@ crow::response denySubgroupRequest(PersistentStore& store, const crow::request&
 
 crow::response getGroupAttribute(PersistentStore& store, const crow::request& req, std::string groupName, std::string attributeName);
 
+crow::response listGroupAttributes(PersistentStore& store, const crow::request& req, std::string groupName);
+
 crow::response setGroupAttribute(PersistentStore& store, const crow::request& req, std::string groupName, std::string attributeName);
 
 crow::response deleteGroupAttribute(PersistentStore& store, const crow::request& req, std::string groupName, std::string attributeName);
@@ -0,0 +1,121 @@
+#ifndef CONNECT_LOCAL_STORAGE_ENGINE_H
+#define CONNECT_LOCAL_STORAGE_ENGINE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include <StorageEngine.h>
+
+///Stores records in a single file on local disk, for single server sites,
+///testing, and benchmarks, without the need for a database service.
+///All tables are held in memory, ordered by primary key, along with their
+///global secondary indices. Every change is appended to the file before it is
+///applied, and the file is replayed when the engine is opened. When the file
+///has grown to more than twice the size of the live data it is compacted by
+///rewriting it from memory.
+///Requests are interpreted as DynamoDB would, for the parts of the API which
+///the store uses: key, filter, and condition expressions with comparisons,
+///BETWEEN, IN, AND, OR, NOT, and the attribute_exists, attribute_not_exists,
+///attribute_type, begins_with, contains, and size functions; update
+///expressions with SET (including +, -, if_not_exists, and list_append),
+///REMOVE, ADD, and DELETE; legacy AttributeUpdates; projection expressions;
+///ReturnValues; Limit, ExclusiveStartKey, and parallel scan segments.
+///Expressions may only refer to top-level attributes, and binary attributes
+///are not supported.
+class LocalStorageEngine : public StorageEngine{
+public:
+	///\param path the file in which to keep the data, which is created if it
+	///            does not exist
+	///\param syncWrites whether each change must reach the disk before it is
+	///                  reported to have succeeded
+	///\throws std::runtime_error if the file cannot be opened, or was written
+	///        by an incompatible version, or is corrupt other than at its end
+	///        (where a partially written change is discarded)
+	explicit LocalStorageEngine(const std::string& path, bool syncWrites=true);
+	~LocalStorageEngine();
+
+	LocalStorageEngine(const LocalStorageEngine&)=delete;
+	LocalStorageEngine& operator=(const LocalStorageEngine&)=delete;
+
+	Aws::DynamoDB::Model::GetItemOutcome getItem(const Aws::DynamoDB::Model::GetItemRequest& request) override;
+	Aws::DynamoDB::Model::BatchGetItemOutcome batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request) override;
+	Aws::DynamoDB::Model::QueryOutcome query(const Aws::DynamoDB::Model::QueryRequest& request) override;
+	Aws::DynamoDB::Model::ScanOutcome scan(const Aws::DynamoDB::Model::ScanRequest& request) override;
+	Aws::DynamoDB::Model::PutItemOutcome putItem(const Aws::DynamoDB::Model::PutItemRequest& request) override;
+	Aws::DynamoDB::Model::UpdateItemOutcome updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request) override;
+	Aws::DynamoDB::Model::DeleteItemOutcome deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request) override;
+	Aws::DynamoDB::Model::BatchWriteItemOutcome batchWriteItem(const Aws::DynamoDB::Model::BatchWriteItemRequest& request) override;
+	Aws::DynamoDB::Model::TransactWriteItemsOutcome transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request) override;
+
+	Aws::DynamoDB::Model::DescribeTableOutcome describeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request) override;
+	Aws::DynamoDB::Model::CreateTableOutcome createTable(const Aws::DynamoDB::Model::CreateTableRequest& request) override;
+	Aws::DynamoDB::Model::UpdateTableOutcome updateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request) override;
+	Aws::DynamoDB::Model::DeleteTableOutcome deleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request) override;
+
+	///Batches are always processed completely, so there is never a need to wait
+	void waitToRetry(const std::string& /*tableName*/, unsigned int /*attempt*/) override{}
+
+	std::string describe() const override;
+
+	struct Table;
+	///A change to one item, as recorded in the file
+	struct Change;
+
+private:
+	///A reader-writer lock: requests which only read share it, while changes
+	///hold it exclusively
+	class SharedMutex{
+	public:
+		SharedMutex(){ pthread_rwlock_init(&rwlock,nullptr); }
+		~SharedMutex(){ pthread_rwlock_destroy(&rwlock); }
+		void lock_shared(){ pthread_rwlock_rdlock(&rwlock); }
+		void unlock_shared(){ pthread_rwlock_unlock(&rwlock); }
+		void lock(){ pthread_rwlock_wrlock(&rwlock); }
+		void unlock(){ pthread_rwlock_unlock(&rwlock); }
+	private:
+		pthread_rwlock_t rwlock;
+	};
+
+	const std::string path;
+	const bool syncWrites;
+	mutable SharedMutex mutex;
+	std::map<std::string,std::unique_ptr<Table>> tables;
+	///The file to which changes are appended
+	int fd;
+	///The current size of the file
+	uint64_t logBytes;
+
+	///\return the table with a name
+	///\throws RequestError (RESOURCE_NOT_FOUND) if the table does not exist
+	Table& getTable(const std::string& name) const;
+	///Read the file, applying all of the records it contains
+	void replay();
+	///Append a record to the file
+	///\throws RequestError (INTERNAL_FAILURE) if the record cannot be written,
+	///        in which case the file is left as it was
+	void append(const std::string& record);
+	///Record and then apply a set of changes which must take effect together
+	void commit(std::vector<Change>& changes);
+	///Apply a set of changes to the tables in memory
+	void apply(std::vector<Change>& changes);
+	///\return the record describing a table's key schema and indices
+	static std::string schemaRecord(const Table& table);
+	///Create a table, or bring an existing table's attribute definitions and
+	///indices into line with a new description
+	///\param schema the table's description, without any items
+	void applySchema(std::unique_ptr<Table> schema);
+	///\return the approximate number of bytes which a compacted file would have
+	uint64_t liveBytes() const;
+	///Rewrite the file with only the current contents of the tables, if it has
+	///grown large enough that this is worthwhile
+	void compactIfNeeded();
+	///Rewrite the file with only the current contents of the tables
+	void compact();
+};
+
+#endif //CONNECT_LOCAL_STORAGE_ENGINE_H
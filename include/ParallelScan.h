@@ -0,0 +1,118 @@
+#ifndef CONNECT_PARALLEL_SCAN_H
+#define CONNECT_PARALLEL_SCAN_H
+
+#include <functional>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <aws/core/Aws.h>
+#include <aws/dynamodb/model/ScanRequest.h>
+
+#include <StorageEngine.h>
+#include <ThreadPool.h>
+
+///Reads every item of a table which matches a scan request by
+///dividing the table into segments (using the Segment and TotalSegments scan
+///parameters) which are read concurrently on a thread pool. Each segment
+///follows its own chain of pages, and items are processed on the thread which
+///read them, so the calling thread only has to merge the results.
+class ParallelScan{
+public:
+	using Item=Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>;
+	///A function called when a segment has been completely read, with the
+	///segment's index and the number of items it contained
+	using SegmentCallback=std::function<void(unsigned int,std::size_t)>;
+
+	///\param engine the database from which to read
+	///\param pool the threads on which to read segments. Tasks running on
+	///            this pool must never wait for a scan, or it may deadlock.
+	///\param segments the number of segments into which to divide each scan.
+	///                Segments beyond the number of threads in the pool wait
+	///                for a free thread.
+	ParallelScan(StorageEngine& engine, ThreadPool& pool, unsigned int segments):
+	engine(engine),pool(pool),segments(segments?segments:1){}
+
+	///\return the number of segments into which each scan is divided
+	unsigned int getSegments() const{ return segments; }
+
+	///Scan a table, accumulating a result separately for each segment
+	///\param request the scan to perform. Its segment parameters and start key
+	///               are set by this function.
+	///\param visit a callable taking (const Item&, Accumulator&) which will be
+	///             called for every item, concurrently from several threads
+	///             but never concurrently for the same accumulator
+	///\param segmentDone an optional callable to be notified as each segment
+	///                   finishes
+	///\return the accumulators of all segments
+	///\throws std::runtime_error if any segment could not be read, or
+	///        the first exception thrown by visit, after all segments have
+	///        finished
+	template<typename Accumulator, typename Visit>
+	std::vector<Accumulator> accumulate(const Aws::DynamoDB::Model::ScanRequest& request,
+	                                    Visit visit, SegmentCallback segmentDone=SegmentCallback()){
+		std::vector<std::future<Accumulator>> pending;
+		pending.reserve(segments);
+		for(unsigned int i=0; i<segments; i++){
+			auto readSegment=[this,&request,&visit,&segmentDone,i]{
+				Accumulator acc;
+				std::size_t items=scanSegment(request,i,[&](const Item& item){ visit(item,acc); });
+				if(segmentDone)
+					segmentDone(i,items);
+				return acc;
+			};
+			pending.push_back(pool.enqueue(readSegment));
+		}
+		//every segment must be finished with before returning, since they
+		//refer to this function's arguments
+		std::vector<Accumulator> results;
+		results.reserve(segments);
+		std::exception_ptr error;
+		for(auto& segment : pending){
+			try{
+				results.push_back(segment.get());
+			}catch(...){
+				if(!error)
+					error=std::current_exception();
+			}
+		}
+		if(error)
+			std::rethrow_exception(error);
+		return results;
+	}
+
+	///Scan a table, decoding items into a single collection
+	///\param request the scan to perform
+	///\param decode a callable taking (const Item&, std::vector<T>&) which
+	///              should append any results for the item, and will be
+	///              called concurrently from several threads
+	///\return the results from all segments
+	///\throws std::runtime_error as for accumulate
+	template<typename T, typename Decode>
+	std::vector<T> collect(const Aws::DynamoDB::Model::ScanRequest& request, Decode decode){
+		auto parts=accumulate<std::vector<T>>(request,decode);
+		std::size_t total=0;
+		for(const auto& part : parts)
+			total+=part.size();
+		std::vector<T> results;
+		results.reserve(total);
+		for(auto& part : parts)
+			std::move(part.begin(),part.end(),std::back_inserter(results));
+		return results;
+	}
+
+private:
+	StorageEngine& engine;
+	ThreadPool& pool;
+	const unsigned int segments;
+
+	///Read all pages of one segment
+	///\return the number of items read
+	///\throws std::runtime_error if a page cannot be read
+	std::size_t scanSegment(Aws::DynamoDB::Model::ScanRequest request, unsigned int segment,
+	                        const std::function<void(const Item&)>& fn);
+};
+
+#endif //CONNECT_PARALLEL_SCAN_H
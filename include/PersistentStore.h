@@ -2,18 +2,45 @@
 #define CONNECT_PERSISTENT_STORE_H
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_set>
 
 #include <aws/core/Aws.h>
-#include <aws/core/auth/AWSCredentialsProvider.h>
-#include <aws/dynamodb/DynamoDBClient.h>
+#include <aws/dynamodb/model/BatchGetItemRequest.h>
+#include <aws/dynamodb/model/DeleteItemRequest.h>
+#include <aws/dynamodb/model/GetItemRequest.h>
+#include <aws/dynamodb/model/PutItemRequest.h>
+#include <aws/dynamodb/model/QueryRequest.h>
+#include <aws/dynamodb/model/TransactWriteItemsRequest.h>
+#include <aws/dynamodb/model/UpdateItemRequest.h>
 
 #include <libcuckoo/cuckoohash_map.hh>
 
+#include <attribute_table.h>
+#include <Authorizer.h>
+#include <BatchWriter.h>
+#include <bloom_filter.h>
+#include <bounded_cache.h>
+#include <CacheSnapshot.h>
+#include <ChangeFeed.h>
 #include <concurrent_multimap.h>
 #include <Entities.h>
+#include <ParallelScan.h>
+#include <single_flight.h>
+#include <StorageEngine.h>
+#include <group_tree.h>
+#include <ThreadPool.h>
+#include <timer_wheel.h>
+#include <UnixIDAllocator.h>
+#include <versioned_directory.h>
 //#include <FileHandle.h>
 
 //In libstdc++ versions < 5 std::atomic seems to be broken for non-integral types
@@ -110,6 +137,18 @@ struct hash<std::set<T>>{
 };
 }
 
+///The approximate amount of memory used by a cache record, including its data
+template <typename T>
+std::size_t memory_footprint(const CacheRecord<T>& r){
+	return sizeof(r)-sizeof(T)+memory_footprint(r.record);
+}
+
+//The approximate amounts of memory used by entity records
+std::size_t memory_footprint(const User& user);
+std::size_t memory_footprint(const Group& group);
+std::size_t memory_footprint(const GroupRequest& gr);
+std::size_t memory_footprint(const GroupMembership& membership);
+
 class EmailClient{
 public:
 	struct Email{
@@ -135,9 +174,7 @@ private:
 
 class PersistentStore{
 public:
-	///\param credentials the AWS credentials used for authenitcation with the 
-	///                   database
-	///\param clientConfig specification of the database endpoint to contact
+	///\param engine the database in which records are kept
 	///\param bootstrapUserFile the path from which the initial portal user
 	///                         (superuser) credentials should be loaded
 	///\param encryptionKeyFile the path to the file from which the encryption 
@@ -146,10 +183,12 @@ public:
 	///                            send monitoring data
 	///\param appLoggingServerPort port to which application instances should 
 	///                            send monitoring data
-	PersistentStore(const Aws::Auth::AWSCredentials& credentials, 
-	                const Aws::Client::ClientConfiguration& clientConfig,
+	PersistentStore(std::shared_ptr<StorageEngine> engine,
 	                std::string bootstrapUserFile, EmailClient emailClient);
 	
+	///Stops background maintenance of the caches
+	~PersistentStore();
+	
 	///Store a record for a new user
 	///\param user the user to create. If the user does not have a unix ID number, 
 	///            one will be assigned
@@ -161,8 +200,21 @@ public:
 	///\return the corresponding user or an invalid user object if the id is not known
 	User getUser(const std::string& id);
 	
-	///Find the user who owns the given access token. Currently does not bother 
-	///to retreive the user's name, email address, or globus ID. 
+	///Find information about several users at once. Users which are not cached 
+	///are fetched together, in batches which are read concurrently.
+	///\param ids the IDs of the users
+	///\param complete if not null, set to whether every user could be looked 
+	///                up; if not, some of the invalid user objects returned may 
+	///                be for users which do exist but could not be read
+	///\return the corresponding users, in the same order as ids, with an 
+	///        invalid user object for each ID which is not known
+	std::vector<User> getUsers(const std::vector<std::string>& ids, bool* complete=nullptr);
+	
+	///Find the user who owns the given access token. When the user's record is 
+	///not cached, only the attributes needed to authenticate the user and make 
+	///authorization decisions are retrieved, in a single query: the user's 
+	///unixName, name, email address, phone number, token, and superuser and 
+	///service account status. 
 	///\param token access token
 	///\return the token owner or an invalid user object if the token is not known
 	User findUserByToken(const std::string& token);
@@ -173,20 +225,36 @@ public:
 	///\return the corresponding user or an invalid user object if the ID is not known
 	User findUserByGlobusID(const std::string& globusID);
 	
-	///Change a user record
+	///Change a user record. Only the attributes which the request supplied 
+	///are written, and nothing is written if it supplied none. The record is 
+	///not recreated if it has been deleted. 
 	///\param user the updated user record, with an ID matching the previous ID
-	///\param user the previous user record
+	///\param oldUser the previous user record
+	///\param attributes the names of the database attributes to write
 	///\return Whether the user record was successfully altered in the database
-	bool updateUser(const User& user, const User& oldUser);
+	bool updateUser(const User& user, const User& oldUser, const std::set<std::string>& attributes);
+	
+	///Record that a user has been active. The cached record is changed 
+	///immediately, but the database is only updated periodically, so that 
+	///repeated uses by the same user are written once. 
+	///\param user the user record, with its new last use time
+	void updateLastUseTime(const User& user);
 	
-	///Delete a user record
+	///Write all pending last use times to the database
+	///\return whether all were written. Any which were not are kept to be 
+	///        tried again. 
+	bool flushLastUseTimes();
+	
+	///Delete a user record, along with the user's secondary attributes and 
+	///group memberships
 	///\param id the ID of the user to delete
-	///\return Whether the user record was successfully removed from the database
+	///\return Whether all of the user's records were successfully removed from 
+	///        the database
 	bool removeUser(const std::string& id);
 	
 	///Compile a list of all current user records
-	///\return all users, but with only IDs, names, and email addresses
-	std::vector<User> listUsers();
+	///\return summaries of all users, which omit their credentials
+	std::vector<UserSummary> listUsers();
 
 	///Compile a list of all current user records for the given group
 	///\return all users from the given group, but with only IDs, names, and email addresses
@@ -199,6 +267,14 @@ public:
 	///\return wther the addition operation succeeded
 	bool setUserStatusInGroup(const GroupMembership& membership);
 	
+	///Set the statuses of several users within groups at once, using batched 
+	///writes. The writes are not atomic as a group. 
+	///Should not be used for non-member status, instead use removeUserFromGroup
+	///\param memberships the memberships to store, no two of which may be for 
+	///                   the same user and group
+	///\return whether each membership, in the same order, was stored
+	std::vector<bool> setUserStatusesInGroups(const std::vector<GroupMembership>& memberships);
+	
 	///Remove a user from a group
 	///\param uID the ID of the user to remove
 	///\param groupID the ID of the group from which to remove the user
@@ -209,20 +285,54 @@ public:
 	///\param uID the ID of the user to look up
 	///\param useNames if true perform the necessary extra lookups to transform
 	///                the group IDs into the more human-friendly names
+	///\param complete if not null, set to whether all of the user's memberships 
+	///                could be read
 	///\return the IDs or names of all groups to which the user belongs
-	std::vector<GroupMembership> getUserGroupMemberships(const std::string& uID);
+	std::vector<GroupMembership> getUserGroupMemberships(const std::string& uID, bool* complete=nullptr);
 	
 	///Check whether a user is a member of a group
 	///\param uID the ID of the user to look up
 	///\param groupID the ID of the group to look up
+	///\param expiration if not null, set to the time after which the record 
+	///                  returned should no longer be relied upon
 	///\return whether the user is a member of the group
-	GroupMembership userStatusInGroup(const std::string& uID, std::string groupName);
+	GroupMembership userStatusInGroup(const std::string& uID, std::string groupName, 
+	                                  std::chrono::steady_clock::time_point* expiration=nullptr);
+	
+	///Find the nearest group enclosing a group of which a user is an admin, 
+	///using the set of groups which the user administers. This set is built 
+	///from the user's memberships when first needed and then kept until one of 
+	///them changes, and the answer for each group is remembered, so that 
+	///repeated checks are a single hash table lookup.
+	///\param uID the ID of the user whose admin status should be checked
+	///\param groupName the group whose enclosing groups should be checked; this 
+	///                 group itself is _not_ checked
+	///\param expiration if not null, set to the time after which the answer 
+	///                  should no longer be relied upon, which is when the 
+	///                  memberships from which it was found expire
+	///\param complete if not null, set to whether all of the user's memberships 
+	///                could be read. If not, the answer may be wrong. 
+	///\return the name of the most closely enclosing group of which the user is 
+	///        an admin, or the empty string if there is none
+	std::string enclosingAdminGroup(const std::string& uID, const std::string& groupName, 
+	                                std::chrono::steady_clock::time_point* expiration=nullptr, 
+	                                bool* complete=nullptr);
+	
+	///\return the object which checks whether users may perform actions on 
+	///        groups
+	Authorizer& getAuthorizer(){ return authorizer; }
 	
 	///\return whether the attribute was successfully recorded
 	bool setUserSecondaryAttribute(const std::string& uID, const std::string& attributeName, const std::string& attributeValue);
 	
 	std::string getUserSecondaryAttribute(const std::string& uID, const std::string& attributeName);
 	
+	///Get all of a user's secondary attributes
+	///\param uID the ID of the user
+	///\return the names and values of the user's attributes. Empty if the user 
+	///        has no attributes, or does not exist.
+	std::map<std::string,std::string> getUserSecondaryAttributes(const std::string& uID);
+	
 	///\return whether the attribute was successfully deleted
 	bool removeUserSecondaryAttribute(const std::string& uID, const std::string& attributeName);
 	
@@ -244,30 +354,81 @@ public:
 	///\return whether the addition operation was successful
 	bool addGroupRequest(GroupRequest& gr);
 	
-	///Delete a group record
+	///Delete a group (or group request) record, along with the group's 
+	///secondary attributes and memberships
 	///\param groupID the ID of the group to delete
 	///\return Whether the user record was successfully removed from the database
 	bool removeGroup(const std::string& groupName);
 	
-	///Change a group record
-	///\param group the updated group record, which must have matching ID 
-	///          with the old record
+	///Change a group record. Only the attributes which the request supplied 
+	///are written, and nothing is written if it supplied none. The record is 
+	///not recreated if it has been deleted. 
+	///\param group the updated group record
+	///\param attributes the names of the database attributes to write
 	///\return Whether the group record was successfully altered in the database
-	bool updateGroup(const Group& group);
+	bool updateGroup(const Group& group, const std::set<std::string>& attributes);
 	
-	bool updateGroupRequest(const GroupRequest& request);
+	///Change a group request record, writing only the attributes which the 
+	///request supplied, in the same manner as updateGroup
+	///\param request the updated request, with the same name as the old one
+	///\param attributes the names of the database attributes to write
+	///\return Whether the request record was successfully altered in the database
+	bool updateGroupRequest(const GroupRequest& request, const std::set<std::string>& attributes);
 	
 	///Find all users who belong to a group
 	///\groupID the ID of the group whose members are to be found
 	///\return the IDs of all members of the group
 	std::vector<GroupMembership> getMembersOfGroup(const std::string groupName);
 	
+	///A portion of the members of a group
+	struct MembershipPage{
+		MembershipPage():valid(false){}
+		///Whether the page could be read
+		bool valid;
+		std::vector<GroupMembership> memberships;
+		///The value to pass to getMembersOfGroupPage to read the following 
+		///page, or empty if there are no further members
+		std::string cursor;
+	};
+	
+	///Read one page of the members of a group from the database
+	///\param groupName the name of the group whose members are to be found
+	///\param limit the maximum number of memberships to read, or zero to read 
+	///             as many as fit in one database response
+	///\param cursor empty to read the first page, otherwise the cursor 
+	///              returned with the previous page
+	///\return the page, which is invalid if the database could not be read
+	MembershipPage getMembersOfGroupPage(const std::string& groupName, unsigned int limit, 
+	                                     const std::string& cursor);
+	
+	///Visit every member of a group, reading one page at a time so that 
+	///large groups need not be held in memory all at once. The complete list 
+	///is used instead if it is cached. 
+	///\param groupName the name of the group whose members are to be found
+	///\param visit the function to call with each membership
+	///\return false if the memberships could not all be read, in which case 
+	///        visit may already have been called for some of them
+	bool forEachMemberOfGroup(const std::string& groupName, 
+	                          const std::function<void(const GroupMembership&)>& visit);
+	
 	///Find all current groups
 	///\return all recorded groups
 	std::vector<Group> listGroups();
 	
 	std::vector<GroupRequest> listGroupRequests();
 	
+	///Find the groups enclosed by a group
+	///\param groupName the enclosing group, in canonical form
+	///\param maxDepth the number of levels below the group to include, so that
+	///                1 finds only its direct subgroups, or zero for all levels
+	///\return the subgroups, ordered so that each precedes its own subgroups
+	std::vector<Group> listSubgroups(const std::string& groupName, unsigned int maxDepth=0);
+	
+	///Find the requests to create groups within a group
+	///\param groupName the enclosing group, in canonical form
+	///\return the requests for groups at any level below the group
+	std::vector<GroupRequest> listSubgroupRequests(const std::string& groupName);
+	
 	std::vector<GroupRequest> listGroupRequestsByRequester(const std::string& requester);
 	
 	///Find the group, if any, with the given UUID or name
@@ -275,6 +436,19 @@ public:
 	///\return the group corresponding to the name, or an invalid group if none exists
 	Group getGroup(const std::string& groupName);
 	
+	//Asynchronous lookups, for issuing several independent lookups at once. 
+	//Each returns immediately: a cached result is ready at once, otherwise 
+	//the database request is issued on the database client's executor and the 
+	//future becomes ready when it completes. Results are cached exactly as 
+	//for the synchronous versions.
+	
+	///Asynchronous version of getUser
+	std::future<User> getUserAsync(const std::string& id);
+	///Asynchronous version of getGroup
+	std::future<Group> getGroupAsync(const std::string& groupName);
+	///Asynchronous version of userStatusInGroup
+	std::future<GroupMembership> userStatusInGroupAsync(const std::string& uID, std::string groupName);
+	
 	GroupRequest getGroupRequest(const std::string& groupName);
 	
 	bool approveGroupRequest(const std::string& groupName);
@@ -284,19 +458,111 @@ public:
 	
 	std::string getGroupSecondaryAttribute(const std::string& groupName, const std::string& attributeName);
 	
+	///Get all of a group's secondary attributes
+	///\param groupName the name of the group
+	///\return the names and values of the group's attributes. Empty if the 
+	///        group has no attributes, or does not exist.
+	std::map<std::string,std::string> getGroupSecondaryAttributes(const std::string& groupName);
+	
 	///\return whether the attribute was successfully deleted
 	bool removeGroupSecondaryAttribute(const std::string& groupName, const std::string& attributeName);
 	
 	///Return human-readable performance statistics
 	std::string getStatistics() const;
 	
+	///Set the memory budget for all caches together. The budget is divided 
+	///among the individual caches in fixed proportions. 
+	///\param bytes the total budget, or zero to remove all limits
+	void setCacheMemoryLimit(std::size_t bytes);
+	
+	///Set the memory budget for a single cache, overriding its share of any 
+	///total limit
+	///\param cacheName the name of the cache, as reported by getStatistics
+	///\param bytes the budget, or zero to remove the cache's limit
+	///\return false if no cache has the given name
+	bool setCacheMemoryBudget(const std::string& cacheName, std::size_t bytes);
+	
+	///Configure how frequently used records are kept fresh
+	///\param refreshAhead records used within this long before they expire 
+	///                    are reloaded in the background, while the cached 
+	///                    copy continues to be served
+	///\param staleGrace records which have expired less than this long ago 
+	///                  may be served while a background reload is in progress, 
+	///                  rather than being reloaded synchronously
+	void setCacheRefreshPolicy(std::chrono::seconds refreshAhead, std::chrono::seconds staleGrace);
+	
+	///Share changes with other instances using the same database, so that 
+	///cached data modified by any instance is promptly discarded by all. 
+	///This should be called before the store is used by multiple threads. 
+	///\param feed the feed through which to publish and receive changes
+	///\param pollInterval how often to check for changes made by other instances
+	void setChangeFeed(std::shared_ptr<ChangeFeed> feed, std::chrono::milliseconds pollInterval);
+	
+	///Preserve the contents of the caches across restarts. If a snapshot 
+	///file already exists its records are loaded into the caches, marked as 
+	///about to expire so that they are revalidated in the background, and a 
+	///new snapshot will be saved when the store is destroyed. 
+	///This should be called before the store is used by multiple threads. 
+	///\param path the snapshot file to read and write
+	///\param interval how often to save a snapshot while running, or zero to 
+	///                save only at destruction
+	void enableCacheSnapshots(const std::string& path, std::chrono::seconds interval);
+	
+	///Fill the caches by reading both tables in their entirety, using 
+	///parallel scans. When this succeeds all users, groups, memberships, and 
+	///secondary attributes are cached, and listings can be served from the 
+	///cache. 
+	///This should be called before the store is used by multiple threads. 
+	///\param segments the number of segments into which each table is divided 
+	///                and which are scanned concurrently
+	///\return whether all records were read successfully. Even if not, any 
+	///        records which were read remain cached.
+	bool prewarmCaches(unsigned int segments);
+	
+	///Set how many segments full table scans (of users, groups, and group 
+	///requests, and when cleaning up after deletions) are divided into to be 
+	///read concurrently. At most bulkThreads segments are read at once. 
+	///\param segments the number of segments, where zero is treated as one
+	void setScanParallelism(unsigned int segments){ scanSegments=segments?segments:1; }
+	
+	///Set how many unix IDs are leased at once for new users and groups. 
+	///Larger blocks mean fewer updates of the shared counter when many 
+	///accounts are created, but leave larger gaps when the server stops. 
+	///\param size the number of IDs, where zero is treated as one
+	void setUnixIDBlockSize(unsigned int size){
+		userIDAllocator.setBlockSize(size);
+		groupIDAllocator.setBlockSize(size);
+	}
+	
+	///Set how often users' last use times are written to the database. All 
+	///pending times are also written when the store is destroyed. 
+	///\param interval the time between writes, where zero is treated as one 
+	///                second
+	void setLastUseFlushInterval(std::chrono::seconds interval){ 
+		lastUseFlushInterval=interval.count()?interval:std::chrono::seconds(1);
+	}
+	
+	///Write the current contents of the caches to the snapshot file
+	///\return whether the snapshot was saved. Fails if snapshots have not 
+	///        been enabled.
+	bool saveCacheSnapshot();
+	
 	const User& getRootUser() const{ return rootUser; }
 	
 	EmailClient& getEmailClient(){ return emailClient; }
 	
 private:
-	///Database interface object
-	Aws::DynamoDB::DynamoDBClient dbClient;
+	///The database, which handles rate limiting and retries of its requests
+	std::shared_ptr<StorageEngine> engine;
+	
+	//Requests to the database, made through the storage engine
+	Aws::DynamoDB::Model::GetItemOutcome getItem(const Aws::DynamoDB::Model::GetItemRequest& request);
+	Aws::DynamoDB::Model::BatchGetItemOutcome batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request);
+	Aws::DynamoDB::Model::QueryOutcome query(const Aws::DynamoDB::Model::QueryRequest& request);
+	Aws::DynamoDB::Model::PutItemOutcome putItem(const Aws::DynamoDB::Model::PutItemRequest& request);
+	Aws::DynamoDB::Model::UpdateItemOutcome updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request);
+	Aws::DynamoDB::Model::DeleteItemOutcome deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request);
+	Aws::DynamoDB::Model::TransactWriteItemsOutcome transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request);
 	///Name of the users table in the database
 	const std::string userTableName;
 	///Name of the groups table in the database
@@ -306,32 +572,129 @@ private:
 	const static unsigned int minimumGroupID, maximumGroupID;
 	const static std::string nextIDKeyName;
 	
+	///Leases blocks of unix IDs from the next ID record of one table
+	class IDCounter : public UnixIDAllocator::LeaseSource{
+	public:
+		IDCounter(PersistentStore& store, std::string tableName, std::string nameKeyName, 
+		          unsigned int minID, unsigned int maxID):
+		store(store),tableName(std::move(tableName)),nameKeyName(std::move(nameKeyName)),
+		minID(minID),maxID(maxID){}
+		bool lease(unsigned int size, unsigned int& first, unsigned int& end) override;
+		bool giveBack(unsigned int first, unsigned int end) override;
+	private:
+		PersistentStore& store;
+		const std::string tableName;
+		const std::string nameKeyName;
+		const unsigned int minID, maxID;
+	};
+	IDCounter userIDCounter, groupIDCounter;
+	///Allocators which hand out IDs leased from the counters. The store's 
+	///destructor gives back any unused IDs. 
+	UnixIDAllocator userIDAllocator, groupIDAllocator;
+	
 	User rootUser;
 	
 	EmailClient emailClient;
 	
 	///duration for which cached user records should remain valid
 	const std::chrono::seconds userCacheValidity;
-	connect_atomic<std::chrono::steady_clock::time_point> userCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<User>> userCache;
-	cuckoohash_map<std::string,CacheRecord<User>> userByTokenCache;
-	cuckoohash_map<std::string,CacheRecord<User>> userByGlobusIDCache;
-	///This cache holds secondary user attributes
-	cuckoohash_map<std::string,std::map<std::string,CacheRecord<std::string>>> userAttributeCache;
+	bounded_cache<std::string,CacheRecord<User>> userCache;
+	bounded_cache<std::string,CacheRecord<User>> userByTokenCache;
+	bounded_cache<std::string,CacheRecord<User>> userByGlobusIDCache;
+	///The tokens under which incomplete records read from the ByTokenAuth 
+	///index are cached, keyed by user. These records are not in userCache, so this 
+	///is needed to find them when the user changes. 
+	cuckoohash_map<std::string,std::string> indexedTokens;
+	///Discard any incomplete record read from the ByTokenAuth index for a user
+	void forgetIndexedToken(const std::string& uID);
+	///Whether the ByTokenAuth index, which carries the attributes needed to 
+	///authenticate a user, is active. Until it is, tokens are looked up in the 
+	///older ByToken index, which only carries unixName. 
+	std::atomic<bool> tokenIndexActive;
+	///The earliest time at which the status of the ByTokenAuth index should 
+	///be checked again
+	connect_atomic<std::chrono::steady_clock::time_point> nextTokenIndexCheck;
+	///duration for which the absence of a user, token, or Globus ID is remembered
+	const std::chrono::seconds negativeCacheValidity;
+	///This cache records lookups which found no matching user. Keys are the 
+	///value sought prefixed with the kind of lookup (see knownUserKey).
+	bounded_cache<std::string,std::chrono::steady_clock::time_point> userNegativeCache;
+	///A filter of all known user names, tokens, and Globus IDs, which can 
+	///answer that a value is definitely unknown without consulting the database. 
+	///It is only trusted until its expiration time, since it must be built from 
+	///a complete scan of the users table, and only while a change feed is 
+	///attached, since otherwise users added by other instances never reach it. 
+	///It is built in the background when first needed. 
+	std::shared_ptr<bloom_filter> knownUserFilter;
+	///A filter being filled by a scan in progress, which must also receive 
+	///any users added in the meantime
+	std::shared_ptr<bloom_filter> pendingKnownUserFilter;
+	std::chrono::steady_clock::time_point knownUserFilterExpiration;
+	///Protects the filter pointers and the expiration time
+	mutable std::mutex knownUserFilterMutex;
+	std::atomic<bool> knownUserFilterRebuilding;
+	///A complete set of one user's or group's secondary attributes
+	using AttributeRecord=CacheRecord<std::shared_ptr<const attribute_table>>;
+	///This cache holds secondary user attributes. All of a user's attributes 
+	///are loaded and cached together. 
+	bounded_cache<std::string,AttributeRecord> userAttributeCache;
 	///This cache holds individual membership records, keyed by userID:groupName
-	cuckoohash_map<std::string,CacheRecord<GroupMembership>> groupMembershipCache;
+	bounded_cache<std::string,CacheRecord<GroupMembership>> groupMembershipCache;
 	///This cache holds all memberships associated with each user
 	concurrent_multimap<std::string,CacheRecord<GroupMembership>> groupMembershipByUserCache;
 	///This cache holds all memberships associated with each group
 	concurrent_multimap<std::string,CacheRecord<GroupMembership>> groupMembershipByGroupCache;
-	///This cache holds secondary group attributes
-	cuckoohash_map<std::string,std::map<std::string,CacheRecord<std::string>>> groupAttributeCache;
+	///The groups of which one user is an admin, along with the answers already 
+	///found by enclosingAdminGroup
+	struct AdminClosure{
+		std::unordered_set<std::string> administered;
+		///Maps group names to the nearest strictly enclosing group in 
+		///administered, or the empty string if there is none
+		cuckoohash_map<std::string,std::string> enclosing;
+		///Whether all of the user's memberships could be read. Incomplete 
+		///closures are never cached. 
+		bool complete;
+	};
+	friend std::size_t memory_footprint(const AdminClosure& closure);
+	///Each user's admin closure, keyed by user ID, which expires along with 
+	///the list of memberships from which it was built
+	bounded_cache<std::string,CacheRecord<std::shared_ptr<AdminClosure>>> adminClosureCache;
+	///Incremented by every invalidation, so that a closure built from 
+	///memberships which were read before an invalidation is not kept
+	std::atomic<uint64_t> adminClosureGeneration;
+	///Serializes installing closures with invalidating them
+	std::mutex adminClosureMutex;
+	///\param expiration set to the time after which the closure should no 
+	///                  longer be used
+	///\return the admin closure for a user, building it if necessary
+	std::shared_ptr<AdminClosure> getAdminClosure(const std::string& uID, 
+	                                              std::chrono::steady_clock::time_point& expiration);
+	///Decides and remembers which actions users may perform on groups
+	Authorizer authorizer;
+	///Discard a user's admin closure and authorization decisions because the 
+	///user or the user's memberships have changed
+	void invalidateAuthorization(const std::string& uID);
+	///This cache holds secondary group attributes, in the same manner as 
+	///userAttributeCache
+	bounded_cache<std::string,AttributeRecord> groupAttributeCache;
 	///duration for which cached group records should remain valid
 	const std::chrono::seconds groupCacheValidity;
-	connect_atomic<std::chrono::steady_clock::time_point> groupCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<Group>> groupCache;
-	connect_atomic<std::chrono::steady_clock::time_point> groupRequestCacheExpirationTime;
-	cuckoohash_map<std::string,CacheRecord<GroupRequest>> groupRequestCache;
+	bounded_cache<std::string,CacheRecord<Group>> groupCache;
+	bounded_cache<std::string,CacheRecord<GroupRequest>> groupRequestCache;
+	
+	///The groups and group requests arranged by name, so that the subgroups of
+	///a group can be found without examining all groups. Each observes the 
+	///corresponding directory below, and so is complete whenever it is.
+	group_tree<Group> groupTree;
+	group_tree<GroupRequest> groupRequestTree;
+	
+	///Snapshots of all users, groups, and group requests used to answer list 
+	///requests without locking the caches above. These are complete only after 
+	///a full scan, and are kept current by every write which passes through 
+	///this object.
+	versioned_directory<std::string,UserSummary> userDirectory;
+	versioned_directory<std::string,Group> groupDirectory;
+	versioned_directory<std::string,GroupRequest> groupRequestDirectory;
 	
 	///Check that all necessary tables exist in the database, and create them if 
 	///they do not
@@ -363,6 +726,9 @@ private:
 	                   unsigned int next,
 	                   const std::string& recordName);
 	
+	///Take IDs from an allocator until one is found which is not in use, and 
+	///reserve it by writing a placeholder record
+	///\param allocator the allocator from which to take IDs
 	///\param tableName the name of the table in which to allocate the ID
 	///\param nameKeyName the name used for the hash key used by the table in 
 	///                   which the ID is to be allocated
@@ -371,7 +737,8 @@ private:
 	///\param maxID the maximum allowed ID number in the table, as part of a 
 	///                 half-open range
 	///\param recordName the name of the record for which the ID will be allocated
-	unsigned int allocateUnixID(const std::string& tableName, 
+	unsigned int allocateUnixID(UnixIDAllocator& allocator, 
+	                            const std::string& tableName, 
 	                            const std::string& nameKeyName, 
 	                            const unsigned int minID, 
 	                            const unsigned int maxID, 
@@ -383,7 +750,288 @@ private:
 	                            std::string recordName,
 	                            unsigned int targetID);
 	
+	///Build a key for the negative cache or known user filter
+	///\param kind the kind of lookup, e.g. "token"
+	///\param value the value being looked up
+	static std::string knownUserKey(const char* kind, const std::string& value){
+		return std::string(kind)+":"+value;
+	}
+	///Check whether a lookup is already known to have no result, either from 
+	///the negative cache or from the known user filter
+	///\param key a key constructed by knownUserKey
+	///\return true if the value is definitely not associated with any user
+	bool knownToBeAbsent(const std::string& key);
+	///Remember that a lookup found no result
+	///\param key a key constructed by knownUserKey
+	void recordAbsent(const std::string& key);
+	///Make a user's name, token, and Globus ID known, clearing any negative 
+	///cache entries which would contradict them
+	void recordUserPresent(const User& user);
+	///Start building a replacement for the known user filter
+	///\return the new filter, which should be filled and passed to 
+	///        finishKnownUserFilterRebuild, or null if another rebuild is 
+	///        already in progress
+	std::shared_ptr<bloom_filter> beginKnownUserFilterRebuild();
+	///Install (or discard, if the rebuild failed) a filter returned by 
+	///beginKnownUserFilterRebuild
+	void finishKnownUserFilterRebuild(std::shared_ptr<bloom_filter> filter, bool success);
+	///Insert all identifying values for a user into a filter
+	static void addToFilter(bloom_filter& filter, const User& user);
+	///Scan the users table to build a new known user filter
+	void rebuildKnownUserFilter();
+	
+	///Fetch a user record from the database, bypassing the cache
+	User loadUser(const std::string& id);
+	///Interpret the result of fetching a user record, updating the caches
+	User finishLoadUser(const std::string& id, const Aws::DynamoDB::Model::GetItemOutcome& outcome);
+	///Interpret the result of fetching a group record, updating the caches
+	Group finishLoadGroup(const std::string& groupName, const Aws::DynamoDB::Model::GetItemOutcome& outcome);
+	///Fetch several user records from the database with a single batch read, 
+	///bypassing the cache
+	///\param ids the IDs of the users, of which there may be at most 
+	///           batchGetLimit
+	///\param complete set to whether every ID was answered, so that those not 
+	///                found are known not to exist
+	///\return the users which were found, indexed by ID
+	std::map<std::string,User> loadUsers(const std::vector<std::string>& ids, bool& complete);
+	///The maximum number of items DynamoDB allows in one BatchGetItem request
+	static const std::size_t batchGetLimit;
+	///The number of times to request items a batch read left unprocessed
+	static const unsigned int batchRetryLimit;
+	///Look up a user by token in the database, bypassing the cache
+	User loadUserByToken(const std::string& token);
+	///Check in the background whether the ByTokenAuth index has become active, 
+	///unless this was done recently
+	void checkTokenIndexStatus();
+	///Fetch a membership record from the database, bypassing the cache
+	GroupMembership loadUserStatusInGroup(const std::string& uID, const std::string& groupName);
+	///Interpret the result of fetching a membership record, updating the caches
+	GroupMembership finishLoadUserStatusInGroup(const std::string& uID, const std::string& groupName, 
+	                                            const Aws::DynamoDB::Model::GetItemOutcome& outcome);
+	///Issue a GetItem request without waiting for it
+	///\param request the request to issue
+	///\param finish a callable which will be passed the request's outcome, on 
+	///              one of the database client's threads, and whose result 
+	///              fulfills the returned future
+	template<typename Result, typename Finish>
+	std::future<Result> getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, Finish finish);
+	///The number of asynchronous requests whose handlers have not finished
+	std::size_t pendingAsyncRequests;
+	std::mutex asyncMutex;
+	///Signaled when an asynchronous request's handler finishes
+	std::condition_variable asyncDone;
+	///Fetch all of a user's memberships from the database, bypassing the cache
+	///\return all of a user's memberships as a single page, which is invalid if 
+	///        any part of the list could not be read
+	MembershipPage loadUserGroupMemberships(const std::string& uID);
+	///Fetch all of a group's memberships from the database, bypassing the cache
+	std::vector<GroupMembership> loadMembersOfGroup(const std::string& groupName);
+	///Get all of a user's or group's secondary attributes, from the cache if 
+	///possible
+	///\param cache the cache of attributes for the kind of entity
+	///\param tableName the table in which the entity's attributes are stored
+	///\param keyName the name of the table's hash key
+	///\param owner the name of the entity
+	///\param validity how long to cache newly loaded attributes
+	///\return the attributes, or null if they could not be loaded
+	std::shared_ptr<const attribute_table> 
+	getSecondaryAttributes(bounded_cache<std::string,AttributeRecord>& cache, 
+	                       const std::string& tableName, const std::string& keyName, 
+	                       const std::string& owner, std::chrono::seconds validity);
+	///Fetch all of a user's or group's secondary attributes from the database 
+	///with a single query, bypassing the cache
+	std::shared_ptr<const attribute_table> 
+	loadSecondaryAttributes(bounded_cache<std::string,AttributeRecord>& cache, 
+	                        const std::string& tableName, const std::string& keyName, 
+	                        const std::string& owner, std::chrono::seconds validity);
+	///Scan the database for the public attributes of all users, rebuilding 
+	///the user directory
+	std::vector<UserSummary> scanUsers();
+	///Scan the database for all groups, rebuilding the group directory
+	std::vector<Group> scanGroups();
+	///Scan the database for all group requests, rebuilding the request directory
+	std::vector<GroupRequest> scanGroupRequests();
+	///The complete records read from one segment of a table by prewarmCaches
+	struct PrewarmBatch{
+		std::vector<User> users;
+		std::vector<GroupMembership> memberships;
+		std::vector<Group> groups;
+		std::vector<GroupRequest> groupRequests;
+		std::vector<CacheSnapshot::Attribute> userAttributes;
+		std::vector<CacheSnapshot::Attribute> groupAttributes;
+	};
+	///Cache a record read by prewarmCaches, and add it to a batch
+	void prewarmItem(const std::string& tableName, const ParallelScan::Item& item, PrewarmBatch& batch);
+	std::atomic<unsigned int> prewarmSegments, prewarmSegmentsDone;
+	std::atomic<size_t> prewarmedItems;
+	///The time taken by the prewarm, or -1 if it has not finished
+	std::atomic<long> prewarmMilliseconds;
+	std::atomic<bool> prewarmFailed;
+	
+	//Database reads which are in progress, so that concurrent requests for the 
+	//same data can share a single read. Keys are prefixed with the kind of 
+	//lookup where one object serves several.
+	single_flight<std::string,User> userLoads;
+	single_flight<std::string,GroupMembership> membershipLoads;
+	single_flight<std::string,std::vector<GroupMembership>> membershipListLoads;
+	single_flight<std::string,MembershipPage> userMembershipListLoads;
+	single_flight<std::string,std::vector<UserSummary>> userScans;
+	single_flight<std::string,std::vector<Group>> groupScans;
+	single_flight<std::string,std::vector<GroupRequest>> groupRequestScans;
+	single_flight<std::string,std::shared_ptr<const attribute_table>> attributeLoads;
+	
+	///Records used within this long of expiring are reloaded in the background
+	connect_atomic<std::chrono::seconds> refreshAheadWindow;
+	///Records which expired less than this long ago may be served while a 
+	///reload is in progress
+	connect_atomic<std::chrono::seconds> staleGracePeriod;
+	///Decide whether a cached record may be used, and start a background 
+	///reload if it is close to expiring or has recently expired
+	///\param expiration the record's expiration time
+	///\param refreshKey a key identifying the reload, so that concurrent 
+	///                  requests for the same record start only one
+	///\param reload the function which reloads the record into the cache
+	///\return whether the cached record should be returned
+	bool useCachedRecord(std::chrono::steady_clock::time_point expiration, 
+	                     const std::string& refreshKey, std::function<void()> reload);
+	///Keys of the reloads currently running in the background
+	cuckoohash_map<std::string,bool> refreshesInFlight;
+	std::atomic<size_t> backgroundRefreshes, staleHits;
+	
+	///A type-erased reference to one of the bounded caches, used for 
+	///configuring and reporting on them uniformly
+	struct CacheHandle{
+		std::string name;
+		///The percentage of the total memory limit allotted to this cache
+		unsigned int share;
+		std::function<std::size_t()> size;
+		std::function<std::size_t()> residentBytes;
+		std::function<std::size_t()> budget;
+		std::function<std::size_t()> evictions;
+		std::function<void(std::size_t)> setBudget;
+		///Erase the entry with the given key if it expired before the cutoff
+		///\return whether an entry was erased
+		std::function<bool(const std::string&,std::chrono::steady_clock::time_point)> sweep;
+		///The address of the cache, used to identify it when scheduling expiry
+		const void* address;
+	};
+	template<typename Cache>
+	static CacheHandle makeCacheHandle(const std::string& name, unsigned int share, Cache& cache);
+	///All bounded caches
+	std::vector<CacheHandle> cacheHandles;
+	
+	///An entry which should be checked for expiration: the index of its cache
+	///in cacheHandles and its key
+	using ExpiryItem=std::pair<uint8_t,std::string>;
+	///Tracks the expiration times of all cache entries, so that expired 
+	///entries can be removed without searching for them
+	timer_wheel<ExpiryItem> expiryWheel;
+	///Background thread which removes expired cache entries
+	std::thread expirySweeper;
+	///Used to tell background threads to stop
+	std::mutex maintenanceMutex;
+	std::condition_variable maintenanceWakeup;
+	bool stopMaintenance;
+	std::atomic<size_t> sweptEntries;
+	///Remove expired cache entries until asked to stop
+	void runExpirySweeper();
+	///Arrange for a cache entry to be checked for expiration
+	///\param cache the cache containing the entry
+	///\param key the entry's key
+	///\param expiration the time after which the entry will have expired
+	template<typename Cache>
+	void scheduleExpiry(const Cache& cache, const std::string& key, 
+	                    std::chrono::steady_clock::time_point expiration);
+	///Store a record in a cache, replacing any existing record for the same 
+	///key, and schedule its removal once it expires
+	template<typename Cache, typename Value>
+	void cacheRecord(Cache& cache, const std::string& key, const Value& value);
+	
+	///Source of changes made by other instances, and destination for changes 
+	///made by this one, if any
+	std::shared_ptr<ChangeFeed> changeFeed;
+	///Background thread which applies changes received from the feed
+	std::thread changeFeedReader;
+	std::atomic<size_t> appliedChanges;
+	///Tell other instances about a change made by this one
+	void announceChange(ChangeEvent::Kind kind, const std::string& subject, const std::string& detail="");
+	///Receive changes from the feed until asked to stop
+	void runChangeFeedReader(std::chrono::milliseconds pollInterval);
+	///Discard cached data affected by a change made by another instance, 
+	///reloading records which are needed to keep the directories complete
+	void applyChange(const ChangeEvent& event);
+	
+	///The file to which the caches are saved, if any
+	std::string cacheSnapshotPath;
+	///Background thread which saves the caches periodically
+	std::thread cacheSnapshotWriter;
+	///Serializes writing the snapshot file
+	std::mutex cacheSnapshotMutex;
+	std::atomic<size_t> restoredRecords, savedSnapshots;
+	///Save the caches at the given interval until asked to stop
+	void runCacheSnapshotWriter(std::chrono::seconds interval);
+	
+	///Last use times which have not yet been written to the database, by user
+	std::map<std::string,std::string> pendingLastUseTimes;
+	mutable std::mutex lastUseMutex;
+	///How often pending last use times are written
+	connect_atomic<std::chrono::seconds> lastUseFlushInterval;
+	///Background thread which writes pending last use times
+	std::thread lastUseWriter;
+	std::atomic<size_t> recordedLastUses, writtenLastUses;
+	///Write pending last use times periodically until asked to stop
+	void runLastUseWriter();
+	///Gather all unexpired cached records
+	CacheSnapshot collectCacheSnapshot();
+	///Fill the caches from a snapshot, without replacing any records which are 
+	///already cached, and start reloading the complete directories it contains
+	///\return the number of records used
+	std::size_t restoreCacheSnapshot(const CacheSnapshot& snapshot);
+	
+	///The number of threads in bulkPool
+	static const unsigned int bulkThreads;
+	///The number of segments into which full table scans are divided
+	std::atomic<unsigned int> scanSegments;
+	///Threads which perform the parts of bulk operations: the segments of 
+	///full table scans and the batches of batch reads and writes. This is 
+	///separate from backgroundPool, whose tasks may themselves wait for bulk 
+	///operations.
+	ThreadPool bulkPool;
+	///\return an object for performing a parallel scan of either table
+	ParallelScan makeScan(){ return ParallelScan(*engine,bulkPool,scanSegments.load()); }
+	///\return an object for performing batched writes to either table
+	BatchWriter makeBatchWriter(){ return BatchWriter(*engine,bulkPool); }
+	///Read all pages of a query's results
+	///\param request the query to perform
+	///\param items the variable to which to append the items found
+	///\return whether the query succeeded
+	bool queryAll(Aws::DynamoDB::Model::QueryRequest request, std::vector<BatchWriter::Item>& items);
+	///Delete every record belonging to a user or group: the record itself and 
+	///all secondary records in its partition, and all memberships which refer 
+	///to it
+	///\param tableName the table in which the entity is stored
+	///\param keyName the name of the table's hash key
+	///\param owner the name of the entity
+	///\param membershipIndex the index of the users table by which to find 
+	///                       the entity's memberships, or empty if they are in 
+	///                       its partition
+	///\param deletedMemberships the variable to which to append the 
+	///                          memberships which were deleted, as pairs of 
+	///                          user and group name
+	///\return whether all records were deleted
+	bool cascadeDelete(const std::string& tableName, const std::string& keyName,
+	                   const std::string& owner, const std::string& membershipIndex,
+	                   std::vector<std::pair<std::string,std::string>>& deletedMemberships);
+	///Update the caches to reflect that a user is not a member of a group
+	void forgetMembership(const std::string& uID, const std::string& groupName);
+	
 	std::atomic<size_t> cacheHits, databaseQueries, databaseScans;
+	std::atomic<size_t> negativeCacheHits;
+	
+	///Threads used for background cache maintenance. This is declared last so 
+	///that it is destroyed first, finishing outstanding work while the rest 
+	///of the object is still intact.
+	ThreadPool backgroundPool;
 };
 
 ///\param store the database in which to look up the user
@@ -0,0 +1,125 @@
+#ifndef CONNECT_RATE_LIMITER_H
+#define CONNECT_RATE_LIMITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <aws/dynamodb/DynamoDBErrors.h>
+
+///Limits the rate of requests to each DynamoDB table, separately for each
+///class of operation, using token buckets. Each bucket's rate starts at a
+///ceiling and adapts to the database's throttling responses: it is halved
+///whenever a request is throttled and grows back by a small step with each
+///success (additive increase, multiplicative decrease).
+///Scans are treated as background work: a scan page waits while any other
+///request to the same table is waiting for its bucket, throttling of any read
+///also slows scans of the table, and scans have a lower ceiling.
+class RateLimiter{
+public:
+	///The classes of operations, which are limited separately
+	enum Operation{
+		PointRead, ///< GetItem and BatchGetItem
+		Query,
+		Scan, ///< each page of a scan
+		Write ///< PutItem, UpdateItem, DeleteItem, and batch and transactional writes
+	};
+
+	///The number of times a request is attempted before giving up
+	static const unsigned int attemptLimit;
+
+	///\param ceiling the greatest rate, in requests per second, of each class
+	///               of operation other than scans on each table. The ceiling
+	///               for scan pages is a tenth of this.
+	explicit RateLimiter(double ceiling);
+
+	///Change the greatest rate of requests. Rates which are above the new
+	///ceiling are lowered to it.
+	void setCeiling(double ceiling);
+
+	///Wait until a request may be made
+	void acquire(const std::string& table, Operation op);
+	///Record that a request succeeded, allowing the rate to increase
+	void succeeded(const std::string& table, Operation op);
+	///Record that a request was throttled by the database, reducing the rate
+	void throttled(const std::string& table, Operation op);
+	///\return the time to wait before retrying a request which failed, chosen
+	///        at random from an exponentially growing range ('full jitter'),
+	///        so that clients which failed together do not retry together
+	std::chrono::milliseconds retryDelay(unsigned int attempt);
+	///\return the current rate of an operation on a table, in requests per
+	///        second
+	double currentRate(const std::string& table, Operation op);
+
+	///\return whether an error indicates that the database throttled a request
+	static bool isThrottling(Aws::DynamoDB::DynamoDBErrors error);
+
+	///Perform a database request subject to the rate limit, retrying it with
+	///jittered backoff if it is throttled or fails in another way which the
+	///SDK considers retryable
+	///\param table the table to which the request is made
+	///\param op the class of the request
+	///\param request a callable which performs the request and returns its
+	///               outcome
+	///\return the outcome of the last attempt
+	template<typename Request>
+	auto call(const std::string& table, Operation op, Request request) -> decltype(request()){
+		for(unsigned int attempt=1; ; attempt++){
+			acquire(table,op);
+			auto outcome=request();
+			if(outcome.IsSuccess()){
+				succeeded(table,op);
+				return outcome;
+			}
+			const auto& err=outcome.GetError();
+			bool throttling=isThrottling(err.GetErrorType());
+			if(throttling)
+				throttled(table,op);
+			if((!throttling && !err.ShouldRetry()) || attempt==attemptLimit)
+				return outcome;
+			std::this_thread::sleep_for(retryDelay(attempt));
+		}
+	}
+
+private:
+	static const unsigned int operationCount=4;
+
+	struct Bucket{
+		Bucket():rate(0),ceiling(0),tokens(0){}
+		///The current rate, in requests per second
+		double rate;
+		double ceiling;
+		double tokens;
+		std::chrono::steady_clock::time_point lastRefill;
+	};
+
+	struct Table{
+		Table():interactiveWaiting(0){}
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		Bucket buckets[operationCount];
+		///The number of point reads, queries, and writes waiting for tokens
+		unsigned int interactiveWaiting;
+	};
+
+	std::mutex mutex;
+	double ceiling;
+	std::map<std::string,std::unique_ptr<Table>> tables;
+	std::mt19937 rng;
+
+	///\return the state of a table, which is created if necessary
+	Table& getTable(const std::string& name);
+	///\return the ceiling of a class of operations
+	double ceilingFor(Operation op) const;
+	///Add the tokens accumulated since a bucket was last refilled
+	static void refill(Bucket& bucket, std::chrono::steady_clock::time_point now);
+	///Reduce a bucket's rate in response to throttling
+	static void decrease(Bucket& bucket);
+};
+
+#endif //CONNECT_RATE_LIMITER_H
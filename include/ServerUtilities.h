@@ -89,4 +89,17 @@ std::string to_string(const JSONDocument& json){
 //Check if a command is intended to be silent and not send email
 bool silentMode(const crow::request& req);
 
+///Read an optional non-negative integer query parameter
+///\param req the request whose query parameters should be examined
+///\param name the name of the parameter
+///\param value set to the parameter's value if it is present and valid,
+///             otherwise left unchanged
+///\param minimum the smallest value which should be accepted
+///\param error set to a 400 response naming the parameter if it is present
+///             but is not a decimal number in range
+///\return whether the parameter was absent or valid
+bool unsignedQueryParam(const crow::request& req, const std::string& name, 
+                        unsigned int& value, unsigned int minimum, 
+                        crow::response& error);
+
 #endif //SLATE_SERVER_UTILITIES_H
@@ -0,0 +1,119 @@
+#ifndef CONNECT_STORAGE_ENGINE_H
+#define CONNECT_STORAGE_ENGINE_H
+
+#include <functional>
+#include <string>
+
+#include <aws/core/Aws.h>
+#include <aws/core/auth/AWSCredentialsProvider.h>
+#include <aws/dynamodb/DynamoDBClient.h>
+#include <aws/dynamodb/model/BatchGetItemRequest.h>
+#include <aws/dynamodb/model/BatchWriteItemRequest.h>
+#include <aws/dynamodb/model/CreateTableRequest.h>
+#include <aws/dynamodb/model/DeleteItemRequest.h>
+#include <aws/dynamodb/model/DeleteTableRequest.h>
+#include <aws/dynamodb/model/DescribeTableRequest.h>
+#include <aws/dynamodb/model/GetItemRequest.h>
+#include <aws/dynamodb/model/PutItemRequest.h>
+#include <aws/dynamodb/model/QueryRequest.h>
+#include <aws/dynamodb/model/ScanRequest.h>
+#include <aws/dynamodb/model/TransactWriteItemsRequest.h>
+#include <aws/dynamodb/model/UpdateItemRequest.h>
+#include <aws/dynamodb/model/UpdateTableRequest.h>
+
+#include <RateLimiter.h>
+
+///The database in which PersistentStore keeps its records.
+///Requests and results are expressed with DynamoDB's data model, which the
+///store already uses to describe its tables, items, and queries, so an engine
+///must interpret the same key schemas, secondary indices, and expressions as
+///DynamoDB. Each engine decides for itself how to handle throttling and
+///retries; failures are reported as DynamoDB errors.
+///Implementations must be safe for concurrent use from many threads.
+class StorageEngine{
+public:
+	using GetItemHandler=std::function<void(const Aws::DynamoDB::Model::GetItemOutcome&)>;
+
+	virtual ~StorageEngine(){}
+
+	virtual Aws::DynamoDB::Model::GetItemOutcome getItem(const Aws::DynamoDB::Model::GetItemRequest& request)=0;
+	///Issue a GetItem request without waiting for its result
+	///\param request the request to issue
+	///\param handler a callable which will be passed the request's outcome,
+	///               possibly on another thread. The default implementation
+	///               performs the request immediately, on the calling thread.
+	virtual void getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, GetItemHandler handler);
+	virtual Aws::DynamoDB::Model::BatchGetItemOutcome batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request)=0;
+	virtual Aws::DynamoDB::Model::QueryOutcome query(const Aws::DynamoDB::Model::QueryRequest& request)=0;
+	virtual Aws::DynamoDB::Model::ScanOutcome scan(const Aws::DynamoDB::Model::ScanRequest& request)=0;
+	virtual Aws::DynamoDB::Model::PutItemOutcome putItem(const Aws::DynamoDB::Model::PutItemRequest& request)=0;
+	virtual Aws::DynamoDB::Model::UpdateItemOutcome updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request)=0;
+	virtual Aws::DynamoDB::Model::DeleteItemOutcome deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request)=0;
+	virtual Aws::DynamoDB::Model::BatchWriteItemOutcome batchWriteItem(const Aws::DynamoDB::Model::BatchWriteItemRequest& request)=0;
+	virtual Aws::DynamoDB::Model::TransactWriteItemsOutcome transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request)=0;
+
+	virtual Aws::DynamoDB::Model::DescribeTableOutcome describeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request)=0;
+	virtual Aws::DynamoDB::Model::CreateTableOutcome createTable(const Aws::DynamoDB::Model::CreateTableRequest& request)=0;
+	virtual Aws::DynamoDB::Model::UpdateTableOutcome updateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request)=0;
+	virtual Aws::DynamoDB::Model::DeleteTableOutcome deleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request)=0;
+
+	///Wait before resubmitting the part of a batch request which the engine
+	///left unprocessed
+	///\param tableName the table to which the batch was addressed
+	///\param attempt the number of times the batch has been submitted
+	virtual void waitToRetry(const std::string& tableName, unsigned int attempt)=0;
+
+	///\return a brief, human-readable description of the engine's state
+	virtual std::string describe() const=0;
+};
+
+///Stores records in DynamoDB.
+///All item-level requests pass through a RateLimiter, which also retries
+///those which are throttled; the client's own retries are disabled, since
+///they are unaware of the limits.
+class DynamoDBStorageEngine : public StorageEngine{
+public:
+	///\param credentials the credentials to use to access the database
+	///\param clientConfig the configuration to use to connect to the database
+	///\param rateLimit the greatest rate, in requests per second, of each
+	///                 class of operation on each table
+	DynamoDBStorageEngine(const Aws::Auth::AWSCredentials& credentials,
+	                      const Aws::Client::ClientConfiguration& clientConfig,
+	                      double rateLimit=1000);
+
+	Aws::DynamoDB::Model::GetItemOutcome getItem(const Aws::DynamoDB::Model::GetItemRequest& request) override;
+	void getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, GetItemHandler handler) override;
+	Aws::DynamoDB::Model::BatchGetItemOutcome batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request) override;
+	Aws::DynamoDB::Model::QueryOutcome query(const Aws::DynamoDB::Model::QueryRequest& request) override;
+	Aws::DynamoDB::Model::ScanOutcome scan(const Aws::DynamoDB::Model::ScanRequest& request) override;
+	Aws::DynamoDB::Model::PutItemOutcome putItem(const Aws::DynamoDB::Model::PutItemRequest& request) override;
+	Aws::DynamoDB::Model::UpdateItemOutcome updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request) override;
+	Aws::DynamoDB::Model::DeleteItemOutcome deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request) override;
+	Aws::DynamoDB::Model::BatchWriteItemOutcome batchWriteItem(const Aws::DynamoDB::Model::BatchWriteItemRequest& request) override;
+	Aws::DynamoDB::Model::TransactWriteItemsOutcome transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request) override;
+
+	Aws::DynamoDB::Model::DescribeTableOutcome describeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request) override;
+	Aws::DynamoDB::Model::CreateTableOutcome createTable(const Aws::DynamoDB::Model::CreateTableRequest& request) override;
+	Aws::DynamoDB::Model::UpdateTableOutcome updateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request) override;
+	Aws::DynamoDB::Model::DeleteTableOutcome deleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request) override;
+
+	///Unprocessed items mean that the table's capacity was exceeded, so this
+	///slows down writes to the table as well as waiting
+	void waitToRetry(const std::string& tableName, unsigned int attempt) override;
+
+	std::string describe() const override;
+
+	///Set the greatest rate at which requests of each class (point reads,
+	///queries, and writes) are made to each table. Scans are limited to a
+	///tenth of this. Rates are lowered automatically when the database
+	///throttles requests.
+	///\param requestsPerSecond the maximum rate
+	void setRateLimit(double requestsPerSecond){ limiter.setCeiling(requestsPerSecond); }
+
+private:
+	Aws::DynamoDB::DynamoDBClient client;
+	RateLimiter limiter;
+	std::string endpoint;
+};
+
+#endif //CONNECT_STORAGE_ENGINE_H
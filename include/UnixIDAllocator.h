@@ -0,0 +1,80 @@
+#ifndef CONNECT_UNIX_ID_ALLOCATOR_H
+#define CONNECT_UNIX_ID_ALLOCATOR_H
+
+#include <deque>
+#include <mutex>
+#include <utility>
+
+///Hands out numeric unix IDs from contiguous blocks leased from a counter
+///shared by all servers. Each block is claimed with a single update of the
+///counter, after which its IDs are handed out from memory, so that servers
+///creating many accounts at once do not contend for the counter for every
+///ID.
+///IDs which have been leased are not necessarily unused (some may have been
+///assigned explicitly, or the counter may have wrapped around), so callers
+///must still check each ID before using it.
+class UnixIDAllocator{
+public:
+	///The shared counter from which blocks are leased
+	class LeaseSource{
+	public:
+		virtual ~LeaseSource(){}
+		///Claim a block of IDs by advancing the counter
+		///\param size the number of IDs wanted
+		///\param first set to the first ID claimed
+		///\param end set to the ID after the last one claimed. Fewer than
+		///           size IDs may be claimed when the counter reaches the end
+		///           of its range and wraps around.
+		///\return whether any IDs were claimed
+		virtual bool lease(unsigned int size, unsigned int& first, unsigned int& end)=0;
+		///Return the unused end of a block by moving the counter back, which
+		///is only possible if no other block has been claimed since
+		///\param first the first ID to return
+		///\param end the end of the block, where the counter should now be
+		///\return whether the IDs were returned
+		virtual bool giveBack(unsigned int first, unsigned int end)=0;
+	};
+
+	///\param source the counter from which to lease blocks
+	///\param blockSize the number of IDs to lease at once
+	UnixIDAllocator(LeaseSource& source, unsigned int blockSize):
+	source(source),blockSize(blockSize?blockSize:1),lastLeaseEnd(0){}
+
+	///Return any unused IDs which can be given back
+	~UnixIDAllocator(){ returnUnused(); }
+
+	///Obtain an ID, leasing a new block if none are left
+	///\return an ID which this allocator has not handed out before (unless
+	///        it was released), or zero if no block could be leased
+	unsigned int next();
+
+	///Put back an ID obtained from next which turned out not to be needed, so
+	///that it is handed out again
+	void release(unsigned int id);
+
+	///Give back as many unused IDs as possible to the lease source. Only the
+	///end of the most recent block can be returned, and only if no other
+	///server has leased a block since; other unused IDs are simply skipped by
+	///the counter.
+	///\return the number of IDs given back
+	unsigned int returnUnused();
+
+	///Change the number of IDs leased at once
+	void setBlockSize(unsigned int size);
+
+	///\return the number of IDs held but not yet handed out
+	unsigned int available() const;
+
+private:
+	LeaseSource& source;
+	unsigned int blockSize;
+	mutable std::mutex mutex;
+	///Half-open ranges of IDs which are held but not yet handed out, in the
+	///order in which they should be used
+	std::deque<std::pair<unsigned int,unsigned int>> freeList;
+	///The end of the most recently leased block, which is where the counter
+	///stands if no other server has leased a block since
+	unsigned int lastLeaseEnd;
+};
+
+#endif //CONNECT_UNIX_ID_ALLOCATOR_H
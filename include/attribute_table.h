@@ -0,0 +1,154 @@
+#ifndef CONNECT_ATTRIBUTE_TABLE_H
+#define CONNECT_ATTRIBUTE_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+///An immutable set of named string attributes, stored flat: all names and
+///values are packed into a single buffer, in order of name, with a table of
+///offsets into it. Lookups are a binary search, and the whole table costs two
+///allocations regardless of how many attributes it holds.
+///Changes are made by constructing a modified copy.
+class attribute_table{
+public:
+	using value_type=std::pair<std::string,std::string>;
+
+	attribute_table():offsets(1,0){}
+
+	///\param attributes the names and values to store. If a name appears more
+	///                  than once, the last value given for it is kept.
+	explicit attribute_table(std::vector<value_type> attributes):offsets(1,0){
+		std::stable_sort(attributes.begin(),attributes.end(),
+		                 [](const value_type& a, const value_type& b){ return a.first<b.first; });
+		std::size_t total=0;
+		for(const auto& attr : attributes)
+			total+=attr.first.size()+attr.second.size();
+		data.reserve(total);
+		offsets.reserve(2*attributes.size()+1);
+		for(std::size_t i=0; i<attributes.size(); i++){
+			if(i+1<attributes.size() && attributes[i+1].first==attributes[i].first)
+				continue; //superseded by a later value
+			append(attributes[i].first,attributes[i].second);
+		}
+		data.shrink_to_fit();
+		offsets.shrink_to_fit();
+	}
+
+	///\return the number of attributes stored
+	std::size_t size() const{ return offsets.size()/2; }
+	bool empty() const{ return offsets.size()==1; }
+
+	///Look up an attribute
+	///\param name the name of the attribute
+	///\param value the variable into which to copy the value, if found
+	///\return whether the attribute is present
+	bool find(const std::string& name, std::string& value) const{
+		std::size_t idx;
+		if(!locate(name,idx))
+			return false;
+		value=valueAt(idx);
+		return true;
+	}
+
+	///\return whether the named attribute is present
+	bool contains(const std::string& name) const{
+		std::size_t idx;
+		return locate(name,idx);
+	}
+
+	///\return a copy of the attribute at the given position, in order of name
+	value_type at(std::size_t idx) const{ return value_type(nameAt(idx),valueAt(idx)); }
+
+	///Apply a function to every attribute, in order of name
+	///\param fn a callable taking (const std::string& name, const std::string& value)
+	template<typename F>
+	void for_each(F&& fn) const{
+		for(std::size_t i=0; i<size(); i++)
+			fn(nameAt(i),valueAt(i));
+	}
+
+	///\return a copy of this table with one attribute added or replaced
+	attribute_table with(const std::string& name, const std::string& value) const{
+		attribute_table result;
+		result.data.reserve(data.size()+name.size()+value.size());
+		result.offsets.reserve(offsets.size()+2);
+		bool added=false;
+		for(std::size_t i=0; i<size(); i++){
+			std::string existing=nameAt(i);
+			if(!added && name<=existing){
+				result.append(name,value);
+				added=true;
+				if(name==existing)
+					continue;
+			}
+			result.append(existing,valueAt(i));
+		}
+		if(!added)
+			result.append(name,value);
+		return result;
+	}
+
+	///\return a copy of this table without the named attribute
+	attribute_table without(const std::string& name) const{
+		attribute_table result;
+		result.data.reserve(data.size());
+		result.offsets.reserve(offsets.size());
+		for(std::size_t i=0; i<size(); i++){
+			std::string existing=nameAt(i);
+			if(existing!=name)
+				result.append(existing,valueAt(i));
+		}
+		return result;
+	}
+
+	///\return the approximate number of bytes of memory used
+	std::size_t bytes() const{
+		return sizeof(*this)+data.capacity()+offsets.capacity()*sizeof(uint32_t);
+	}
+
+private:
+	///All names and values, concatenated
+	std::string data;
+	///Attribute i's name is the range [offsets[2i],offsets[2i+1]) of data, and
+	///its value is [offsets[2i+1],offsets[2i+2]).
+	std::vector<uint32_t> offsets;
+
+	std::string nameAt(std::size_t idx) const{
+		return data.substr(offsets[2*idx],offsets[2*idx+1]-offsets[2*idx]);
+	}
+	std::string valueAt(std::size_t idx) const{
+		return data.substr(offsets[2*idx+1],offsets[2*idx+2]-offsets[2*idx+1]);
+	}
+	int compareName(std::size_t idx, const std::string& name) const{
+		return data.compare(offsets[2*idx],offsets[2*idx+1]-offsets[2*idx],name);
+	}
+	bool locate(const std::string& name, std::size_t& idx) const{
+		std::size_t low=0, high=size();
+		while(low<high){
+			std::size_t mid=low+(high-low)/2;
+			int cmp=compareName(mid,name);
+			if(cmp==0){
+				idx=mid;
+				return true;
+			}
+			if(cmp<0)
+				low=mid+1;
+			else
+				high=mid;
+		}
+		return false;
+	}
+	void append(const std::string& name, const std::string& value){
+		data+=name;
+		offsets.push_back(data.size());
+		data+=value;
+		offsets.push_back(data.size());
+	}
+};
+
+inline std::size_t memory_footprint(const attribute_table& table){ return table.bytes(); }
+
+#endif //CONNECT_ATTRIBUTE_TABLE_H
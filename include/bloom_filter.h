@@ -0,0 +1,88 @@
+#ifndef CONNECT_BLOOM_FILTER_H
+#define CONNECT_BLOOM_FILTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+///A fixed-size Bloom filter over strings which supports concurrent insertion
+///and lookup without locking.
+///Items cannot be removed; a filter which has accumulated too many stale
+///items should be replaced with a freshly built one.
+class bloom_filter{
+public:
+	///\param expectedItems the number of items the filter should be sized for
+	///\param bitsPerItem the number of bits to allocate per expected item. The
+	///                   default of 10 gives a false positive rate of about 1%.
+	explicit bloom_filter(std::size_t expectedItems, unsigned int bitsPerItem=10):
+	nWords(wordsFor(expectedItems,bitsPerItem)),
+	nHashes(std::max(1u,(unsigned int)std::lround(bitsPerItem*0.693))),
+	words(new std::atomic<uint64_t>[nWords]),
+	nItems(0){
+		for(std::size_t i=0; i<nWords; i++)
+			words[i].store(0,std::memory_order_relaxed);
+	}
+	bloom_filter(const bloom_filter&)=delete;
+	bloom_filter& operator=(const bloom_filter&)=delete;
+
+	///Record an item as present
+	void insert(const std::string& item){
+		uint64_t h1, h2;
+		hashes(item,h1,h2);
+		for(unsigned int i=0; i<nHashes; i++){
+			uint64_t bit=(h1+i*h2)%(nWords*64);
+			words[bit/64].fetch_or(uint64_t(1)<<(bit%64),std::memory_order_relaxed);
+		}
+		nItems.fetch_add(1,std::memory_order_relaxed);
+	}
+
+	///\return false if the item has definitely never been inserted, true if
+	///        it may have been
+	bool possibly_contains(const std::string& item) const{
+		uint64_t h1, h2;
+		hashes(item,h1,h2);
+		for(unsigned int i=0; i<nHashes; i++){
+			uint64_t bit=(h1+i*h2)%(nWords*64);
+			if(!(words[bit/64].load(std::memory_order_relaxed) & (uint64_t(1)<<(bit%64))))
+				return false;
+		}
+		return true;
+	}
+
+	///\return the number of insertions performed, including duplicates
+	std::size_t insertions() const{ return nItems.load(std::memory_order_relaxed); }
+	///\return the size of the filter's bit array in bytes
+	std::size_t size_bytes() const{ return nWords*sizeof(uint64_t); }
+
+private:
+	const std::size_t nWords;
+	const unsigned int nHashes;
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	std::atomic<std::size_t> nItems;
+
+	static std::size_t wordsFor(std::size_t items, unsigned int bitsPerItem){
+		std::size_t bits=std::max<std::size_t>(items*bitsPerItem,1u<<12);
+		return (bits+63)/64;
+	}
+
+	///Derive two independent-enough hashes for double hashing
+	static void hashes(const std::string& item, uint64_t& h1, uint64_t& h2){
+		//FNV-1a for the first, std::hash for the second
+		h1=14695981039346656037ull;
+		for(unsigned char c : item){
+			h1^=c;
+			h1*=1099511628211ull;
+		}
+		h2=std::hash<std::string>{}(item);
+		h2^=h2>>33;
+		h2*=0xff51afd7ed558ccdull;
+		h2^=h2>>33;
+		h2|=1; //ensure odd stride so that all probes are distinct
+	}
+};
+
+#endif //CONNECT_BLOOM_FILTER_H
@@ -0,0 +1,376 @@
+#ifndef CONNECT_BOUNDED_CACHE_H
+#define CONNECT_BOUNDED_CACHE_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <libcuckoo/cuckoohash_map.hh>
+
+//Approximate accounting of the heap memory used by cached objects.
+//Each overload returns the size of the object itself plus any storage it owns.
+//Overloads for other types should be declared (in the namespace of the type,
+//so that they are found by argument dependent lookup) before a bounded_cache
+//holding that type is used.
+
+template<typename T>
+std::size_t memory_footprint(const T&);
+inline std::size_t memory_footprint(const std::string& s);
+template<typename T1, typename T2>
+std::size_t memory_footprint(const std::pair<T1,T2>& p);
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::vector<T,Rest...>& v);
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::set<T,Rest...>& s);
+template<typename K, typename V, typename... Rest>
+std::size_t memory_footprint(const std::map<K,V,Rest...>& m);
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::unordered_set<T,Rest...>& s);
+template<typename T>
+std::size_t memory_footprint(const std::shared_ptr<T>& p);
+
+///By default, assume that an object owns no additional storage
+template<typename T>
+std::size_t memory_footprint(const T&){ return sizeof(T); }
+
+inline std::size_t memory_footprint(const std::string& s){
+	//short strings are stored inline, but accounting for that is not worthwhile
+	return sizeof(std::string)+s.capacity();
+}
+
+///The pointee is charged in full, even though it may be shared
+template<typename T>
+std::size_t memory_footprint(const std::shared_ptr<T>& p){
+	return sizeof(p)+(p?memory_footprint(*p):0);
+}
+
+template<typename T1, typename T2>
+std::size_t memory_footprint(const std::pair<T1,T2>& p){
+	return memory_footprint(p.first)+memory_footprint(p.second);
+}
+
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::vector<T,Rest...>& v){
+	std::size_t size=sizeof(v)+(v.capacity()-v.size())*sizeof(T);
+	for(const auto& item : v)
+		size+=memory_footprint(item);
+	return size;
+}
+
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::set<T,Rest...>& s){
+	//assume three pointers and a color per tree node
+	const std::size_t nodeOverhead=4*sizeof(void*);
+	std::size_t size=sizeof(s);
+	for(const auto& item : s)
+		size+=nodeOverhead+memory_footprint(item);
+	return size;
+}
+
+template<typename K, typename V, typename... Rest>
+std::size_t memory_footprint(const std::map<K,V,Rest...>& m){
+	const std::size_t nodeOverhead=4*sizeof(void*);
+	std::size_t size=sizeof(m);
+	for(const auto& item : m)
+		size+=nodeOverhead+memory_footprint(item.first)+memory_footprint(item.second);
+	return size;
+}
+
+template<typename T, typename... Rest>
+std::size_t memory_footprint(const std::unordered_set<T,Rest...>& s){
+	//one next pointer and a cached hash per node, plus the bucket array
+	const std::size_t nodeOverhead=2*sizeof(void*);
+	std::size_t size=sizeof(s)+s.bucket_count()*sizeof(void*);
+	for(const auto& item : s)
+		size+=nodeOverhead+memory_footprint(item);
+	return size;
+}
+
+///A concurrent hash table with the same interface as cuckoohash_map, whose
+///memory use can be bounded.
+///When a budget is set and the approximate resident size of the stored keys
+///and values exceeds it, entries are evicted in approximately least recently
+///used order according to the CLOCK algorithm: every lookup marks an entry as
+///referenced, and the eviction hand sweeps over entries clearing these marks
+///and evicting the first entry it finds unmarked.
+///Evicted entries simply disappear, as though they had been erased, so this
+///is only suitable for data which can be reloaded on a miss.
+template<typename Key, typename T,
+         typename Hash=std::hash<Key>, typename KeyEqual=std::equal_to<Key>>
+class bounded_cache{
+private:
+	struct slot{
+		slot(const T& v):value(v),keyBytes(0),bytes(0),referenced(true){}
+		slot(T&& v):value(std::move(v)),keyBytes(0),bytes(0),referenced(true){}
+		slot(const slot&)=default;
+		slot(slot&&)=default;
+		slot& operator=(const slot&)=default;
+		slot& operator=(slot&&)=default;
+
+		T value;
+		///The footprint of the entry's key
+		std::size_t keyBytes;
+		///The footprint last charged for this entry
+		std::size_t bytes;
+		///The CLOCK reference bit. Only accessed while the table holds the
+		///lock for the entry's bucket, so it need not be atomic.
+		mutable bool referenced;
+	};
+	using Table=cuckoohash_map<Key,slot,Hash,KeyEqual>;
+public:
+	using key_type=Key;
+	using mapped_type=T;
+	using size_type=typename Table::size_type;
+
+	///\param budget the maximum number of bytes to be used by stored items,
+	///              or zero for no limit
+	explicit bounded_cache(std::size_t budget=0):
+	budget(budget),residentBytes(0),evictionCount(0),hand(0){}
+	bounded_cache(const bounded_cache&)=delete;
+	bounded_cache& operator=(const bounded_cache&)=delete;
+
+	///Change the memory budget, evicting entries if the new budget is already
+	///exceeded
+	///\param bytes the maximum number of bytes to be used, or zero for no limit
+	void set_budget(std::size_t bytes){
+		budget.store(bytes);
+		evictIfNeeded();
+	}
+	///\return the current memory budget, or zero if unlimited
+	std::size_t get_budget() const{ return budget.load(); }
+	///\return the approximate number of bytes currently used by stored items
+	std::size_t resident_bytes() const{ return residentBytes.load(); }
+	///\return the number of entries evicted to stay within the budget
+	std::size_t evictions() const{ return evictionCount.load(); }
+	///\return the number of entries stored
+	size_type size() const{ return data.size(); }
+
+	bool reserve(size_type n){ return data.reserve(n); }
+	bool rehash(size_type n){ return data.rehash(n); }
+
+	void clear(){
+		std::lock_guard<std::mutex> lock(clockMutex);
+		data.clear();
+		ring.clear();
+		hand=0;
+		residentBytes.store(0);
+	}
+
+	template<typename K, typename F>
+	bool find_fn(const K& key, F fn) const{
+		return data.find_fn(key,[&fn](const slot& s){
+			s.referenced=true;
+			fn(s.value);
+		});
+	}
+
+	template<typename K>
+	bool find(const K& key, mapped_type& val) const{
+		return find_fn(key,[&val](const mapped_type& v){ val=v; });
+	}
+
+	template<typename K>
+	mapped_type find(const K& key) const{
+		mapped_type val;
+		if(!find(key,val))
+			throw std::out_of_range("key not found in table");
+		return val;
+	}
+
+	template<typename K>
+	bool contains(const K& key) const{
+		return data.contains(key);
+	}
+
+	template<typename K, typename F>
+	bool update_fn(const K& key, F fn){
+		std::ptrdiff_t delta=0;
+		bool found=data.update_fn(key,[&](slot& s){
+			fn(s.value);
+			s.referenced=true;
+			delta=recharge(s);
+		});
+		if(found)
+			adjust(delta);
+		return found;
+	}
+
+	template<typename K, typename V>
+	bool update(const K& key, V&& val){
+		return update_fn(key,[&val](mapped_type& v){ v=std::forward<V>(val); });
+	}
+
+	///\param fn a callable taking mapped_type& and returning whether the entry
+	///          should be erased
+	template<typename K, typename F>
+	bool erase_fn(const K& key, F fn){
+		std::ptrdiff_t delta=0;
+		bool found=data.erase_fn(key,[&](slot& s){
+			if(fn(s.value)){
+				delta=-(std::ptrdiff_t)s.bytes;
+				return true;
+			}
+			delta=recharge(s);
+			return false;
+		});
+		if(found)
+			adjust(delta);
+		return found;
+	}
+
+	template<typename K>
+	bool erase(const K& key){
+		return erase_fn(key,[](mapped_type&){ return true; });
+	}
+
+	///If the key is present, apply fn to its value, otherwise insert a new
+	///value constructed from args.
+	///\return true if a new entry was inserted
+	template<typename K, typename F, typename... Args>
+	bool upsert(K&& key, F fn, Args&&... val){
+		std::ptrdiff_t delta=0;
+		Key keyCopy(key);
+		bool inserted=data.uprase_fn(std::forward<K>(key),[&](slot& s){
+			fn(s.value);
+			s.referenced=true;
+			delta=recharge(s);
+			return false;
+		},std::forward<Args>(val)...);
+		if(inserted){
+			//charge the new entry; this must be done after the fact since the
+			//table constructs the slot itself
+			const std::size_t keyBytes=memory_footprint(keyCopy);
+			data.update_fn(keyCopy,[&](slot& s){
+				s.keyBytes=keyBytes;
+				delta=recharge(s);
+			});
+			{
+				std::lock_guard<std::mutex> lock(clockMutex);
+				ring.push_back(keyCopy);
+				compactRingIfNeeded();
+			}
+		}
+		adjust(delta);
+		return inserted;
+	}
+
+	template<typename K, typename... Args>
+	bool insert(K&& key, Args&&... val){
+		return upsert(std::forward<K>(key),[](mapped_type&){},std::forward<Args>(val)...);
+	}
+
+	template<typename K, typename V>
+	bool insert_or_assign(K&& key, V&& val){
+		return upsert(std::forward<K>(key),[&val](mapped_type& m){ m=val; },std::forward<V>(val));
+	}
+
+	///Visit every entry. The whole table is locked for the duration, so all
+	///other operations block until this completes.
+	///\param fn a callable which will be passed each key and its value, and
+	///          must not access this cache
+	template<typename F>
+	void for_each(F fn){
+		auto locked=data.lock_table();
+		for(const auto& entry : locked)
+			fn(entry.first,entry.second.value);
+	}
+
+	///Evict entries until the resident size is within budget
+	void evictIfNeeded(){
+		std::size_t limit=budget.load();
+		if(!limit || residentBytes.load()<=limit)
+			return;
+		//if another thread is already evicting, let it do the work
+		std::unique_lock<std::mutex> lock(clockMutex,std::try_to_lock);
+		if(!lock.owns_lock())
+			return;
+		//Each entry may need to be visited twice: once to clear its reference
+		//bit and once to evict it
+		std::size_t steps=2*ring.size()+1;
+		while(residentBytes.load()>limit && !ring.empty() && steps--){
+			if(hand>=ring.size())
+				hand=0;
+			std::size_t freed=0;
+			bool evict=false;
+			bool present=data.erase_fn(ring[hand],[&](slot& s){
+				if(s.referenced){
+					s.referenced=false;
+					return false;
+				}
+				freed=s.bytes;
+				evict=true;
+				return true;
+			});
+			if(!present || evict){
+				//drop this key from the ring by moving the last key into its place
+				if(hand!=ring.size()-1)
+					std::swap(ring[hand],ring.back());
+				ring.pop_back();
+				if(evict){
+					residentBytes.fetch_sub(freed);
+					evictionCount++;
+				}
+			}
+			else
+				hand++;
+		}
+	}
+
+private:
+	Table data;
+	std::atomic<std::size_t> budget;
+	std::atomic<std::size_t> residentBytes;
+	std::atomic<std::size_t> evictionCount;
+	///Protects the ring and the hand
+	std::mutex clockMutex;
+	///All keys in insertion order, which the CLOCK hand cycles over. Keys
+	///which have been erased are only removed when the hand reaches them.
+	std::vector<Key> ring;
+	std::size_t hand;
+
+	///Recompute the footprint of an entry
+	///\return the change in the footprint
+	std::ptrdiff_t recharge(slot& s) const{
+		//the key is counted twice, since a copy lives in the ring
+		std::size_t bytes=sizeof(slot)+2*s.keyBytes+memory_footprint(s.value);
+		std::ptrdiff_t delta=(std::ptrdiff_t)bytes-(std::ptrdiff_t)s.bytes;
+		s.bytes=bytes;
+		return delta;
+	}
+
+	void adjust(std::ptrdiff_t delta){
+		if(delta>0){
+			residentBytes.fetch_add(delta);
+			evictIfNeeded();
+		}
+		else if(delta<0)
+			residentBytes.fetch_sub(-delta);
+	}
+
+	///Remove keys of erased entries from the ring if they have come to
+	///dominate it. Must be called with clockMutex held.
+	void compactRingIfNeeded(){
+		if(ring.size()<=2*data.size()+1024)
+			return;
+		std::unordered_set<Key,Hash,KeyEqual> seen;
+		std::size_t kept=0;
+		for(std::size_t i=0; i<ring.size(); i++){
+			if(data.contains(ring[i]) && seen.insert(ring[i]).second){
+				if(kept!=i)
+					ring[kept]=std::move(ring[i]);
+				kept++;
+			}
+		}
+		ring.resize(kept);
+		hand=0;
+	}
+};
+
+#endif //CONNECT_BOUNDED_CACHE_H
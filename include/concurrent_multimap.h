@@ -4,7 +4,7 @@
 #include <functional>
 #include <unordered_set>
 
-#include <libcuckoo/cuckoohash_map.hh>
+#include <bounded_cache.h>
 
 ///Implements a multimap by storing items within unordered sets indexed by the 
 ///keys. This requires not only the keys but the values as well to be hasable 
@@ -13,7 +13,10 @@
 ///in the underlying cuckoohash_map can proceed concurrently, however, operations
 ///involving different values with the same key are guaranteed to map to the same
 ///bucket and thus will block each other waiting for its lock. 
-///Does not currently have allocation or iteration support.
+///The underlying table is a bounded_cache, so the total memory used may be 
+///limited, in which case whole keys (with all of their values) are evicted.
+///Does not currently have allocation support, and iteration is only possible
+///via for_each.
 template<typename Key, typename Value, 
          typename KeyHash=std::hash<Key>, typename KeyEqual=std::equal_to<Key>, 
          typename ValueHash=std::hash<Value>, typename ValueEqual=std::equal_to<Value>>
@@ -25,7 +28,7 @@ public:
 	///The set of values the key maps to with its associated expiration time
 	using category_type=std::pair<set_type,steady_clock::time_point>;
 	///The underlying hash table type
-	using Table=cuckoohash_map<Key,category_type,KeyHash,KeyEqual>;
+	using Table=bounded_cache<Key,category_type,KeyHash,KeyEqual>;
 	using key_type=Key;
 	using mapped_type=Value;
 	using value_type=std::pair<const Key,category_type>;
@@ -73,6 +76,18 @@ public:
 	///\return true if the table changed size, false otherwise
 	bool rehash(size_type n){ return data.rehash(n); }
 	
+	///Limit the memory used by the map, evicting keys if necessary
+	///\param bytes the maximum number of bytes to use, or zero for no limit
+	void set_budget(std::size_t bytes){ data.set_budget(bytes); }
+	///\return the current memory budget, or zero if unlimited
+	std::size_t get_budget() const{ return data.get_budget(); }
+	///\return the approximate number of bytes currently used
+	std::size_t resident_bytes() const{ return data.resident_bytes(); }
+	///\return the number of keys evicted to stay within the budget
+	std::size_t evictions() const{ return data.evictions(); }
+	///\return the number of keys in the map
+	size_type size() const{ return data.size(); }
+	
 	///Erases the key from the table. 
 	///\tparam K type of the key
 	///\param k the key to be removed
@@ -87,6 +102,27 @@ public:
 		return erased;
 	}
 	
+	///Erases the key from the table if a predicate is satisfied
+	///\tparam K type of the key
+	///\tparam F type of the predicate
+	///\param k the key to be examined
+	///\param fn a callable which will be passed the category_type associated 
+	///          with the key, if any, and should return whether to erase it
+	///\return true if the key was found (whether or not it was erased)
+	template <typename K, typename F>
+	bool erase_fn(const K& k, F fn){
+		return data.erase_fn(k,fn);
+	}
+
+	///Visits every key. The whole table is locked for the duration.
+	///\tparam F type of the visitor
+	///\param fn a callable which will be passed each key and the category_type
+	///          associated with it, and must not access this map
+	template <typename F>
+	void for_each(F fn){
+		data.for_each(fn);
+	}
+	
 	///Erases the mapping of the key to a single value from the table, leaving
 	///any other values to which that key may map. 
 	///\tparam K type of the key
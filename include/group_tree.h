@@ -0,0 +1,199 @@
+#ifndef CONNECT_GROUP_TREE_H
+#define CONNECT_GROUP_TREE_H
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <versioned_directory.h>
+
+///An index of records named by dot-separated paths, like group names
+///('root.foo.bar'), arranged as a tree with one level per name component.
+///This allows the records beneath or above a name to be found by visiting only
+///those records, rather than by testing the name of every record.
+///A tree can keep itself consistent with a versioned_directory by observing
+///it; the tree holds its own copies of the records.
+///All operations are thread-safe.
+template<typename Value>
+class group_tree : public versioned_directory<std::string,Value>::observer{
+public:
+	using snapshot=typename versioned_directory<std::string,Value>::snapshot;
+
+	group_tree():root(new node){}
+	group_tree(const group_tree&)=delete;
+	group_tree& operator=(const group_tree&)=delete;
+
+	///Insert or replace the record with a name
+	void insert(const std::string& name, const Value& value){
+		std::lock_guard<std::mutex> lock(mutex);
+		node* n=root.get();
+		for(const auto& component : split(name)){
+			auto& child=n->children[component];
+			if(!child)
+				child.reset(new node);
+			n=child.get();
+		}
+		if(!n->present)
+			count++;
+		n->present=true;
+		n->value=value;
+	}
+
+	///Remove the record with a name, if it is present. Records beneath it are
+	///not affected.
+	void erase(const std::string& name){
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::string> components=split(name);
+		//the nodes along the path, so that any left empty can be pruned
+		std::vector<node*> path{root.get()};
+		for(const auto& component : components){
+			auto it=path.back()->children.find(component);
+			if(it==path.back()->children.end())
+				return;
+			path.push_back(it->second.get());
+		}
+		if(path.back()->present)
+			count--;
+		path.back()->present=false;
+		path.back()->value=Value();
+		for(std::size_t i=components.size(); i>0; i--){
+			if(path[i]->present || !path[i]->children.empty())
+				break;
+			path[i-1]->children.erase(components[i-1]);
+		}
+	}
+
+	///Remove all records
+	void clear(){
+		std::lock_guard<std::mutex> lock(mutex);
+		root.reset(new node);
+		count=0;
+	}
+
+	///\return the number of records in the tree
+	std::size_t size() const{
+		std::lock_guard<std::mutex> lock(mutex);
+		return count;
+	}
+
+	///Find the records beneath a name.
+	///\param name the name whose descendants should be found; it need not
+	///            itself have a record
+	///\param maxDepth the number of levels below name to include, so that 1
+	///                finds only direct children, or zero for all levels
+	///\return the records, ordered so that each precedes the records beneath
+	///        it, and siblings are ordered by name
+	std::vector<Value> descendants(const std::string& name, unsigned int maxDepth=0) const{
+		std::vector<Value> result;
+		std::lock_guard<std::mutex> lock(mutex);
+		if(const node* n=find(name))
+			collect(*n,maxDepth,result);
+		return result;
+	}
+
+	///\return the records directly beneath a name
+	std::vector<Value> children(const std::string& name) const{
+		return descendants(name,1);
+	}
+
+	///Find the records above a name.
+	///\return the records of the name's enclosing names, nearest first,
+	///        skipping any which have no record
+	std::vector<Value> ancestors(const std::string& name) const{
+		std::vector<Value> result;
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::string> components=split(name);
+		if(!components.empty())
+			components.pop_back();
+		const node* n=root.get();
+		for(const auto& component : components){
+			auto it=n->children.find(component);
+			if(it==n->children.end())
+				break;
+			n=it->second.get();
+			if(n->present)
+				result.push_back(n->value);
+		}
+		std::reverse(result.begin(),result.end());
+		return result;
+	}
+
+	void upserted(const std::string& key, const Value& value) override{ insert(key,value); }
+
+	void erased(const std::string& key) override{ erase(key); }
+
+	void replaced(const snapshot& contents) override{
+		std::unique_ptr<node> fresh(new node);
+		std::size_t freshCount=0;
+		contents.for_each([&](const std::string& key, const Value& value){
+			node* n=fresh.get();
+			for(const auto& component : split(key)){
+				auto& child=n->children[component];
+				if(!child)
+					child.reset(new node);
+				n=child.get();
+			}
+			if(!n->present)
+				freshCount++;
+			n->present=true;
+			n->value=value;
+		});
+		//the old tree is destroyed after the lock is released
+		std::lock_guard<std::mutex> lock(mutex);
+		root.swap(fresh);
+		count=freshCount;
+	}
+
+private:
+	struct node{
+		node():present(false){}
+		///Whether a record has exactly this node's name, rather than the node
+		///only being on the path to other records
+		bool present;
+		Value value;
+		std::map<std::string,std::unique_ptr<node>> children;
+	};
+
+	mutable std::mutex mutex;
+	std::unique_ptr<node> root;
+	std::size_t count=0;
+
+	static std::vector<std::string> split(const std::string& name){
+		std::vector<std::string> components;
+		std::size_t start=0;
+		while(true){
+			std::size_t end=name.find('.',start);
+			components.push_back(name.substr(start,end-start));
+			if(end==std::string::npos)
+				break;
+			start=end+1;
+		}
+		return components;
+	}
+
+	///Must be called with mutex held
+	const node* find(const std::string& name) const{
+		const node* n=root.get();
+		for(const auto& component : split(name)){
+			auto it=n->children.find(component);
+			if(it==n->children.end())
+				return nullptr;
+			n=it->second.get();
+		}
+		return n;
+	}
+
+	static void collect(const node& n, unsigned int depth, std::vector<Value>& result){
+		for(const auto& child : n.children){
+			if(child.second->present)
+				result.push_back(child.second->value);
+			if(depth!=1)
+				collect(*child.second,depth?depth-1:0,result);
+		}
+	}
+};
+
+#endif //CONNECT_GROUP_TREE_H
@@ -0,0 +1,80 @@
+#ifndef CONNECT_SINGLE_FLIGHT_H
+#define CONNECT_SINGLE_FLIGHT_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+///Coalesces concurrent invocations of an expensive operation: while the
+///operation is running for a given key, any further requests for the same key
+///wait for it to finish and receive a copy of its result (or its exception),
+///rather than repeating the work.
+///Requests which arrive after an operation has finished start a new one; no
+///results are retained.
+template<typename Key, typename Result, typename Hash=std::hash<Key>>
+class single_flight{
+public:
+	single_flight():sharedCount(0){}
+	single_flight(const single_flight&)=delete;
+	single_flight& operator=(const single_flight&)=delete;
+
+	///Perform an operation, or wait for an identical one already in progress
+	///\param key identifies the operation
+	///\param fn a callable taking no arguments and returning Result, which
+	///          will be invoked only if no operation is in progress for key
+	///\return the result of the operation
+	template<typename F>
+	Result run(const Key& key, F&& fn){
+		std::shared_future<Result> pending;
+		std::promise<Result> promise;
+		{
+			std::lock_guard<std::mutex> lock(mut);
+			auto it=calls.find(key);
+			if(it!=calls.end())
+				pending=it->second;
+			else
+				calls.emplace(key,promise.get_future().share());
+		}
+		if(pending.valid()){
+			sharedCount++;
+			return pending.get();
+		}
+		try{
+			Result result=fn();
+			//stop accepting new waiters before publishing, so that the entry is
+			//never visible after its result has been delivered
+			finish(key);
+			promise.set_value(result);
+			return result;
+		}catch(...){
+			finish(key);
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+	}
+
+	///\return the number of requests which were satisfied by waiting for
+	///        another request's operation
+	std::size_t shared() const{ return sharedCount.load(); }
+
+	///\return the number of operations currently in progress
+	std::size_t in_flight() const{
+		std::lock_guard<std::mutex> lock(mut);
+		return calls.size();
+	}
+
+private:
+	mutable std::mutex mut;
+	std::unordered_map<Key,std::shared_future<Result>,Hash> calls;
+	std::atomic<std::size_t> sharedCount;
+
+	void finish(const Key& key){
+		std::lock_guard<std::mutex> lock(mut);
+		calls.erase(key);
+	}
+};
+
+#endif //CONNECT_SINGLE_FLIGHT_H
@@ -0,0 +1,142 @@
+#ifndef CONNECT_TIMER_WHEEL_H
+#define CONNECT_TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+///A hierarchical timing wheel, which tracks a large number of items, each with
+///a deadline, and efficiently produces the items whose deadlines have passed.
+///Scheduling an item is O(1), and advancing time costs O(1) per elapsed tick
+///plus O(1) per item as it is cascaded from coarser wheels to finer ones and
+///finally handed out. There is no way to cancel an item; callers should
+///instead check when an item is produced whether it is still relevant.
+///Deadlines are rounded up to a whole number of ticks.
+///All operations are thread-safe.
+///\tparam Item the type of the tracked items
+///\tparam SlotBits log2 of the number of slots in each wheel
+///\tparam Levels the number of wheels. Items with deadlines further in the
+///               future than the total span of the wheels are kept on an
+///               overflow list which is reexamined each time the coarsest
+///               wheel completes a revolution.
+template<typename Item, unsigned int SlotBits=6, unsigned int Levels=4>
+class timer_wheel{
+public:
+	using clock=std::chrono::steady_clock;
+
+	///\param tick the time resolution of the wheel
+	explicit timer_wheel(clock::duration tick):
+	tick(tick),origin(clock::now()),currentTick(0),count(0){}
+	timer_wheel(const timer_wheel&)=delete;
+	timer_wheel& operator=(const timer_wheel&)=delete;
+
+	///Add an item
+	///\param item the item to track
+	///\param deadline the time after which the item should be produced
+	void schedule(Item item, clock::time_point deadline){
+		uint64_t due=0;
+		if(deadline>origin)
+			due=(deadline-origin+tick-clock::duration(1))/tick;
+		std::lock_guard<std::mutex> lock(mut);
+		place(entry{std::move(item),due});
+		count++;
+	}
+
+	///Advance the wheel to the given time, and collect items which have come due
+	///\param now the current time
+	///\param out the vector to which due items will be appended
+	///\param maxItems the maximum number of items to collect. Any further due
+	///                items are retained, to be collected by subsequent calls.
+	///\return the number of due items remaining after this call
+	std::size_t advance(clock::time_point now, std::vector<Item>& out, std::size_t maxItems){
+		uint64_t nowTick=0;
+		if(now>origin)
+			nowTick=(now-origin)/tick;
+		std::lock_guard<std::mutex> lock(mut);
+		while(currentTick<nowTick){
+			currentTick++;
+			//cascade coarser wheels whose current slot has just begun, from
+			//the coarsest inwards
+			if((currentTick&mask(Levels*SlotBits))==0){
+				std::vector<entry> pending;
+				pending.swap(overflow);
+				for(auto& e : pending)
+					place(std::move(e));
+			}
+			for(unsigned int level=Levels-1; level>0; level--){
+				if((currentTick&mask(level*SlotBits))==0)
+					cascade(level,slotIndex(currentTick,level));
+			}
+			auto& slot=wheels[0][slotIndex(currentTick,0)];
+			for(auto& e : slot)
+				ready.push_back(std::move(e));
+			slot.clear();
+		}
+		while(!ready.empty() && maxItems--){
+			out.push_back(std::move(ready.front().item));
+			ready.pop_front();
+			count--;
+		}
+		return ready.size();
+	}
+
+	///\return the number of items currently tracked, including any which have
+	///        come due but not yet been collected
+	std::size_t size() const{
+		std::lock_guard<std::mutex> lock(mut);
+		return count;
+	}
+
+private:
+	struct entry{
+		Item item;
+		///The tick at which the item is due
+		uint64_t due;
+	};
+	using wheel=std::array<std::vector<entry>,(1u<<SlotBits)>;
+
+	const clock::duration tick;
+	const clock::time_point origin;
+	mutable std::mutex mut;
+	uint64_t currentTick;
+	std::size_t count;
+	std::array<wheel,Levels> wheels;
+	std::vector<entry> overflow;
+	std::deque<entry> ready;
+
+	static constexpr uint64_t mask(unsigned int bits){ return (uint64_t(1)<<bits)-1; }
+	static std::size_t slotIndex(uint64_t t, unsigned int level){
+		return (t>>(level*SlotBits))&mask(SlotBits);
+	}
+
+	///Put an entry in the appropriate place for its due time. Must be called
+	///with mut held.
+	void place(entry e){
+		if(e.due<=currentTick){
+			ready.push_back(std::move(e));
+			return;
+		}
+		uint64_t delta=e.due-currentTick;
+		for(unsigned int level=0; level<Levels; level++){
+			if(delta<=mask((level+1)*SlotBits)){
+				wheels[level][slotIndex(e.due,level)].push_back(std::move(e));
+				return;
+			}
+		}
+		overflow.push_back(std::move(e));
+	}
+
+	///Redistribute the entries in one slot of a coarse wheel into finer wheels.
+	///Must be called with mut held.
+	void cascade(unsigned int level, std::size_t index){
+		std::vector<entry> pending;
+		pending.swap(wheels[level][index]);
+		for(auto& e : pending)
+			place(std::move(e));
+	}
+};
+
+#endif //CONNECT_TIMER_WHEEL_H
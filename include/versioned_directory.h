@@ -0,0 +1,289 @@
+#ifndef CONNECT_VERSIONED_DIRECTORY_H
+#define CONNECT_VERSIONED_DIRECTORY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///A read-mostly collection of all records of one kind, intended for serving
+///'list everything' requests.
+///Readers obtain an immutable, versioned snapshot through a single atomic
+///pointer load, and may then iterate over it for as long as they like without
+///holding any lock or blocking writers.
+///Writers are serialized among themselves and publish a new version by copying
+///only the shard affected by their change, so a single-record update costs
+///O(N/Shards) rather than O(N).
+///A directory is only considered complete (and so usable for listings)
+///after a full set of records has been published and until its expiration time
+///passes; incremental updates keep a complete directory current but never make
+///an incomplete one complete.
+template<typename Key, typename Value, std::size_t Shards=32,
+         typename Hash=std::hash<Key>>
+class versioned_directory{
+public:
+	using steady_clock=std::chrono::steady_clock;
+	using shard_type=std::unordered_map<Key,Value,Hash>;
+
+	///An immutable view of the directory's contents at some version
+	class snapshot{
+	public:
+		///\return the version number of this snapshot, which increases with
+		///        each change published to the directory
+		uint64_t version() const{ return version_; }
+		///\return whether this snapshot contains a complete set of records
+		///        which has not yet expired
+		bool valid() const{ return complete_ && steady_clock::now()<expiration_; }
+		///\return the time after which this snapshot should not be used
+		steady_clock::time_point expiration() const{ return expiration_; }
+		///\return the number of records in this snapshot
+		std::size_t size() const{ return size_; }
+
+		///Apply a function to every record in the snapshot
+		///\param f a callable taking (const Key&, const Value&)
+		template<typename F>
+		void for_each(F&& f) const{
+			for(const auto& shard : shards_){
+				for(const auto& entry : *shard)
+					f(entry.first,entry.second);
+			}
+		}
+
+		///\return copies of all values in the snapshot
+		std::vector<Value> values() const{
+			std::vector<Value> result;
+			result.reserve(size_);
+			for_each([&result](const Key&, const Value& v){ result.push_back(v); });
+			return result;
+		}
+	private:
+		friend class versioned_directory;
+		std::array<std::shared_ptr<const shard_type>,Shards> shards_;
+		uint64_t version_;
+		std::size_t size_;
+		bool complete_;
+		steady_clock::time_point expiration_;
+	};
+	using snapshot_ptr=std::shared_ptr<const snapshot>;
+
+	///Receives every change published to a directory, in the order in which
+	///the changes take effect, so that a secondary index over the records
+	///can be kept consistent with the directory. Each change is delivered just
+	///before the snapshot containing it becomes visible to readers.
+	///Notifications are delivered while the directory's write lock is held,
+	///so they must be brief and must not modify the directory.
+	class observer{
+	public:
+		virtual ~observer(){}
+		///A record was inserted or replaced
+		virtual void upserted(const Key& key, const Value& value)=0;
+		///A record was removed
+		virtual void erased(const Key& key)=0;
+		///The entire contents of the directory were replaced
+		virtual void replaced(const snapshot& contents)=0;
+	};
+
+	///A marker used to associate a full rebuild with the incremental changes
+	///which occur while its data is being collected
+	using rebuild_token=uint64_t;
+
+	versioned_directory():rebuilds(0),changeCounter(0),watcher(nullptr){
+		auto initial=std::make_shared<snapshot>();
+		auto empty=std::make_shared<const shard_type>();
+		for(auto& shard : initial->shards_)
+			shard=empty;
+		initial->version_=0;
+		initial->size_=0;
+		initial->complete_=false;
+		initial->expiration_=steady_clock::time_point::min();
+		store(initial);
+	}
+	versioned_directory(const versioned_directory&)=delete;
+	versioned_directory& operator=(const versioned_directory&)=delete;
+
+	///Get the current contents of the directory. Never blocks on writers.
+	snapshot_ptr get() const{ return load(); }
+
+	///\return the current version number
+	uint64_t version() const{ return load()->version_; }
+
+	///Attach an observer, which is immediately told the current contents of
+	///the directory and then notified of every subsequent change. Only one
+	///observer may be attached, and it must outlive the directory's use.
+	void observe(observer* obs){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		watcher=obs;
+		watcher->replaced(*load());
+	}
+
+	///Insert or replace a single record
+	void upsert(const Key& key, const Value& value){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		auto next=copyCurrent();
+		std::size_t idx=shardIndex(key);
+		auto shard=std::make_shared<shard_type>(*next->shards_[idx]);
+		auto result=shard->emplace(key,value);
+		if(!result.second)
+			result.first->second=value;
+		else
+			next->size_++;
+		next->shards_[idx]=std::move(shard);
+		record(key,false,value);
+		if(watcher)
+			watcher->upserted(key,value);
+		store(next);
+	}
+
+	///Remove a single record, if it is present
+	void erase(const Key& key){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		auto current=load();
+		std::size_t idx=shardIndex(key);
+		bool present=current->shards_[idx]->count(key);
+		//even if there is nothing to remove, a rebuild in progress must learn
+		//that the record should not be resurrected from its older data
+		record(key,true,Value());
+		if(!present)
+			return;
+		auto next=copyCurrent();
+		auto shard=std::make_shared<shard_type>(*next->shards_[idx]);
+		shard->erase(key);
+		next->size_--;
+		next->shards_[idx]=std::move(shard);
+		if(watcher)
+			watcher->erased(key);
+		store(next);
+	}
+
+	///Mark the current contents as no longer usable for listings, without
+	///discarding them.
+	void invalidate(){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		auto next=copyCurrent();
+		next->complete_=false;
+		store(next);
+	}
+
+	///Announce that a full set of records is about to be collected.
+	///Changes made via upsert or erase from this point on will be reapplied
+	///on top of the collected records when they are published, so that
+	///writes which race with the collection are not lost.
+	///\return a token which must be passed to publish (or abandon)
+	rebuild_token begin_rebuild(){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		rebuilds++;
+		return changeCounter;
+	}
+
+	///Give up on a rebuild started with begin_rebuild, e.g. because collecting
+	///the records failed.
+	void abandon(rebuild_token){
+		std::lock_guard<std::mutex> lock(writeMutex);
+		finishRebuild();
+	}
+
+	///Replace the entire contents of the directory
+	///\param token the token obtained from begin_rebuild before the records
+	///             were collected
+	///\param entries the complete set of records
+	///\param expiration the time after which the published data should no
+	///                  longer be used for listings
+	void publish(rebuild_token token, std::vector<std::pair<Key,Value>> entries,
+	             steady_clock::time_point expiration){
+		std::array<shard_type,Shards> shards;
+		for(auto& entry : entries){
+			std::size_t idx=shardIndex(entry.first);
+			shards[idx][entry.first]=std::move(entry.second);
+		}
+		std::lock_guard<std::mutex> lock(writeMutex);
+		//reapply any changes which happened after the collection started
+		for(const auto& change : journal){
+			if(change.sequence<=token)
+				continue;
+			std::size_t idx=shardIndex(change.key);
+			if(change.erased)
+				shards[idx].erase(change.key);
+			else
+				shards[idx][change.key]=change.value;
+		}
+		auto next=std::make_shared<snapshot>();
+		next->size_=0;
+		for(std::size_t i=0; i<Shards; i++){
+			next->size_+=shards[i].size();
+			next->shards_[i]=std::make_shared<const shard_type>(std::move(shards[i]));
+		}
+		next->version_=load()->version_+1;
+		next->complete_=true;
+		next->expiration_=expiration;
+		finishRebuild();
+		if(watcher)
+			watcher->replaced(*next);
+		store(next);
+	}
+
+private:
+	struct change{
+		uint64_t sequence;
+		Key key;
+		bool erased;
+		Value value;
+	};
+
+	std::shared_ptr<const snapshot> current;
+	mutable std::mutex writeMutex;
+	#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
+	//libstdc++ before version 5 lacks the atomic shared_ptr operations, so
+	//fall back to a short critical section around the pointer copy
+	mutable std::mutex pointerMutex;
+	snapshot_ptr load() const{
+		std::lock_guard<std::mutex> lock(pointerMutex);
+		return current;
+	}
+	void store(snapshot_ptr next){
+		std::lock_guard<std::mutex> lock(pointerMutex);
+		current=std::move(next);
+	}
+	#else
+	snapshot_ptr load() const{ return std::atomic_load(&current); }
+	void store(snapshot_ptr next){ std::atomic_store(&current,std::move(next)); }
+	#endif
+
+	///Number of rebuilds currently in progress; while nonzero changes are journaled
+	unsigned int rebuilds;
+	///Sequence number of the most recent change
+	uint64_t changeCounter;
+	///Changes made while rebuilds are in progress
+	std::vector<change> journal;
+	///The observer to be notified of changes, if any
+	observer* watcher;
+
+	static std::size_t shardIndex(const Key& key){ return Hash{}(key)%Shards; }
+
+	///Must be called with writeMutex held
+	std::shared_ptr<snapshot> copyCurrent() const{
+		auto next=std::make_shared<snapshot>(*load());
+		next->version_++;
+		return next;
+	}
+
+	///Must be called with writeMutex held
+	void record(const Key& key, bool erased, const Value& value){
+		changeCounter++;
+		if(rebuilds)
+			journal.push_back(change{changeCounter,key,erased,value});
+	}
+
+	///Must be called with writeMutex held
+	void finishRebuild(){
+		if(rebuilds && !--rebuilds)
+			journal.clear();
+	}
+};
+
+#endif //CONNECT_VERSIONED_DIRECTORY_H
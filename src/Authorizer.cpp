@@ -0,0 +1,75 @@
+#include "Authorizer.h"
+
+#include <algorithm>
+
+#include "PersistentStore.h"
+
+Authorizer::Authorizer(PersistentStore& store):
+store(store),hitCount(0),missCount(0){}
+
+Authorizer::Decision Authorizer::check(const User& user, const std::string& groupName, Action action){
+	const std::string key=std::to_string(action)+":"+user.unixName+":"+groupName;
+	//the generation must be read before deciding, so that a change which
+	//happens while the decision is being made renders it obsolete
+	uint64_t generation=generationOf(user.unixName);
+	Decision decision;
+	Entry entry;
+	if(decisions.find(key,entry) && entry.generation==generation
+	   && entry.expiration>std::chrono::steady_clock::now()){
+		hitCount++;
+		decision=entry.decision;
+	}
+	else{
+		missCount++;
+		decision=decide(user.unixName,groupName,action,entry.expiration);
+		entry.decision=decision;
+		entry.generation=generation;
+		if(decision.complete && entry.expiration>std::chrono::steady_clock::now())
+			decisions.insert_or_assign(key,entry);
+	}
+	//superusers do not depend on their memberships
+	if(user.superuser){
+		decision.allowed=true;
+		decision.complete=true;
+	}
+	return decision;
+}
+
+void Authorizer::invalidate(const std::string& uID){
+	generations.upsert(uID,[](uint64_t& generation){ generation++; },1);
+}
+
+uint64_t Authorizer::generationOf(const std::string& uID) const{
+	uint64_t generation=0;
+	generations.find(uID,generation);
+	return generation;
+}
+
+Authorizer::Decision Authorizer::decide(const std::string& uID, const std::string& groupName, Action action, 
+                                        std::chrono::steady_clock::time_point& expiration){
+	Decision decision;
+	GroupMembership membership=store.userStatusInGroup(uID,groupName,&expiration);
+	decision.complete=membership.valid;
+	if(membership.state==GroupMembership::Admin)
+		decision.adminGroup=groupName;
+	else{
+		std::chrono::steady_clock::time_point closureExpiration;
+		bool closureComplete=false;
+		decision.adminGroup=store.enclosingAdminGroup(uID,groupName,&closureExpiration,&closureComplete);
+		expiration=std::min(expiration,closureExpiration);
+		decision.complete&=closureComplete;
+	}
+	switch(action){
+		case Participate:
+			decision.allowed=membership.isMember() || !decision.adminGroup.empty();
+			break;
+		case Administer:
+			decision.allowed=!decision.adminGroup.empty();
+			break;
+	}
+	return decision;
+}
+
+std::size_t memory_footprint(const Authorizer::Entry& entry){
+	return sizeof(entry)+memory_footprint(entry.decision.adminGroup)-sizeof(std::string);
+}
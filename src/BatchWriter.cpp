@@ -0,0 +1,113 @@
+#include <BatchWriter.h>
+
+#include <future>
+
+#include <aws/core/utils/Outcome.h>
+#include <aws/dynamodb/model/BatchWriteItemRequest.h>
+
+#include <Logging.h>
+
+const std::size_t BatchWriter::batchLimit=25;
+const unsigned int BatchWriter::attemptLimit=8;
+
+namespace{
+///\return whether two write requests refer to the same item
+bool sameWrite(const Aws::DynamoDB::Model::WriteRequest& w1,
+               const Aws::DynamoDB::Model::WriteRequest& w2){
+	const auto& key1=w1.GetDeleteRequest().GetKey();
+	const auto& key2=w2.GetDeleteRequest().GetKey();
+	if(!key1.empty() || !key2.empty())
+		return key1==key2;
+	return w1.GetPutRequest().GetItem()==w2.GetPutRequest().GetItem();
+}
+}
+
+Aws::DynamoDB::Model::WriteRequest BatchWriter::put(const Item& item){
+	return Aws::DynamoDB::Model::WriteRequest()
+	       .WithPutRequest(Aws::DynamoDB::Model::PutRequest().WithItem(item));
+}
+
+Aws::DynamoDB::Model::WriteRequest BatchWriter::erase(const Item& key){
+	return Aws::DynamoDB::Model::WriteRequest()
+	       .WithDeleteRequest(Aws::DynamoDB::Model::DeleteRequest().WithKey(key));
+}
+
+std::vector<bool> BatchWriter::write(const std::string& tableName,
+                                     const std::vector<Aws::DynamoDB::Model::WriteRequest>& writes){
+	//char rather than bool so that batches can set their flags concurrently
+	std::vector<char> done(writes.size(),false);
+	if(writes.size()<=batchLimit) //no point in handing off a single batch
+		writeBatch(tableName,writes,0,writes.size(),done);
+	else{
+		std::vector<std::future<void>> pending;
+		for(std::size_t i=0; i<writes.size(); i+=batchLimit){
+			std::size_t end=std::min(i+batchLimit,writes.size());
+			pending.push_back(pool.enqueue([this,&tableName,&writes,i,end,&done]{
+				writeBatch(tableName,writes,i,end,done);
+			}));
+		}
+		for(auto& batch : pending)
+			batch.wait();
+	}
+	return std::vector<bool>(done.begin(),done.end());
+}
+
+std::vector<bool> BatchWriter::remove(const std::string& tableName, const std::vector<Item>& keys){
+	std::vector<Aws::DynamoDB::Model::WriteRequest> writes;
+	writes.reserve(keys.size());
+	for(const auto& key : keys)
+		writes.push_back(erase(key));
+	return write(tableName,writes);
+}
+
+void BatchWriter::writeBatch(const std::string& tableName,
+                             const std::vector<Aws::DynamoDB::Model::WriteRequest>& writes,
+                             std::size_t begin, std::size_t end, std::vector<char>& done){
+	//the indices of the writes not yet known to have been performed
+	std::vector<std::size_t> remaining;
+	for(std::size_t i=begin; i<end; i++)
+		remaining.push_back(i);
+	Aws::Vector<Aws::DynamoDB::Model::WriteRequest> batch(writes.begin()+begin,writes.begin()+end);
+	for(unsigned int attempt=0; !remaining.empty(); attempt++){
+		//writes are left unprocessed when the table's capacity is exceeded,
+		//so back off before submitting them again
+		if(attempt)
+			engine.waitToRetry(tableName,attempt);
+		auto request=Aws::DynamoDB::Model::BatchWriteItemRequest().AddRequestItems(tableName,batch);
+		auto outcome=engine.batchWriteItem(request);
+		if(!outcome.IsSuccess()){
+			auto err=outcome.GetError();
+			log_error("Failed to write batch of " << batch.size() << " items to "
+			          << tableName << ": " << err.GetMessage());
+			return;
+		}
+		const auto& unprocessed=outcome.GetResult().GetUnprocessedItems();
+		auto leftOver=unprocessed.find(tableName);
+		if(leftOver==unprocessed.end() || leftOver->second.empty()){
+			for(auto idx : remaining)
+				done[idx]=true;
+			return;
+		}
+		std::vector<std::size_t> stillRemaining;
+		for(auto idx : remaining){
+			bool pending=false;
+			for(const auto& write : leftOver->second){
+				if(sameWrite(write,writes[idx])){
+					pending=true;
+					break;
+				}
+			}
+			if(pending)
+				stillRemaining.push_back(idx);
+			else
+				done[idx]=true;
+		}
+		remaining.swap(stillRemaining);
+		batch=leftOver->second;
+		if(attempt+1==attemptLimit){
+			log_error("Failed to write " << remaining.size() << " items to " << tableName
+			          << ": items remained unprocessed after " << attemptLimit << " attempts");
+			return;
+		}
+	}
+}
@@ -0,0 +1,411 @@
+#include <CacheSnapshot.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//File layout:
+//  header: 8 byte magic, uint32 format version, uint32 byte order mark,
+//          uint32 flags, uint32 section count, uint64 checksum
+//  section table: for each section uint32 kind, uint32 record count,
+//                 uint64 offset from the start of the file, uint64 length
+//  sections: records stored back to back
+//Integers are stored in native byte order, which the byte order mark allows
+//a reader to verify. Strings are stored as a uint32 length followed by their
+//bytes. The checksum covers everything following the header.
+//Readers skip sections of unknown kinds, so new kinds of data can be added
+//without changing the format version; any other change requires a new version.
+
+std::size_t CacheSnapshot::size() const{
+	return users.size()+userSummaries.size()+groups.size()+groupRequests.size()+memberships.size()
+	       +userAttributes.size()+groupAttributes.size();
+}
+
+namespace{
+
+const char snapshotMagic[8]={'C','I','C','S','N','A','P','\0'};
+const uint32_t snapshotVersion=1;
+const uint32_t byteOrderMark=0x01020304;
+const std::size_t headerSize=32;
+const std::size_t sectionEntrySize=24;
+
+enum SnapshotFlags : uint32_t{
+	UsersComplete=1,
+	GroupsComplete=2,
+	GroupRequestsComplete=4
+};
+
+enum SectionKind : uint32_t{
+	UserSection=1,
+	GroupSection=2,
+	GroupRequestSection=3,
+	MembershipSection=4,
+	CompleteUserMembershipSection=5,
+	CompleteGroupMembershipSection=6,
+	UserAttributeSection=7,
+	GroupAttributeSection=8,
+	UserSummarySection=9
+};
+
+uint64_t checksum(const char* data, std::size_t length){
+	//FNV-1a
+	uint64_t hash=14695981039346656037ull;
+	for(std::size_t i=0; i<length; i++){
+		hash^=(unsigned char)data[i];
+		hash*=1099511628211ull;
+	}
+	return hash;
+}
+
+class SnapshotWriter{
+public:
+	template<typename T>
+	void put(T value){
+		static_assert(std::is_integral<T>::value,"Only integers may be written directly");
+		buffer.append((const char*)&value,sizeof(T));
+	}
+	void put(const std::string& s){
+		put<uint32_t>(s.size());
+		buffer.append(s);
+	}
+	void put(const User& user){
+		for(const auto* field : {&user.unixName,&user.name,&user.email,&user.phone,
+		                         &user.institution,&user.token,&user.globusID,
+		                         &user.sshKey,&user.x509DN,&user.totpSecret,
+		                         &user.joinDate,&user.lastUseTime})
+			put(*field);
+		put<uint32_t>(user.unixID);
+		put<uint8_t>(user.superuser);
+		put<uint8_t>(user.serviceAccount);
+	}
+	void put(const UserSummary& user){
+		for(const auto* field : {&user.unixName,&user.name,&user.email,&user.phone,
+		                         &user.institution,&user.joinDate,&user.lastUseTime})
+			put(*field);
+		put<uint32_t>(user.unixID);
+		put<uint8_t>(user.superuser);
+		put<uint8_t>(user.serviceAccount);
+	}
+	void put(const Group& group){
+		for(const auto* field : {&group.name,&group.displayName,&group.email,&group.phone,
+		                         &group.purpose,&group.description,&group.creationDate})
+			put(*field);
+		put<uint32_t>(group.unixID);
+		put<uint8_t>(group.pending);
+	}
+	void put(const GroupRequest& request){
+		for(const auto* field : {&request.name,&request.displayName,&request.email,&request.phone,
+		                         &request.purpose,&request.description,&request.requester})
+			put(*field);
+		put<uint32_t>(request.unixID);
+		put<uint32_t>(request.secondaryAttributes.size());
+		for(const auto& attr : request.secondaryAttributes){
+			put(attr.first);
+			put(attr.second);
+		}
+	}
+	void put(const GroupMembership& membership){
+		put(membership.userName);
+		put(membership.groupName);
+		put<uint8_t>(membership.state);
+		put(membership.stateSetBy);
+	}
+	void put(const CacheSnapshot::Attribute& attribute){
+		put(std::get<0>(attribute));
+		put(std::get<1>(attribute));
+		put(std::get<2>(attribute));
+	}
+
+	///Encode a collection of records as a section
+	template<typename Container>
+	void addSection(SectionKind kind, const Container& records){
+		std::string data;
+		data.swap(buffer);
+		for(const auto& record : records)
+			put(record);
+		data.swap(buffer);
+		sections.push_back(Section{kind,(uint32_t)records.size(),std::move(data)});
+	}
+
+	///Assemble the complete file contents
+	std::string finish(uint32_t flags){
+		std::string body;
+		uint64_t offset=headerSize+sections.size()*sectionEntrySize;
+		for(const auto& section : sections){
+			buffer.clear();
+			put<uint32_t>(section.kind);
+			put<uint32_t>(section.count);
+			put<uint64_t>(offset);
+			put<uint64_t>(section.data.size());
+			body+=buffer;
+			offset+=section.data.size();
+		}
+		for(const auto& section : sections)
+			body+=section.data;
+		buffer.assign(snapshotMagic,sizeof(snapshotMagic));
+		put<uint32_t>(snapshotVersion);
+		put<uint32_t>(byteOrderMark);
+		put<uint32_t>(flags);
+		put<uint32_t>(sections.size());
+		put<uint64_t>(checksum(body.data(),body.size()));
+		return buffer+body;
+	}
+
+private:
+	struct Section{
+		SectionKind kind;
+		uint32_t count;
+		std::string data;
+	};
+	std::string buffer;
+	std::vector<Section> sections;
+};
+
+class SnapshotReader{
+public:
+	SnapshotReader(const char* begin, const char* end):pos(begin),end(end){}
+
+	template<typename T>
+	T get(){
+		static_assert(std::is_integral<T>::value,"Only integers may be read directly");
+		need(sizeof(T));
+		T value;
+		std::memcpy(&value,pos,sizeof(T));
+		pos+=sizeof(T);
+		return value;
+	}
+	void get(std::string& s){
+		uint32_t length=get<uint32_t>();
+		need(length);
+		s.assign(pos,length);
+		pos+=length;
+	}
+	void get(User& user){
+		user.valid=true;
+		for(auto* field : {&user.unixName,&user.name,&user.email,&user.phone,
+		                   &user.institution,&user.token,&user.globusID,
+		                   &user.sshKey,&user.x509DN,&user.totpSecret,
+		                   &user.joinDate,&user.lastUseTime})
+			get(*field);
+		user.unixID=get<uint32_t>();
+		user.superuser=get<uint8_t>();
+		user.serviceAccount=get<uint8_t>();
+	}
+	void get(UserSummary& user){
+		user.valid=true;
+		for(auto* field : {&user.unixName,&user.name,&user.email,&user.phone,
+		                   &user.institution,&user.joinDate,&user.lastUseTime})
+			get(*field);
+		user.unixID=get<uint32_t>();
+		user.superuser=get<uint8_t>();
+		user.serviceAccount=get<uint8_t>();
+	}
+	void get(Group& group){
+		group.valid=true;
+		for(auto* field : {&group.name,&group.displayName,&group.email,&group.phone,
+		                   &group.purpose,&group.description,&group.creationDate})
+			get(*field);
+		group.unixID=get<uint32_t>();
+		group.pending=get<uint8_t>();
+	}
+	void get(GroupRequest& request){
+		request.valid=true;
+		for(auto* field : {&request.name,&request.displayName,&request.email,&request.phone,
+		                   &request.purpose,&request.description,&request.requester})
+			get(*field);
+		request.unixID=get<uint32_t>();
+		uint32_t nAttributes=get<uint32_t>();
+		for(uint32_t i=0; i<nAttributes; i++){
+			std::string name, value;
+			get(name);
+			get(value);
+			request.secondaryAttributes.emplace(std::move(name),std::move(value));
+		}
+	}
+	void get(GroupMembership& membership){
+		membership.valid=true;
+		get(membership.userName);
+		get(membership.groupName);
+		uint8_t state=get<uint8_t>();
+		if(state>GroupMembership::Disabled)
+			throw std::runtime_error("Invalid membership state in cache snapshot");
+		membership.state=(GroupMembership::Status)state;
+		get(membership.stateSetBy);
+	}
+	void get(CacheSnapshot::Attribute& attribute){
+		get(std::get<0>(attribute));
+		get(std::get<1>(attribute));
+		get(std::get<2>(attribute));
+	}
+
+	///Decode a section containing count records
+	template<typename T>
+	void getAll(std::vector<T>& records, uint32_t count){
+		//the count cannot be trusted to size the allocation until it is known
+		//that the section is large enough
+		records.reserve(std::min<std::size_t>(count,end-pos));
+		for(uint32_t i=0; i<count; i++){
+			records.emplace_back();
+			get(records.back());
+		}
+	}
+
+private:
+	const char* pos;
+	const char* end;
+
+	void need(std::size_t n) const{
+		if((std::size_t)(end-pos)<n)
+			throw std::runtime_error("Cache snapshot is truncated");
+	}
+};
+
+///Owns a read-only memory mapping of a file
+class MappedFile{
+public:
+	explicit MappedFile(const std::string& path):data(nullptr),length(0){
+		int fd=open(path.c_str(),O_RDONLY);
+		if(fd<0)
+			throw std::runtime_error("Unable to open "+path+": "+std::strerror(errno));
+		struct stat info;
+		if(fstat(fd,&info)){
+			int err=errno;
+			close(fd);
+			throw std::runtime_error("Unable to stat "+path+": "+std::strerror(err));
+		}
+		length=info.st_size;
+		if(length){
+			void* mapped=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+			if(mapped==MAP_FAILED){
+				int err=errno;
+				close(fd);
+				throw std::runtime_error("Unable to map "+path+": "+std::strerror(err));
+			}
+			data=(const char*)mapped;
+		}
+		close(fd);
+	}
+	MappedFile(const MappedFile&)=delete;
+	MappedFile& operator=(const MappedFile&)=delete;
+	~MappedFile(){
+		if(data)
+			munmap((void*)data,length);
+	}
+
+	const char* data;
+	std::size_t length;
+};
+
+}
+
+void writeCacheSnapshot(const std::string& path, const CacheSnapshot& snapshot){
+	SnapshotWriter writer;
+	writer.addSection(UserSection,snapshot.users);
+	writer.addSection(GroupSection,snapshot.groups);
+	writer.addSection(GroupRequestSection,snapshot.groupRequests);
+	writer.addSection(MembershipSection,snapshot.memberships);
+	writer.addSection(CompleteUserMembershipSection,snapshot.completeUserMemberships);
+	writer.addSection(CompleteGroupMembershipSection,snapshot.completeGroupMemberships);
+	writer.addSection(UserAttributeSection,snapshot.userAttributes);
+	writer.addSection(GroupAttributeSection,snapshot.groupAttributes);
+	writer.addSection(UserSummarySection,snapshot.userSummaries);
+	uint32_t flags=0;
+	if(snapshot.usersComplete)
+		flags|=UsersComplete;
+	if(snapshot.groupsComplete)
+		flags|=GroupsComplete;
+	if(snapshot.groupRequestsComplete)
+		flags|=GroupRequestsComplete;
+	const std::string contents=writer.finish(flags);
+
+	const std::string tempPath=path+".tmp";
+	int fd=open(tempPath.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0600);
+	if(fd<0)
+		throw std::runtime_error("Unable to open "+tempPath+": "+std::strerror(errno));
+	std::size_t written=0;
+	while(written<contents.size()){
+		ssize_t result=write(fd,contents.data()+written,contents.size()-written);
+		if(result<0){
+			if(errno==EINTR)
+				continue;
+			int err=errno;
+			close(fd);
+			unlink(tempPath.c_str());
+			throw std::runtime_error("Unable to write "+tempPath+": "+std::strerror(err));
+		}
+		written+=result;
+	}
+	if(fsync(fd) || close(fd)){
+		int err=errno;
+		unlink(tempPath.c_str());
+		throw std::runtime_error("Unable to write "+tempPath+": "+std::strerror(err));
+	}
+	if(rename(tempPath.c_str(),path.c_str())){
+		int err=errno;
+		unlink(tempPath.c_str());
+		throw std::runtime_error("Unable to replace "+path+": "+std::strerror(err));
+	}
+}
+
+CacheSnapshot readCacheSnapshot(const std::string& path){
+	MappedFile file(path);
+	if(file.length<headerSize || std::memcmp(file.data,snapshotMagic,sizeof(snapshotMagic)))
+		throw std::runtime_error(path+" is not a cache snapshot");
+	SnapshotReader header(file.data+sizeof(snapshotMagic),file.data+headerSize);
+	uint32_t version=header.get<uint32_t>();
+	if(version!=snapshotVersion)
+		throw std::runtime_error("Unsupported cache snapshot version "+std::to_string(version));
+	if(header.get<uint32_t>()!=byteOrderMark)
+		throw std::runtime_error("Cache snapshot was written on a machine with a different byte order");
+	uint32_t flags=header.get<uint32_t>();
+	uint32_t nSections=header.get<uint32_t>();
+	uint64_t expectedChecksum=header.get<uint64_t>();
+	if(checksum(file.data+headerSize,file.length-headerSize)!=expectedChecksum)
+		throw std::runtime_error("Cache snapshot is corrupt");
+
+	CacheSnapshot snapshot;
+	snapshot.usersComplete=flags&UsersComplete;
+	snapshot.groupsComplete=flags&GroupsComplete;
+	snapshot.groupRequestsComplete=flags&GroupRequestsComplete;
+	SnapshotReader table(file.data+headerSize,file.data+file.length);
+	bool sawSummaries=false;
+	for(uint32_t i=0; i<nSections; i++){
+		uint32_t kind=table.get<uint32_t>();
+		uint32_t count=table.get<uint32_t>();
+		uint64_t offset=table.get<uint64_t>();
+		uint64_t length=table.get<uint64_t>();
+		if(offset>file.length || length>file.length-offset)
+			throw std::runtime_error("Cache snapshot section lies outside the file");
+		SnapshotReader section(file.data+offset,file.data+offset+length);
+		switch(kind){
+			case UserSection: section.getAll(snapshot.users,count); break;
+			case GroupSection: section.getAll(snapshot.groups,count); break;
+			case GroupRequestSection: section.getAll(snapshot.groupRequests,count); break;
+			case MembershipSection: section.getAll(snapshot.memberships,count); break;
+			case CompleteUserMembershipSection: section.getAll(snapshot.completeUserMemberships,count); break;
+			case CompleteGroupMembershipSection: section.getAll(snapshot.completeGroupMemberships,count); break;
+			case UserAttributeSection: section.getAll(snapshot.userAttributes,count); break;
+			case GroupAttributeSection: section.getAll(snapshot.groupAttributes,count); break;
+			case UserSummarySection:
+				section.getAll(snapshot.userSummaries,count);
+				sawSummaries=true;
+				break;
+			default: break; //written by a newer version; ignore
+		}
+	}
+	//Older snapshots marked users complete when the full records of all 
+	//users were present, so the summaries can be derived from them
+	if(snapshot.usersComplete && !sawSummaries){
+		snapshot.userSummaries.reserve(snapshot.users.size());
+		for(const auto& user : snapshot.users)
+			snapshot.userSummaries.emplace_back(user);
+	}
+	return snapshot;
+}
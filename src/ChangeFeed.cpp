@@ -0,0 +1,329 @@
+#include <ChangeFeed.h>
+
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+#include <aws/core/utils/Outcome.h>
+#include <aws/dynamodb/model/CreateTableRequest.h>
+#include <aws/dynamodb/model/DescribeTableRequest.h>
+#include <aws/dynamodb/model/PutItemRequest.h>
+#include <aws/dynamodb/model/QueryRequest.h>
+#include <aws/dynamodb/model/UpdateTimeToLiveRequest.h>
+
+#include <Logging.h>
+#include <ServerUtilities.h>
+
+std::string ChangeEvent::to_string(Kind kind){
+	switch(kind){
+		case UserChanged: return "user";
+		case MembershipChanged: return "membership";
+		case UserAttributeChanged: return "userAttribute";
+		case GroupChanged: return "group";
+		case GroupAttributeChanged: return "groupAttribute";
+	}
+	throw std::runtime_error("Invalid change event kind");
+}
+
+ChangeEvent::Kind ChangeEvent::from_string(const std::string& kind){
+	if(kind=="user")
+		return UserChanged;
+	if(kind=="membership")
+		return MembershipChanged;
+	if(kind=="userAttribute")
+		return UserAttributeChanged;
+	if(kind=="group")
+		return GroupChanged;
+	if(kind=="groupAttribute")
+		return GroupAttributeChanged;
+	throw std::runtime_error("Invalid change event kind: "+kind);
+}
+
+namespace{
+
+///\return a name for this process which is very likely to be unique among all
+///        server instances
+std::string makeOrigin(){
+	char hostname[256]={0};
+	if(gethostname(hostname,sizeof(hostname)-1))
+		hostname[0]='\0';
+	std::random_device source;
+	std::ostringstream os;
+	os << hostname << '-' << getpid() << '-' << std::hex << source();
+	return os.str();
+}
+
+}
+
+ChangeFeed::ChangeFeed():origin(makeOrigin()),published(0),received(0){}
+
+std::string ChangeFeed::describe() const{
+	std::ostringstream os;
+	os << published.load() << " changes published, " << received.load() << " received";
+	return os.str();
+}
+
+//----
+
+class LoopbackChangeFeed::Hub{
+public:
+	std::mutex mut;
+	std::vector<std::pair<const LoopbackChangeFeed*,std::weak_ptr<Inbox>>> members;
+};
+
+std::shared_ptr<LoopbackChangeFeed::Hub> LoopbackChangeFeed::makeHub(){
+	return std::make_shared<Hub>();
+}
+
+LoopbackChangeFeed::LoopbackChangeFeed(std::shared_ptr<Hub> hub):
+hub(std::move(hub)),inbox(std::make_shared<Inbox>()){
+	std::lock_guard<std::mutex> lock(this->hub->mut);
+	this->hub->members.emplace_back(this,inbox);
+}
+
+LoopbackChangeFeed::~LoopbackChangeFeed(){
+	std::lock_guard<std::mutex> lock(hub->mut);
+	for(auto it=hub->members.begin(); it!=hub->members.end(); it++){
+		if(it->first==this){
+			hub->members.erase(it);
+			break;
+		}
+	}
+}
+
+bool LoopbackChangeFeed::publish(ChangeEvent event){
+	event.origin=origin;
+	std::lock_guard<std::mutex> lock(hub->mut);
+	for(const auto& member : hub->members){
+		if(member.first==this)
+			continue;
+		if(auto other=member.second.lock()){
+			std::lock_guard<std::mutex> inboxLock(other->mut);
+			other->events.push_back(event);
+		}
+	}
+	published++;
+	return true;
+}
+
+std::vector<ChangeEvent> LoopbackChangeFeed::poll(){
+	std::vector<ChangeEvent> events;
+	{
+		std::lock_guard<std::mutex> lock(inbox->mut);
+		events.swap(inbox->events);
+	}
+	received+=events.size();
+	return events;
+}
+
+//----
+
+const unsigned int DynamoDBChangeFeed::shards=4;
+const std::chrono::milliseconds DynamoDBChangeFeed::clockSkewAllowance(5000);
+const std::chrono::hours DynamoDBChangeFeed::retention(24);
+
+namespace{
+
+///Format a time as fixed width microseconds since the epoch, so that
+///positions sort in time order
+std::string formatPositionTime(std::chrono::system_clock::time_point time){
+	auto micros=std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+	if(micros<0)
+		micros=0;
+	std::ostringstream os;
+	os << std::setw(16) << std::setfill('0') << micros;
+	return os.str();
+}
+
+///Recover the time from a position
+std::chrono::system_clock::time_point parsePositionTime(const std::string& position){
+	unsigned long long micros=std::stoull(position.substr(0,16));
+	return std::chrono::system_clock::time_point(std::chrono::microseconds(micros));
+}
+
+}
+
+DynamoDBChangeFeed::DynamoDBChangeFeed(const Aws::Auth::AWSCredentials& credentials,
+                                       const Aws::Client::ClientConfiguration& clientConfig,
+                                       std::string tableName):
+dbClient(credentials,clientConfig),
+tableName(std::move(tableName)),
+sequence(0),
+//changes made before this instance started are of no interest, since it has
+//not yet cached anything
+lastPositions(shards,formatPositionTime(std::chrono::system_clock::now())),
+recentlySeen(shards),
+pollFailures(0)
+{
+	initializeTable();
+	log_info("Publishing changes as " << origin << " via table " << this->tableName);
+}
+
+void DynamoDBChangeFeed::initializeTable(){
+	using namespace Aws::DynamoDB::Model;
+	using AttDef=Aws::DynamoDB::Model::AttributeDefinition;
+	using SAT=Aws::DynamoDB::Model::ScalarAttributeType;
+
+	auto tableOut=dbClient.DescribeTable(DescribeTableRequest()
+	                                     .WithTableName(tableName));
+	if(tableOut.IsSuccess())
+		return;
+	if(tableOut.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::RESOURCE_NOT_FOUND){
+		log_fatal("Unable to connect to DynamoDB: "
+		          << tableOut.GetError().GetMessage());
+	}
+
+	log_info("changes table does not exist; creating");
+	auto request=CreateTableRequest();
+	request.SetTableName(tableName);
+	request.SetAttributeDefinitions({
+		AttDef().WithAttributeName("shard").WithAttributeType(SAT::N),
+		AttDef().WithAttributeName("position").WithAttributeType(SAT::S)
+	});
+	request.SetKeySchema({
+		KeySchemaElement().WithAttributeName("shard").WithKeyType(KeyType::HASH),
+		KeySchemaElement().WithAttributeName("position").WithKeyType(KeyType::RANGE)
+	});
+	request.SetProvisionedThroughput(ProvisionedThroughput()
+	                                 .WithReadCapacityUnits(1)
+	                                 .WithWriteCapacityUnits(1));
+	auto createOut=dbClient.CreateTable(request);
+	if(!createOut.IsSuccess())
+		log_fatal("Failed to create changes table: " + createOut.GetError().GetMessage());
+
+	log_info("Waiting for table " << tableName << " to reach active status");
+	DescribeTableOutcome outcome;
+	do{
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		outcome=dbClient.DescribeTable(DescribeTableRequest()
+		                               .WithTableName(tableName));
+	}while(outcome.IsSuccess() &&
+	       outcome.GetResult().GetTable().GetTableStatus()!=TableStatus::ACTIVE);
+	if(!outcome.IsSuccess())
+		log_fatal("Table " << tableName << " does not seem to be available? "
+		          "Dynamo error: " << outcome.GetError().GetMessage());
+
+	//Not all implementations support this, and the feed works without it,
+	//so failure is not fatal.
+	auto ttlOut=dbClient.UpdateTimeToLive(UpdateTimeToLiveRequest()
+	                                      .WithTableName(tableName)
+	                                      .WithTimeToLiveSpecification(TimeToLiveSpecification()
+	                                                                   .WithEnabled(true)
+	                                                                   .WithAttributeName("expires")));
+	if(!ttlOut.IsSuccess())
+		log_warn("Unable to enable expiration of old changes: " << ttlOut.GetError().GetMessage());
+}
+
+std::string DynamoDBChangeFeed::makePosition(std::chrono::system_clock::time_point time){
+	std::ostringstream os;
+	os << formatPositionTime(time) << ':' << origin << ':'
+	   << std::setw(10) << std::setfill('0') << (sequence++);
+	return os.str();
+}
+
+bool DynamoDBChangeFeed::publish(ChangeEvent event){
+	event.origin=origin;
+	auto now=std::chrono::system_clock::now();
+	unsigned int shard=std::hash<std::string>{}(event.subject)%shards;
+	auto expires=std::chrono::duration_cast<std::chrono::seconds>((now+retention).time_since_epoch()).count();
+
+	using AV=Aws::DynamoDB::Model::AttributeValue;
+	Aws::Map<Aws::String,AV> item{
+		{"shard",AV().SetN(std::to_string(shard))},
+		{"position",AV(makePosition(now))},
+		{"kind",AV(ChangeEvent::to_string(event.kind))},
+		{"subject",AV(event.subject)},
+		{"origin",AV(event.origin)},
+		{"expires",AV().SetN(std::to_string(expires))}
+	};
+	//Dynamo does not allow empty strings
+	if(!event.detail.empty())
+		item.emplace("detail",AV(event.detail));
+	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	                              .WithTableName(tableName)
+	                              .WithItem(item));
+	if(!outcome.IsSuccess()){
+		auto err=outcome.GetError();
+		log_error("Failed to publish change record: " << err.GetMessage());
+		return false;
+	}
+	published++;
+	return true;
+}
+
+std::vector<ChangeEvent> DynamoDBChangeFeed::poll(){
+	using AV=Aws::DynamoDB::Model::AttributeValue;
+	std::vector<ChangeEvent> events;
+	for(unsigned int shard=0; shard<shards; shard++){
+		//Look back from the last event seen, in case another instance with a
+		//slower clock has since published an event which sorts before it
+		const std::string start=formatPositionTime(parsePositionTime(lastPositions[shard])-clockSkewAllowance);
+		auto& seen=recentlySeen[shard];
+		//events before the start cannot be returned again, so need not be remembered
+		seen.erase(seen.begin(),seen.lower_bound(start));
+
+		auto request=Aws::DynamoDB::Model::QueryRequest()
+		.WithTableName(tableName)
+		.WithConsistentRead(true)
+		.WithKeyConditionExpression("#shard = :shard AND #position > :start")
+		.WithExpressionAttributeNames({
+			{"#shard","shard"},
+			{"#position","position"}
+		})
+		.WithExpressionAttributeValues({
+			{":shard",AV().SetN(std::to_string(shard))},
+			{":start",AV(start)}
+		});
+		bool keepGoing=false;
+		do{
+			auto outcome=dbClient.Query(request);
+			if(!outcome.IsSuccess()){
+				auto err=outcome.GetError();
+				log_warn("Failed to read change records: " << err.GetMessage());
+				pollFailures++;
+				break;
+			}
+			const auto& result=outcome.GetResult();
+			if(!result.GetLastEvaluatedKey().empty()){
+				keepGoing=true;
+				request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
+			}
+			else
+				keepGoing=false;
+			for(const auto& item : result.GetItems()){
+				try{
+					std::string position=findOrThrow(item,"position","change record missing position").GetS();
+					if(!seen.insert(position).second)
+						continue; //already handled
+					if(position>lastPositions[shard])
+						lastPositions[shard]=position;
+					ChangeEvent event;
+					event.origin=findOrThrow(item,"origin","change record missing origin").GetS();
+					if(event.origin==origin)
+						continue;
+					event.kind=ChangeEvent::from_string(findOrThrow(item,"kind","change record missing kind").GetS());
+					event.subject=findOrThrow(item,"subject","change record missing subject").GetS();
+					auto detail=item.find("detail");
+					if(detail!=item.end())
+						event.detail=detail->second.GetS();
+					events.push_back(std::move(event));
+				}catch(std::exception& ex){
+					log_warn("Ignoring malformed change record: " << ex.what());
+				}
+			}
+		}while(keepGoing);
+	}
+	received+=events.size();
+	return events;
+}
+
+std::string DynamoDBChangeFeed::describe() const{
+	std::ostringstream os;
+	os << ChangeFeed::describe() << ", " << pollFailures.load() << " failed reads";
+	return os.str();
+}
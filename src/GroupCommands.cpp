@@ -200,8 +200,10 @@ crow::response createGroup(PersistentStore& store, const crow::request& req,
 		return crow::response(404,generateError("Parent group not found"));
 	//only an admin in the parent group may create child groups
 	//other members may request the creation of child groups
-	if(!user.superuser && !store.userStatusInGroup(user.unixName,parentGroup.name).isMember()
-	   && adminInAnyEnclosingGroup(store,user.unixName,parentGroup.name).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,parentGroup.name,Authorizer::Participate);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	{
 		Group existingGroup=store.getGroup(newGroupName);
@@ -333,9 +335,10 @@ crow::response createGroup(PersistentStore& store, const crow::request& req,
 	
 	//if the user is a superuser, group admin, or admin of an enclosing group, 
 	//we just go ahead with creating the group
-	if(user.superuser || 
-	   store.userStatusInGroup(user.unixName,parentGroup.name).state==GroupMembership::Admin
-	   || !adminInAnyEnclosingGroup(store,user.unixName,parentGroup.name).empty()){
+	Authorizer::Decision adminAuthorization=store.getAuthorizer().check(user,parentGroup.name,Authorizer::Administer);
+	if(!adminAuthorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(adminAuthorization){
 		group.valid=true;
 	
 		log_info("Creating Group " << group);
@@ -387,12 +390,13 @@ crow::response createGroup(PersistentStore& store, const crow::request& req,
 		EmailClient::Email adminMessage;
 		adminMessage.fromAddress="noreply@api.ci-connect.net";
 		adminMessage.toAddresses={parentGroup.email};
+		std::vector<std::string> adminNames;
 		for(const auto& membership : store.getMembersOfGroup(parentGroup.name)){
-			if(membership.state==GroupMembership::Admin){
-				User admin=store.getUser(membership.userName);
-				adminMessage.toAddresses.push_back(admin.email);
-			}
+			if(membership.state==GroupMembership::Admin)
+				adminNames.push_back(membership.userName);
 		}
+		for(const User& admin : store.getUsers(adminNames))
+			adminMessage.toAddresses.push_back(admin.email);
 		adminMessage.replyTo=user.email;
 		adminMessage.subject="CI-Connect group creation request";
 		adminMessage.body="This is an automatic notification that "+user.name+
@@ -464,9 +468,10 @@ crow::response updateGroup(PersistentStore& store, const crow::request& req, std
 		
 	groupName=canonicalizeGroupName(groupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,groupName).state!=GroupMembership::Admin &&
-	   adminInAnyEnclosingGroup(store,user.unixName,groupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,groupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	//unpack the new Group info
@@ -483,24 +488,25 @@ crow::response updateGroup(PersistentStore& store, const crow::request& req, std
 	if(!body["metadata"].IsObject())
 		return crow::response(400,generateError("Incorrect type for metadata"));
 		
-	bool doUpdate=false;
+	//the database attributes which the request supplies
+	std::set<std::string> updatedAttributes;
 	if(body["metadata"].HasMember("display_name")){
 		if(!body["metadata"]["display_name"].IsString())
 			return crow::response(400,generateError("Incorrect type for display name"));	
 		targetGroup.displayName=body["metadata"]["display_name"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("displayName");
 	}
 	if(body["metadata"].HasMember("email")){
 		if(!body["metadata"]["email"].IsString())
 			return crow::response(400,generateError("Incorrect type for email"));	
 		targetGroup.email=body["metadata"]["email"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("email");
 	}
 	if(body["metadata"].HasMember("phone")){
 		if(!body["metadata"]["phone"].IsString())
 			return crow::response(400,generateError("Incorrect type for phone"));	
 		targetGroup.phone=body["metadata"]["phone"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("phone");
 	}
 	if(body["metadata"].HasMember("purpose")){
 		if(!body["metadata"]["purpose"].IsString())
@@ -508,22 +514,22 @@ crow::response updateGroup(PersistentStore& store, const crow::request& req, std
 		targetGroup.purpose=normalizeScienceField(body["metadata"]["purpose"].GetString());
 		if(targetGroup.purpose.empty())
 			return crow::response(400,generateError("Unrecognized value for Group purpose"));
-		doUpdate=true;
+		updatedAttributes.insert("purpose");
 	}
 	if(body["metadata"].HasMember("description")){
 		if(!body["metadata"]["description"].IsString())
 			return crow::response(400,generateError("Incorrect type for description"));	
 		targetGroup.description=body["metadata"]["description"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("description");
 	}
 	
-	if(!doUpdate){
+	if(updatedAttributes.empty()){
 		log_info("Requested update to " << targetGroup << " is trivial");
 		return(crow::response(200));
 	}
 	
 	log_info("Updating " << targetGroup);
-	bool success=store.updateGroup(targetGroup);
+	bool success=store.updateGroup(targetGroup,updatedAttributes);
 	
 	if(!success){
 		log_error("Failed to update " << targetGroup);
@@ -548,11 +554,13 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 	//There are no members of a group request; the relevant authorities are the 
 	//enclosing group admins and the requester. 
 	std::string enclosingGroupName=enclosingGroup(groupName);
-	if(!user.superuser && 
-	  store.userStatusInGroup(user.unixName,enclosingGroupName).state!=GroupMembership::Admin
-	  && adminInAnyEnclosingGroup(store,user.unixName,enclosingGroupName).empty()
-	  && user.unixName!=targetRequest.requester)
-		return crow::response(403,generateError("Not authorized"));
+	if(user.unixName!=targetRequest.requester){
+		Authorizer::Decision authorization=store.getAuthorizer().check(user,enclosingGroupName,Authorizer::Administer);
+		if(!authorization.complete)
+			return crow::response(500,generateError("Failed to look up group memberships"));
+		if(!authorization)
+			return crow::response(403,generateError("Not authorized"));
+	}
 	
 	//unpack the new info
 	rapidjson::Document body;
@@ -568,7 +576,8 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 	if(!body["metadata"].IsObject())
 		return crow::response(400,generateError("Incorrect type for metadata"));
 		
-	bool doUpdate=false;
+	//the database attributes which the request supplies
+	std::set<std::string> updatedAttributes;
 	bool nameChange=false;
 	
 	if(body["metadata"].HasMember("name")){
@@ -586,26 +595,26 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 		//TODO: it would be problematic if the requested name attempts to move 
 		//the request somewhere else in the group hierarchy
 		targetRequest.name=requestedName;
-		doUpdate=true;
+		updatedAttributes.insert("name");
 		nameChange=true;
 	}
 	if(body["metadata"].HasMember("display_name")){
 		if(!body["metadata"]["display_name"].IsString())
 			return crow::response(400,generateError("Incorrect type for display name"));
 		targetRequest.displayName=body["metadata"]["display_name"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("displayName");
 	}
 	if(body["metadata"].HasMember("email")){
 		if(!body["metadata"]["email"].IsString())
 			return crow::response(400,generateError("Incorrect type for email"));
 		targetRequest.email=body["metadata"]["email"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("email");
 	}
 	if(body["metadata"].HasMember("phone")){
 		if(!body["metadata"]["phone"].IsString())
 			return crow::response(400,generateError("Incorrect type for phone"));
 		targetRequest.phone=body["metadata"]["phone"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("phone");
 	}
 	if(body["metadata"].HasMember("purpose")){
 		if(!body["metadata"]["purpose"].IsString())
@@ -613,13 +622,13 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 		targetRequest.purpose=normalizeScienceField(body["metadata"]["purpose"].GetString());
 		if(targetRequest.purpose.empty())
 			return crow::response(400,generateError("Unrecognized value for Group purpose"));
-		doUpdate=true;
+		updatedAttributes.insert("purpose");
 	}
 	if(body["metadata"].HasMember("description")){
 		if(!body["metadata"]["description"].IsString())
 			return crow::response(400,generateError("Incorrect type for description"));
 		targetRequest.description=body["metadata"]["description"].GetString();
-		doUpdate=true;
+		updatedAttributes.insert("description");
 	}
 	if(body["metadata"].HasMember("additional_attributes")){
 		if(!body["metadata"]["additional_attributes"].IsObject())
@@ -632,12 +641,12 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 			if(key.empty() || value.empty())
 				return crow::response(400,generateError("Additional group attribute keys and values cannot be empty strings"));
 			targetRequest.secondaryAttributes[key]=value;
-			doUpdate=true;
+			updatedAttributes.insert("secondaryAttributes");
 		}
 	}
 	
 	
-	if(!doUpdate){
+	if(updatedAttributes.empty()){
 		log_info("Requested update to " << targetRequest << " is trivial");
 		return(crow::response(200));
 	}
@@ -657,7 +666,7 @@ crow::response updateGroupRequest(PersistentStore& store, const crow::request& r
 		}
 	}
 	else
-		success=store.updateGroupRequest(targetRequest);
+		success=store.updateGroupRequest(targetRequest,updatedAttributes);
 	
 	if(!success){
 		log_error("Failed to update " << targetRequest);
@@ -674,9 +683,10 @@ crow::response deleteGroup(PersistentStore& store, const crow::request& req, std
 		return crow::response(403,generateError("Not authorized"));
 	groupName=canonicalizeGroupName(groupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,groupName).state!=GroupMembership::Admin
-	   && adminInAnyEnclosingGroup(store,user.unixName,groupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,groupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	Group targetGroup = store.getGroup(groupName);
@@ -690,19 +700,12 @@ crow::response deleteGroup(PersistentStore& store, const crow::request& req, std
 	const Group parentGroup=store.getGroup(enclosingGroup(groupName));
 	
 	log_info("Deleting " << targetGroup << " subgroups");
-	std::string filterPrefix=groupName+".";
-	//collect names of all subgroups
-	std::vector<std::string> subgroups;
-	for (const Group& group : store.listGroups()){
-		if(group.name.find(filterPrefix)!=0)
-			continue;
-		subgroups.push_back(group.name);
-	}
-	//sort in reverse order so that we delete foo.bar.baz before foo.bar, etc.
-	std::sort(subgroups.begin(),subgroups.end(),std::greater<std::string>{});
-	for(auto group : subgroups){
-		log_info("Deleting " << group);
-		bool deleted = store.removeGroup(group);
+	std::vector<Group> subgroups=store.listSubgroups(groupName);
+	//subgroups are listed after their enclosing groups, so go backwards to 
+	//delete foo.bar.baz before foo.bar, etc.
+	for(auto group=subgroups.rbegin(); group!=subgroups.rend(); group++){
+		log_info("Deleting " << group->name);
+		bool deleted = store.removeGroup(group->name);
 		if (!deleted)
 			return crow::response(500, generateError("Group deletion failed"));
 	}
@@ -717,11 +720,15 @@ crow::response deleteGroup(PersistentStore& store, const crow::request& req, std
 	message.fromAddress="noreply@api.ci-connect.net";
 	message.toAddresses={parentGroup.email};
 	message.bccAddresses.reserve(memberships.size());
+	std::vector<std::string> memberNames;
+	memberNames.reserve(memberships.size());
 	for(const auto& membership : memberships){
 		if(membership.state==GroupMembership::NonMember)
 			continue; //ignore non-members who may have been reported
-		message.bccAddresses.push_back(store.getUser(membership.userName).email);
+		memberNames.push_back(membership.userName);
 	}
+	for(const User& member : store.getUsers(memberNames))
+		message.bccAddresses.push_back(member.email);
 	message.subject="CI-Connect group deleted";
 	message.body="This is an automatic notification that "+user.name+
 	" ("+user.unixName+") has deleted the "+targetGroup.displayName+
@@ -745,31 +752,60 @@ crow::response listGroupMembers(PersistentStore& store, const crow::request& req
 	if(!targetGroup)
 		return crow::response(404,generateError("Group not found"));
 	
-	try{
-	auto memberships=store.getMembersOfGroup(targetGroup.name);
-	log_info("Found " << memberships.size() << " members of " << groupName);
-	
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	//A limit or cursor requests a single page; otherwise all members are 
+	//returned, read a page at a time and written out as they arrive
+	unsigned int limit=0;
+	crow::response paramError;
+	if(!unsignedQueryParam(req,"limit",limit,1,paramError))
+		return paramError;
+	const char* cursorParam=req.url_params.get("cursor");
+	bool paged=limit || cursorParam;
 	
-	result.AddMember("apiVersion", "v1alpha1", alloc);
-	rapidjson::Value resultItems(rapidjson::kArrayType);
-	resultItems.Reserve(memberships.size(), alloc);
-	for(const auto& membership : memberships){
+	try{
+	rapidjson::StringBuffer buf;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buf);
+	writer.StartObject();
+	writer.Key("apiVersion");
+	writer.String("v1alpha1");
+	writer.Key("memberships");
+	writer.StartArray();
+	std::size_t count=0;
+	auto writeMembership=[&](const GroupMembership& membership){
 		if(membership.state==GroupMembership::NonMember)
-			continue;
-		rapidjson::Value userResult(rapidjson::kObjectType);
-		userResult.AddMember("user_name", membership.userName, alloc);
-		userResult.AddMember("state", GroupMembership::to_string(membership.state), alloc);
-		userResult.AddMember("state_set_by", membership.stateSetBy, alloc);
-		resultItems.PushBack(userResult, alloc);
+			return;
+		writer.StartObject();
+		writer.Key("user_name");
+		writer.String(membership.userName);
+		writer.Key("state");
+		writer.String(GroupMembership::to_string(membership.state));
+		writer.Key("state_set_by");
+		writer.String(membership.stateSetBy);
+		writer.EndObject();
+		count++;
+	};
+	std::string nextCursor;
+	if(paged){
+		auto page=store.getMembersOfGroupPage(targetGroup.name,limit,cursorParam?cursorParam:"");
+		if(!page.valid)
+			return crow::response(500,generateError("Failed to read group members"));
+		for(const auto& membership : page.memberships)
+			writeMembership(membership);
+		nextCursor=std::move(page.cursor);
 	}
-	result.AddMember("memberships", resultItems, alloc);
+	else if(!store.forEachMemberOfGroup(targetGroup.name,writeMembership))
+		return crow::response(500,generateError("Failed to read group members"));
+	writer.EndArray();
+	if(!nextCursor.empty()){
+		writer.Key("next_cursor");
+		writer.String(nextCursor);
+	}
+	writer.EndObject();
+	log_info("Found " << count << " members of " << groupName);
 	
 	high_resolution_clock::time_point t2 = high_resolution_clock::now();
 	log_info("Sending OK response with group membership data after " <<
 	         duration_cast<duration<double>>(t2-t1).count() << " seconds");
-	return crow::response(to_string(result));
+	return crow::response(std::string(buf.GetString(),buf.GetSize()));
 	}catch(std::exception& ex){
 		log_error("Failure providing group membership data: " << ex.what());
 		throw;
@@ -812,17 +848,22 @@ crow::response getSubgroups(PersistentStore& store, const crow::request& req, st
 	if(!parentGroup)
 		return crow::response(404,generateError("Group not found"));
 	
-	std::string filterPrefix=groupName+".";
-	std::vector<Group> allGroups=store.listGroups();
+	//A depth limits how many levels of subgroups are listed, so that 1 lists 
+	//only direct subgroups; otherwise all levels are listed
+	unsigned int depth=0;
+	crow::response paramError;
+	if(!unsignedQueryParam(req,"depth",depth,0,paramError))
+		return paramError;
+	
+	std::vector<Group> subgroups=store.listSubgroups(groupName,depth);
 
 	rapidjson::Document result(rapidjson::kObjectType);
 	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 	rapidjson::Value resultItems(rapidjson::kArrayType);
-	for (const Group& group : allGroups){
-		if(group.name.find(filterPrefix)!=0)
-			continue;
+	resultItems.Reserve(subgroups.size(), alloc);
+	for (const Group& group : subgroups){
 		rapidjson::Value groupResult(rapidjson::kObjectType);
 		groupResult.AddMember("name", group.name, alloc);
 		groupResult.AddMember("display_name", group.displayName, alloc);
@@ -851,17 +892,15 @@ crow::response getSubgroupRequests(PersistentStore& store, const crow::request&
 	if(!parentGroup)
 		return crow::response(404,generateError("Group not found"));
 	
-	std::string filterPrefix=groupName+".";
-	std::vector<GroupRequest> allGroups=store.listGroupRequests();
+	std::vector<GroupRequest> requests=store.listSubgroupRequests(groupName);
 
 	rapidjson::Document result(rapidjson::kObjectType);
 	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
 	
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 	rapidjson::Value resultItems(rapidjson::kArrayType);
-	for (const GroupRequest& group : allGroups){
-		if(group.name.find(filterPrefix)!=0)
-			continue;
+	resultItems.Reserve(requests.size(), alloc);
+	for (const GroupRequest& group : requests){
 		rapidjson::Value groupResult(rapidjson::kObjectType);
 		groupResult.AddMember("name", group.name, alloc);
 		groupResult.AddMember("display_name", group.displayName, alloc);
@@ -889,9 +928,10 @@ crow::response approveSubgroupRequest(PersistentStore& store, const crow::reques
 		
 	parentGroupName=canonicalizeGroupName(parentGroupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,parentGroupName).state!=GroupMembership::Admin
-	   && adminInAnyEnclosingGroup(store,user.unixName,parentGroupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,parentGroupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	newGroupName=canonicalizeGroupName(newGroupName,parentGroupName);
@@ -963,9 +1003,10 @@ crow::response denySubgroupRequest(PersistentStore& store, const crow::request&
 		
 	parentGroupName=canonicalizeGroupName(parentGroupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,parentGroupName).state!=GroupMembership::Admin
-	   && adminInAnyEnclosingGroup(store,user.unixName,parentGroupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,parentGroupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	newGroupName=canonicalizeGroupName(newGroupName);
@@ -1029,6 +1070,30 @@ crow::response getGroupAttribute(PersistentStore& store, const crow::request& re
 	return crow::response(to_string(result));
 }
 
+crow::response listGroupAttributes(PersistentStore& store, const crow::request& req, std::string groupName){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested to fetch all secondary attributes of group " << groupName << " from " << req.remote_endpoint);
+	if(!user)
+		return crow::response(403,generateError("Not authorized"));
+	
+	groupName=canonicalizeGroupName(groupName);
+	//Any user can query any group property?
+	
+	if(!store.getGroup(groupName))
+		return crow::response(404,generateError("Group not found"));
+	
+	rapidjson::Document result(rapidjson::kObjectType);
+	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	
+	result.AddMember("apiVersion", "v1alpha1", alloc);
+	rapidjson::Value data(rapidjson::kObjectType);
+	for(const auto& attribute : store.getGroupSecondaryAttributes(groupName))
+		data.AddMember(rapidjson::Value(attribute.first,alloc), rapidjson::Value(attribute.second,alloc), alloc);
+	result.AddMember("data", data, alloc);
+	
+	return crow::response(to_string(result));
+}
+
 crow::response setGroupAttribute(PersistentStore& store, const crow::request& req, std::string groupName, std::string attributeName){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to set secondary attribute " << attributeName << " for group " << groupName << " from " << req.remote_endpoint);
@@ -1037,9 +1102,10 @@ crow::response setGroupAttribute(PersistentStore& store, const crow::request& re
 		
 	groupName=canonicalizeGroupName(groupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,groupName).state!=GroupMembership::Admin
-	   && adminInAnyEnclosingGroup(store,user.unixName,groupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,groupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 
 	rapidjson::Document body;
@@ -1073,9 +1139,10 @@ crow::response deleteGroupAttribute(PersistentStore& store, const crow::request&
 	
 	groupName=canonicalizeGroupName(groupName);
 	//Only superusers and admins of a Group can alter it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,groupName).state!=GroupMembership::Admin
-	   && adminInAnyEnclosingGroup(store,user.unixName,groupName).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,groupName,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	bool success=store.removeGroupSecondaryAttribute(groupName, attributeName);
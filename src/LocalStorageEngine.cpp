@@ -0,0 +1,2527 @@
+#include <LocalStorageEngine.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <aws/core/client/AWSError.h>
+#include <aws/core/utils/Outcome.h>
+#include <aws/dynamodb/model/AttributeValue.h>
+
+#include <Logging.h>
+
+//File layout:
+//  header: 8 byte magic, uint32 format version, uint32 byte order mark
+//  records, back to back, each: uint32 payload length, uint64 checksum of
+//  the payload, payload
+//A payload is a uint8 record kind followed by the kind's fields:
+//  schema: table name, hash key name, range key name (empty if none),
+//          uint32 count of attribute definitions, each (name, uint8 type),
+//          uint32 count of indices, each (name, hash key name, range key
+//          name, uint8 projection type, uint32 count of non-key attributes,
+//          their names)
+//  drop table: table name
+//  changes: uint32 count, each (uint8 put or delete, table name, the whole
+//           item for a put or its key for a delete)
+//Items are a uint32 count of attributes, each (name, value). Values are a
+//uint8 type followed by: strings and numbers as strings, booleans as a uint8,
+//nothing for null, sets as a uint32 count and strings, maps as a uint32 count
+//and (name, value) pairs, and lists as a uint32 count and values.
+//Integers are stored in native byte order, which the byte order mark allows
+//a reader to verify. Strings are stored as a uint32 length followed by their
+//bytes. All of the changes in one record are applied together or not at all;
+//a record whose end is missing or damaged at the end of the file was being
+//written when the process stopped, and is discarded.
+
+namespace{
+
+using Aws::DynamoDB::DynamoDBErrors;
+using Aws::DynamoDB::Model::AttributeValue;
+using Aws::DynamoDB::Model::ValueType;
+using Item=Aws::Map<Aws::String,AttributeValue>;
+using NameMap=Aws::Map<Aws::String,Aws::String>;
+
+const char logMagic[8]={'C','I','C','L','O','G','\0','\0'};
+const uint32_t logVersion=1;
+const uint32_t byteOrderMark=0x01020304;
+const std::size_t headerSize=16;
+const std::size_t frameSize=12;
+///The file is never compacted while it is smaller than this
+const uint64_t compactionFloor=1u<<20;
+///The number of items written in each record when compacting
+const std::size_t compactionBatch=1000;
+
+enum RecordKind : uint8_t{
+	SchemaRecord=1,
+	DropTableRecord=2,
+	ChangesRecord=3
+};
+
+enum ChangeKind : uint8_t{
+	PutChange=1,
+	DeleteChange=2
+};
+
+enum ValueTag : uint8_t{
+	StringTag=1,
+	NumberTag=2,
+	BoolTag=3,
+	NullTag=4,
+	StringSetTag=5,
+	NumberSetTag=6,
+	MapTag=7,
+	ListTag=8
+};
+
+uint64_t checksum(const char* data, std::size_t length){
+	//FNV-1a
+	uint64_t hash=14695981039346656037ull;
+	for(std::size_t i=0; i<length; i++){
+		hash^=(unsigned char)data[i];
+		hash*=1099511628211ull;
+	}
+	return hash;
+}
+
+///A failure of a request, to be reported as a DynamoDB error
+struct RequestError{
+	DynamoDBErrors type;
+	std::string exceptionName;
+	std::string message;
+
+	template<typename Outcome>
+	Outcome as() const{
+		return Outcome(Aws::Client::AWSError<DynamoDBErrors>(type,exceptionName,message,false));
+	}
+};
+
+RequestError invalid(const std::string& message){
+	return RequestError{DynamoDBErrors::VALIDATION,"ValidationException",message};
+}
+
+RequestError conditionFailed(){
+	return RequestError{DynamoDBErrors::CONDITIONAL_CHECK_FAILED,"ConditionalCheckFailedException",
+	                    "The conditional request failed"};
+}
+
+///Holds a reader-writer lock in shared mode
+template<typename Mutex>
+class SharedLock{
+public:
+	explicit SharedLock(Mutex& mutex):mutex(mutex){ mutex.lock_shared(); }
+	~SharedLock(){ mutex.unlock_shared(); }
+	SharedLock(const SharedLock&)=delete;
+	SharedLock& operator=(const SharedLock&)=delete;
+private:
+	Mutex& mutex;
+};
+
+//----
+//Numbers
+
+///A number in plain decimal notation, reduced to a canonical form
+struct Decimal{
+	bool negative;
+	///Digits before the decimal point, without leading zeros
+	std::string integer;
+	///Digits after the decimal point, without trailing zeros
+	std::string fraction;
+};
+
+///\return whether text is a number in plain decimal notation
+bool parseDecimal(const std::string& text, Decimal& number){
+	std::size_t i=0;
+	number.negative=false;
+	if(i<text.size() && (text[i]=='-' || text[i]=='+'))
+		number.negative=(text[i++]=='-');
+	std::size_t start=i;
+	while(i<text.size() && std::isdigit((unsigned char)text[i]))
+		i++;
+	number.integer=text.substr(start,i-start);
+	number.fraction.clear();
+	if(i<text.size() && text[i]=='.'){
+		start=++i;
+		while(i<text.size() && std::isdigit((unsigned char)text[i]))
+			i++;
+		number.fraction=text.substr(start,i-start);
+	}
+	if(i!=text.size() || (number.integer.empty() && number.fraction.empty()))
+		return false;
+	number.integer.erase(0,number.integer.find_first_not_of('0'));
+	number.fraction.erase(number.fraction.find_last_not_of('0')+1);
+	if(number.integer.empty() && number.fraction.empty())
+		number.negative=false;
+	return true;
+}
+
+///\return a negative number, zero, or a positive number as the first number
+///        is less than, equal to, or greater than the second
+int compareNumbers(const std::string& a, const std::string& b){
+	Decimal x, y;
+	if(!parseDecimal(a,x) || !parseDecimal(b,y)){
+		//exponential notation, which the store never writes, is compared
+		//approximately
+		long double u=std::strtold(a.c_str(),nullptr), v=std::strtold(b.c_str(),nullptr);
+		return (u>v)-(u<v);
+	}
+	if(x.negative!=y.negative)
+		return x.negative?-1:1;
+	int order=0;
+	if(x.integer.size()!=y.integer.size())
+		order=(x.integer.size()<y.integer.size()?-1:1);
+	else
+		order=x.integer.compare(y.integer);
+	if(!order)
+		order=x.fraction.compare(y.fraction);
+	order=(order>0)-(order<0);
+	return x.negative?-order:order;
+}
+
+struct NumberLess{
+	bool operator()(const std::string& a, const std::string& b) const{ return compareNumbers(a,b)<0; }
+};
+
+bool parseInteger(const std::string& text, long long& value){
+	if(text.empty())
+		return false;
+	errno=0;
+	char* end;
+	value=std::strtoll(text.c_str(),&end,10);
+	return errno==0 && *end=='\0';
+}
+
+///\return the sum or difference of two numbers. Integers are added exactly as
+///        long as the result fits in 64 bits; anything else is computed with
+///        long double precision.
+std::string addNumbers(const std::string& a, const std::string& b, bool subtract){
+	long long x, y;
+	if(parseInteger(a,x) && parseInteger(b,y) && !(subtract && y==LLONG_MIN)){
+		if(subtract)
+			y=-y;
+		if(!((y>0 && x>LLONG_MAX-y) || (y<0 && x<LLONG_MIN-y)))
+			return std::to_string(x+y);
+	}
+	long double u=std::strtold(a.c_str(),nullptr), v=std::strtold(b.c_str(),nullptr);
+	char buffer[64];
+	std::snprintf(buffer,sizeof(buffer),"%.18Lg",subtract?u-v:u+v);
+	return buffer;
+}
+
+//----
+//Attribute values
+
+std::string typeName(ValueType type){
+	switch(type){
+		case ValueType::STRING: return "S";
+		case ValueType::NUMBER: return "N";
+		case ValueType::BYTEBUFFER: return "B";
+		case ValueType::STRING_SET: return "SS";
+		case ValueType::NUMBER_SET: return "NS";
+		case ValueType::BYTEBUFFER_SET: return "BS";
+		case ValueType::ATTRIBUTE_MAP: return "M";
+		case ValueType::ATTRIBUTE_LIST: return "L";
+		case ValueType::BOOL: return "BOOL";
+		case ValueType::NULLVALUE: return "NULL";
+	}
+	return "";
+}
+
+bool containsBinary(const AttributeValue& value){
+	switch(value.GetType()){
+		case ValueType::BYTEBUFFER:
+		case ValueType::BYTEBUFFER_SET:
+			return true;
+		case ValueType::ATTRIBUTE_MAP:
+			for(const auto& entry : value.GetM()){
+				if(containsBinary(*entry.second))
+					return true;
+			}
+			return false;
+		case ValueType::ATTRIBUTE_LIST:
+			for(const auto& element : value.GetL()){
+				if(containsBinary(*element))
+					return true;
+			}
+			return false;
+		default:
+			return false;
+	}
+}
+
+///\throws RequestError if an item cannot be stored
+void validateItem(const Item& item){
+	for(const auto& attribute : item){
+		if(containsBinary(attribute.second))
+			throw invalid("Binary attributes are not supported by the local storage engine; attribute: "+attribute.first);
+	}
+}
+
+///\return whether two sets contain the same elements
+template<typename Less>
+bool sameSet(const Aws::Vector<Aws::String>& a, const Aws::Vector<Aws::String>& b){
+	return std::set<std::string,Less>(a.begin(),a.end())==std::set<std::string,Less>(b.begin(),b.end());
+}
+
+///\return whether two values are equal, as DynamoDB compares them
+bool sameValue(const AttributeValue& a, const AttributeValue& b){
+	if(a.GetType()!=b.GetType())
+		return false;
+	switch(a.GetType()){
+		case ValueType::STRING:
+			return a.GetS()==b.GetS();
+		case ValueType::NUMBER:
+			return compareNumbers(a.GetN(),b.GetN())==0;
+		case ValueType::BOOL:
+			return a.GetBool()==b.GetBool();
+		case ValueType::NULLVALUE:
+			return true;
+		case ValueType::STRING_SET:
+			return sameSet<std::less<std::string>>(a.GetSS(),b.GetSS());
+		case ValueType::NUMBER_SET:
+			return sameSet<NumberLess>(a.GetNS(),b.GetNS());
+		case ValueType::ATTRIBUTE_MAP:{
+			const auto& x=a.GetM();
+			const auto& y=b.GetM();
+			if(x.size()!=y.size())
+				return false;
+			for(const auto& entry : x){
+				auto other=y.find(entry.first);
+				if(other==y.end() || !sameValue(*entry.second,*other->second))
+					return false;
+			}
+			return true;
+		}
+		case ValueType::ATTRIBUTE_LIST:{
+			const auto& x=a.GetL();
+			const auto& y=b.GetL();
+			if(x.size()!=y.size())
+				return false;
+			for(std::size_t i=0; i<x.size(); i++){
+				if(!sameValue(*x[i],*y[i]))
+					return false;
+			}
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+///Order two values, if they are strings or numbers of the same type
+///\return whether the values can be ordered
+bool compareScalars(const AttributeValue& a, const AttributeValue& b, int& order){
+	if(a.GetType()!=b.GetType())
+		return false;
+	if(a.GetType()==ValueType::STRING){
+		int result=a.GetS().compare(b.GetS());
+		order=(result>0)-(result<0);
+	}
+	else if(a.GetType()==ValueType::NUMBER)
+		order=compareNumbers(a.GetN(),b.GetN());
+	else
+		return false;
+	return true;
+}
+
+///\return the union of two sets of the same type, or the elements of the
+///        first which are not in the second
+AttributeValue combineSets(const AttributeValue& a, const AttributeValue& b, bool remove){
+	const bool numbers=(a.GetType()==ValueType::NUMBER_SET);
+	Aws::Vector<Aws::String> x=numbers?a.GetNS():a.GetSS();
+	Aws::Vector<Aws::String> y=numbers?b.GetNS():b.GetSS();
+	auto contains=[numbers](const Aws::Vector<Aws::String>& set, const std::string& element){
+		return std::any_of(set.begin(),set.end(),[&](const std::string& other){
+			return numbers?compareNumbers(element,other)==0:element==other;
+		});
+	};
+	Aws::Vector<Aws::String> result;
+	if(remove){
+		for(const auto& element : x){
+			if(!contains(y,element))
+				result.push_back(element);
+		}
+	}
+	else{
+		result=x;
+		for(const auto& element : y){
+			if(!contains(result,element))
+				result.push_back(element);
+		}
+	}
+	AttributeValue value;
+	if(numbers)
+		value.SetNS(result);
+	else
+		value.SetSS(result);
+	return value;
+}
+
+bool isSet(const AttributeValue& value){
+	return value.GetType()==ValueType::STRING_SET || value.GetType()==ValueType::NUMBER_SET;
+}
+
+///Apply an ADD action: add to a number, or add elements to a set
+void addToAttribute(Item& item, const std::string& name, const AttributeValue& value){
+	if(value.GetType()!=ValueType::NUMBER && !isSet(value))
+		throw invalid("Invalid UpdateExpression: Incorrect operand type for operator or function; operator: ADD, operand type: "+typeName(value.GetType()));
+	auto it=item.find(name);
+	if(it==item.end()){
+		item[name]=value;
+		return;
+	}
+	if(it->second.GetType()!=value.GetType())
+		throw invalid("An operand in the update expression has an incorrect data type");
+	if(value.GetType()==ValueType::NUMBER)
+		it->second=AttributeValue().SetN(addNumbers(it->second.GetN(),value.GetN(),false));
+	else
+		it->second=combineSets(it->second,value,false);
+}
+
+///Apply a DELETE action: remove elements from a set, removing the attribute
+///entirely if the set becomes empty
+void deleteFromAttribute(Item& item, const std::string& name, const AttributeValue& value){
+	if(!isSet(value))
+		throw invalid("Invalid UpdateExpression: Incorrect operand type for operator or function; operator: DELETE, operand type: "+typeName(value.GetType()));
+	auto it=item.find(name);
+	if(it==item.end())
+		return;
+	if(it->second.GetType()!=value.GetType())
+		throw invalid("An operand in the update expression has an incorrect data type");
+	AttributeValue remaining=combineSets(it->second,value,true);
+	if((remaining.GetType()==ValueType::NUMBER_SET?remaining.GetNS():remaining.GetSS()).empty())
+		item.erase(it);
+	else
+		it->second=remaining;
+}
+
+///\return a copy of an item containing only some of its attributes
+///\param attributes the names of the attributes to keep, or empty to keep all
+Item project(const Item& item, const std::vector<std::string>& attributes){
+	if(attributes.empty())
+		return item;
+	Item result;
+	for(const auto& name : attributes){
+		auto it=item.find(name);
+		if(it!=item.end())
+			result.emplace(name,it->second);
+	}
+	return result;
+}
+
+//----
+//Keys
+
+///One part of a primary key or an index key
+struct KeyValue{
+	enum Kind : uint8_t{
+		///The missing range key of a table or index which has none, which
+		///also orders before all other values
+		Absent,
+		Number,
+		String
+	};
+
+	KeyValue():kind(Absent){}
+	KeyValue(Kind kind, std::string text):kind(kind),text(std::move(text)){}
+
+	Kind kind;
+	std::string text;
+
+	bool operator<(const KeyValue& other) const{
+		if(kind!=other.kind)
+			return kind<other.kind;
+		if(kind==Number)
+			return compareNumbers(text,other.text)<0;
+		return text<other.text;
+	}
+	bool operator==(const KeyValue& other) const{ return !(*this<other) && !(other<*this); }
+};
+
+struct Key{
+	KeyValue hash, range;
+
+	bool operator<(const Key& other) const{
+		if(hash<other.hash)
+			return true;
+		if(other.hash<hash)
+			return false;
+		return range<other.range;
+	}
+};
+
+///The position of an item in a table or index, in the index's order: its
+///index key followed by its primary key. For a table both are the primary key.
+using Position=std::pair<Key,Key>;
+
+///Convert a value to a key part
+///\return whether the value is a non-empty string or a number
+bool toKeyValue(const AttributeValue& value, KeyValue& part){
+	if(value.GetType()==ValueType::STRING && !value.GetS().empty())
+		part=KeyValue(KeyValue::String,value.GetS());
+	else if(value.GetType()==ValueType::NUMBER)
+		part=KeyValue(KeyValue::Number,value.GetN());
+	else
+		return false;
+	return true;
+}
+
+//----
+//Expressions
+
+///A reference to an attribute or a value in an expression
+struct Operand{
+	enum Kind{
+		Path,
+		Value,
+		///The size of an attribute
+		Size
+	};
+
+	Kind kind;
+	///The attribute, for paths and sizes
+	std::string name;
+	AttributeValue value;
+
+	///\param scratch storage for a value computed from the item
+	///\return the operand's value for an item, or null if the operand refers
+	///        to an attribute which the item does not have
+	const AttributeValue* resolve(const Item& item, AttributeValue& scratch) const{
+		if(kind==Value)
+			return &value;
+		auto it=item.find(name);
+		if(it==item.end())
+			return nullptr;
+		if(kind==Path)
+			return &it->second;
+		std::size_t size=0;
+		switch(it->second.GetType()){
+			case ValueType::STRING: size=it->second.GetS().size(); break;
+			case ValueType::STRING_SET: size=it->second.GetSS().size(); break;
+			case ValueType::NUMBER_SET: size=it->second.GetNS().size(); break;
+			case ValueType::ATTRIBUTE_MAP: size=it->second.GetM().size(); break;
+			case ValueType::ATTRIBUTE_LIST: size=it->second.GetL().size(); break;
+			default: return nullptr;
+		}
+		scratch.SetN(std::to_string(size));
+		return &scratch;
+	}
+};
+
+///A condition, filter, or key condition expression
+struct Condition{
+	enum Kind{
+		Compare,
+		Between,
+		In,
+		Exists,
+		NotExists,
+		AttributeType,
+		BeginsWith,
+		Contains,
+		And,
+		Or,
+		Not
+	};
+	enum Comparator{
+		Equal,
+		NotEqual,
+		Less,
+		LessEqual,
+		Greater,
+		GreaterEqual
+	};
+
+	Kind kind;
+	Comparator comparator;
+	std::vector<Operand> operands;
+	std::vector<Condition> children;
+
+	bool evaluate(const Item& item) const{
+		AttributeValue scratch1, scratch2, scratch3;
+		switch(kind){
+			case And:
+				for(const auto& child : children){
+					if(!child.evaluate(item))
+						return false;
+				}
+				return true;
+			case Or:
+				for(const auto& child : children){
+					if(child.evaluate(item))
+						return true;
+				}
+				return false;
+			case Not:
+				return !children.front().evaluate(item);
+			case Exists:
+				return item.count(operands[0].name);
+			case NotExists:
+				return !item.count(operands[0].name);
+			case AttributeType:{
+				auto it=item.find(operands[0].name);
+				return it!=item.end() && typeName(it->second.GetType())==operands[1].value.GetS();
+			}
+			case BeginsWith:{
+				const AttributeValue* value=operands[0].resolve(item,scratch1);
+				const AttributeValue* prefix=operands[1].resolve(item,scratch2);
+				return value && prefix && value->GetType()==ValueType::STRING && prefix->GetType()==ValueType::STRING
+				       && value->GetS().compare(0,prefix->GetS().size(),prefix->GetS())==0;
+			}
+			case Contains:{
+				const AttributeValue* value=operands[0].resolve(item,scratch1);
+				const AttributeValue* element=operands[1].resolve(item,scratch2);
+				if(!value || !element)
+					return false;
+				switch(value->GetType()){
+					case ValueType::STRING:
+						return element->GetType()==ValueType::STRING && value->GetS().find(element->GetS())!=std::string::npos;
+					case ValueType::STRING_SET:
+					case ValueType::NUMBER_SET:{
+						if(element->GetType()!=(value->GetType()==ValueType::STRING_SET?ValueType::STRING:ValueType::NUMBER))
+							return false;
+						AttributeValue single;
+						if(value->GetType()==ValueType::STRING_SET)
+							single.SetSS({element->GetS()});
+						else
+							single.SetNS({element->GetN()});
+						return !sameValue(combineSets(single,*value,true),single);
+					}
+					case ValueType::ATTRIBUTE_LIST:
+						for(const auto& member : value->GetL()){
+							if(sameValue(*member,*element))
+								return true;
+						}
+						return false;
+					default:
+						return false;
+				}
+			}
+			case Between:{
+				const AttributeValue* value=operands[0].resolve(item,scratch1);
+				const AttributeValue* low=operands[1].resolve(item,scratch2);
+				const AttributeValue* high=operands[2].resolve(item,scratch3);
+				int lowOrder, highOrder;
+				return value && low && high && compareScalars(*value,*low,lowOrder) && lowOrder>=0
+				       && compareScalars(*value,*high,highOrder) && highOrder<=0;
+			}
+			case In:{
+				const AttributeValue* value=operands[0].resolve(item,scratch1);
+				if(!value)
+					return false;
+				for(std::size_t i=1; i<operands.size(); i++){
+					const AttributeValue* candidate=operands[i].resolve(item,scratch2);
+					if(candidate && sameValue(*value,*candidate))
+						return true;
+				}
+				return false;
+			}
+			case Compare:{
+				const AttributeValue* left=operands[0].resolve(item,scratch1);
+				const AttributeValue* right=operands[1].resolve(item,scratch2);
+				if(comparator==Equal)
+					return left && right && sameValue(*left,*right);
+				if(comparator==NotEqual)
+					return !(left && right && sameValue(*left,*right));
+				int order;
+				if(!left || !right || !compareScalars(*left,*right,order))
+					return false;
+				switch(comparator){
+					case Less: return order<0;
+					case LessEqual: return order<=0;
+					case Greater: return order>0;
+					case GreaterEqual: return order>=0;
+					default: return false;
+				}
+			}
+		}
+		return false;
+	}
+};
+
+///The right hand side of a SET action, or the value of an ADD or DELETE action
+struct UpdateValue{
+	enum Kind{
+		Plain,
+		Plus,
+		Minus,
+		IfNotExists,
+		ListAppend
+	};
+
+	Kind kind;
+	///The operands of Plain, IfNotExists, and ListAppend values
+	std::vector<Operand> operands;
+	///The sides of Plus and Minus values
+	std::vector<UpdateValue> parts;
+
+	///\param item the item as it was before the update
+	AttributeValue evaluate(const Item& item) const{
+		AttributeValue scratch1, scratch2;
+		switch(kind){
+			case Plain:
+				return require(operands[0].resolve(item,scratch1));
+			case IfNotExists:{
+				auto existing=item.find(operands[0].name);
+				if(existing!=item.end())
+					return existing->second;
+				return require(operands[1].resolve(item,scratch1));
+			}
+			case ListAppend:{
+				const AttributeValue& head=require(operands[0].resolve(item,scratch1));
+				const AttributeValue& tail=require(operands[1].resolve(item,scratch2));
+				if(head.GetType()!=ValueType::ATTRIBUTE_LIST || tail.GetType()!=ValueType::ATTRIBUTE_LIST)
+					throw invalid("An operand in the update expression has an incorrect data type");
+				auto list=head.GetL();
+				const auto& rest=tail.GetL();
+				list.insert(list.end(),rest.begin(),rest.end());
+				AttributeValue result;
+				result.SetL(list);
+				return result;
+			}
+			case Plus:
+			case Minus:{
+				AttributeValue left=parts[0].evaluate(item);
+				AttributeValue right=parts[1].evaluate(item);
+				if(left.GetType()!=ValueType::NUMBER || right.GetType()!=ValueType::NUMBER)
+					throw invalid("An operand in the update expression has an incorrect data type");
+				AttributeValue result;
+				result.SetN(addNumbers(left.GetN(),right.GetN(),kind==Minus));
+				return result;
+			}
+		}
+		return AttributeValue();
+	}
+
+private:
+	static const AttributeValue& require(const AttributeValue* value){
+		if(!value)
+			throw invalid("The provided expression refers to an attribute that does not exist in the item");
+		return *value;
+	}
+};
+
+struct UpdateAction{
+	enum Kind{
+		Set,
+		Remove,
+		Add,
+		Delete
+	};
+
+	Kind kind;
+	std::string name;
+	///For SET, the new value; for ADD and DELETE, a plain value
+	UpdateValue value;
+};
+
+///Reads DynamoDB expressions, substituting the placeholders for attribute names
+///and values
+class ExpressionParser{
+public:
+	///\param expression the expression to parse
+	///\param names the substitutions for attribute name placeholders
+	///\param values the substitutions for value placeholders
+	ExpressionParser(const std::string& expression, const NameMap& names, const Item& values):
+	expression(expression),names(names),values(values),pos(0){
+		tokenize();
+	}
+
+	Condition parseCondition(){
+		Condition condition=parseOr();
+		expectEnd();
+		return condition;
+	}
+
+	std::vector<UpdateAction> parseUpdate(){
+		std::vector<UpdateAction> actions;
+		std::set<std::string> clauses;
+		while(peek().kind!=Token::End){
+			if(peek().kind!=Token::Word)
+				syntaxError();
+			std::string clause=peek().text;
+			std::transform(clause.begin(),clause.end(),clause.begin(),::toupper);
+			UpdateAction::Kind kind;
+			if(clause=="SET")
+				kind=UpdateAction::Set;
+			else if(clause=="REMOVE")
+				kind=UpdateAction::Remove;
+			else if(clause=="ADD")
+				kind=UpdateAction::Add;
+			else if(clause=="DELETE")
+				kind=UpdateAction::Delete;
+			else
+				syntaxError();
+			if(!clauses.insert(clause).second)
+				throw invalid("Invalid UpdateExpression: The \""+clause+"\" section can only be used once in an update expression");
+			pos++;
+			do{
+				UpdateAction action;
+				action.kind=kind;
+				action.name=parsePath();
+				if(kind==UpdateAction::Set){
+					expectSymbol("=");
+					action.value=parseSetValue();
+				}
+				else if(kind!=UpdateAction::Remove){
+					action.value.kind=UpdateValue::Plain;
+					action.value.operands.push_back(parseOperand());
+					if(action.value.operands.back().kind!=Operand::Value)
+						throw invalid("Invalid UpdateExpression: The operand of "+clause+" must be a value");
+				}
+				actions.push_back(std::move(action));
+			}while(acceptSymbol(","));
+		}
+		if(actions.empty())
+			syntaxError();
+		return actions;
+	}
+
+	std::vector<std::string> parseProjection(){
+		std::vector<std::string> attributes;
+		do{
+			attributes.push_back(parsePath());
+		}while(acceptSymbol(","));
+		expectEnd();
+		return attributes;
+	}
+
+private:
+	struct Token{
+		enum Kind{
+			End,
+			///A bare attribute name, function name, or keyword
+			Word,
+			///An attribute name placeholder
+			Name,
+			///A value placeholder
+			Value,
+			Symbol
+		};
+		Kind kind;
+		std::string text;
+	};
+
+	const std::string& expression;
+	const NameMap& names;
+	const Item& values;
+	std::vector<Token> tokens;
+	std::size_t pos;
+
+	void tokenize(){
+		static const char* symbols[]={"<>","<=",">=","<",">","=","(",")",",","+","-",".","[","]"};
+		auto isWordChar=[](char c){ return std::isalnum((unsigned char)c) || c=='_'; };
+		std::size_t i=0;
+		while(i<expression.size()){
+			char c=expression[i];
+			std::size_t start=i;
+			if(std::isspace((unsigned char)c))
+				i++;
+			else if(c=='#' || c==':' || isWordChar(c)){
+				i++;
+				while(i<expression.size() && isWordChar(expression[i]))
+					i++;
+				if(!isWordChar(c) && i==start+1)
+					throw syntaxError(std::string(1,c));
+				tokens.push_back(Token{c=='#'?Token::Name:c==':'?Token::Value:Token::Word,
+				                       expression.substr(start,i-start)});
+			}
+			else{
+				for(const char* symbol : symbols){
+					std::size_t length=std::strlen(symbol);
+					if(expression.compare(i,length,symbol)==0){
+						tokens.push_back(Token{Token::Symbol,symbol});
+						i+=length;
+						break;
+					}
+				}
+				if(i==start)
+					throw syntaxError(std::string(1,c));
+			}
+		}
+		tokens.push_back(Token{Token::End,"<EOF>"});
+	}
+
+	const Token& peek() const{ return tokens[pos]; }
+
+	RequestError syntaxError(const std::string& token) const{
+		return invalid("Invalid expression: Syntax error; token: \""+token+"\", near: \""+expression+"\"");
+	}
+	[[noreturn]] void syntaxError() const{ throw syntaxError(peek().text); }
+
+	bool acceptSymbol(const char* symbol){
+		if(peek().kind==Token::Symbol && peek().text==symbol){
+			pos++;
+			return true;
+		}
+		return false;
+	}
+	void expectSymbol(const char* symbol){
+		if(!acceptSymbol(symbol))
+			syntaxError();
+	}
+	///Keywords, unlike function names, are not case sensitive
+	bool acceptKeyword(const char* keyword){
+		if(peek().kind!=Token::Word || peek().text.size()!=std::strlen(keyword))
+			return false;
+		for(std::size_t i=0; keyword[i]; i++){
+			if(std::toupper((unsigned char)peek().text[i])!=keyword[i])
+				return false;
+		}
+		pos++;
+		return true;
+	}
+	void expectEnd() const{
+		if(peek().kind!=Token::End)
+			syntaxError();
+	}
+	bool atFunction(const char* name) const{
+		return peek().kind==Token::Word && peek().text==name
+		       && tokens[pos+1].kind==Token::Symbol && tokens[pos+1].text=="(";
+	}
+
+	std::string parsePath(){
+		const Token& token=peek();
+		std::string name;
+		if(token.kind==Token::Name){
+			auto it=names.find(token.text);
+			if(it==names.end())
+				throw invalid("An expression attribute name used in the document path is not defined; attribute name: "+token.text);
+			name=it->second;
+		}
+		else if(token.kind==Token::Word)
+			name=token.text;
+		else
+			syntaxError();
+		pos++;
+		if(peek().kind==Token::Symbol && (peek().text=="." || peek().text=="["))
+			throw invalid("Nested attribute paths are not supported by the local storage engine: \""+expression+"\"");
+		return name;
+	}
+
+	Operand parseOperand(){
+		Operand operand;
+		const Token& token=peek();
+		if(token.kind==Token::Value){
+			auto it=values.find(token.text);
+			if(it==values.end())
+				throw invalid("An expression attribute value used in expression is not defined; attribute value: "+token.text);
+			operand.kind=Operand::Value;
+			operand.value=it->second;
+			pos++;
+		}
+		else if(atFunction("size")){
+			pos+=2;
+			operand.kind=Operand::Size;
+			operand.name=parsePath();
+			expectSymbol(")");
+		}
+		else{
+			operand.kind=Operand::Path;
+			operand.name=parsePath();
+		}
+		return operand;
+	}
+
+	Condition parseOr(){
+		Condition first=parseAnd();
+		if(!acceptKeyword("OR"))
+			return first;
+		Condition condition;
+		condition.kind=Condition::Or;
+		condition.children.push_back(std::move(first));
+		do{
+			condition.children.push_back(parseAnd());
+		}while(acceptKeyword("OR"));
+		return condition;
+	}
+
+	Condition parseAnd(){
+		Condition first=parseNot();
+		if(!acceptKeyword("AND"))
+			return first;
+		Condition condition;
+		condition.kind=Condition::And;
+		condition.children.push_back(std::move(first));
+		do{
+			condition.children.push_back(parseNot());
+		}while(acceptKeyword("AND"));
+		return condition;
+	}
+
+	Condition parseNot(){
+		if(!acceptKeyword("NOT"))
+			return parsePrimary();
+		Condition condition;
+		condition.kind=Condition::Not;
+		condition.children.push_back(parseNot());
+		return condition;
+	}
+
+	Condition parsePrimary(){
+		if(acceptSymbol("(")){
+			Condition condition=parseOr();
+			expectSymbol(")");
+			return condition;
+		}
+		struct Function{
+			const char* name;
+			Condition::Kind kind;
+			unsigned int arguments;
+		};
+		static const Function functions[]={
+			{"attribute_exists",Condition::Exists,1},
+			{"attribute_not_exists",Condition::NotExists,1},
+			{"attribute_type",Condition::AttributeType,2},
+			{"begins_with",Condition::BeginsWith,2},
+			{"contains",Condition::Contains,2}
+		};
+		Condition condition;
+		for(const auto& function : functions){
+			if(!atFunction(function.name))
+				continue;
+			pos+=2;
+			condition.kind=function.kind;
+			Operand path;
+			path.kind=Operand::Path;
+			path.name=parsePath();
+			condition.operands.push_back(path);
+			if(function.arguments==2){
+				expectSymbol(",");
+				condition.operands.push_back(parseOperand());
+			}
+			expectSymbol(")");
+			if(function.kind==Condition::AttributeType &&
+			   (condition.operands[1].kind!=Operand::Value || condition.operands[1].value.GetType()!=ValueType::STRING))
+				throw invalid("Invalid ConditionExpression: The second operand of attribute_type must be a string value");
+			return condition;
+		}
+
+		condition.operands.push_back(parseOperand());
+		if(acceptKeyword("BETWEEN")){
+			condition.kind=Condition::Between;
+			condition.operands.push_back(parseOperand());
+			if(!acceptKeyword("AND"))
+				syntaxError();
+			condition.operands.push_back(parseOperand());
+			return condition;
+		}
+		if(acceptKeyword("IN")){
+			condition.kind=Condition::In;
+			expectSymbol("(");
+			do{
+				condition.operands.push_back(parseOperand());
+			}while(acceptSymbol(","));
+			expectSymbol(")");
+			return condition;
+		}
+		static const std::pair<const char*,Condition::Comparator> comparators[]={
+			{"=",Condition::Equal},{"<>",Condition::NotEqual},
+			{"<",Condition::Less},{"<=",Condition::LessEqual},
+			{">",Condition::Greater},{">=",Condition::GreaterEqual}
+		};
+		condition.kind=Condition::Compare;
+		for(const auto& comparator : comparators){
+			if(acceptSymbol(comparator.first)){
+				condition.comparator=comparator.second;
+				condition.operands.push_back(parseOperand());
+				return condition;
+			}
+		}
+		syntaxError();
+	}
+
+	UpdateValue parseSetValue(){
+		UpdateValue first=parseSetOperand();
+		UpdateValue value;
+		if(acceptSymbol("+"))
+			value.kind=UpdateValue::Plus;
+		else if(acceptSymbol("-"))
+			value.kind=UpdateValue::Minus;
+		else
+			return first;
+		value.parts.push_back(std::move(first));
+		value.parts.push_back(parseSetOperand());
+		return value;
+	}
+
+	UpdateValue parseSetOperand(){
+		UpdateValue value;
+		if(atFunction("if_not_exists")){
+			pos+=2;
+			value.kind=UpdateValue::IfNotExists;
+			Operand path;
+			path.kind=Operand::Path;
+			path.name=parsePath();
+			value.operands.push_back(path);
+			expectSymbol(",");
+			value.operands.push_back(parseOperand());
+			expectSymbol(")");
+		}
+		else if(atFunction("list_append")){
+			pos+=2;
+			value.kind=UpdateValue::ListAppend;
+			value.operands.push_back(parseOperand());
+			expectSymbol(",");
+			value.operands.push_back(parseOperand());
+			expectSymbol(")");
+		}
+		else{
+			value.kind=UpdateValue::Plain;
+			value.operands.push_back(parseOperand());
+		}
+		return value;
+	}
+};
+
+///\return the names of the attributes selected by a projection expression,
+///        or nothing if there is no expression, meaning that all attributes
+///        are selected
+std::vector<std::string> parseProjection(const std::string& expression, const NameMap& names){
+	if(expression.empty())
+		return {};
+	const Item values;
+	return ExpressionParser(expression,names,values).parseProjection();
+}
+
+///\return whether an item satisfies a condition expression
+///\param item the item, or null if it does not exist
+bool conditionHolds(const std::string& expression, const NameMap& names, const Item& values, const Item* item){
+	if(expression.empty())
+		return true;
+	const Item none;
+	return ExpressionParser(expression,names,values).parseCondition().evaluate(item?*item:none);
+}
+
+///\return the value which a key condition requires the partition key to have,
+///        or null if it does not
+const AttributeValue* partitionValue(const Condition& condition, const std::string& hashName){
+	if(condition.kind==Condition::And){
+		for(const auto& child : condition.children){
+			if(const AttributeValue* value=partitionValue(child,hashName))
+				return value;
+		}
+	}
+	else if(condition.kind==Condition::Compare && condition.comparator==Condition::Equal){
+		for(unsigned int i=0; i<2; i++){
+			const Operand& path=condition.operands[i];
+			const Operand& value=condition.operands[1-i];
+			if(path.kind==Operand::Path && path.name==hashName && value.kind==Operand::Value)
+				return &value.value;
+		}
+	}
+	return nullptr;
+}
+
+//----
+//Encoding
+
+std::size_t encodedSize(const AttributeValue& value){
+	const std::size_t tag=1, count=4, length=4;
+	switch(value.GetType()){
+		case ValueType::STRING:
+			return tag+length+value.GetS().size();
+		case ValueType::NUMBER:
+			return tag+length+value.GetN().size();
+		case ValueType::BOOL:
+			return tag+1;
+		case ValueType::STRING_SET:
+		case ValueType::NUMBER_SET:{
+			std::size_t size=tag+count;
+			for(const auto& element : value.GetType()==ValueType::STRING_SET?value.GetSS():value.GetNS())
+				size+=length+element.size();
+			return size;
+		}
+		case ValueType::ATTRIBUTE_MAP:{
+			std::size_t size=tag+count;
+			for(const auto& entry : value.GetM())
+				size+=length+entry.first.size()+encodedSize(*entry.second);
+			return size;
+		}
+		case ValueType::ATTRIBUTE_LIST:{
+			std::size_t size=tag+count;
+			for(const auto& element : value.GetL())
+				size+=encodedSize(*element);
+			return size;
+		}
+		default:
+			return tag;
+	}
+}
+
+std::size_t encodedSize(const Item& item){
+	std::size_t size=4;
+	for(const auto& attribute : item)
+		size+=4+attribute.first.size()+encodedSize(attribute.second);
+	return size;
+}
+
+class LogWriter{
+public:
+	template<typename T>
+	void put(T value){
+		static_assert(std::is_integral<T>::value,"Only integers may be written directly");
+		buffer.append((const char*)&value,sizeof(T));
+	}
+	void put(const std::string& s){
+		put<uint32_t>(s.size());
+		buffer.append(s);
+	}
+	void put(const AttributeValue& value){
+		switch(value.GetType()){
+			case ValueType::STRING:
+				put<uint8_t>(StringTag);
+				put(value.GetS());
+				break;
+			case ValueType::NUMBER:
+				put<uint8_t>(NumberTag);
+				put(value.GetN());
+				break;
+			case ValueType::BOOL:
+				put<uint8_t>(BoolTag);
+				put<uint8_t>(value.GetBool());
+				break;
+			case ValueType::STRING_SET:
+			case ValueType::NUMBER_SET:{
+				bool strings=(value.GetType()==ValueType::STRING_SET);
+				put<uint8_t>(strings?StringSetTag:NumberSetTag);
+				const auto& set=strings?value.GetSS():value.GetNS();
+				put<uint32_t>(set.size());
+				for(const auto& element : set)
+					put(element);
+				break;
+			}
+			case ValueType::ATTRIBUTE_MAP:{
+				put<uint8_t>(MapTag);
+				const auto& map=value.GetM();
+				put<uint32_t>(map.size());
+				for(const auto& entry : map){
+					put(entry.first);
+					put(*entry.second);
+				}
+				break;
+			}
+			case ValueType::ATTRIBUTE_LIST:{
+				put<uint8_t>(ListTag);
+				const auto& list=value.GetL();
+				put<uint32_t>(list.size());
+				for(const auto& element : list)
+					put(*element);
+				break;
+			}
+			default: //binary values are rejected before reaching this point
+				put<uint8_t>(NullTag);
+		}
+	}
+	void put(const Item& item){
+		put<uint32_t>(item.size());
+		for(const auto& attribute : item){
+			put(attribute.first);
+			put(attribute.second);
+		}
+	}
+
+	///\return the data written so far, framed as a record
+	std::string record() const{
+		LogWriter frame;
+		frame.put<uint32_t>(buffer.size());
+		frame.put<uint64_t>(checksum(buffer.data(),buffer.size()));
+		return frame.buffer+buffer;
+	}
+
+	std::string buffer;
+};
+
+class LogReader{
+public:
+	LogReader(const char* begin, const char* end):pos(begin),end(end){}
+
+	template<typename T>
+	T get(){
+		static_assert(std::is_integral<T>::value,"Only integers may be read directly");
+		need(sizeof(T));
+		T value;
+		std::memcpy(&value,pos,sizeof(T));
+		pos+=sizeof(T);
+		return value;
+	}
+	void get(std::string& s){
+		uint32_t length=get<uint32_t>();
+		need(length);
+		s.assign(pos,length);
+		pos+=length;
+	}
+	std::string getString(){
+		std::string s;
+		get(s);
+		return s;
+	}
+	void get(AttributeValue& value){
+		uint8_t tag=get<uint8_t>();
+		switch(tag){
+			case StringTag:
+				value.SetS(getString());
+				break;
+			case NumberTag:
+				value.SetN(getString());
+				break;
+			case BoolTag:
+				value.SetBool(get<uint8_t>());
+				break;
+			case NullTag:
+				value.SetNull(true);
+				break;
+			case StringSetTag:
+			case NumberSetTag:{
+				uint32_t count=get<uint32_t>();
+				Aws::Vector<Aws::String> set;
+				for(uint32_t i=0; i<count; i++)
+					set.push_back(getString());
+				if(tag==StringSetTag)
+					value.SetSS(set);
+				else
+					value.SetNS(set);
+				break;
+			}
+			case MapTag:{
+				uint32_t count=get<uint32_t>();
+				Aws::Map<Aws::String,const std::shared_ptr<AttributeValue>> map;
+				for(uint32_t i=0; i<count; i++){
+					std::string name=getString();
+					auto element=std::make_shared<AttributeValue>();
+					get(*element);
+					map.emplace(name,element);
+				}
+				value.SetM(map);
+				break;
+			}
+			case ListTag:{
+				uint32_t count=get<uint32_t>();
+				Aws::Vector<std::shared_ptr<AttributeValue>> list;
+				for(uint32_t i=0; i<count; i++){
+					auto element=std::make_shared<AttributeValue>();
+					get(*element);
+					list.push_back(element);
+				}
+				value.SetL(list);
+				break;
+			}
+			default:
+				throw std::runtime_error("Invalid attribute type "+std::to_string(tag));
+		}
+	}
+	void get(Item& item){
+		uint32_t count=get<uint32_t>();
+		for(uint32_t i=0; i<count; i++){
+			std::string name=getString();
+			get(item[name]);
+		}
+	}
+
+	bool done() const{ return pos==end; }
+
+private:
+	const char* pos;
+	const char* end;
+
+	void need(std::size_t n) const{
+		if((std::size_t)(end-pos)<n)
+			throw std::runtime_error("Record is truncated");
+	}
+};
+
+uint8_t projectionCode(Aws::DynamoDB::Model::ProjectionType type){
+	switch(type){
+		case Aws::DynamoDB::Model::ProjectionType::KEYS_ONLY: return 1;
+		case Aws::DynamoDB::Model::ProjectionType::INCLUDE: return 2;
+		default: return 0;
+	}
+}
+
+Aws::DynamoDB::Model::ProjectionType projectionType(uint8_t code){
+	switch(code){
+		case 1: return Aws::DynamoDB::Model::ProjectionType::KEYS_ONLY;
+		case 2: return Aws::DynamoDB::Model::ProjectionType::INCLUDE;
+		default: return Aws::DynamoDB::Model::ProjectionType::ALL;
+	}
+}
+
+uint8_t scalarTypeCode(Aws::DynamoDB::Model::ScalarAttributeType type){
+	switch(type){
+		case Aws::DynamoDB::Model::ScalarAttributeType::N: return 1;
+		case Aws::DynamoDB::Model::ScalarAttributeType::B: return 2;
+		default: return 0;
+	}
+}
+
+Aws::DynamoDB::Model::ScalarAttributeType scalarType(uint8_t code){
+	switch(code){
+		case 1: return Aws::DynamoDB::Model::ScalarAttributeType::N;
+		case 2: return Aws::DynamoDB::Model::ScalarAttributeType::B;
+		default: return Aws::DynamoDB::Model::ScalarAttributeType::S;
+	}
+}
+
+bool writeAll(int fd, const std::string& data){
+	std::size_t written=0;
+	while(written<data.size()){
+		ssize_t result=write(fd,data.data()+written,data.size()-written);
+		if(result<0){
+			if(errno==EINTR)
+				continue;
+			return false;
+		}
+		written+=result;
+	}
+	return true;
+}
+
+bool readAll(int fd, std::string& data){
+	struct stat info;
+	if(fstat(fd,&info))
+		return false;
+	data.resize(info.st_size);
+	std::size_t done=0;
+	while(done<data.size()){
+		ssize_t result=pread(fd,&data[done],data.size()-done,done);
+		if(result<0){
+			if(errno==EINTR)
+				continue;
+			return false;
+		}
+		if(result==0)
+			break;
+		done+=result;
+	}
+	data.resize(done);
+	return true;
+}
+
+std::string fileHeader(){
+	LogWriter header;
+	header.buffer.assign(logMagic,sizeof(logMagic));
+	header.put<uint32_t>(logVersion);
+	header.put<uint32_t>(byteOrderMark);
+	return header.buffer;
+}
+
+///\return the key schema for a hash key and optional range key
+Aws::Vector<Aws::DynamoDB::Model::KeySchemaElement> keySchema(const std::string& hashName, const std::string& rangeName){
+	using namespace Aws::DynamoDB::Model;
+	Aws::Vector<KeySchemaElement> schema{KeySchemaElement().WithAttributeName(hashName).WithKeyType(KeyType::HASH)};
+	if(!rangeName.empty())
+		schema.push_back(KeySchemaElement().WithAttributeName(rangeName).WithKeyType(KeyType::RANGE));
+	return schema;
+}
+
+///Read a key schema
+///\throws RequestError if the schema is not a hash key and an optional range key
+void parseKeySchema(const Aws::Vector<Aws::DynamoDB::Model::KeySchemaElement>& schema,
+                    std::string& hashName, std::string& rangeName){
+	using Aws::DynamoDB::Model::KeyType;
+	hashName.clear();
+	rangeName.clear();
+	for(const auto& element : schema){
+		std::string& name=(element.GetKeyType()==KeyType::RANGE?rangeName:hashName);
+		if(!name.empty() || element.GetAttributeName().empty())
+			throw invalid("Invalid KeySchema: Some index key attribute have no definition or are duplicated");
+		name=element.GetAttributeName();
+	}
+	if(hashName.empty())
+		throw invalid("Invalid KeySchema: The first KeySchemaElement is not a HASH key type");
+}
+
+}
+
+//----
+//Tables
+
+struct LocalStorageEngine::Table{
+	struct Index{
+		std::string hashName, rangeName;
+		Aws::DynamoDB::Model::ProjectionType projection;
+		Aws::Vector<Aws::String> nonKeyAttributes;
+		///The index keys of items which have them, each paired with the item's
+		///primary key
+		std::set<Position> entries;
+
+		///Find an item's key in this index
+		///\return whether the item has the index's key attributes
+		bool keyOf(const Item& item, Key& key) const{
+			auto hash=item.find(hashName);
+			if(hash==item.end() || !toKeyValue(hash->second,key.hash))
+				return false;
+			key.range=KeyValue();
+			if(!rangeName.empty()){
+				auto range=item.find(rangeName);
+				if(range==item.end() || !toKeyValue(range->second,key.range))
+					return false;
+			}
+			return true;
+		}
+	};
+
+	std::string name;
+	std::string hashName, rangeName;
+	Aws::Vector<Aws::DynamoDB::Model::AttributeDefinition> definitions;
+	std::map<Key,Item> items;
+	std::map<std::string,Index> indices;
+	///The approximate size of all items, as encoded in the file
+	uint64_t bytes=0;
+
+	///\param exact whether the item should contain only its key
+	///\return an item's primary key
+	///\throws RequestError if the item does not have a valid key
+	Key keyOf(const Item& item, bool exact) const{
+		Key key;
+		key.hash=keyPart(item,hashName);
+		if(!rangeName.empty())
+			key.range=keyPart(item,rangeName);
+		if(exact && item.size()!=(rangeName.empty()?1u:2u))
+			throw invalid("The provided key element does not match the schema");
+		return key;
+	}
+
+	const Index* findIndex(const std::string& indexName) const{
+		if(indexName.empty())
+			return nullptr;
+		auto it=indices.find(indexName);
+		if(it==indices.end())
+			throw invalid("The table does not have the specified index: "+indexName);
+		return &it->second;
+	}
+
+	///\return the attributes of an item which are present in an index
+	Item indexView(const Index& index, const Item& item) const{
+		if(index.projection==Aws::DynamoDB::Model::ProjectionType::ALL)
+			return item;
+		Item view;
+		auto copy=[&](const std::string& attribute){
+			auto it=item.find(attribute);
+			if(it!=item.end())
+				view.emplace(attribute,it->second);
+		};
+		for(const auto* attribute : {&hashName,&rangeName,&index.hashName,&index.rangeName}){
+			if(!attribute->empty())
+				copy(*attribute);
+		}
+		if(index.projection==Aws::DynamoDB::Model::ProjectionType::INCLUDE){
+			for(const auto& attribute : index.nonKeyAttributes)
+				copy(attribute);
+		}
+		return view;
+	}
+
+	///\return the key attributes of an item, for resuming a query or scan
+	///        after it
+	Item positionKey(const Index* index, const Item& item) const{
+		Item key;
+		for(const auto* attribute : {&hashName,&rangeName,
+		                             index?&index->hashName:&hashName,index?&index->rangeName:&rangeName}){
+			auto it=item.find(*attribute);
+			if(!attribute->empty() && it!=item.end())
+				key.emplace(*attribute,it->second);
+		}
+		return key;
+	}
+
+	///\return the position given by an ExclusiveStartKey
+	Position startPosition(const Index* index, const Item& start) const{
+		Key tableKey=keyOf(start,false);
+		if(!index)
+			return Position(tableKey,tableKey);
+		Key indexKey;
+		if(!index->keyOf(start,indexKey))
+			throw invalid("The provided starting key is invalid");
+		return Position(indexKey,tableKey);
+	}
+
+	void put(const Key& key, Item item){
+		auto it=items.find(key);
+		if(it!=items.end()){
+			unindex(key,it->second);
+			bytes-=encodedSize(it->second);
+			it->second=std::move(item);
+		}
+		else
+			it=items.emplace(key,std::move(item)).first;
+		bytes+=encodedSize(it->second);
+		addToIndices(key,it->second);
+	}
+
+	void erase(const Key& key){
+		auto it=items.find(key);
+		if(it==items.end())
+			return;
+		unindex(key,it->second);
+		bytes-=encodedSize(it->second);
+		items.erase(it);
+	}
+
+	///Add an index, including all existing items which have its key
+	void addIndex(const std::string& indexName, Index index){
+		Index& added=(indices[indexName]=std::move(index));
+		added.entries.clear();
+		Key indexKey;
+		for(const auto& item : items){
+			if(added.keyOf(item.second,indexKey))
+				added.entries.emplace(indexKey,item.first);
+		}
+	}
+
+private:
+	KeyValue keyPart(const Item& item, const std::string& attribute) const{
+		auto it=item.find(attribute);
+		if(it==item.end())
+			throw invalid("One or more parameter values were invalid: Missing the key "+attribute+" in the item");
+		KeyValue part;
+		if(!toKeyValue(it->second,part)){
+			if(it->second.GetType()==ValueType::STRING)
+				throw invalid("One or more parameter values are not valid. The AttributeValue for a key attribute cannot contain an empty string value. Key: "+attribute);
+			throw invalid("One or more parameter values were invalid: Type mismatch for key "+attribute);
+		}
+		for(const auto& definition : definitions){
+			if(definition.GetAttributeName()!=attribute)
+				continue;
+			bool number=(definition.GetAttributeType()==Aws::DynamoDB::Model::ScalarAttributeType::N);
+			if(number!=(part.kind==KeyValue::Number))
+				throw invalid("One or more parameter values were invalid: Type mismatch for key "+attribute);
+		}
+		return part;
+	}
+
+	void addToIndices(const Key& key, const Item& item){
+		Key indexKey;
+		for(auto& index : indices){
+			if(index.second.keyOf(item,indexKey))
+				index.second.entries.emplace(indexKey,key);
+		}
+	}
+
+	void unindex(const Key& key, const Item& item){
+		Key indexKey;
+		for(auto& index : indices){
+			if(index.second.keyOf(item,indexKey))
+				index.second.entries.erase(Position(indexKey,key));
+		}
+	}
+};
+
+struct LocalStorageEngine::Change{
+	Table* table;
+	ChangeKind kind;
+	Key key;
+	///The whole item for a put, or its key for a delete
+	Item item;
+};
+
+namespace{
+
+using Table=LocalStorageEngine::Table;
+
+///Accumulates the results of a query or scan, up to a limit on the number of
+///items read
+class Page{
+public:
+	Page(const Table& table, const Table::Index* index, const Condition* filter,
+	     const std::vector<std::string>& projection, int limit, bool countOnly):
+	table(table),index(index),filter(filter),projection(projection),
+	limit(limit>0?limit:0),countOnly(countOnly),count(0),scanned(0),
+	truncated(false),last(nullptr){}
+
+	///Read an item, which must already satisfy any key condition
+	///\return false if the limit has been reached, in which case the item was
+	///        not read
+	bool add(const Item& item){
+		if(limit && scanned==limit){
+			truncated=true;
+			return false;
+		}
+		scanned++;
+		last=&item;
+		Item view;
+		if(index)
+			view=table.indexView(*index,item);
+		const Item& visible=(index?view:item);
+		if(filter && !filter->evaluate(visible))
+			return true;
+		count++;
+		if(!countOnly)
+			items.push_back(project(visible,projection));
+		return true;
+	}
+
+	template<typename Result>
+	Result finish(){
+		Result result;
+		result.SetItems(std::move(items));
+		result.SetCount(count);
+		result.SetScannedCount(scanned);
+		if(truncated && last)
+			result.SetLastEvaluatedKey(table.positionKey(index,*last));
+		return result;
+	}
+
+private:
+	const Table& table;
+	const Table::Index* index;
+	const Condition* filter;
+	const std::vector<std::string>& projection;
+	const int limit;
+	const bool countOnly;
+	Aws::Vector<Item> items;
+	int count;
+	int scanned;
+	bool truncated;
+	const Item* last;
+};
+
+///\return the attributes to return from a write
+///\param old the item before the write, or null if it did not exist
+///\param updated the item after the write, or null if it was deleted
+///\param changed the attributes named by an update
+Item returnedAttributes(Aws::DynamoDB::Model::ReturnValue which, const Item* old, const Item* updated,
+                        const std::set<std::string>& changed){
+	using Aws::DynamoDB::Model::ReturnValue;
+	const Item* source=nullptr;
+	switch(which){
+		case ReturnValue::ALL_OLD:
+			return old?*old:Item();
+		case ReturnValue::ALL_NEW:
+			return updated?*updated:Item();
+		case ReturnValue::UPDATED_OLD:
+			source=old;
+			break;
+		case ReturnValue::UPDATED_NEW:
+			source=updated;
+			break;
+		default:
+			return Item();
+	}
+	Item result;
+	if(source){
+		for(const auto& name : changed){
+			auto it=source->find(name);
+			if(it!=source->end())
+				result.emplace(name,it->second);
+		}
+	}
+	return result;
+}
+
+///\return an item as it would be after an update
+///\param current the item before the update, or null if it does not exist
+///\param key the item's key
+///\param changed the attributes named by the update will be added to this
+Item updatedItem(const Table& table, const Item* current, const Item& key,
+                 const std::string& expression, const NameMap& names, const Item& values,
+                 const Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValueUpdate>& attributeUpdates,
+                 std::set<std::string>& changed){
+	using Aws::DynamoDB::Model::AttributeAction;
+	const Item& before=(current?*current:key);
+	Item after=before;
+	if(!expression.empty()){
+		if(!attributeUpdates.empty())
+			throw invalid("Can not use both expression and non-expression parameters in the same request: "
+			              "Non-expression parameters: {AttributeUpdates} Expression parameters: {UpdateExpression}");
+		std::vector<UpdateAction> actions=ExpressionParser(expression,names,values).parseUpdate();
+		for(const auto& action : actions){
+			if(!changed.insert(action.name).second)
+				throw invalid("Invalid UpdateExpression: Two document paths overlap with each other; "
+				              "must remove or rewrite one of these paths; path one: ["+action.name+"], path two: ["+action.name+"]");
+		}
+		//all values are computed from the item as it was before the update
+		std::vector<AttributeValue> results;
+		for(const auto& action : actions)
+			results.push_back(action.kind==UpdateAction::Remove?AttributeValue():action.value.evaluate(before));
+		for(std::size_t i=0; i<actions.size(); i++){
+			const UpdateAction& action=actions[i];
+			switch(action.kind){
+				case UpdateAction::Set: after[action.name]=results[i]; break;
+				case UpdateAction::Remove: after.erase(action.name); break;
+				case UpdateAction::Add: addToAttribute(after,action.name,results[i]); break;
+				case UpdateAction::Delete: deleteFromAttribute(after,action.name,results[i]); break;
+			}
+		}
+	}
+	else{
+		for(const auto& update : attributeUpdates){
+			changed.insert(update.first);
+			switch(update.second.GetAction()){
+				case AttributeAction::ADD:
+					addToAttribute(after,update.first,update.second.GetValue());
+					break;
+				case AttributeAction::DELETE_:
+					if(update.second.ValueHasBeenSet())
+						deleteFromAttribute(after,update.first,update.second.GetValue());
+					else
+						after.erase(update.first);
+					break;
+				default: //PUT
+					after[update.first]=update.second.GetValue();
+			}
+		}
+	}
+	for(const auto& name : changed){
+		if(name==table.hashName || name==table.rangeName)
+			throw invalid("One or more parameter values were invalid: Cannot update attribute "+name+". This attribute is part of the key");
+	}
+	validateItem(after);
+	return after;
+}
+
+///\return the index of the segment of a parallel scan in which an item is read
+unsigned int segmentOf(const Key& key, unsigned int totalSegments){
+	return checksum(key.hash.text.data(),key.hash.text.size())%totalSegments;
+}
+
+}
+
+//----
+//The engine
+
+LocalStorageEngine::LocalStorageEngine(const std::string& path, bool syncWrites):
+path(path),syncWrites(syncWrites),fd(-1),logBytes(0){
+	fd=open(path.c_str(),O_RDWR|O_CREAT|O_APPEND,0600);
+	if(fd<0)
+		throw std::runtime_error("Unable to open "+path+": "+std::strerror(errno));
+	//two processes appending to the same file would corrupt it
+	if(flock(fd,LOCK_EX|LOCK_NB)){
+		int err=errno;
+		close(fd);
+		throw std::runtime_error("Unable to lock "+path+": "+std::strerror(err));
+	}
+	try{
+		replay();
+		compactIfNeeded();
+	}catch(...){
+		close(fd);
+		throw;
+	}
+	log_info("Opened local database " << path << ": " << tables.size() << " tables, "
+	         << logBytes << " bytes");
+}
+
+LocalStorageEngine::~LocalStorageEngine(){
+	if(fd>=0)
+		close(fd);
+}
+
+LocalStorageEngine::Table& LocalStorageEngine::getTable(const std::string& name) const{
+	auto it=tables.find(name);
+	if(it==tables.end())
+		throw RequestError{DynamoDBErrors::RESOURCE_NOT_FOUND,"ResourceNotFoundException",
+		                   "Requested resource not found: Table: "+name+" not found"};
+	return *it->second;
+}
+
+void LocalStorageEngine::replay(){
+	std::string contents;
+	if(!readAll(fd,contents))
+		throw std::runtime_error("Unable to read "+path+": "+std::strerror(errno));
+	if(contents.empty()){
+		const std::string header=fileHeader();
+		if(!writeAll(fd,header) || fsync(fd))
+			throw std::runtime_error("Unable to write "+path+": "+std::strerror(errno));
+		logBytes=header.size();
+		return;
+	}
+	if(contents.size()<headerSize || std::memcmp(contents.data(),logMagic,sizeof(logMagic)))
+		throw std::runtime_error(path+" is not a local database file");
+	LogReader header(contents.data()+sizeof(logMagic),contents.data()+headerSize);
+	uint32_t version=header.get<uint32_t>();
+	if(version!=logVersion)
+		throw std::runtime_error("Unsupported local database version "+std::to_string(version));
+	if(header.get<uint32_t>()!=byteOrderMark)
+		throw std::runtime_error("Local database was written on a machine with a different byte order");
+
+	std::size_t pos=headerSize;
+	std::size_t records=0;
+	while(pos<contents.size()){
+		std::size_t remaining=contents.size()-pos;
+		if(remaining<frameSize)
+			break;
+		LogReader frame(contents.data()+pos,contents.data()+pos+frameSize);
+		uint32_t length=frame.get<uint32_t>();
+		uint64_t expectedChecksum=frame.get<uint64_t>();
+		if(length>remaining-frameSize)
+			break;
+		const char* payload=contents.data()+pos+frameSize;
+		if(checksum(payload,length)!=expectedChecksum){
+			if(length==remaining-frameSize) //the last record, partially written
+				break;
+			throw std::runtime_error(path+" is corrupt at offset "+std::to_string(pos));
+		}
+		LogReader reader(payload,payload+length);
+		try{
+			switch(reader.get<uint8_t>()){
+				case SchemaRecord:{
+					std::unique_ptr<Table> table(new Table);
+					reader.get(table->name);
+					reader.get(table->hashName);
+					reader.get(table->rangeName);
+					uint32_t nDefinitions=reader.get<uint32_t>();
+					for(uint32_t i=0; i<nDefinitions; i++){
+						std::string name=reader.getString();
+						table->definitions.push_back(Aws::DynamoDB::Model::AttributeDefinition()
+						                             .WithAttributeName(name)
+						                             .WithAttributeType(scalarType(reader.get<uint8_t>())));
+					}
+					uint32_t nIndices=reader.get<uint32_t>();
+					for(uint32_t i=0; i<nIndices; i++){
+						std::string name=reader.getString();
+						Table::Index& index=table->indices[name];
+						reader.get(index.hashName);
+						reader.get(index.rangeName);
+						index.projection=projectionType(reader.get<uint8_t>());
+						uint32_t nAttributes=reader.get<uint32_t>();
+						for(uint32_t j=0; j<nAttributes; j++)
+							index.nonKeyAttributes.push_back(reader.getString());
+					}
+					applySchema(std::move(table));
+					break;
+				}
+				case DropTableRecord:
+					tables.erase(reader.getString());
+					break;
+				case ChangesRecord:{
+					std::vector<Change> changes(reader.get<uint32_t>());
+					for(auto& change : changes){
+						change.kind=(ChangeKind)reader.get<uint8_t>();
+						change.table=&getTable(reader.getString());
+						reader.get(change.item);
+						change.key=change.table->keyOf(change.item,change.kind==DeleteChange);
+					}
+					apply(changes);
+					break;
+				}
+				default:
+					throw std::runtime_error("unknown record kind");
+			}
+			if(!reader.done())
+				throw std::runtime_error("unexpected data at end of record");
+		}catch(RequestError& err){
+			throw std::runtime_error(path+" contains an invalid record at offset "+std::to_string(pos)+": "+err.message);
+		}catch(std::runtime_error& err){
+			throw std::runtime_error(path+" contains an invalid record at offset "+std::to_string(pos)+": "+err.what());
+		}
+		pos+=frameSize+length;
+		records++;
+	}
+	if(pos<contents.size()){
+		log_warn("Discarding " << (contents.size()-pos) << " bytes of incompletely written changes at the end of " << path);
+		if(ftruncate(fd,pos))
+			throw std::runtime_error("Unable to truncate "+path+": "+std::strerror(errno));
+	}
+	logBytes=pos;
+	log_info("Replayed " << records << " records from " << path);
+}
+
+void LocalStorageEngine::append(const std::string& record){
+	if(!writeAll(fd,record) || (syncWrites && fdatasync(fd))){
+		int err=errno;
+		//remove any part of the record which was written, so that later
+		//records are not hidden behind it
+		if(ftruncate(fd,logBytes))
+			log_error("Unable to truncate " << path << ": " << std::strerror(errno));
+		throw RequestError{DynamoDBErrors::INTERNAL_FAILURE,"InternalServerError",
+		                   "Unable to write to "+path+": "+std::strerror(err)};
+	}
+	logBytes+=record.size();
+}
+
+void LocalStorageEngine::commit(std::vector<Change>& changes){
+	if(changes.empty())
+		return;
+	LogWriter writer;
+	writer.put<uint8_t>(ChangesRecord);
+	writer.put<uint32_t>(changes.size());
+	for(const auto& change : changes){
+		writer.put<uint8_t>(change.kind);
+		writer.put(change.table->name);
+		writer.put(change.item);
+	}
+	append(writer.record());
+	apply(changes);
+	compactIfNeeded();
+}
+
+void LocalStorageEngine::apply(std::vector<Change>& changes){
+	for(auto& change : changes){
+		if(change.kind==PutChange)
+			change.table->put(change.key,std::move(change.item));
+		else
+			change.table->erase(change.key);
+	}
+}
+
+std::string LocalStorageEngine::schemaRecord(const Table& table){
+	LogWriter writer;
+	writer.put<uint8_t>(SchemaRecord);
+	writer.put(table.name);
+	writer.put(table.hashName);
+	writer.put(table.rangeName);
+	writer.put<uint32_t>(table.definitions.size());
+	for(const auto& definition : table.definitions){
+		writer.put(definition.GetAttributeName());
+		writer.put<uint8_t>(scalarTypeCode(definition.GetAttributeType()));
+	}
+	writer.put<uint32_t>(table.indices.size());
+	for(const auto& index : table.indices){
+		writer.put(index.first);
+		writer.put(index.second.hashName);
+		writer.put(index.second.rangeName);
+		writer.put<uint8_t>(projectionCode(index.second.projection));
+		writer.put<uint32_t>(index.second.nonKeyAttributes.size());
+		for(const auto& attribute : index.second.nonKeyAttributes)
+			writer.put(attribute);
+	}
+	return writer.record();
+}
+
+void LocalStorageEngine::applySchema(std::unique_ptr<Table> schema){
+	auto it=tables.find(schema->name);
+	if(it==tables.end()){
+		tables.emplace(schema->name,std::move(schema));
+		return;
+	}
+	Table& table=*it->second;
+	table.definitions=schema->definitions;
+	for(auto index=table.indices.begin(); index!=table.indices.end();){
+		if(schema->indices.count(index->first))
+			++index;
+		else
+			index=table.indices.erase(index);
+	}
+	for(auto& index : schema->indices){
+		if(!table.indices.count(index.first))
+			table.addIndex(index.first,std::move(index.second));
+	}
+}
+
+uint64_t LocalStorageEngine::liveBytes() const{
+	uint64_t bytes=headerSize;
+	for(const auto& table : tables){
+		//each item is also preceded by its change kind and table name
+		bytes+=table.second->bytes+table.second->items.size()*(1+4+table.first.size());
+	}
+	return bytes;
+}
+
+void LocalStorageEngine::compactIfNeeded(){
+	if(logBytes>std::max(compactionFloor,2*liveBytes()))
+		compact();
+}
+
+void LocalStorageEngine::compact(){
+	std::string contents=fileHeader();
+	for(const auto& entry : tables){
+		const Table& table=*entry.second;
+		contents+=schemaRecord(table);
+		auto item=table.items.begin();
+		while(item!=table.items.end()){
+			LogWriter writer;
+			writer.put<uint8_t>(ChangesRecord);
+			std::size_t count=std::min(compactionBatch,(std::size_t)std::distance(item,table.items.end()));
+			writer.put<uint32_t>(count);
+			for(std::size_t i=0; i<count; i++, ++item){
+				writer.put<uint8_t>(PutChange);
+				writer.put(table.name);
+				writer.put(item->second);
+			}
+			contents+=writer.record();
+		}
+	}
+
+	//the current file remains in use unless the new one is completely written
+	const std::string tempPath=path+".tmp";
+	int newFD=open(tempPath.c_str(),O_RDWR|O_CREAT|O_TRUNC|O_APPEND,0600);
+	if(newFD<0){
+		log_error("Unable to open " << tempPath << ": " << std::strerror(errno));
+		return;
+	}
+	if(flock(newFD,LOCK_EX|LOCK_NB) || !writeAll(newFD,contents) || fsync(newFD)){
+		log_error("Unable to write " << tempPath << ": " << std::strerror(errno));
+		close(newFD);
+		unlink(tempPath.c_str());
+		return;
+	}
+	if(rename(tempPath.c_str(),path.c_str())){
+		log_error("Unable to replace " << path << ": " << std::strerror(errno));
+		close(newFD);
+		unlink(tempPath.c_str());
+		return;
+	}
+	close(fd);
+	fd=newFD;
+	log_info("Compacted " << path << " from " << logBytes << " to " << contents.size() << " bytes");
+	logBytes=contents.size();
+}
+
+Aws::DynamoDB::Model::GetItemOutcome LocalStorageEngine::getItem(const Aws::DynamoDB::Model::GetItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		SharedLock<SharedMutex> lock(mutex);
+		const Table& table=getTable(request.GetTableName());
+		Key key=table.keyOf(request.GetKey(),true);
+		GetItemResult result;
+		auto it=table.items.find(key);
+		if(it!=table.items.end())
+			result.SetItem(project(it->second,parseProjection(request.GetProjectionExpression(),
+			                                                  request.GetExpressionAttributeNames())));
+		return GetItemOutcome(result);
+	}catch(RequestError& err){
+		return err.as<GetItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::BatchGetItemOutcome LocalStorageEngine::batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		SharedLock<SharedMutex> lock(mutex);
+		BatchGetItemResult result;
+		for(const auto& entry : request.GetRequestItems()){
+			const Table& table=getTable(entry.first);
+			const KeysAndAttributes& request=entry.second;
+			auto projection=parseProjection(request.GetProjectionExpression(),request.GetExpressionAttributeNames());
+			Aws::Vector<Item> items;
+			for(const auto& keyItem : request.GetKeys()){
+				auto it=table.items.find(table.keyOf(keyItem,true));
+				if(it!=table.items.end())
+					items.push_back(project(it->second,projection));
+			}
+			result.AddResponses(entry.first,items);
+		}
+		return BatchGetItemOutcome(result);
+	}catch(RequestError& err){
+		return err.as<BatchGetItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::QueryOutcome LocalStorageEngine::query(const Aws::DynamoDB::Model::QueryRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		SharedLock<SharedMutex> lock(mutex);
+		const Table& table=getTable(request.GetTableName());
+		const Table::Index* index=table.findIndex(request.GetIndexName());
+		const auto& names=request.GetExpressionAttributeNames();
+		const auto& values=request.GetExpressionAttributeValues();
+		Condition keyCondition=ExpressionParser(request.GetKeyConditionExpression(),names,values).parseCondition();
+		Condition filter;
+		if(!request.GetFilterExpression().empty())
+			filter=ExpressionParser(request.GetFilterExpression(),names,values).parseCondition();
+		auto projection=parseProjection(request.GetProjectionExpression(),names);
+
+		const std::string& hashName=(index?index->hashName:table.hashName);
+		const AttributeValue* hashValue=partitionValue(keyCondition,hashName);
+		KeyValue hash;
+		if(!hashValue || !toKeyValue(*hashValue,hash))
+			throw invalid("Query condition missed key schema element: "+hashName);
+
+		//collect the partition, in order
+		std::vector<std::pair<Position,const Item*>> partition;
+		if(index){
+			for(auto it=index->entries.lower_bound(Position(Key{hash,KeyValue()},Key()));
+			    it!=index->entries.end() && it->first.hash==hash; ++it)
+				partition.emplace_back(*it,&table.items.find(it->second)->second);
+		}
+		else{
+			for(auto it=table.items.lower_bound(Key{hash,KeyValue()});
+			    it!=table.items.end() && it->first.hash==hash; ++it)
+				partition.emplace_back(Position(it->first,it->first),&it->second);
+		}
+		const bool forward=!request.ScanIndexForwardHasBeenSet() || request.GetScanIndexForward();
+		if(!forward)
+			std::reverse(partition.begin(),partition.end());
+		std::size_t i=0;
+		if(!request.GetExclusiveStartKey().empty()){
+			Position after=table.startPosition(index,request.GetExclusiveStartKey());
+			while(i<partition.size() && (forward?!(after<partition[i].first):!(partition[i].first<after)))
+				i++;
+		}
+
+		Page page(table,index,request.GetFilterExpression().empty()?nullptr:&filter,projection,
+		          request.GetLimit(),request.GetSelect()==Select::COUNT);
+		for(; i<partition.size(); i++){
+			if(keyCondition.evaluate(*partition[i].second) && !page.add(*partition[i].second))
+				break;
+		}
+		return QueryOutcome(page.finish<QueryResult>());
+	}catch(RequestError& err){
+		return err.as<QueryOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::ScanOutcome LocalStorageEngine::scan(const Aws::DynamoDB::Model::ScanRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		SharedLock<SharedMutex> lock(mutex);
+		const Table& table=getTable(request.GetTableName());
+		const Table::Index* index=table.findIndex(request.GetIndexName());
+		Condition filter;
+		if(!request.GetFilterExpression().empty())
+			filter=ExpressionParser(request.GetFilterExpression(),request.GetExpressionAttributeNames(),
+			                        request.GetExpressionAttributeValues()).parseCondition();
+		auto projection=parseProjection(request.GetProjectionExpression(),request.GetExpressionAttributeNames());
+		unsigned int segment=0, totalSegments=1;
+		if(request.TotalSegmentsHasBeenSet() || request.SegmentHasBeenSet()){
+			if(request.GetTotalSegments()<1 || request.GetSegment()<0 || request.GetSegment()>=request.GetTotalSegments())
+				throw invalid("The Segment parameter must be less than the TotalSegments parameter");
+			segment=request.GetSegment();
+			totalSegments=request.GetTotalSegments();
+		}
+
+		Page page(table,index,request.GetFilterExpression().empty()?nullptr:&filter,projection,
+		          request.GetLimit(),request.GetSelect()==Select::COUNT);
+		const bool resume=!request.GetExclusiveStartKey().empty();
+		if(index){
+			auto it=resume?index->entries.upper_bound(table.startPosition(index,request.GetExclusiveStartKey()))
+			              :index->entries.begin();
+			for(; it!=index->entries.end(); ++it){
+				if(segmentOf(it->first,totalSegments)==segment && !page.add(table.items.find(it->second)->second))
+					break;
+			}
+		}
+		else{
+			auto it=resume?table.items.upper_bound(table.startPosition(nullptr,request.GetExclusiveStartKey()).first)
+			              :table.items.begin();
+			for(; it!=table.items.end(); ++it){
+				if(segmentOf(it->first,totalSegments)==segment && !page.add(it->second))
+					break;
+			}
+		}
+		return ScanOutcome(page.finish<ScanResult>());
+	}catch(RequestError& err){
+		return err.as<ScanOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::PutItemOutcome LocalStorageEngine::putItem(const Aws::DynamoDB::Model::PutItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		Table& table=getTable(request.GetTableName());
+		validateItem(request.GetItem());
+		Key key=table.keyOf(request.GetItem(),false);
+		auto existing=table.items.find(key);
+		const Item* old=(existing==table.items.end()?nullptr:&existing->second);
+		if(!conditionHolds(request.GetConditionExpression(),request.GetExpressionAttributeNames(),
+		                   request.GetExpressionAttributeValues(),old))
+			throw conditionFailed();
+		PutItemResult result;
+		result.SetAttributes(returnedAttributes(request.GetReturnValues(),old,nullptr,{}));
+		std::vector<Change> changes{Change{&table,PutChange,key,request.GetItem()}};
+		commit(changes);
+		return PutItemOutcome(result);
+	}catch(RequestError& err){
+		return err.as<PutItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::UpdateItemOutcome LocalStorageEngine::updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		Table& table=getTable(request.GetTableName());
+		Key key=table.keyOf(request.GetKey(),true);
+		auto existing=table.items.find(key);
+		const Item* old=(existing==table.items.end()?nullptr:&existing->second);
+		if(!conditionHolds(request.GetConditionExpression(),request.GetExpressionAttributeNames(),
+		                   request.GetExpressionAttributeValues(),old))
+			throw conditionFailed();
+		std::set<std::string> changed;
+		Item updated=updatedItem(table,old,request.GetKey(),request.GetUpdateExpression(),
+		                         request.GetExpressionAttributeNames(),request.GetExpressionAttributeValues(),
+		                         request.GetAttributeUpdates(),changed);
+		UpdateItemResult result;
+		result.SetAttributes(returnedAttributes(request.GetReturnValues(),old,&updated,changed));
+		std::vector<Change> changes{Change{&table,PutChange,key,std::move(updated)}};
+		commit(changes);
+		return UpdateItemOutcome(result);
+	}catch(RequestError& err){
+		return err.as<UpdateItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::DeleteItemOutcome LocalStorageEngine::deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		Table& table=getTable(request.GetTableName());
+		Key key=table.keyOf(request.GetKey(),true);
+		auto existing=table.items.find(key);
+		const Item* old=(existing==table.items.end()?nullptr:&existing->second);
+		if(!conditionHolds(request.GetConditionExpression(),request.GetExpressionAttributeNames(),
+		                   request.GetExpressionAttributeValues(),old))
+			throw conditionFailed();
+		DeleteItemResult result;
+		result.SetAttributes(returnedAttributes(request.GetReturnValues(),old,nullptr,{}));
+		if(old){
+			std::vector<Change> changes{Change{&table,DeleteChange,key,request.GetKey()}};
+			commit(changes);
+		}
+		return DeleteItemOutcome(result);
+	}catch(RequestError& err){
+		return err.as<DeleteItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::BatchWriteItemOutcome LocalStorageEngine::batchWriteItem(const Aws::DynamoDB::Model::BatchWriteItemRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		std::vector<Change> changes;
+		std::set<std::pair<const Table*,Key>> seen;
+		for(const auto& entry : request.GetRequestItems()){
+			Table& table=getTable(entry.first);
+			for(const auto& write : entry.second){
+				if(write.PutRequestHasBeenSet()){
+					const Item& item=write.GetPutRequest().GetItem();
+					validateItem(item);
+					changes.push_back(Change{&table,PutChange,table.keyOf(item,false),item});
+				}
+				else{
+					const Item& key=write.GetDeleteRequest().GetKey();
+					changes.push_back(Change{&table,DeleteChange,table.keyOf(key,true),key});
+				}
+				if(!seen.emplace(&table,changes.back().key).second)
+					throw invalid("Provided list of item keys contains duplicates");
+			}
+		}
+		commit(changes);
+		return BatchWriteItemOutcome(BatchWriteItemResult());
+	}catch(RequestError& err){
+		return err.as<BatchWriteItemOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::TransactWriteItemsOutcome LocalStorageEngine::transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		std::vector<Change> changes;
+		std::set<std::pair<const Table*,Key>> seen;
+		std::string reasons;
+		bool cancelled=false;
+		for(const auto& operation : request.GetTransactItems()){
+			Table* table=nullptr;
+			Key key;
+			const Item* old=nullptr;
+			//find the item to which an operation applies, and check its condition
+			auto prepare=[&](const std::string& tableName, const Item& keyOrItem, bool exact,
+			                 const std::string& condition, const NameMap& names, const Item& values){
+				table=&getTable(tableName);
+				key=table->keyOf(keyOrItem,exact);
+				if(!seen.emplace(table,key).second)
+					throw invalid("Transaction request cannot include multiple operations on one item");
+				auto existing=table->items.find(key);
+				old=(existing==table->items.end()?nullptr:&existing->second);
+				bool holds=conditionHolds(condition,names,values,old);
+				reasons+=std::string(reasons.empty()?"":", ")+(holds?"None":"ConditionalCheckFailed");
+				cancelled|=!holds;
+			};
+			if(operation.ConditionCheckHasBeenSet()){
+				const auto& check=operation.GetConditionCheck();
+				prepare(check.GetTableName(),check.GetKey(),true,check.GetConditionExpression(),
+				        check.GetExpressionAttributeNames(),check.GetExpressionAttributeValues());
+			}
+			else if(operation.PutHasBeenSet()){
+				const auto& put=operation.GetPut();
+				validateItem(put.GetItem());
+				prepare(put.GetTableName(),put.GetItem(),false,put.GetConditionExpression(),
+				        put.GetExpressionAttributeNames(),put.GetExpressionAttributeValues());
+				changes.push_back(Change{table,PutChange,key,put.GetItem()});
+			}
+			else if(operation.DeleteHasBeenSet()){
+				const auto& del=operation.GetDelete();
+				prepare(del.GetTableName(),del.GetKey(),true,del.GetConditionExpression(),
+				        del.GetExpressionAttributeNames(),del.GetExpressionAttributeValues());
+				if(old)
+					changes.push_back(Change{table,DeleteChange,key,del.GetKey()});
+			}
+			else if(operation.UpdateHasBeenSet()){
+				const auto& update=operation.GetUpdate();
+				prepare(update.GetTableName(),update.GetKey(),true,update.GetConditionExpression(),
+				        update.GetExpressionAttributeNames(),update.GetExpressionAttributeValues());
+				std::set<std::string> changed;
+				changes.push_back(Change{table,PutChange,key,
+				                         updatedItem(*table,old,update.GetKey(),update.GetUpdateExpression(),
+				                                     update.GetExpressionAttributeNames(),update.GetExpressionAttributeValues(),
+				                                     {},changed)});
+			}
+			else
+				throw invalid("TransactItems can only contain one of Check, Put, Update or Delete");
+		}
+		if(cancelled)
+			throw RequestError{DynamoDBErrors::TRANSACTION_CANCELED,"TransactionCanceledException",
+			                   "Transaction cancelled, please refer cancellation reasons for specific reasons ["+reasons+"]"};
+		commit(changes);
+		return TransactWriteItemsOutcome(TransactWriteItemsResult());
+	}catch(RequestError& err){
+		return err.as<TransactWriteItemsOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::DescribeTableOutcome LocalStorageEngine::describeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		SharedLock<SharedMutex> lock(mutex);
+		const Table& table=getTable(request.GetTableName());
+		TableDescription description;
+		description.SetTableName(table.name);
+		description.SetTableStatus(TableStatus::ACTIVE);
+		description.SetKeySchema(keySchema(table.hashName,table.rangeName));
+		description.SetAttributeDefinitions(table.definitions);
+		description.SetItemCount(table.items.size());
+		Aws::Vector<GlobalSecondaryIndexDescription> indices;
+		for(const auto& index : table.indices){
+			Projection projection;
+			projection.SetProjectionType(index.second.projection);
+			if(index.second.projection==ProjectionType::INCLUDE)
+				projection.SetNonKeyAttributes(index.second.nonKeyAttributes);
+			indices.push_back(GlobalSecondaryIndexDescription()
+			                  .WithIndexName(index.first)
+			                  .WithKeySchema(keySchema(index.second.hashName,index.second.rangeName))
+			                  .WithProjection(projection)
+			                  .WithIndexStatus(IndexStatus::ACTIVE));
+		}
+		description.SetGlobalSecondaryIndexes(indices);
+		DescribeTableResult result;
+		result.SetTable(description);
+		return DescribeTableOutcome(result);
+	}catch(RequestError& err){
+		return err.as<DescribeTableOutcome>();
+	}
+}
+
+namespace{
+///\return an index's definition, as the engine stores it
+Table::Index makeIndex(const Aws::Vector<Aws::DynamoDB::Model::KeySchemaElement>& schema,
+                       const Aws::DynamoDB::Model::Projection& projection){
+	Table::Index index;
+	parseKeySchema(schema,index.hashName,index.rangeName);
+	index.projection=projection.GetProjectionType();
+	if(index.projection==Aws::DynamoDB::Model::ProjectionType::INCLUDE)
+		index.nonKeyAttributes=projection.GetNonKeyAttributes();
+	return index;
+}
+
+///Add or replace attribute definitions
+void mergeDefinitions(Aws::Vector<Aws::DynamoDB::Model::AttributeDefinition>& definitions,
+                      const Aws::Vector<Aws::DynamoDB::Model::AttributeDefinition>& additions){
+	for(const auto& addition : additions){
+		auto it=std::find_if(definitions.begin(),definitions.end(),
+		                     [&](const Aws::DynamoDB::Model::AttributeDefinition& definition){
+		                     	return definition.GetAttributeName()==addition.GetAttributeName();
+		                     });
+		if(it!=definitions.end())
+			*it=addition;
+		else
+			definitions.push_back(addition);
+	}
+}
+}
+
+Aws::DynamoDB::Model::CreateTableOutcome LocalStorageEngine::createTable(const Aws::DynamoDB::Model::CreateTableRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		if(tables.count(request.GetTableName()))
+			throw RequestError{DynamoDBErrors::RESOURCE_IN_USE,"ResourceInUseException",
+			                   "Table already exists: "+request.GetTableName()};
+		std::unique_ptr<Table> table(new Table);
+		table->name=request.GetTableName();
+		parseKeySchema(request.GetKeySchema(),table->hashName,table->rangeName);
+		table->definitions=request.GetAttributeDefinitions();
+		for(const auto& index : request.GetGlobalSecondaryIndexes()){
+			if(table->indices.count(index.GetIndexName()))
+				throw invalid("One or more parameter values were invalid: Duplicate index name: "+index.GetIndexName());
+			table->indices[index.GetIndexName()]=makeIndex(index.GetKeySchema(),index.GetProjection());
+		}
+		append(schemaRecord(*table));
+		applySchema(std::move(table));
+		return CreateTableOutcome(CreateTableResult());
+	}catch(RequestError& err){
+		return err.as<CreateTableOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::UpdateTableOutcome LocalStorageEngine::updateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		const Table& table=getTable(request.GetTableName());
+		//describe the modified table, without its contents
+		std::unique_ptr<Table> schema(new Table);
+		schema->name=table.name;
+		schema->hashName=table.hashName;
+		schema->rangeName=table.rangeName;
+		schema->definitions=table.definitions;
+		mergeDefinitions(schema->definitions,request.GetAttributeDefinitions());
+		for(const auto& index : table.indices){
+			Table::Index& copy=schema->indices[index.first];
+			copy.hashName=index.second.hashName;
+			copy.rangeName=index.second.rangeName;
+			copy.projection=index.second.projection;
+			copy.nonKeyAttributes=index.second.nonKeyAttributes;
+		}
+		for(const auto& update : request.GetGlobalSecondaryIndexUpdates()){
+			if(update.CreateHasBeenSet()){
+				const auto& create=update.GetCreate();
+				if(schema->indices.count(create.GetIndexName()))
+					throw invalid("Attempting to create an index which already exists: "+create.GetIndexName());
+				schema->indices[create.GetIndexName()]=makeIndex(create.GetKeySchema(),create.GetProjection());
+			}
+			else if(update.DeleteHasBeenSet()){
+				if(!schema->indices.erase(update.GetDelete().GetIndexName()))
+					throw RequestError{DynamoDBErrors::RESOURCE_NOT_FOUND,"ResourceNotFoundException",
+					                   "Requested resource not found: Index: "+update.GetDelete().GetIndexName()+" not found"};
+			}
+		}
+		append(schemaRecord(*schema));
+		applySchema(std::move(schema));
+		return UpdateTableOutcome(UpdateTableResult());
+	}catch(RequestError& err){
+		return err.as<UpdateTableOutcome>();
+	}
+}
+
+Aws::DynamoDB::Model::DeleteTableOutcome LocalStorageEngine::deleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request){
+	using namespace Aws::DynamoDB::Model;
+	try{
+		std::lock_guard<SharedMutex> lock(mutex);
+		getTable(request.GetTableName());
+		LogWriter writer;
+		writer.put<uint8_t>(DropTableRecord);
+		writer.put(request.GetTableName());
+		append(writer.record());
+		tables.erase(request.GetTableName());
+		compactIfNeeded();
+		return DeleteTableOutcome(DeleteTableResult());
+	}catch(RequestError& err){
+		return err.as<DeleteTableOutcome>();
+	}
+}
+
+std::string LocalStorageEngine::describe() const{
+	SharedLock<SharedMutex> lock(mutex);
+	std::size_t items=0;
+	for(const auto& table : tables)
+		items+=table.second->items.size();
+	std::ostringstream os;
+	os << "local file " << path << " (" << tables.size() << " tables, " << items
+	   << " items, " << logBytes << " bytes)";
+	return os.str();
+}
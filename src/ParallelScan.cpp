@@ -0,0 +1,35 @@
+#include <ParallelScan.h>
+
+#include <aws/core/utils/Outcome.h>
+
+std::size_t ParallelScan::scanSegment(Aws::DynamoDB::Model::ScanRequest request, unsigned int segment,
+                                      const std::function<void(const Item&)>& fn){
+	//a single segment is an ordinary scan, for which the segment parameters
+	//must not be set
+	if(segments>1){
+		request.SetSegment(segment);
+		request.SetTotalSegments(segments);
+	}
+	std::size_t items=0;
+	bool keepGoing=false;
+	do{
+		auto outcome=engine.scan(request);
+		if(!outcome.IsSuccess()){
+			auto err=outcome.GetError();
+			throw std::runtime_error("Failed to scan segment "+std::to_string(segment)
+			                         +" of "+request.GetTableName()+": "+err.GetMessage());
+		}
+		const auto& result=outcome.GetResult();
+		//set up fetching the next page if necessary
+		if(!result.GetLastEvaluatedKey().empty()){
+			keepGoing=true;
+			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
+		}
+		else
+			keepGoing=false;
+		for(const auto& item : result.GetItems())
+			fn(item);
+		items+=result.GetItems().size();
+	}while(keepGoing);
+	return items;
+}
@@ -12,6 +12,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <aws/core/utils/Outcome.h>
+#include <aws/dynamodb/model/BatchGetItemRequest.h>
 #include <aws/dynamodb/model/DeleteItemRequest.h>
 #include <aws/dynamodb/model/GetItemRequest.h>
 #include <aws/dynamodb/model/PutItemRequest.h>
@@ -58,6 +59,16 @@ bool indexHasNonKeyProjection(const Aws::DynamoDB::Model::TableDescription& tabl
 	return false;
 }
 
+bool indexIsActive(const Aws::DynamoDB::Model::TableDescription& tableDesc, const std::string& name){
+	using namespace Aws::DynamoDB::Model;
+	const Aws::Vector<GlobalSecondaryIndexDescription>& indices=tableDesc.GetGlobalSecondaryIndexes();
+	auto index=std::find_if(indices.begin(),indices.end(),
+	                        [&name](const GlobalSecondaryIndexDescription& gsid)->bool{
+	                        	return gsid.GetIndexName()==name;
+	                        });
+	return index!=indices.end() && index->GetIndexStatus()==IndexStatus::ACTIVE;
+}
+
 Aws::DynamoDB::Model::CreateGlobalSecondaryIndexAction
 secondaryIndexToCreateAction(const Aws::DynamoDB::Model::GlobalSecondaryIndex& index){
 	using namespace Aws::DynamoDB::Model;
@@ -80,13 +91,13 @@ updateTableWithNewSecondaryIndex(const std::string& tableName, const Aws::Dynamo
 	return request;
 }
 	
-void waitTableReadiness(Aws::DynamoDB::DynamoDBClient& dbClient, const std::string& tableName){
+void waitTableReadiness(StorageEngine& engine, const std::string& tableName){
 	using namespace Aws::DynamoDB::Model;
 	log_info("Waiting for table " << tableName << " to reach active status");
 	DescribeTableOutcome outcome;
 	do{
 		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		outcome=dbClient.DescribeTable(DescribeTableRequest()
+		outcome=engine.describeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() && 
 		   outcome.GetResult().GetTable().GetTableStatus()!=TableStatus::ACTIVE);
@@ -95,7 +106,7 @@ void waitTableReadiness(Aws::DynamoDB::DynamoDBClient& dbClient, const std::stri
 				  "Dynamo error: " << outcome.GetError().GetMessage());
 }
 
-void waitIndexReadiness(Aws::DynamoDB::DynamoDBClient& dbClient, 
+void waitIndexReadiness(StorageEngine& engine, 
                         const std::string& tableName, 
                         const std::string& indexName){
 	using namespace Aws::DynamoDB::Model;
@@ -106,7 +117,7 @@ void waitIndexReadiness(Aws::DynamoDB::DynamoDBClient& dbClient,
 	Aws::Vector<GSID>::iterator index;
 	do{
 		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		outcome=dbClient.DescribeTable(DescribeTableRequest()
+		outcome=engine.describeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() && (
 		   (indices=outcome.GetResult().GetTable().GetGlobalSecondaryIndexes()).empty() ||
@@ -119,7 +130,7 @@ void waitIndexReadiness(Aws::DynamoDB::DynamoDBClient& dbClient,
 	
 
 
-void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient, 
+void waitUntilIndexDeleted(StorageEngine& engine, 
                         const std::string& tableName, 
                         const std::string& indexName){
 	using namespace Aws::DynamoDB::Model;
@@ -130,7 +141,7 @@ void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient,
 	Aws::Vector<GSID>::iterator index;
 	do{
 		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		outcome=dbClient.DescribeTable(DescribeTableRequest()
+		outcome=engine.describeTable(DescribeTableRequest()
 		                               .WithTableName(tableName));
 	}while(outcome.IsSuccess() &&
 		   !(indices=outcome.GetResult().GetTable().GetGlobalSecondaryIndexes()).empty() &&
@@ -144,13 +155,340 @@ void waitUntilIndexDeleted(Aws::DynamoDB::DynamoDBClient& dbClient,
 ///trivial value is not a big concern
 const Aws::DynamoDB::Model::AttributeValue missingString(" ");
 
+using DynamoItem=Aws::Map<Aws::String,Aws::DynamoDB::Model::AttributeValue>;
+
+///Construct a user from a complete user record
+User decodeUser(const DynamoItem& item){
+	User user;
+	user.valid=true;
+	user.unixName=findOrThrow(item,"unixName","user record missing unixName attribute").GetS();
+	user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
+	user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
+	user.phone=findOrDefault(item,"phone",missingString).GetS();
+	user.institution=findOrDefault(item,"institution",missingString).GetS();
+	user.token=findOrThrow(item,"token","user record missing token attribute").GetS();
+	user.globusID=findOrThrow(item,"globusID","user record missing globusID attribute").GetS();
+	user.sshKey=findOrThrow(item,"sshKey","user record missing sshKey attribute").GetS();
+	user.x509DN=findOrDefault(item,"x509DN",missingString).GetS();
+	user.totpSecret=findOrDefault(item,"totpSecret",missingString).GetS();
+	user.joinDate=findOrThrow(item,"joinDate","user record missing joinDate attribute").GetS();
+	user.lastUseTime=findOrThrow(item,"lastUseTime","user record missing lastUseTime attribute").GetS();
+	user.superuser=findOrThrow(item,"superuser","user record missing superuser attribute").GetBool();
+	user.serviceAccount=findOrThrow(item,"serviceAccount","user record missing serviceAccount attribute").GetBool();
+	user.unixID=std::stoul(findOrThrow(item,"unixID","user record missing unixID attribute").GetN());
+	return user;
+}
+
+///The attributes of a user record which make up a UserSummary
+const std::vector<std::string> userSummaryAttributes={
+	"unixName","name","email","phone","institution","joinDate","lastUseTime",
+	"unixID","superuser","serviceAccount"
+};
+
+///Construct a user summary from a user record, which need contain only the 
+///userSummaryAttributes
+UserSummary decodeUserSummary(const DynamoItem& item){
+	UserSummary user;
+	user.valid=true;
+	user.unixName=findOrThrow(item,"unixName","user record missing unixName attribute").GetS();
+	user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
+	user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
+	user.phone=findOrDefault(item,"phone",missingString).GetS();
+	user.institution=findOrDefault(item,"institution",missingString).GetS();
+	user.joinDate=findOrThrow(item,"joinDate","user record missing joinDate attribute").GetS();
+	user.lastUseTime=findOrThrow(item,"lastUseTime","user record missing lastUseTime attribute").GetS();
+	user.superuser=findOrThrow(item,"superuser","user record missing superuser attribute").GetBool();
+	user.serviceAccount=findOrThrow(item,"serviceAccount","user record missing serviceAccount attribute").GetBool();
+	user.unixID=std::stoul(findOrThrow(item,"unixID","user record missing unixID attribute").GetN());
+	return user;
+}
+
+///Restrict a scan or query to reading only some attributes of each item. 
+///Placeholders are used for all of the names, since some (like 'name') are 
+///reserved words. 
+///\param request the request to modify, which may already have other 
+///               expression attribute names
+///\param attributes the names of the attributes to read
+template<typename Request>
+void projectAttributes(Request& request, const std::vector<std::string>& attributes){
+	std::string projection;
+	for(std::size_t i=0; i<attributes.size(); i++){
+		std::string placeholder="#proj"+std::to_string(i);
+		if(i)
+			projection+=", ";
+		projection+=placeholder;
+		request.AddExpressionAttributeNames(placeholder,attributes[i]);
+	}
+	request.SetProjectionExpression(projection);
+}
+
+///Builds an update expression which sets only those attributes of a record 
+///which a request supplied. As with projections, placeholders are used for 
+///all names. 
+class AttributeChanges{
+public:
+	///\param supplied the names of the attributes which the request supplied
+	explicit AttributeChanges(const std::set<std::string>& supplied):supplied(supplied){}
+	///Set an attribute if the request supplied it. Values are not compared 
+	///with cached ones, which may be out of date. 
+	template<typename T>
+	void offer(const std::string& name, const T& value){
+		if(supplied.count(name))
+			set(name,attributeValue(value));
+	}
+	///Set an attribute unconditionally
+	void set(const std::string& name, const Aws::DynamoDB::Model::AttributeValue& value){
+		std::string index=std::to_string(names.size());
+		if(!expression.empty())
+			expression+=", ";
+		expression+="#set"+index+" = :set"+index;
+		names.emplace("#set"+index,name);
+		values.emplace(":set"+index,value);
+		changed.push_back(name);
+	}
+	///\return whether no attribute has changed
+	bool empty() const{ return changed.empty(); }
+	///\return the names of the changed attributes
+	const std::vector<std::string>& attributes() const{ return changed; }
+	///Make a request set the changed attributes, but only if the record 
+	///still exists, so that a record deleted in the meantime is not recreated 
+	///with only these attributes
+	///\param keyName the name of the record's hash key attribute
+	void applyTo(Aws::DynamoDB::Model::UpdateItemRequest& request, const std::string& keyName) const{
+		request.SetUpdateExpression("SET "+expression);
+		request.SetConditionExpression("attribute_exists(#key)");
+		request.AddExpressionAttributeNames("#key",keyName);
+		for(const auto& name : names)
+			request.AddExpressionAttributeNames(name.first,name.second);
+		for(const auto& value : values)
+			request.AddExpressionAttributeValues(value.first,value.second);
+	}
+private:
+	const std::set<std::string>& supplied;
+	std::string expression;
+	std::map<std::string,std::string> names;
+	std::map<std::string,Aws::DynamoDB::Model::AttributeValue> values;
+	std::vector<std::string> changed;
+	
+	static Aws::DynamoDB::Model::AttributeValue attributeValue(const std::string& value){
+		return Aws::DynamoDB::Model::AttributeValue(value);
+	}
+	static Aws::DynamoDB::Model::AttributeValue attributeValue(bool value){
+		return Aws::DynamoDB::Model::AttributeValue().SetBool(value);
+	}
+};
+
+///Construct a membership from a membership record in the users table
+GroupMembership decodeMembership(const DynamoItem& item){
+	GroupMembership membership;
+	membership.valid=true;
+	membership.userName=findOrThrow(item,"unixName","membership record missing unixName attribute").GetS();
+	membership.groupName=findOrThrow(item,"groupName","membership record missing group name attribute").GetS();
+	membership.state=GroupMembership::from_string(findOrThrow(item,"state","membership record missing state attribute").GetS());
+	membership.stateSetBy=findOrThrow(item,"stateSetBy","membership record missing state set by attribute").GetS();
+	return membership;
+}
+
+///Construct a group from a complete group record
+Group decodeGroup(const DynamoItem& item){
+	Group group;
+	group.valid=true;
+	group.name=findOrThrow(item,"name","Group record missing name attribute").GetS();
+	group.displayName=findOrThrow(item,"displayName","Group record missing displayName attribute").GetS();
+	group.email=findOrThrow(item,"email","Group record missing email attribute").GetS();
+	group.phone=findOrThrow(item,"phone","Group record missing phone attribute").GetS();
+	group.purpose=findOrThrow(item,"purpose","Group record missing purpose attribute").GetS();
+	group.description=findOrThrow(item,"description","Group record missing description attribute").GetS();
+	group.creationDate=findOrThrow(item,"creationDate","Group record missing creation date attribute").GetS();
+	group.unixID=std::stoul(findOrThrow(item,"unixID","Group record missing unixID attribute").GetN());
+	return group;
+}
+
+///Construct a group request from a complete group request record
+GroupRequest decodeGroupRequest(const DynamoItem& item){
+	GroupRequest gr;
+	gr.valid=true;
+	gr.name=findOrThrow(item,"name","Group request record missing name attribute").GetS();
+	gr.displayName=findOrThrow(item,"displayName","Group request record missing displayName attribute").GetS();
+	gr.email=findOrThrow(item,"email","Group request record missing email attribute").GetS();
+	gr.phone=findOrThrow(item,"phone","Group request record missing phone attribute").GetS();
+	gr.purpose=findOrThrow(item,"purpose","Group request record missing purpose attribute").GetS();
+	gr.description=findOrThrow(item,"description","Group request record missing description attribute").GetS();
+	gr.requester=findOrThrow(item,"requester","Group request record missing requester attribute").GetS();
+	gr.unixID=std::stoul(findOrThrow(item,"unixID","Group request record missing unixID attribute").GetN());
+	auto extra=findOrThrow(item,"secondaryAttributes","Group Request record missing secondary attributes").GetM();
+	for(const auto& attr : extra){
+		if(attr.first=="dummy")
+			continue;
+		gr.secondaryAttributes[attr.first]=attr.second->GetS();
+	}
+	return gr;
+}
+
 template<typename Cache, typename Key=typename Cache::key_type, typename Value=typename Cache::mapped_type>
 void replaceCacheRecord(Cache& cache, const Key& key, const Value& value){
 	cache.upsert(key,[&value](Value& existing){ existing=value; },value);
 }
 
+template<typename K, typename V, typename Value>
+void replaceCacheRecord(concurrent_multimap<K,V>& cache, const K& key, const Value& value){
+	cache.insert_or_assign(key,value);
+}
+
+///\return the time after which a cached item should be discarded
+template<typename T>
+std::chrono::steady_clock::time_point expirationOf(const CacheRecord<T>& record){
+	return record.expirationTime;
+}
+std::chrono::steady_clock::time_point expirationOf(std::chrono::steady_clock::time_point t){
+	return t;
+}
+
+//These functions determine whether a cache entry has expired and should be 
+//removed. 
+
+template<typename T>
+bool entryExpired(CacheRecord<T>& record, std::chrono::steady_clock::time_point cutoff){
+	return record.expirationTime<cutoff;
+}
+
+bool entryExpired(std::chrono::steady_clock::time_point& expiration, std::chrono::steady_clock::time_point cutoff){
+	return expiration<cutoff;
+}
+
+bool entryExpired(Authorizer::Entry& entry, std::chrono::steady_clock::time_point cutoff){
+	return entry.expiration<cutoff;
+}
+
+///Multimap categories are discarded as a whole once the collection as a whole
+///is no longer valid, since individual records are never used on their own
+template<typename S>
+bool entryExpired(std::pair<S,std::chrono::steady_clock::time_point>& category, std::chrono::steady_clock::time_point cutoff){
+	return category.second<cutoff;
+}
+
+///Erases cache entries for which entryExpired is true
+struct ExpiredEntryEraser{
+	std::chrono::steady_clock::time_point cutoff;
+	bool* erased;
+	template<typename V>
+	bool operator()(V& value) const{
+		*erased=entryExpired(value,cutoff);
+		return *erased;
+	}
+};
+
+///Gather the records of one kind for a cache snapshot: all of those in the 
+///directory if it is complete, and any others which are cached and unexpired
+///\return whether the directory was complete
+template<typename Record>
+bool collectCachedRecords(const versioned_directory<std::string,Record>& directory, 
+                          bounded_cache<std::string,CacheRecord<Record>>& cache, 
+                          std::vector<Record>& records){
+	auto contents=directory.get();
+	bool complete=contents->valid();
+	std::unordered_set<std::string> seen;
+	if(complete){
+		records.reserve(contents->size());
+		contents->for_each([&](const std::string& name, const Record& record){
+			seen.insert(name);
+			records.push_back(record);
+		});
+	}
+	cache.for_each([&](const std::string& name, const CacheRecord<Record>& record){
+		if(record && seen.insert(name).second)
+			records.push_back(record.record);
+	});
+	return complete;
+}
+
+///Gather the unexpired secondary attributes from an attribute cache
+void collectCachedAttributes(bounded_cache<std::string,CacheRecord<std::shared_ptr<const attribute_table>>>& cache, 
+                             std::vector<CacheSnapshot::Attribute>& attributes){
+	cache.for_each([&](const std::string& owner, const CacheRecord<std::shared_ptr<const attribute_table>>& record){
+		if(record && record.record){
+			record.record->for_each([&](const std::string& name, const std::string& value){
+				attributes.emplace_back(owner,name,value);
+			});
+		}
+	});
+}
+
+///Group secondary attributes by their owners
+std::map<std::string,std::vector<attribute_table::value_type>> 
+attributesByOwner(const std::vector<CacheSnapshot::Attribute>& attributes){
+	std::map<std::string,std::vector<attribute_table::value_type>> owners;
+	for(const auto& attribute : attributes)
+		owners[std::get<0>(attribute)].emplace_back(std::get<1>(attribute),std::get<2>(attribute));
+	return owners;
+}
+
+///Install the contents of a complete directory read from a cache snapshot, if
+///the directory is not already complete
+///\return whether the restored records were published
+template<typename Record>
+bool publishRestoredDirectory(versioned_directory<std::string,Record>& directory, 
+                              const std::vector<Record>& records, 
+                              const std::string Record::* name, 
+                              std::chrono::steady_clock::time_point expiration){
+	if(directory.get()->valid())
+		return false;
+	auto rebuild=directory.begin_rebuild();
+	std::vector<std::pair<std::string,Record>> entries;
+	entries.reserve(records.size());
+	for(const auto& record : records)
+		entries.emplace_back(record.*name,record);
+	directory.publish(rebuild,std::move(entries),expiration);
+	return true;
+}
+
+///The maximum number of expired entries the sweeper will examine before 
+///pausing briefly to let other threads have uncontended access to the caches
+const std::size_t expirySweepSliceSize=256;
+
 } //anonymous namespace
 
+std::size_t memory_footprint(const User& user){
+	return sizeof(User)-12*sizeof(std::string)
+	       +memory_footprint(user.unixName)+memory_footprint(user.name)
+	       +memory_footprint(user.email)+memory_footprint(user.phone)
+	       +memory_footprint(user.institution)+memory_footprint(user.token)
+	       +memory_footprint(user.globusID)+memory_footprint(user.sshKey)
+	       +memory_footprint(user.x509DN)+memory_footprint(user.totpSecret)
+	       +memory_footprint(user.joinDate)+memory_footprint(user.lastUseTime);
+}
+
+std::size_t memory_footprint(const Group& group){
+	return sizeof(Group)-7*sizeof(std::string)
+	       +memory_footprint(group.name)+memory_footprint(group.displayName)
+	       +memory_footprint(group.email)+memory_footprint(group.phone)
+	       +memory_footprint(group.purpose)+memory_footprint(group.description)
+	       +memory_footprint(group.creationDate);
+}
+
+std::size_t memory_footprint(const GroupRequest& gr){
+	return sizeof(GroupRequest)-7*sizeof(std::string)
+	       -sizeof(std::map<std::string,std::string>)
+	       +memory_footprint(gr.name)+memory_footprint(gr.displayName)
+	       +memory_footprint(gr.email)+memory_footprint(gr.phone)
+	       +memory_footprint(gr.purpose)+memory_footprint(gr.description)
+	       +memory_footprint(gr.requester)+memory_footprint(gr.secondaryAttributes);
+}
+
+std::size_t memory_footprint(const GroupMembership& membership){
+	return sizeof(GroupMembership)-3*sizeof(std::string)
+	       +memory_footprint(membership.userName)+memory_footprint(membership.groupName)
+	       +memory_footprint(membership.stateSetBy);
+}
+
+///This counts the answers remembered in the closure when it is cached, but 
+///not those added later
+std::size_t memory_footprint(const PersistentStore::AdminClosure& closure){
+	return sizeof(closure)-sizeof(closure.administered)
+	       +memory_footprint(closure.administered)
+	       +closure.enclosing.size()*2*sizeof(std::string);
+}
+
 EmailClient::EmailClient(const std::string& mailgunEndpoint, 
                          const std::string& mailgunKey, 
                          const std::string& emailDomain):
@@ -190,26 +528,525 @@ const unsigned int PersistentStore::maximumUserID=1u<<17;
 const unsigned int PersistentStore::minimumGroupID=5000;
 const unsigned int PersistentStore::maximumGroupID=1u<<17;
 const std::string PersistentStore::nextIDKeyName="!_NextUnixID";
+const unsigned int PersistentStore::bulkThreads=8;
+const std::size_t PersistentStore::batchGetLimit=100;
+const unsigned int PersistentStore::batchRetryLimit=8;
 
-PersistentStore::PersistentStore(const Aws::Auth::AWSCredentials& credentials, 
-                                 const Aws::Client::ClientConfiguration& clientConfig,
+PersistentStore::PersistentStore(std::shared_ptr<StorageEngine> engine,
                                  std::string bootstrapUserFile, EmailClient emailClient):
-	dbClient(credentials,clientConfig),
+	engine(std::move(engine)),
 	userTableName("CONNECT_users"),
 	groupTableName("CONNECT_groups"),
+	userIDCounter(*this,userTableName,"unixName",minimumUserID,maximumUserID),
+	groupIDCounter(*this,groupTableName,"name",minimumGroupID,maximumGroupID),
+	userIDAllocator(userIDCounter,16),groupIDAllocator(groupIDCounter,16),
 	emailClient(emailClient),
 	userCacheValidity(std::chrono::minutes(60)),
-	userCacheExpirationTime(std::chrono::steady_clock::now()),
+	tokenIndexActive(false),
+	nextTokenIndexCheck(std::chrono::steady_clock::time_point::min()),
+	negativeCacheValidity(std::chrono::seconds(30)),
+	knownUserFilterExpiration(std::chrono::steady_clock::time_point::min()),
+	knownUserFilterRebuilding(false),
+	adminClosureGeneration(0),
+	authorizer(*this),
 	groupCacheValidity(std::chrono::minutes(60)),
-	groupCacheExpirationTime(std::chrono::steady_clock::now()),
-	groupRequestCacheExpirationTime(std::chrono::steady_clock::now()),
-	cacheHits(0),databaseQueries(0),databaseScans(0)
+	pendingAsyncRequests(0),
+	prewarmSegments(0),prewarmSegmentsDone(0),prewarmedItems(0),
+	prewarmMilliseconds(-1),prewarmFailed(false),
+	refreshAheadWindow(std::chrono::minutes(5)),
+	staleGracePeriod(std::chrono::seconds(30)),
+	backgroundRefreshes(0),staleHits(0),
+	expiryWheel(std::chrono::seconds(1)),
+	stopMaintenance(false),
+	sweptEntries(0),
+	appliedChanges(0),
+	restoredRecords(0),savedSnapshots(0),
+	lastUseFlushInterval(std::chrono::seconds(10)),
+	recordedLastUses(0),writtenLastUses(0),
+	scanSegments(4),bulkPool(bulkThreads),
+	cacheHits(0),databaseQueries(0),databaseScans(0),
+	negativeCacheHits(0),
+	backgroundPool(4)
 {
-	log_info("Starting database client");
+	cacheHandles={
+		makeCacheHandle("user",15,userCache),
+		makeCacheHandle("userByToken",10,userByTokenCache),
+		makeCacheHandle("userByGlobusID",10,userByGlobusIDCache),
+		makeCacheHandle("userNegative",5,userNegativeCache),
+		makeCacheHandle("userAttribute",5,userAttributeCache),
+		makeCacheHandle("groupMembership",15,groupMembershipCache),
+		makeCacheHandle("groupMembershipByUser",10,groupMembershipByUserCache),
+		makeCacheHandle("groupMembershipByGroup",5,groupMembershipByGroupCache),
+		makeCacheHandle("groupAttribute",5,groupAttributeCache),
+		makeCacheHandle("group",5,groupCache),
+		makeCacheHandle("groupRequest",5,groupRequestCache),
+		makeCacheHandle("adminClosure",5,adminClosureCache),
+		makeCacheHandle("authorization",5,authorizer.decisionCache()),
+	};
+	groupDirectory.observe(&groupTree);
+	groupRequestDirectory.observe(&groupRequestTree);
+	log_info("Starting database client: " << this->engine->describe());
 	InitializeTables(bootstrapUserFile);
+	expirySweeper=std::thread(&PersistentStore::runExpirySweeper,this);
+	lastUseWriter=std::thread(&PersistentStore::runLastUseWriter,this);
 	log_info("Database client ready");
 }
 
+PersistentStore::~PersistentStore(){
+	{
+		std::lock_guard<std::mutex> lock(maintenanceMutex);
+		stopMaintenance=true;
+	}
+	maintenanceWakeup.notify_all();
+	if(expirySweeper.joinable())
+		expirySweeper.join();
+	if(changeFeedReader.joinable())
+		changeFeedReader.join();
+	if(cacheSnapshotWriter.joinable())
+		cacheSnapshotWriter.join();
+	if(lastUseWriter.joinable())
+		lastUseWriter.join();
+	flushLastUseTimes();
+	if(!cacheSnapshotPath.empty())
+		saveCacheSnapshot();
+	//give back unused IDs now, while everything the counters use still exists
+	userIDAllocator.returnUnused();
+	groupIDAllocator.returnUnused();
+	//asynchronous request handlers use the caches, so they must finish first
+	std::unique_lock<std::mutex> lock(asyncMutex);
+	asyncDone.wait(lock,[this]{ return pendingAsyncRequests==0; });
+}
+
+template<typename Result, typename Finish>
+std::future<Result> PersistentStore::getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, Finish finish){
+	auto promise=std::make_shared<std::promise<Result>>();
+	{
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		pendingAsyncRequests++;
+	}
+	databaseQueries++;
+	engine->getItemAsync(request,
+		[this,promise,finish](const Aws::DynamoDB::Model::GetItemOutcome& outcome){
+			try{
+				promise->set_value(finish(outcome));
+			}catch(...){
+				promise->set_exception(std::current_exception());
+			}
+			std::lock_guard<std::mutex> lock(asyncMutex);
+			if(--pendingAsyncRequests==0)
+				asyncDone.notify_all();
+		});
+	return promise->get_future();
+}
+
+Aws::DynamoDB::Model::GetItemOutcome PersistentStore::getItem(const Aws::DynamoDB::Model::GetItemRequest& request){
+	return engine->getItem(request);
+}
+
+Aws::DynamoDB::Model::BatchGetItemOutcome PersistentStore::batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request){
+	return engine->batchGetItem(request);
+}
+
+Aws::DynamoDB::Model::QueryOutcome PersistentStore::query(const Aws::DynamoDB::Model::QueryRequest& request){
+	return engine->query(request);
+}
+
+Aws::DynamoDB::Model::PutItemOutcome PersistentStore::putItem(const Aws::DynamoDB::Model::PutItemRequest& request){
+	return engine->putItem(request);
+}
+
+Aws::DynamoDB::Model::UpdateItemOutcome PersistentStore::updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request){
+	return engine->updateItem(request);
+}
+
+Aws::DynamoDB::Model::DeleteItemOutcome PersistentStore::deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request){
+	return engine->deleteItem(request);
+}
+
+Aws::DynamoDB::Model::TransactWriteItemsOutcome PersistentStore::transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request){
+	return engine->transactWriteItems(request);
+}
+
+namespace{
+template<typename T>
+std::future<T> readyFuture(T value){
+	std::promise<T> promise;
+	promise.set_value(std::move(value));
+	return promise.get_future();
+}
+}
+
+void PersistentStore::runExpirySweeper(){
+	std::vector<ExpiryItem> due;
+	std::unique_lock<std::mutex> lock(maintenanceMutex);
+	while(!stopMaintenance){
+		lock.unlock();
+		std::size_t remaining;
+		do{
+			due.clear();
+			auto now=std::chrono::steady_clock::now();
+			remaining=expiryWheel.advance(now,due,expirySweepSliceSize);
+			//records within the grace period may still be served
+			auto cutoff=now-staleGracePeriod.load();
+			for(const auto& item : due){
+				if(cacheHandles[item.first].sweep(item.second,cutoff))
+					sweptEntries++;
+			}
+			if(remaining)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}while(remaining && !stopMaintenance);
+		lock.lock();
+		maintenanceWakeup.wait_for(lock,std::chrono::seconds(1),[this]{ return stopMaintenance; });
+	}
+}
+
+template<typename Cache>
+void PersistentStore::scheduleExpiry(const Cache& cache, const std::string& key, 
+                                     std::chrono::steady_clock::time_point expiration){
+	for(std::size_t i=0; i<cacheHandles.size(); i++){
+		if(cacheHandles[i].address==&cache){
+			expiryWheel.schedule(ExpiryItem(i,key),expiration+staleGracePeriod.load());
+			return;
+		}
+	}
+}
+
+bool PersistentStore::useCachedRecord(std::chrono::steady_clock::time_point expiration, 
+                                      const std::string& refreshKey, std::function<void()> reload){
+	auto now=std::chrono::steady_clock::now();
+	bool fresh=(now<=expiration);
+	if(fresh && now+refreshAheadWindow.load()<expiration)
+		return true; //no need to do anything yet
+	if(!fresh && now>expiration+staleGracePeriod.load())
+		return false; //too old to use at all
+	//The record is about to expire or has just done so. Start reloading it, 
+	//unless another request already has, and use the current copy meanwhile.
+	if(refreshesInFlight.insert(refreshKey,true)){
+		try{
+			backgroundPool.enqueue([this,refreshKey,reload]{
+				try{
+					reload();
+				}catch(std::exception& ex){
+					log_error("Background refresh of " << refreshKey << " failed: " << ex.what());
+				}
+				refreshesInFlight.erase(refreshKey);
+			});
+			backgroundRefreshes++;
+		}catch(std::runtime_error& ex){
+			//the pool is shutting down
+			refreshesInFlight.erase(refreshKey);
+			return fresh;
+		}
+	}
+	if(!fresh)
+		staleHits++;
+	return true;
+}
+
+template<typename Cache, typename Value>
+void PersistentStore::cacheRecord(Cache& cache, const std::string& key, const Value& value){
+	replaceCacheRecord(cache,key,value);
+	scheduleExpiry(cache,key,expirationOf(value));
+}
+
+void PersistentStore::setChangeFeed(std::shared_ptr<ChangeFeed> feed, std::chrono::milliseconds pollInterval){
+	if(changeFeed)
+		throw std::logic_error("A change feed has already been set");
+	changeFeed=std::move(feed);
+	changeFeedReader=std::thread(&PersistentStore::runChangeFeedReader,this,pollInterval);
+}
+
+void PersistentStore::announceChange(ChangeEvent::Kind kind, const std::string& subject, const std::string& detail){
+	if(!changeFeed)
+		return;
+	//Failure to publish cannot be undone, since the change has already been 
+	//made; other instances will have to rely on their cache entries expiring.
+	try{
+		changeFeed->publish(ChangeEvent(kind,subject,detail));
+	}catch(std::exception& ex){
+		log_error("Failed to publish change to " << subject << ": " << ex.what());
+	}
+}
+
+void PersistentStore::runChangeFeedReader(std::chrono::milliseconds pollInterval){
+	std::unique_lock<std::mutex> lock(maintenanceMutex);
+	while(!stopMaintenance){
+		lock.unlock();
+		try{
+			for(const auto& event : changeFeed->poll()){
+				applyChange(event);
+				appliedChanges++;
+			}
+		}catch(std::exception& ex){
+			log_error("Failed to apply changes from other instances: " << ex.what());
+		}
+		lock.lock();
+		maintenanceWakeup.wait_for(lock,pollInterval,[this]{ return stopMaintenance; });
+	}
+}
+
+void PersistentStore::applyChange(const ChangeEvent& event){
+	const std::string& subject=event.subject;
+	switch(event.kind){
+		case ChangeEvent::UserChanged:
+		{
+			//the token and Globus ID may have changed, so the old ones must be 
+			//found from the cached record
+			CacheRecord<User> record;
+			if(userCache.find(subject,record)){
+				userByTokenCache.erase(record.record.token);
+				userByGlobusIDCache.erase(record.record.globusID);
+			}
+			forgetIndexedToken(subject);
+			userCache.erase(subject);
+			groupMembershipByUserCache.erase(subject);
+			invalidateAuthorization(subject);
+			userNegativeCache.erase(knownUserKey("user",subject));
+			//The user directory must either be updated or lose the user, and a 
+			//new user must be added to the known user filter, so reload the 
+			//record. This is done in the background to keep up with the feed. 
+			backgroundPool.enqueue([this,subject]{
+				User user=userLoads.run("user:"+subject,[&]{ return loadUser(subject); });
+				if(user)
+					recordUserPresent(user);
+				else
+					userDirectory.erase(subject);
+			});
+			break;
+		}
+		case ChangeEvent::MembershipChanged:
+			groupMembershipCache.erase(subject+":"+event.detail);
+			groupMembershipByUserCache.erase(subject);
+			groupMembershipByGroupCache.erase(event.detail);
+			invalidateAuthorization(subject);
+			break;
+		case ChangeEvent::UserAttributeChanged:
+			userAttributeCache.erase(subject);
+			break;
+		case ChangeEvent::GroupChanged:
+			groupCache.erase(subject);
+			groupRequestCache.erase(subject);
+			//As for users, reloading keeps the directories current. Loading a 
+			//group which is now pending or a request which is now approved does 
+			//not remove it from the other directory, so that must be done here.
+			backgroundPool.enqueue([this,subject]{
+				Group group=getGroup(subject);
+				if(!group || group.pending)
+					groupDirectory.erase(subject);
+				GroupRequest request=getGroupRequest(subject);
+				if(!request)
+					groupRequestDirectory.erase(subject);
+			});
+			break;
+		case ChangeEvent::GroupAttributeChanged:
+			groupAttributeCache.erase(subject);
+			break;
+	}
+}
+
+void PersistentStore::enableCacheSnapshots(const std::string& path, std::chrono::seconds interval){
+	if(!cacheSnapshotPath.empty())
+		throw std::logic_error("Cache snapshots have already been enabled");
+	cacheSnapshotPath=path;
+	if(access(path.c_str(),F_OK)==0){
+		try{
+			auto start=std::chrono::steady_clock::now();
+			CacheSnapshot snapshot=readCacheSnapshot(path);
+			std::size_t used=restoreCacheSnapshot(snapshot);
+			restoredRecords+=used;
+			log_info("Restored " << used << " of " << snapshot.size() << " cached records from " 
+			         << path << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count() << " ms");
+		}catch(std::exception& ex){
+			//the snapshot is only an optimization, so carry on without it
+			log_warn("Unable to load cache snapshot: " << ex.what());
+		}
+	}
+	if(interval.count())
+		cacheSnapshotWriter=std::thread(&PersistentStore::runCacheSnapshotWriter,this,interval);
+}
+
+bool PersistentStore::saveCacheSnapshot(){
+	if(cacheSnapshotPath.empty())
+		return false;
+	std::lock_guard<std::mutex> lock(cacheSnapshotMutex);
+	try{
+		CacheSnapshot snapshot=collectCacheSnapshot();
+		writeCacheSnapshot(cacheSnapshotPath,snapshot);
+		savedSnapshots++;
+		log_info("Saved " << snapshot.size() << " cached records to " << cacheSnapshotPath);
+	}catch(std::exception& ex){
+		log_error("Failed to save cache snapshot: " << ex.what());
+		return false;
+	}
+	return true;
+}
+
+void PersistentStore::runLastUseWriter(){
+	std::unique_lock<std::mutex> lock(maintenanceMutex);
+	while(!stopMaintenance){
+		maintenanceWakeup.wait_for(lock,lastUseFlushInterval.load(),[this]{ return stopMaintenance; });
+		//the final write is made by the destructor
+		if(stopMaintenance)
+			break;
+		lock.unlock();
+		flushLastUseTimes();
+		lock.lock();
+	}
+}
+
+void PersistentStore::runCacheSnapshotWriter(std::chrono::seconds interval){
+	std::unique_lock<std::mutex> lock(maintenanceMutex);
+	while(!stopMaintenance){
+		maintenanceWakeup.wait_for(lock,interval,[this]{ return stopMaintenance; });
+		//the final snapshot is written by the destructor
+		if(stopMaintenance)
+			break;
+		lock.unlock();
+		saveCacheSnapshot();
+		lock.lock();
+	}
+}
+
+CacheSnapshot PersistentStore::collectCacheSnapshot(){
+	CacheSnapshot snapshot;
+	//The user directory holds only summaries, so full records can only come 
+	//from the cache
+	{
+		auto users=userDirectory.get();
+		snapshot.usersComplete=users->valid();
+		if(snapshot.usersComplete)
+			snapshot.userSummaries=users->values();
+		userCache.for_each([&](const std::string&, const CacheRecord<User>& record){
+			if(record)
+				snapshot.users.push_back(record.record);
+		});
+	}
+	snapshot.groupsComplete=collectCachedRecords(groupDirectory,groupCache,snapshot.groups);
+	snapshot.groupRequestsComplete=collectCachedRecords(groupRequestDirectory,groupRequestCache,snapshot.groupRequests);
+	
+	//Memberships are gathered from all three caches, since the lists may 
+	//contain records which have been evicted from the individual cache
+	std::map<std::string,GroupMembership> memberships;
+	groupMembershipCache.for_each([&](const std::string& key, const CacheRecord<GroupMembership>& record){
+		if(record)
+			memberships.emplace(key,record.record);
+	});
+	auto now=std::chrono::steady_clock::now();
+	using MembershipList=concurrent_multimap<std::string,CacheRecord<GroupMembership>>::category_type;
+	auto collectList=[&](std::vector<std::string>& complete){
+		return [&,now](const std::string& key, const MembershipList& list){
+			if(list.second<=now)
+				return;
+			complete.push_back(key);
+			for(const auto& record : list.first)
+				memberships.emplace(record.record.userName+":"+record.record.groupName,record.record);
+		};
+	};
+	groupMembershipByUserCache.for_each(collectList(snapshot.completeUserMemberships));
+	groupMembershipByGroupCache.for_each(collectList(snapshot.completeGroupMemberships));
+	snapshot.memberships.reserve(memberships.size());
+	for(auto& membership : memberships)
+		snapshot.memberships.push_back(std::move(membership.second));
+	
+	collectCachedAttributes(userAttributeCache,snapshot.userAttributes);
+	collectCachedAttributes(groupAttributeCache,snapshot.groupAttributes);
+	return snapshot;
+}
+
+std::size_t PersistentStore::restoreCacheSnapshot(const CacheSnapshot& snapshot){
+	//Restored records are treated as being on the verge of expiring, so that 
+	//they are served but reloaded in the background on first use. Records 
+	//which are not used before they expire are simply dropped. 
+	auto expiration=std::chrono::steady_clock::now()
+	                +std::max(refreshAheadWindow.load(),std::chrono::seconds(60));
+	std::size_t used=0;
+	
+	for(const auto& user : snapshot.users){
+		CacheRecord<User> record(user,expiration);
+		if(!userCache.insert(user.unixName,record))
+			continue; //already loaded, and probably newer
+		scheduleExpiry(userCache,user.unixName,expiration);
+		if(userByTokenCache.insert(user.token,record))
+			scheduleExpiry(userByTokenCache,user.token,expiration);
+		if(userByGlobusIDCache.insert(user.globusID,record))
+			scheduleExpiry(userByGlobusIDCache,user.globusID,expiration);
+		used++;
+	}
+	for(const auto& group : snapshot.groups){
+		if(groupCache.insert(group.name,CacheRecord<Group>(group,expiration))){
+			scheduleExpiry(groupCache,group.name,expiration);
+			used++;
+		}
+	}
+	for(const auto& request : snapshot.groupRequests){
+		if(groupRequestCache.insert(request.name,CacheRecord<GroupRequest>(request,expiration))){
+			scheduleExpiry(groupRequestCache,request.name,expiration);
+			used++;
+		}
+	}
+	
+	//A complete directory may be used for listings until it can be reloaded, 
+	//unless a newer one has already been built
+	if(snapshot.usersComplete && publishRestoredDirectory(userDirectory,snapshot.userSummaries,&UserSummary::unixName,expiration))
+		backgroundPool.enqueue([this]{ userScans.run("",[this]{ return scanUsers(); }); });
+	if(snapshot.groupsComplete && publishRestoredDirectory(groupDirectory,snapshot.groups,&Group::name,expiration))
+		backgroundPool.enqueue([this]{ groupScans.run("",[this]{ return scanGroups(); }); });
+	if(snapshot.groupRequestsComplete && publishRestoredDirectory(groupRequestDirectory,snapshot.groupRequests,&GroupRequest::name,expiration))
+		backgroundPool.enqueue([this]{ groupRequestScans.run("",[this]{ return scanGroupRequests(); }); });
+	
+	std::set<std::string> completeUsers(snapshot.completeUserMemberships.begin(),snapshot.completeUserMemberships.end());
+	std::set<std::string> completeGroups(snapshot.completeGroupMemberships.begin(),snapshot.completeGroupMemberships.end());
+	//lists which were already cached must not be extended with old records
+	std::set<std::string> skipUsers, skipGroups;
+	for(const auto& name : completeUsers){
+		if(groupMembershipByUserCache.contains(name))
+			skipUsers.insert(name);
+	}
+	for(const auto& name : completeGroups){
+		if(groupMembershipByGroupCache.contains(name))
+			skipGroups.insert(name);
+	}
+	for(const auto& membership : snapshot.memberships){
+		CacheRecord<GroupMembership> record(membership,expiration);
+		const std::string key=membership.userName+":"+membership.groupName;
+		if(groupMembershipCache.insert(key,record)){
+			scheduleExpiry(groupMembershipCache,key,expiration);
+			used++;
+		}
+		if(completeUsers.count(membership.userName) && !skipUsers.count(membership.userName))
+			groupMembershipByUserCache.insert(membership.userName,record);
+		if(completeGroups.count(membership.groupName) && !skipGroups.count(membership.groupName))
+			groupMembershipByGroupCache.insert(membership.groupName,record);
+	}
+	//only now that they have all their members can the lists be marked valid
+	for(const auto& name : completeUsers){
+		if(!skipUsers.count(name) && groupMembershipByUserCache.update_expiration(name,expiration))
+			scheduleExpiry(groupMembershipByUserCache,name,expiration);
+	}
+	for(const auto& name : completeGroups){
+		if(!skipGroups.count(name) && groupMembershipByGroupCache.update_expiration(name,expiration))
+			scheduleExpiry(groupMembershipByGroupCache,name,expiration);
+	}
+	
+	//Each entity's attributes were saved together, so the sets are complete
+	for(auto& owner : attributesByOwner(snapshot.userAttributes)){
+		std::size_t count=owner.second.size();
+		if(userAttributeCache.insert(owner.first,AttributeRecord(std::make_shared<const attribute_table>(std::move(owner.second)),expiration))){
+			scheduleExpiry(userAttributeCache,owner.first,expiration);
+			used+=count;
+		}
+	}
+	for(auto& owner : attributesByOwner(snapshot.groupAttributes)){
+		std::size_t count=owner.second.size();
+		if(groupAttributeCache.insert(owner.first,AttributeRecord(std::make_shared<const attribute_table>(std::move(owner.second)),expiration))){
+			scheduleExpiry(groupAttributeCache,owner.first,expiration);
+			used+=count;
+		}
+	}
+	
+	return used;
+}
+
 void PersistentStore::InitializeUserTable(){
 	using namespace Aws::DynamoDB::Model;
 	using AttDef=Aws::DynamoDB::Model::AttributeDefinition;
@@ -231,6 +1068,24 @@ void PersistentStore::InitializeUserTable(){
 		                                  .WithReadCapacityUnits(1)
 		                                  .WithWriteCapacityUnits(1));
 	};
+	//The ByTokenAuth index carries everything needed to authenticate a user 
+	//and to make authorization decisions, so that a token can be resolved in 
+	//a single query (see loadUserByToken). Frequently changing attributes 
+	//like lastUseTime are left out, since every change to a projected 
+	//attribute is also a write to the index. 
+	auto getByTokenAuthIndex=[](){
+		return GlobalSecondaryIndex()
+		       .WithIndexName("ByTokenAuth")
+		       .WithKeySchema({KeySchemaElement()
+		                       .WithAttributeName("token")
+		                       .WithKeyType(KeyType::HASH)})
+		       .WithProjection(Projection()
+		                       .WithProjectionType(ProjectionType::INCLUDE)
+		                       .WithNonKeyAttributes({"unixName","name","email","phone","superuser","serviceAccount"}))
+		       .WithProvisionedThroughput(ProvisionedThroughput()
+		                                  .WithReadCapacityUnits(1)
+		                                  .WithWriteCapacityUnits(1));
+	};
 	auto getByGlobusIDIndex=[](){
 		return GlobalSecondaryIndex()
 		       .WithIndexName("ByGlobusID")
@@ -271,7 +1126,7 @@ void PersistentStore::InitializeUserTable(){
 	};
 	
 	//check status of the table
-	auto userTableOut=dbClient.DescribeTable(DescribeTableRequest()
+	auto userTableOut=engine->describeTable(DescribeTableRequest()
 	                                         .WithTableName(userTableName));
 	if(!userTableOut.IsSuccess() &&
 	   userTableOut.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::RESOURCE_NOT_FOUND){
@@ -298,15 +1153,17 @@ void PersistentStore::InitializeUserTable(){
 		                                 .WithReadCapacityUnits(1)
 		                                 .WithWriteCapacityUnits(1));
 		request.AddGlobalSecondaryIndexes(getByTokenIndex());
+		request.AddGlobalSecondaryIndexes(getByTokenAuthIndex());
 		request.AddGlobalSecondaryIndexes(getByGlobusIDIndex());
 		request.AddGlobalSecondaryIndexes(getByGroupIndex());
 		request.AddGlobalSecondaryIndexes(getByUnixIDIndex());
 		
-		auto createOut=dbClient.CreateTable(request);
+		auto createOut=engine->createTable(request);
 		if(!createOut.IsSuccess())
 			log_fatal("Failed to create user table: " + createOut.GetError().GetMessage());
 		
-		waitTableReadiness(dbClient,userTableName);
+		waitTableReadiness(*engine,userTableName);
+		tokenIndexActive=true;
 		
 		{
 			//Set the initial unixID
@@ -319,7 +1176,7 @@ void PersistentStore::InitializeUserTable(){
 					{"sortKey",AttributeValue(nextIDKeyName)},
 					{"next_unixID",AttributeValue().SetN(std::to_string(minimumUserID))}
 				});
-				auto outcome=dbClient.PutItem(request);
+				auto outcome=putItem(request);
 				if(!outcome.IsSuccess()){
 					auto err=outcome.GetError();
 					log_fatal("Failed to set initial user ID record: " << err.GetMessage());
@@ -334,7 +1191,7 @@ void PersistentStore::InitializeUserTable(){
 				log_error("Failed to inject root user; deleting users table");
 				//Demolish the whole table again. This is technically overkill, but it ensures that
 				//on the next start up this step will be run again (hpefully with better results).
-				auto outc=dbClient.DeleteTable(Aws::DynamoDB::Model::DeleteTableRequest().WithTableName(userTableName));
+				auto outc=engine->deleteTable(Aws::DynamoDB::Model::DeleteTableRequest().WithTableName(userTableName));
 				//If the table deletion fails it is still possible to get stuck on a restart, but 
 				//it isn't clear what else could be done about such a failure. 
 				if(!outc.IsSuccess())
@@ -352,7 +1209,7 @@ void PersistentStore::InitializeUserTable(){
 		
 		//if an index was deleted, update the table description so we know to recreate it
 		if(changed){
-			userTableOut=dbClient.DescribeTable(DescribeTableRequest()
+			userTableOut=engine->describeTable(DescribeTableRequest()
 			                                  .WithTableName(userTableName));
 			tableDesc=userTableOut.GetResult().GetTable();
 		}
@@ -360,37 +1217,55 @@ void PersistentStore::InitializeUserTable(){
 		if(!hasIndex(tableDesc,"ByToken")){
 			auto request=updateTableWithNewSecondaryIndex(userTableName,getByTokenIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("token").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-token index to user table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,userTableName,"ByToken");
+			waitIndexReadiness(*engine,userTableName,"ByToken");
 			log_info("Added by-token index to user table");
 		}
+		//Older versions have only the ByToken index, which they continue to 
+		//use while a newer version is rolled out, so ByTokenAuth is added 
+		//alongside it. Building the index may take a long time on a large 
+		//table, so it is not waited for; tokens are looked up using ByToken 
+		//until it is active (see checkTokenIndexStatus). 
+		if(!hasIndex(tableDesc,"ByTokenAuth")){
+			auto request=updateTableWithNewSecondaryIndex(userTableName,getByTokenAuthIndex());
+			request.WithAttributeDefinitions({AttDef().WithAttributeName("token").WithAttributeType(SAT::S)});
+			auto createOut=engine->updateTable(request);
+			//another server may have begun creating the index at the same time, 
+			//and either way ByToken remains usable
+			if(!createOut.IsSuccess())
+				log_error("Failed to add by-token authentication index to user table: " + createOut.GetError().GetMessage());
+			else
+				log_info("Adding by-token authentication index to user table");
+		}
+		else
+			tokenIndexActive=indexIsActive(tableDesc,"ByTokenAuth");
 		if(!hasIndex(tableDesc,"ByGlobusID")){
 			auto request=updateTableWithNewSecondaryIndex(userTableName,getByGlobusIDIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("globusID").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-GlobusID index to user table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,userTableName,"ByGlobusID");
+			waitIndexReadiness(*engine,userTableName,"ByGlobusID");
 			log_info("Added by-GlobusID index to user table");
 		}
 		if(!hasIndex(tableDesc,"ByGroup")){
 			auto request=updateTableWithNewSecondaryIndex(userTableName,getByGroupIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("groupName").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-Group index to user table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,userTableName,"ByGroup");
+			waitIndexReadiness(*engine,userTableName,"ByGroup");
 			log_info("Added by-Group index to user table");
 		}
 		if(!hasIndex(tableDesc,"ByUnixID")){
 			auto request=updateTableWithNewSecondaryIndex(userTableName,getByUnixIDIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("unixID").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-UnixID index to user table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,userTableName,"ByUnixID");
+			waitIndexReadiness(*engine,userTableName,"ByUnixID");
 			log_info("Added by-UnixID index to user table");
 		}
 	}
@@ -428,7 +1303,7 @@ void PersistentStore::InitializeGroupTable(){
 	};
 	
 	//check status of the table
-	auto groupTableOut=dbClient.DescribeTable(DescribeTableRequest()
+	auto groupTableOut=engine->describeTable(DescribeTableRequest()
 											 .WithTableName(groupTableName));
 	if(!groupTableOut.IsSuccess() &&
 	   groupTableOut.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::RESOURCE_NOT_FOUND){
@@ -455,11 +1330,11 @@ void PersistentStore::InitializeGroupTable(){
 		request.AddGlobalSecondaryIndexes(getByUnixIDIndex());
 		request.AddGlobalSecondaryIndexes(getByRequesterIndex());
 		
-		auto createOut=dbClient.CreateTable(request);
+		auto createOut=engine->createTable(request);
 		if(!createOut.IsSuccess())
 			log_fatal("Failed to create groups table: " + createOut.GetError().GetMessage());
 		
-		waitTableReadiness(dbClient,groupTableName);
+		waitTableReadiness(*engine,groupTableName);
 		
 		{
 			//Set the initial unixID
@@ -472,7 +1347,7 @@ void PersistentStore::InitializeGroupTable(){
 					{"sortKey",AttributeValue(nextIDKeyName)},
 					{"next_unixID",AttributeValue().SetN(std::to_string(minimumGroupID))}
 				});
-				auto outcome=dbClient.PutItem(request);
+				auto outcome=putItem(request);
 				if(!outcome.IsSuccess()){
 					auto err=outcome.GetError();
 					log_fatal("Failed to set initial group ID record: " << err.GetMessage());
@@ -505,7 +1380,7 @@ void PersistentStore::InitializeGroupTable(){
 				log_error("Failed to inject root group; deleting group table");
 				//Demolish the whole table again. This is technically overkill, but it ensures that
 				//on the next start up this step will be run again (hpefully with better results).
-				auto outc=dbClient.DeleteTable(Aws::DynamoDB::Model::DeleteTableRequest().WithTableName(groupTableName));
+				auto outc=engine->deleteTable(Aws::DynamoDB::Model::DeleteTableRequest().WithTableName(groupTableName));
 				//If the table deletion fails it is still possible to get stuck on a restart, but 
 				//it isn't clear what else could be done about such a failure. 
 				if(!outc.IsSuccess())
@@ -523,7 +1398,7 @@ void PersistentStore::InitializeGroupTable(){
 		
 		//if an index was deleted, update the table description so we know to recreate it
 		if(changed){
-			groupTableOut=dbClient.DescribeTable(DescribeTableRequest()
+			groupTableOut=engine->describeTable(DescribeTableRequest()
 			                                  .WithTableName(groupTableName));
 			tableDesc=groupTableOut.GetResult().GetTable();
 		}
@@ -532,19 +1407,19 @@ void PersistentStore::InitializeGroupTable(){
 		if(!hasIndex(tableDesc,"ByUnixID")){
 			auto request=updateTableWithNewSecondaryIndex(groupTableName,getByUnixIDIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("unixID").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-UnixID index to group table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,groupTableName,"ByUnixID");
+			waitIndexReadiness(*engine,groupTableName,"ByUnixID");
 			log_info("Added by-UnixID index to group table");
 		}
 		if(!hasIndex(tableDesc,"ByRequester")){
 			auto request=updateTableWithNewSecondaryIndex(groupTableName,getByUnixIDIndex());
 			request.WithAttributeDefinitions({AttDef().WithAttributeName("requester").WithAttributeType(SAT::S)});
-			auto createOut=dbClient.UpdateTable(request);
+			auto createOut=engine->updateTable(request);
 			if(!createOut.IsSuccess())
 				log_fatal("Failed to add by-Requester index to group table: " + createOut.GetError().GetMessage());
-			waitIndexReadiness(dbClient,groupTableName,"ByRequester");
+			waitIndexReadiness(*engine,groupTableName,"ByRequester");
 			log_info("Added by-Requester index to group table");
 		}
 	}
@@ -582,7 +1457,7 @@ unsigned int PersistentStore::getNextIDHint(const std::string& tableName,
                                             const std::string& nameKeyName){
 	databaseQueries++;
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	auto outcome=getItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(tableName)
 								  .WithKey({{nameKeyName,AttributeValue(nextIDKeyName)},
 											{"sortKey",AttributeValue(nextIDKeyName)}}));
@@ -611,7 +1486,7 @@ bool PersistentStore::checkIDAvailability(const std::string& tableName,
 		.WithExpressionAttributeValues({
 			{":id_val",AttributeValue().SetN(std::to_string(id))}
 		});
-	auto outcome=dbClient.Query(request);
+	auto outcome=query(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_fatal("Failed to fetch unix ID record: " << err.GetMessage());
@@ -657,7 +1532,7 @@ bool PersistentStore::reserveUnixID(const std::string& tableName,
 			})
 		),
 	});
-	auto outcome=dbClient.TransactWriteItems(request);
+	auto outcome=transactWriteItems(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to update next unix ID record: " << err.GetMessage());
@@ -666,34 +1541,117 @@ bool PersistentStore::reserveUnixID(const std::string& tableName,
 	return true;
 }
 
-unsigned int PersistentStore::allocateUnixID(const std::string& tableName, const std::string& nameKeyName, const unsigned int minID, const unsigned int maxID, std::string recordName){
-	auto readNext=[&]()->unsigned int{return getNextIDHint(tableName,nameKeyName);};
-	
-	unsigned int initialID=readNext();
-	log_info("Next ID hint: " << initialID);
-	unsigned int tryID=initialID;
+bool PersistentStore::IDCounter::lease(unsigned int size, unsigned int& first, unsigned int& end){
+	using Aws::DynamoDB::Model::AttributeValue;
+	size=std::min(size,maxID-minID);
+	const DynamoItem key={{nameKeyName,AttributeValue(nextIDKeyName)},
+	                      {"sortKey",AttributeValue(nextIDKeyName)}};
 	while(true){
-		unsigned int nextID=tryID+1;
-		if(nextID==maxID)
-			nextID=minID;
-		if(checkIDAvailability(tableName,nameKeyName,tryID)){
-			//if(obtain(initialID,tryID,nextID))
-			if(reserveUnixID(tableName,nameKeyName,initialID,tryID,nextID,recordName)){
-				log_info("Allocated ID " << tryID);
-				return tryID;
-			}
+		//Usually a whole block fits below the maximum, so the counter can be 
+		//advanced without first reading it, and concurrent leases by other 
+		//servers simply take successive blocks rather than conflicting
+		store.databaseQueries++;
+		auto outcome=store.updateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+		                                       .WithTableName(tableName)
+		                                       .WithKey(key)
+		                                       .WithUpdateExpression("SET #id = #id + :size")
+		                                       .WithConditionExpression("#id <= :limit")
+		                                       .WithExpressionAttributeNames({{"#id","next_unixID"}})
+		                                       .WithExpressionAttributeValues({
+		                                         {":size",AttributeValue().SetN(std::to_string(size))},
+		                                         {":limit",AttributeValue().SetN(std::to_string(maxID-size))}
+		                                       })
+		                                       .WithReturnValues(Aws::DynamoDB::Model::ReturnValue::UPDATED_NEW));
+		if(outcome.IsSuccess()){
+			end=std::stoul(findOrThrow(outcome.GetResult().GetAttributes(),"next_unixID",
+			                           "record missing next_unixID attribute").GetN());
+			first=end-size;
+			return true;
 		}
-		unsigned int recommendedNext=readNext();
-		if(recommendedNext==initialID){
-			if(nextID==initialID)
-				log_fatal("Unable to allocate numeric unix ID");
-			tryID=nextID;
+		if(outcome.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED){
+			log_error("Failed to lease unix IDs: " << outcome.GetError().GetMessage());
+			return false;
 		}
-		else{
-			tryID=initialID=recommendedNext;
-			log_info("Next ID hint: " << initialID);
+		
+		//The counter is near the end of its range, so take whatever remains 
+		//and wrap it around, which requires knowing exactly where it stands
+		unsigned int current=store.getNextIDHint(tableName,nameKeyName);
+		if(current+size<=maxID)
+			continue; //another server has already wrapped it
+		store.databaseQueries++;
+		outcome=store.updateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+		                                  .WithTableName(tableName)
+		                                  .WithKey(key)
+		                                  .WithUpdateExpression("SET #id = :min")
+		                                  .WithConditionExpression("#id = :current")
+		                                  .WithExpressionAttributeNames({{"#id","next_unixID"}})
+		                                  .WithExpressionAttributeValues({
+		                                    {":min",AttributeValue().SetN(std::to_string(minID))},
+		                                    {":current",AttributeValue().SetN(std::to_string(current))}
+		                                  }));
+		if(outcome.IsSuccess()){
+			if(current>=maxID)
+				continue; //nothing was left to take, but a full block now is
+			first=current;
+			end=maxID;
+			return true;
+		}
+		if(outcome.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED){
+			log_error("Failed to lease unix IDs: " << outcome.GetError().GetMessage());
+			return false;
+		}
+	}
+}
+
+bool PersistentStore::IDCounter::giveBack(unsigned int first, unsigned int end){
+	using Aws::DynamoDB::Model::AttributeValue;
+	store.databaseQueries++;
+	auto outcome=store.updateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+	                                       .WithTableName(tableName)
+	                                       .WithKey({{nameKeyName,AttributeValue(nextIDKeyName)},
+	                                                 {"sortKey",AttributeValue(nextIDKeyName)}})
+	                                       .WithUpdateExpression("SET #id = :first")
+	                                       .WithConditionExpression("#id = :end")
+	                                       .WithExpressionAttributeNames({{"#id","next_unixID"}})
+	                                       .WithExpressionAttributeValues({
+	                                         {":first",AttributeValue().SetN(std::to_string(first))},
+	                                         {":end",AttributeValue().SetN(std::to_string(end))}
+	                                       }));
+	if(!outcome.IsSuccess()){
+		//the usual reason is that another server has leased IDs since
+		if(outcome.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED)
+			log_error("Failed to return unix IDs: " << outcome.GetError().GetMessage());
+		return false;
+	}
+	return true;
+}
+
+unsigned int PersistentStore::allocateUnixID(UnixIDAllocator& allocator, const std::string& tableName, const std::string& nameKeyName, const unsigned int minID, const unsigned int maxID, std::string recordName){
+	using Aws::DynamoDB::Model::AttributeValue;
+	//Leased IDs may already be in use, if they were assigned explicitly or the 
+	//counter has wrapped around, so each must still be checked. After trying 
+	//as many IDs as the range holds, it must be full. 
+	for(unsigned int attempt=0; attempt<maxID-minID; attempt++){
+		unsigned int id=allocator.next();
+		if(!id)
+			break;
+		if(!checkIDAvailability(tableName,nameKeyName,id))
+			continue;
+		auto outcome=putItem(Aws::DynamoDB::Model::PutItemRequest()
+		                              .WithTableName(tableName)
+		                              .WithItem({
+		                                {nameKeyName,AttributeValue(recordName)},
+		                                {"sortKey",AttributeValue(recordName)},
+		                                {"unixID",AttributeValue().SetN(std::to_string(id))}
+		                              }));
+		if(!outcome.IsSuccess()){
+			allocator.release(id);
+			log_fatal("Failed to reserve unix ID: " << outcome.GetError().GetMessage());
 		}
+		log_info("Allocated ID " << id);
+		return id;
 	}
+	log_fatal("Unable to allocate numeric unix ID");
 }
 
 bool PersistentStore::allocateSpecificUnixID(const std::string& tableName, 
@@ -711,15 +1669,142 @@ std::string recordName, unsigned int targetID){
 	}
 }
 
-bool PersistentStore::addUser(User& user){
-	if(user.unixID!=0){
-		bool reserved=allocateSpecificUnixID(userTableName,"unixName",minimumUserID,maximumUserID,user.unixName,user.unixID);
-		if(!reserved)
-			log_fatal("Existing user ID (" << user.unixID << ") is already in use");
+bool PersistentStore::knownToBeAbsent(const std::string& key){
+	{
+		std::chrono::steady_clock::time_point expiration;
+		if(userNegativeCache.find(key,expiration)){
+			if(expiration>std::chrono::steady_clock::now()){
+				negativeCacheHits++;
+				return true;
+			}
+			userNegativeCache.erase(key);
+		}
 	}
-	else
-		user.unixID=allocateUnixID(userTableName,"unixName",minimumUserID,maximumUserID,user.unixName);
-
+	//Users created on other instances only reach the filter through the 
+	//change feed, so without one the filter cannot be trusted. 
+	if(!changeFeed)
+		return false;
+	std::shared_ptr<bloom_filter> filter;
+	bool expired;
+	{
+		std::lock_guard<std::mutex> lock(knownUserFilterMutex);
+		filter=knownUserFilter;
+		expired=knownUserFilterExpiration<std::chrono::steady_clock::now();
+	}
+	if(expired){
+		//Rebuilding requires a full scan, so it is done in the background, 
+		//and the database is queried until it is complete. 
+		const std::string refreshKey="filter:knownUsers";
+		if(refreshesInFlight.insert(refreshKey,true)){
+			try{
+				backgroundPool.enqueue([this,refreshKey]{
+					rebuildKnownUserFilter();
+					refreshesInFlight.erase(refreshKey);
+				});
+			}catch(std::runtime_error& ex){
+				//the pool is shutting down
+				refreshesInFlight.erase(refreshKey);
+			}
+		}
+		return false;
+	}
+	if(filter && !filter->possibly_contains(key)){
+		negativeCacheHits++;
+		recordAbsent(key);
+		return true;
+	}
+	return false;
+}
+
+void PersistentStore::recordAbsent(const std::string& key){
+	cacheRecord(userNegativeCache,key,std::chrono::steady_clock::now()+negativeCacheValidity);
+}
+
+void PersistentStore::addToFilter(bloom_filter& filter, const User& user){
+	if(!user.unixName.empty())
+		filter.insert(knownUserKey("user",user.unixName));
+	if(!user.token.empty())
+		filter.insert(knownUserKey("token",user.token));
+	if(!user.globusID.empty())
+		filter.insert(knownUserKey("globusID",user.globusID));
+}
+
+void PersistentStore::recordUserPresent(const User& user){
+	userNegativeCache.erase(knownUserKey("user",user.unixName));
+	userNegativeCache.erase(knownUserKey("token",user.token));
+	userNegativeCache.erase(knownUserKey("globusID",user.globusID));
+	std::lock_guard<std::mutex> lock(knownUserFilterMutex);
+	if(knownUserFilter)
+		addToFilter(*knownUserFilter,user);
+	if(pendingKnownUserFilter)
+		addToFilter(*pendingKnownUserFilter,user);
+}
+
+std::shared_ptr<bloom_filter> PersistentStore::beginKnownUserFilterRebuild(){
+	if(knownUserFilterRebuilding.exchange(true))
+		return nullptr;
+	std::lock_guard<std::mutex> lock(knownUserFilterMutex);
+	//leave plenty of room for growth, since the filter cannot be resized
+	std::size_t expected=1u<<16;
+	if(knownUserFilter)
+		expected=std::max(expected,2*knownUserFilter->insertions());
+	pendingKnownUserFilter=std::make_shared<bloom_filter>(expected);
+	return pendingKnownUserFilter;
+}
+
+void PersistentStore::finishKnownUserFilterRebuild(std::shared_ptr<bloom_filter> filter, bool success){
+	{
+		std::lock_guard<std::mutex> lock(knownUserFilterMutex);
+		if(success && filter==pendingKnownUserFilter){
+			knownUserFilter=filter;
+			knownUserFilterExpiration=std::chrono::steady_clock::now()+userCacheValidity;
+		}
+		pendingKnownUserFilter.reset();
+	}
+	knownUserFilterRebuilding=false;
+}
+
+void PersistentStore::rebuildKnownUserFilter(){
+	auto filter=beginKnownUserFilterRebuild();
+	if(!filter)
+		return;
+	log_info("Rebuilding known user filter");
+	databaseScans++;
+	Aws::DynamoDB::Model::ScanRequest request;
+	request.SetTableName(userTableName);
+	//Only user records carry tokens, and only the identifying values are needed
+	request.SetFilterExpression("attribute_exists(#token)");
+	request.SetProjectionExpression("#name, #token, #globusID");
+	request.SetExpressionAttributeNames({{"#name", "unixName"},{"#token", "token"},{"#globusID", "globusID"}});
+	
+	std::vector<User> users;
+	try{
+		users=makeScan().collect<User>(request,[](const DynamoItem& item, std::vector<User>& users){
+			User user;
+			user.unixName=findOrDefault(item,"unixName",missingString).GetS();
+			user.token=findOrDefault(item,"token",missingString).GetS();
+			user.globusID=findOrDefault(item,"globusID",missingString).GetS();
+			users.push_back(std::move(user));
+		});
+	}catch(std::exception& ex){
+		log_error("Failed to scan user records for known user filter: " << ex.what());
+		finishKnownUserFilterRebuild(filter,false);
+		return;
+	}
+	for(const auto& user : users)
+		addToFilter(*filter,user);
+	finishKnownUserFilterRebuild(filter,true);
+}
+
+bool PersistentStore::addUser(User& user){
+	if(user.unixID!=0){
+		bool reserved=allocateSpecificUnixID(userTableName,"unixName",minimumUserID,maximumUserID,user.unixName,user.unixID);
+		if(!reserved)
+			log_fatal("Existing user ID (" << user.unixID << ") is already in use");
+	}
+	else
+		user.unixID=allocateUnixID(userIDAllocator,userTableName,"unixName",minimumUserID,maximumUserID,user.unixName);
+
 	using Aws::DynamoDB::Model::AttributeValue;
 	auto request=Aws::DynamoDB::Model::PutItemRequest()
 	.WithTableName(userTableName)
@@ -741,7 +1826,7 @@ bool PersistentStore::addUser(User& user){
 		{"serviceAccount",AttributeValue().SetBool(user.serviceAccount)},
 		{"unixID",AttributeValue().SetN(std::to_string(user.unixID))}
 	});
-	auto outcome=dbClient.PutItem(request);
+	auto outcome=putItem(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to add user record: " << err.GetMessage());
@@ -750,41 +1835,174 @@ bool PersistentStore::addUser(User& user){
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
-	replaceCacheRecord(userCache,user.unixName,record);
-	replaceCacheRecord(userByTokenCache,user.token,record);
-	replaceCacheRecord(userByGlobusIDCache,user.globusID,record);
+	cacheRecord(userCache,user.unixName,record);
+	cacheRecord(userByTokenCache,user.token,record);
+	cacheRecord(userByGlobusIDCache,user.globusID,record);
+	userDirectory.upsert(user.unixName,UserSummary(user));
+	recordUserPresent(user);
+	announceChange(ChangeEvent::UserChanged,user.unixName);
 	
 	return true;
 }
 
 User PersistentStore::getUser(const std::string& id){
+	auto load=[this,id]{ return userLoads.run("user:"+id,[this,&id]{ return loadUser(id); }); };
 	//first see if we have this cached
 	{
 		CacheRecord<User> record;
 		if(userCache.find(id,record)){
-			//we have a cached record; is it still valid?
-			if(record){ //it is, just return it
+			//we have a cached record; is it still usable?
+			if(useCachedRecord(record.expirationTime,"user:"+id,[load]{ load(); })){
 				cacheHits++;
 				return record;
 			}
 		}
 	}
+	if(knownToBeAbsent(knownUserKey("user",id)))
+		return User{};
+	return load();
+}
+
+std::vector<User> PersistentStore::getUsers(const std::vector<std::string>& ids, bool* complete){
+	std::map<std::string,User> found;
+	std::vector<std::string> toLoad;
+	for(const auto& id : ids){
+		if(found.count(id))
+			continue;
+		CacheRecord<User> record;
+		if(userCache.find(id,record)){
+			auto load=[this,id]{ return userLoads.run("user:"+id,[this,&id]{ return loadUser(id); }); };
+			if(useCachedRecord(record.expirationTime,"user:"+id,[load]{ load(); })){
+				cacheHits++;
+				found.emplace(id,record);
+				continue;
+			}
+		}
+		found.emplace(id,User{});
+		if(!knownToBeAbsent(knownUserKey("user",id)))
+			toLoad.push_back(id);
+	}
+	
+	//read the remaining users in batches, concurrently if there are several
+	std::vector<std::map<std::string,User>> loaded;
+	//one flag per batch, each written only by the task reading that batch
+	std::vector<char> batchComplete((toLoad.size()+batchGetLimit-1)/batchGetLimit,false);
+	if(!toLoad.empty() && toLoad.size()<=batchGetLimit){
+		bool batchDone=false;
+		loaded.push_back(loadUsers(toLoad,batchDone));
+		batchComplete[0]=batchDone;
+	}
+	else if(!toLoad.empty()){
+		std::vector<std::future<std::map<std::string,User>>> pending;
+		for(std::size_t i=0; i<toLoad.size(); i+=batchGetLimit){
+			std::vector<std::string> batch(toLoad.begin()+i,toLoad.begin()+std::min(i+batchGetLimit,toLoad.size()));
+			char* flag=&batchComplete[i/batchGetLimit];
+			pending.push_back(bulkPool.enqueue([this,batch,flag]{
+				bool batchDone=false;
+				auto users=loadUsers(batch,batchDone);
+				*flag=batchDone;
+				return users;
+			}));
+		}
+		for(auto& batch : pending)
+			loaded.push_back(batch.get());
+	}
+	for(auto& batch : loaded){
+		for(auto& user : batch)
+			found[user.first]=std::move(user.second);
+	}
+	if(complete)
+		*complete=std::all_of(batchComplete.begin(),batchComplete.end(),[](char c){ return c!=0; });
+	
+	std::vector<User> users;
+	users.reserve(ids.size());
+	for(const auto& id : ids)
+		users.push_back(found[id]);
+	return users;
+}
+
+std::map<std::string,User> PersistentStore::loadUsers(const std::vector<std::string>& ids, bool& complete){
+	using Aws::DynamoDB::Model::AttributeValue;
+	log_info("Querying database for " << ids.size() << " users");
+	std::map<std::string,User> users;
+	Aws::DynamoDB::Model::KeysAndAttributes keys;
+	for(const auto& id : ids)
+		keys.AddKeys({{"unixName",AttributeValue(id)},{"sortKey",AttributeValue(id)}});
+	auto request=Aws::DynamoDB::Model::BatchGetItemRequest()
+	             .AddRequestItems(userTableName,keys);
+	complete=false;
+	for(unsigned int attempt=0; ; attempt++){
+		databaseQueries++;
+		auto outcome=batchGetItem(request);
+		if(!outcome.IsSuccess()){
+			auto err=outcome.GetError();
+			log_error("Failed to fetch user records: " << err.GetMessage());
+			break;
+		}
+		const auto& result=outcome.GetResult();
+		auto items=result.GetResponses().find(userTableName);
+		if(items!=result.GetResponses().end()){
+			for(const auto& item : items->second){
+				User user=decodeUser(item);
+				CacheRecord<User> record(user,userCacheValidity);
+				cacheRecord(userCache,user.unixName,record);
+				cacheRecord(userByTokenCache,user.token,record);
+				cacheRecord(userByGlobusIDCache,user.globusID,record);
+				userDirectory.upsert(user.unixName,UserSummary(user));
+				users.emplace(user.unixName,std::move(user));
+			}
+		}
+		if(result.GetUnprocessedKeys().empty()){
+			complete=true;
+			break;
+		}
+		if(attempt+1==batchRetryLimit){
+			log_error("Failed to fetch all user records: keys remained unprocessed after " 
+			          << batchRetryLimit << " attempts");
+			break;
+		}
+		//keys are left unprocessed when the table's capacity is exceeded, so 
+		//slow down and back off before asking for them again
+		engine->waitToRetry(userTableName,attempt+1);
+		request.SetRequestItems(result.GetUnprocessedKeys());
+	}
+	//only when every key was answered is a missing user known not to exist
+	if(complete){
+		for(const auto& id : ids){
+			if(!users.count(id)){
+				userCache.erase(id);
+				recordAbsent(knownUserKey("user",id));
+			}
+		}
+	}
+	return users;
+}
+
+User PersistentStore::loadUser(const std::string& id){
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for user " << id);
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	auto outcome=getItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(userTableName)
 								  .WithKey({{"unixName",AttributeValue(id)},
 	                                        {"sortKey",AttributeValue(id)}}));
+	return finishLoadUser(id,outcome);
+}
+
+User PersistentStore::finishLoadUser(const std::string& id, const Aws::DynamoDB::Model::GetItemOutcome& outcome){
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch user record: " << err.GetMessage());
 		return User();
 	}
 	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
+	if(item.empty()){ //no match found
+		//discard any stale record which was being refreshed
+		userCache.erase(id);
+		recordAbsent(knownUserKey("user",id));
 		return User{};
+	}
 	User user;
 	user.valid=true;
 	user.unixName=id;
@@ -805,31 +2023,66 @@ User PersistentStore::getUser(const std::string& id){
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
-	replaceCacheRecord(userCache,user.unixName,record);
-	replaceCacheRecord(userByTokenCache,user.token,record);
-	replaceCacheRecord(userByGlobusIDCache,user.globusID,record);
+	cacheRecord(userCache,user.unixName,record);
+	cacheRecord(userByTokenCache,user.token,record);
+	cacheRecord(userByGlobusIDCache,user.globusID,record);
+	userDirectory.upsert(user.unixName,UserSummary(user));
 	
 	return user;
 }
 
+std::future<User> PersistentStore::getUserAsync(const std::string& id){
+	{
+		CacheRecord<User> record;
+		if(userCache.find(id,record)){
+			auto load=[this,id]{ return userLoads.run("user:"+id,[this,&id]{ return loadUser(id); }); };
+			if(useCachedRecord(record.expirationTime,"user:"+id,[load]{ load(); })){
+				cacheHits++;
+				return readyFuture<User>(record);
+			}
+		}
+	}
+	if(knownToBeAbsent(knownUserKey("user",id)))
+		return readyFuture(User{});
+	log_info("Querying database for user " << id);
+	using Aws::DynamoDB::Model::AttributeValue;
+	return getItemAsync<User>(Aws::DynamoDB::Model::GetItemRequest()
+	                          .WithTableName(userTableName)
+	                          .WithKey({{"unixName",AttributeValue(id)},
+	                                    {"sortKey",AttributeValue(id)}}),
+	                          [this,id](const Aws::DynamoDB::Model::GetItemOutcome& outcome){
+	                          	return finishLoadUser(id,outcome);
+	                          });
+}
+
 User PersistentStore::findUserByToken(const std::string& token){
+	auto load=[this,token]{ return userLoads.run("token:"+token,[this,&token]{ return loadUserByToken(token); }); };
 	//first see if we have this cached
 	{
 		CacheRecord<User> record;
 		if(userByTokenCache.find(token,record)){
-			//we have a cached record; is it still valid?
-			if(record){ //it is, just return it
+			//we have a cached record; is it still usable?
+			if(useCachedRecord(record.expirationTime,"token:"+token,[load]{ load(); })){
 				cacheHits++;
 				return record;
 			}
 		}
 	}
+	if(knownToBeAbsent(knownUserKey("token",token)))
+		return User();
+	return load();
+}
+
+User PersistentStore::loadUserByToken(const std::string& token){
 	//need to query the database
 	databaseQueries++;
 	using Aws::DynamoDB::Model::AttributeValue;
+	const bool useAuthIndex=tokenIndexActive.load();
+	if(!useAuthIndex)
+		checkTokenIndexStatus();
 	auto request=Aws::DynamoDB::Model::QueryRequest()
 	.WithTableName(userTableName)
-	.WithIndexName("ByToken")
+	.WithIndexName(useAuthIndex?"ByTokenAuth":"ByToken")
 	.WithKeyConditionExpression("#token = :tok_val")
 	.WithExpressionAttributeNames({
 		{"#token","token"}
@@ -837,20 +2090,84 @@ User PersistentStore::findUserByToken(const std::string& token){
 	.WithExpressionAttributeValues({
 		{":tok_val",AttributeValue(token)}
 	});
-	auto outcome=dbClient.Query(request);
+	auto outcome=query(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to look up user by token: " << err.GetMessage());
 		return User();
 	}
 	const auto& queryResult=outcome.GetResult();
-	if(queryResult.GetCount()==0)
+	if(queryResult.GetCount()==0){
+		//discard any stale record which was being refreshed
+		userByTokenCache.erase(token);
+		recordAbsent(knownUserKey("token",token));
 		return User();
+	}
 	if(queryResult.GetCount()>1)
 		log_fatal("Multiple user records are associated with token " << token << '!');
 	
 	const auto& item=queryResult.GetItems().front();
-	return getUser(findOrThrow(item,"unixName","user record missing unixName attribute").GetS());
+	const std::string uID=findOrThrow(item,"unixName","user record missing unixName attribute").GetS();
+	//If the index does not carry the authentication attributes (because 
+	//ByTokenAuth is not yet active), load the full record directly, since a 
+	//cached copy would be no fresher than the token cache entry being replaced
+	if(!item.count("superuser"))
+		return loadUser(uID);
+	
+	//Otherwise, the index entry has everything needed to authenticate the 
+	//user, so the full record is not loaded. Since the record is incomplete 
+	//it is only cached by token. 
+	User user;
+	user.valid=true;
+	user.unixName=uID;
+	user.token=token;
+	user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
+	user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
+	user.phone=findOrDefault(item,"phone",missingString).GetS();
+	user.superuser=findOrThrow(item,"superuser","user record missing superuser attribute").GetBool();
+	user.serviceAccount=findOrThrow(item,"serviceAccount","user record missing serviceAccount attribute").GetBool();
+	
+	CacheRecord<User> record(user,userCacheValidity);
+	cacheRecord(userByTokenCache,token,record);
+	indexedTokens.insert_or_assign(uID,token);
+	return user;
+}
+
+void PersistentStore::forgetIndexedToken(const std::string& uID){
+	std::string token;
+	if(indexedTokens.find(uID,token)){
+		userByTokenCache.erase(token);
+		indexedTokens.erase(uID);
+	}
+}
+
+void PersistentStore::checkTokenIndexStatus(){
+	auto now=std::chrono::steady_clock::now();
+	auto due=nextTokenIndexCheck.load();
+	if(now<due)
+		return;
+	//only the caller which moves the time of the next check does this one
+	if(!nextTokenIndexCheck.compare_exchange_strong(due,now+std::chrono::minutes(1)))
+		return;
+	const std::string refreshKey="index:ByTokenAuth";
+	if(!refreshesInFlight.insert(refreshKey,true))
+		return;
+	try{
+		backgroundPool.enqueue([this,refreshKey]{
+			auto outcome=engine->describeTable(Aws::DynamoDB::Model::DescribeTableRequest()
+			                                   .WithTableName(userTableName));
+			if(!outcome.IsSuccess())
+				log_error("Failed to check status of by-token authentication index: " << outcome.GetError().GetMessage());
+			else if(indexIsActive(outcome.GetResult().GetTable(),"ByTokenAuth")){
+				tokenIndexActive=true;
+				log_info("By-token authentication index is active");
+			}
+			refreshesInFlight.erase(refreshKey);
+		});
+	}catch(std::runtime_error& ex){
+		//the pool is shutting down
+		refreshesInFlight.erase(refreshKey);
+	}
 }
 
 User PersistentStore::findUserByGlobusID(const std::string& globusID){
@@ -865,10 +2182,13 @@ User PersistentStore::findUserByGlobusID(const std::string& globusID){
 			}
 		}
 	}
+	const std::string absenceKey=knownUserKey("globusID",globusID);
+	if(knownToBeAbsent(absenceKey))
+		return User();
 	//need to query the database
 	databaseQueries++;
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=query(Aws::DynamoDB::Model::QueryRequest()
 								.WithTableName(userTableName)
 								.WithIndexName("ByGlobusID")
 								.WithKeyConditionExpression("#globusID = :id_val")
@@ -881,8 +2201,10 @@ User PersistentStore::findUserByGlobusID(const std::string& globusID){
 		return User();
 	}
 	const auto& queryResult=outcome.GetResult();
-	if(queryResult.GetCount()==0)
+	if(queryResult.GetCount()==0){
+		recordAbsent(absenceKey);
 		return User();
+	}
 	if(queryResult.GetCount()>1)
 		log_fatal("Multiple user records are associated with Globus ID " << globusID << '!');
 	
@@ -898,52 +2220,120 @@ User PersistentStore::findUserByGlobusID(const std::string& globusID){
 	//We don't have enough information to populate the other caches. :(
 	//replaceCacheRecord(userCache,user.unixName,record);
 	//replaceCacheRecord(userByTokenCache,user.token,record);
-	replaceCacheRecord(userByGlobusIDCache,user.globusID,record);
+	cacheRecord(userByGlobusIDCache,user.globusID,record);
 	
 	return user;
 }
 
-bool PersistentStore::updateUser(const User& user, const User& oldUser){
+bool PersistentStore::updateUser(const User& user, const User& oldUser, const std::set<std::string>& attributes){
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	using AVU=Aws::DynamoDB::Model::AttributeValueUpdate;
-	auto outcome=dbClient.UpdateItem(Aws::DynamoDB::Model::UpdateItemRequest()
-	                                 .WithTableName(userTableName)
-									 .WithKey({{"unixName",AV(user.unixName)},
-	                                           {"sortKey",AV(user.unixName)}})
-	                                 .WithAttributeUpdates({
-	                                            {"name",AVU().WithValue(AV(user.name))},
-	                                            {"globusID",AVU().WithValue(AV(user.globusID))},
-	                                            {"token",AVU().WithValue(AV(user.token))},
-	                                            {"email",AVU().WithValue(AV(user.email))},
-	                                            {"phone",AVU().WithValue(AV(user.phone))},
-	                                            {"institution",AVU().WithValue(AV(user.institution))},
-	                                            {"sshKey",AVU().WithValue(AV(user.sshKey))},
-	                                            {"x509DN",AVU().WithValue(AV(user.x509DN))},
-	                                            {"totpSecret",AVU().WithValue(AV(user.totpSecret))},
-	                                            {"lastUseTime",AVU().WithValue(AV(user.lastUseTime))},
-	                                            {"superuser",AVU().WithValue(AV().SetBool(user.superuser))},
-	                                            {"serviceAccount",AVU().WithValue(AV().SetBool(user.serviceAccount))}
-	                                 }));
+	AttributeChanges changes(attributes);
+	changes.offer("name",user.name);
+	changes.offer("globusID",user.globusID);
+	changes.offer("token",user.token);
+	changes.offer("email",user.email);
+	changes.offer("phone",user.phone);
+	changes.offer("institution",user.institution);
+	changes.offer("sshKey",user.sshKey);
+	changes.offer("x509DN",user.x509DN);
+	changes.offer("totpSecret",user.totpSecret);
+	changes.offer("lastUseTime",user.lastUseTime);
+	changes.offer("superuser",user.superuser);
+	changes.offer("serviceAccount",user.serviceAccount);
+	if(changes.empty()){
+		log_info("Update to " << user << " changes nothing");
+		return true;
+	}
+	
+	Aws::DynamoDB::Model::UpdateItemRequest request;
+	request.SetTableName(userTableName);
+	request.SetKey({{"unixName",AV(user.unixName)},
+	                {"sortKey",AV(user.unixName)}});
+	changes.applyTo(request,"unixName");
+	auto outcome=updateItem(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
-		log_error("Failed to update user record: " << err.GetMessage());
+		if(err.GetErrorType()==Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED)
+			log_info("Not updating " << user << " because it no longer exists");
+		else
+			log_error("Failed to update user record: " << err.GetMessage());
 		return false;
 	}
 	
 	//update caches
 	CacheRecord<User> record(user,userCacheValidity);
 	//userCache.upsert(user.unixName,[&record](CacheRecord<User>& existing){ existing=record; },record);
-	replaceCacheRecord(userCache,user.unixName,record);
+	cacheRecord(userCache,user.unixName,record);
 	//if the token has changed, ensure that any old cache record is removed
 	if(oldUser.token!=user.token)
 		userByTokenCache.erase(oldUser.token);
-	replaceCacheRecord(userByTokenCache,user.token,record);
-	replaceCacheRecord(userByGlobusIDCache,user.globusID,record);
+	cacheRecord(userByTokenCache,user.token,record);
+	cacheRecord(userByGlobusIDCache,user.globusID,record);
+	userDirectory.upsert(user.unixName,UserSummary(user));
+	recordUserPresent(user);
+	announceChange(ChangeEvent::UserChanged,user.unixName);
 	
 	return true;
 }
 
+void PersistentStore::updateLastUseTime(const User& user){
+	{
+		std::lock_guard<std::mutex> lock(lastUseMutex);
+		pendingLastUseTimes[user.unixName]=user.lastUseTime;
+	}
+	recordedLastUses++;
+	
+	CacheRecord<User> record(user,userCacheValidity);
+	cacheRecord(userCache,user.unixName,record);
+	cacheRecord(userByTokenCache,user.token,record);
+	cacheRecord(userByGlobusIDCache,user.globusID,record);
+	userDirectory.upsert(user.unixName,UserSummary(user));
+}
+
+bool PersistentStore::flushLastUseTimes(){
+	using AV=Aws::DynamoDB::Model::AttributeValue;
+	std::map<std::string,std::string> pending;
+	{
+		std::lock_guard<std::mutex> lock(lastUseMutex);
+		pending.swap(pendingLastUseTimes);
+	}
+	if(pending.empty())
+		return true;
+	
+	std::map<std::string,std::string> failed;
+	for(const auto& entry : pending){
+		databaseQueries++;
+		//the condition keeps this from recreating a user deleted in the meantime
+		auto outcome=updateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+		                        .WithTableName(userTableName)
+		                        .WithKey({{"unixName",AV(entry.first)},
+		                                  {"sortKey",AV(entry.first)}})
+		                        .WithUpdateExpression("SET #time = :time")
+		                        .WithConditionExpression("attribute_exists(#name)")
+		                        .WithExpressionAttributeNames({{"#time","lastUseTime"},{"#name","unixName"}})
+		                        .WithExpressionAttributeValues({{":time",AV(entry.second)}}));
+		if(outcome.IsSuccess())
+			writtenLastUses++;
+		else if(outcome.GetError().GetErrorType()!=Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED){
+			log_error("Failed to update last use time of " << entry.first << ": " 
+			          << outcome.GetError().GetMessage());
+			failed.insert(entry);
+		}
+	}
+	if(failed.empty())
+		return true;
+	
+	//keep the failures for next time, unless the users have been used again
+	std::lock_guard<std::mutex> lock(lastUseMutex);
+	pendingLastUseTimes.insert(failed.begin(),failed.end());
+	return false;
+}
+
 bool PersistentStore::removeUser(const std::string& id){
+	{
+		std::lock_guard<std::mutex> lock(lastUseMutex);
+		pendingLastUseTimes.erase(id);
+	}
 	//erase cache entries
 	{
 		//Somewhat hacky: we can't erase the secondary cache entries unless we know 
@@ -961,152 +2351,110 @@ bool PersistentStore::removeUser(const std::string& id){
 			userByGlobusIDCache.erase(record.record.globusID);
 			groupMembershipByUserCache.erase(id);
 		}
+		forgetIndexedToken(id);
 		userCache.erase(id);
-	}
-	
-	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
-								     .WithTableName(userTableName)
-								     .WithKey({{"unixName",AttributeValue(id)},
-	                                           {"sortKey",AttributeValue(id)}}));
-	if(!outcome.IsSuccess()){
-		auto err=outcome.GetError();
-		log_error("Failed to delete user record: " << err.GetMessage());
-		return false;
-	}
-	
-	//clean up any secondary attribute records tied to the user
-	databaseScans++;
-	Aws::DynamoDB::Model::ScanRequest request;
-	request.SetTableName(userTableName);
-	request.SetFilterExpression("attribute_exists(#extra) AND #name = "+id);
-	request.SetExpressionAttributeNames({{"#extra", "secondaryAttribute"},{"#name", "unixName"}});
-	bool keepGoing=false;
-	
-	std::vector<std::string> toDelete;
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch user secondary records: " << err.GetMessage());
-			return false;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems())
-			toDelete.push_back(findOrThrow(item,"sortKey","user secondary record missing sortKey attribute").GetS());
-	}while(keepGoing);
-	
-	for(const auto& sortKey : toDelete){
-		outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
-										 .WithTableName(userTableName)
-										 .WithKey({{"unixName",AttributeValue(id)},
-												   {"sortKey",AttributeValue(sortKey)}}));
-		if(!outcome.IsSuccess()){
-			auto err=outcome.GetError();
-			log_error("Failed to delete user record: " << err.GetMessage());
-			return false;
-		}
-	}
-	return true;
+		userAttributeCache.erase(id);
+		userDirectory.erase(id);
+	}
+	
+	//delete the user record, all secondary records, and all memberships
+	std::vector<std::pair<std::string,std::string>> memberships;
+	bool success=cascadeDelete(userTableName,"unixName",id,"",memberships);
+	for(const auto& membership : memberships){
+		forgetMembership(membership.first,membership.second);
+		announceChange(ChangeEvent::MembershipChanged,membership.first,membership.second);
+	}
+	groupMembershipByUserCache.erase(id);
+	invalidateAuthorization(id);
+	announceChange(ChangeEvent::UserChanged,id);
+	announceChange(ChangeEvent::UserAttributeChanged,id);
+	if(!success)
+		log_error("Failed to delete all records of user " << id);
+	return success;
 }
 
-std::vector<User> PersistentStore::listUsers(){
-	std::vector<User> collected;
+std::vector<UserSummary> PersistentStore::listUsers(){
 	//First check if users are cached
-	if(userCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-		auto table = userCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
-			auto user = itr->second;
+	{
+		auto snapshot=userDirectory.get();
+		if(snapshot->valid()){
 			cacheHits++;
-			collected.push_back(user);
+			return snapshot->values();
 		}
-		table.unlock();
-		return collected;
 	}
-	
+	//all concurrent requests can share one scan
+	return userScans.run("",[this]{ return scanUsers(); });
+}
+
+namespace{
+///The users read by one segment of the scan in scanUsers
+struct UserListing{
+	std::vector<UserSummary> users;
+	///Users with only their identifying values set, for the known user filter
+	std::vector<User> identities;
+};
+}
+
+std::vector<UserSummary> PersistentStore::scanUsers(){
+	std::vector<UserSummary> collected;
+	auto rebuild=userDirectory.begin_rebuild();
+	//A full scan can also see every token and Globus ID, so refresh the known 
+	//user filter at the same time if nothing else is doing so
+	auto filter=beginKnownUserFilterRebuild();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(userTableName);
 	//Ignore group membership records
 	request.SetFilterExpression("attribute_not_exists(#groupName) and attribute_not_exists(#secondAttr) and attribute_not_exists(#nextID)");
 	request.SetExpressionAttributeNames({{"#groupName", "groupName"},{"#secondAttr", "secondaryAttribute"},{"#nextID", "next_unixID"}});
-	bool keepGoing=false;
-	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch user records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			User user;
-			user.valid=true;
-			if(item.count("next_unixID"))
-				log_fatal("Dynamo is stupid");
-			user.unixName=findOrThrow(item,"unixName","user record missing unixName attribute").GetS();
-			//try{
-			user.name=findOrThrow(item,"name","user record missing name attribute").GetS();
-			/*}catch(std::exception& e){
-				std::cout << "user " << user.unixName << " missing name" << std::endl;
-				for(const auto& entry : item){
-					std::cout << " attribute: " << entry.first << " -> ";
-					switch(entry.second.GetType()){
-						case Aws::DynamoDB::Model::ValueType::STRING:
-							std::cout << "[string]\"" << entry.second.GetS() << "\"\n";
-							break;
-						case Aws::DynamoDB::Model::ValueType::NUMBER:
-							std::cout << "[number]" << entry.second.GetN() << '\n';
-							break;
-						case Aws::DynamoDB::Model::ValueType::BOOL:
-							std::cout << "[bool]" << (entry.second.GetBool()?"true":"false") << '\n';
-							break;
-						default:
-							std::cout << "[something else]\n";
-							break;
-					}
-				}
-				continue;
-			}*/
-			user.email=findOrThrow(item,"email","user record missing email attribute").GetS();
-			user.phone=findOrDefault(item,"phone",missingString).GetS();
-			user.institution=findOrDefault(item,"institution",missingString).GetS();
-			user.token=findOrThrow(item,"token","user record missing token attribute").GetS();
-			user.globusID=findOrThrow(item,"globusID","user record missing globusID attribute").GetS();
-			user.sshKey=findOrThrow(item,"sshKey","user record missing sshKey attribute").GetS();
-			user.x509DN=findOrDefault(item,"x509DN",missingString).GetS();
-			user.totpSecret=findOrDefault(item,"totpSecret",missingString).GetS();
-			user.joinDate=findOrThrow(item,"joinDate","user record missing joinDate attribute").GetS();
-			user.lastUseTime=findOrThrow(item,"lastUseTime","user record missing lastUseTime attribute").GetS();
-			user.superuser=findOrThrow(item,"superuser","user record missing superuser attribute").GetBool();
-			user.serviceAccount=findOrThrow(item,"serviceAccount","user record missing serviceAccount attribute").GetBool();
-			user.unixID=std::stoul(findOrThrow(item,"unixID","user record missing unixID attribute (listUsers)").GetN());
-			collected.push_back(user);
-
-			CacheRecord<User> record(user,userCacheValidity);
-			replaceCacheRecord(userCache,user.unixName,record);
+	//Fetch only what the directory holds, skipping SSH keys and other 
+	//credentials, which make up most of the size of each record
+	std::vector<std::string> attributes=userSummaryAttributes;
+	if(filter){
+		attributes.push_back("token");
+		attributes.push_back("globusID");
+	}
+	projectAttributes(request,attributes);
+	
+	std::vector<UserListing> listings;
+	try{
+		bool wantIdentities=(bool)filter;
+		listings=makeScan().accumulate<UserListing>(request,[wantIdentities](const DynamoItem& item, UserListing& listing){
+			listing.users.push_back(decodeUserSummary(item));
+			if(wantIdentities){
+				User identity;
+				identity.unixName=listing.users.back().unixName;
+				identity.token=findOrDefault(item,"token",missingString).GetS();
+				identity.globusID=findOrDefault(item,"globusID",missingString).GetS();
+				listing.identities.push_back(std::move(identity));
+			}
+		});
+	}catch(std::exception& ex){
+		//TODO: more principled logging or reporting of the nature of the error
+		log_error("Failed to fetch user records: " << ex.what());
+		userDirectory.abandon(rebuild);
+		if(filter)
+			finishKnownUserFilterRebuild(filter,false);
+		return collected;
+	}
+	std::size_t total=0;
+	for(const auto& listing : listings)
+		total+=listing.users.size();
+	collected.reserve(total);
+	for(auto& listing : listings){
+		std::move(listing.users.begin(),listing.users.end(),std::back_inserter(collected));
+		if(filter){
+			for(const auto& identity : listing.identities)
+				addToFilter(*filter,identity);
 		}
-	}while(keepGoing);
-	userCacheExpirationTime=std::chrono::steady_clock::now()+userCacheValidity;
+	}
+	std::vector<std::pair<std::string,UserSummary>> entries;
+	entries.reserve(collected.size());
+	for(const auto& user : collected)
+		entries.emplace_back(user.unixName,user);
+	userDirectory.publish(rebuild,std::move(entries),std::chrono::steady_clock::now()+userCacheValidity);
+	if(filter)
+		finishKnownUserFilterRebuild(filter,true);
 	
 	return collected;
 }
@@ -1122,7 +2470,7 @@ bool PersistentStore::setUserStatusInGroup(const GroupMembership& membership){
 		{"state",AttributeValue(GroupMembership::to_string(membership.state))},
 		{"stateSetBy",AttributeValue(membership.stateSetBy)}
 	});
-	auto outcome=dbClient.PutItem(request);
+	auto outcome=putItem(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to add user group membership record: " << err.GetMessage());
@@ -1131,68 +2479,184 @@ bool PersistentStore::setUserStatusInGroup(const GroupMembership& membership){
 	
 	//update cache
 	CacheRecord<GroupMembership> record(membership,userCacheValidity);
-	replaceCacheRecord(groupMembershipCache,membership.userName+":"+membership.groupName,record);
-	groupMembershipByUserCache.insert_or_assign(membership.userName,record);
-	groupMembershipByGroupCache.insert_or_assign(membership.groupName,record);
+	cacheRecord(groupMembershipCache,membership.userName+":"+membership.groupName,record);
+	cacheRecord(groupMembershipByUserCache,membership.userName,record);
+	cacheRecord(groupMembershipByGroupCache,membership.groupName,record);
+	invalidateAuthorization(membership.userName);
+	announceChange(ChangeEvent::MembershipChanged,membership.userName,membership.groupName);
 	
 	return true;
 }
 
-bool PersistentStore::removeUserFromGroup(const std::string& uID, std::string groupName){
-	//write non-member status to all caches
-	GroupMembership membership;
-	membership.valid=true;
-	membership.userName=uID;
-	membership.groupName=groupName;
-	membership.state=GroupMembership::NonMember;
-	CacheRecord<GroupMembership> record(membership,userCacheValidity);
-	replaceCacheRecord(groupMembershipCache,uID+":"+groupName,record);
-	groupMembershipByUserCache.insert_or_assign(uID,record);
-	groupMembershipByGroupCache.insert_or_assign(groupName,record);
-
-	{
-		CacheRecord<GroupMembership> record;
-		bool cached=groupMembershipCache.find(groupName,record);
-		if (cached){
-			groupMembershipByUserCache.erase(uID,record);
-			groupMembershipByGroupCache.erase(groupName,record);
-			groupMembershipCache.erase(uID);
-		}
+std::vector<bool> PersistentStore::setUserStatusesInGroups(const std::vector<GroupMembership>& memberships){
+	using Aws::DynamoDB::Model::AttributeValue;
+	std::vector<Aws::DynamoDB::Model::WriteRequest> writes;
+	writes.reserve(memberships.size());
+	for(const auto& membership : memberships){
+		writes.push_back(BatchWriter::put({
+			{"unixName",AttributeValue(membership.userName)},
+			{"sortKey",AttributeValue(membership.userName+":"+membership.groupName)},
+			{"groupName",AttributeValue(membership.groupName)},
+			{"state",AttributeValue(GroupMembership::to_string(membership.state))},
+			{"stateSetBy",AttributeValue(membership.stateSetBy)}
+		}));
+	}
+	auto stored=makeBatchWriter().write(userTableName,writes);
+	
+	//update caches
+	for(std::size_t i=0; i<memberships.size(); i++){
+		if(!stored[i])
+			continue;
+		const GroupMembership& membership=memberships[i];
+		CacheRecord<GroupMembership> record(membership,userCacheValidity);
+		cacheRecord(groupMembershipCache,membership.userName+":"+membership.groupName,record);
+		cacheRecord(groupMembershipByUserCache,membership.userName,record);
+		cacheRecord(groupMembershipByGroupCache,membership.groupName,record);
+		invalidateAuthorization(membership.userName);
+		announceChange(ChangeEvent::MembershipChanged,membership.userName,membership.groupName);
 	}
 	
+	return stored;
+}
+
+bool PersistentStore::removeUserFromGroup(const std::string& uID, std::string groupName){
+	forgetMembership(uID,groupName);
+	
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
+	auto outcome=deleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
 								     .WithTableName(userTableName)
 								     .WithKey({{"unixName",AttributeValue(uID)},
-	                                           {"sortKey",AttributeValue(uID+":"+membership.groupName)}}));
+	                                           {"sortKey",AttributeValue(uID+":"+groupName)}}));
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to delete user Group membership record: " << err.GetMessage());
 		return false;
 	}
+	announceChange(ChangeEvent::MembershipChanged,uID,groupName);
 	return true;
 }
 
-GroupMembership PersistentStore::userStatusInGroup(const std::string& uID, std::string groupName){
+GroupMembership PersistentStore::userStatusInGroup(const std::string& uID, std::string groupName, 
+                                                   std::chrono::steady_clock::time_point* expiration){
+	const std::string key=uID+":"+groupName;
+	auto load=[this,uID,groupName,key]{
+		return membershipLoads.run(key,[&]{ return loadUserStatusInGroup(uID,groupName); });
+	};
 	//first see if we have this cached
 	{
 		CacheRecord<GroupMembership> record;
-		if(groupMembershipCache.find(uID+":"+groupName,record)){
-			//we have a cached record; is it still valid?
-			if(record){ //it is, just return it
+		if(groupMembershipCache.find(key,record)){
+			//we have a cached record; is it still usable?
+			if(useCachedRecord(record.expirationTime,"membership:"+key,[load]{ load(); })){
 				cacheHits++;
+				if(expiration)
+					*expiration=record.expirationTime;
 				return record;
 			}
 		}
 	}
+	//The record which is loaded will be cached no earlier than now, so it 
+	//will not expire before this. A record which could not be loaded is not 
+	//cached at all. 
+	auto loadExpiration=std::chrono::steady_clock::now()+userCacheValidity;
+	GroupMembership membership=load();
+	if(expiration)
+		*expiration=membership.valid?loadExpiration:std::chrono::steady_clock::time_point::min();
+	return membership;
+}
+
+std::string PersistentStore::enclosingAdminGroup(const std::string& uID, const std::string& groupName, 
+                                                 std::chrono::steady_clock::time_point* expiration, 
+                                                 bool* complete){
+	std::chrono::steady_clock::time_point closureExpiration;
+	std::shared_ptr<AdminClosure> closure=getAdminClosure(uID,closureExpiration);
+	if(expiration)
+		*expiration=closureExpiration;
+	if(complete)
+		*complete=closure->complete;
+	std::string result;
+	if(closure->enclosing.find(groupName,result))
+		return result;
+	//Walk up through the enclosing groups. This only consults the set in 
+	//memory, since groups' existence does not matter.
+	std::string name=groupName;
+	while(true){
+		auto sepPos=name.rfind('.');
+		if(sepPos==std::string::npos || sepPos==0)
+			break; //no farther up to walk
+		name.resize(sepPos);
+		if(closure->administered.count(name)){
+			result=name;
+			break;
+		}
+	}
+	closure->enclosing.insert(groupName,result);
+	return result;
+}
+
+std::shared_ptr<PersistentStore::AdminClosure> PersistentStore::getAdminClosure(const std::string& uID, 
+                                                                               std::chrono::steady_clock::time_point& expiration){
+	CacheRecord<std::shared_ptr<AdminClosure>> record;
+	if(adminClosureCache.find(uID,record) && record){
+		cacheHits++;
+		expiration=record.expirationTime;
+		return record.record;
+	}
+	//note the generation before reading memberships, so that any change 
+	//which the read might miss will prevent the result from being kept
+	uint64_t generation=adminClosureGeneration.load();
+	auto closure=std::make_shared<AdminClosure>();
+	std::vector<GroupMembership> memberships=getUserGroupMemberships(uID,&closure->complete);
+	for(const auto& membership : memberships){
+		if(membership.state==GroupMembership::Admin)
+			closure->administered.insert(membership.groupName);
+	}
+	//a closure missing some memberships could wrongly deny access, so it is 
+	//used only for the request which built it
+	if(!closure->complete){
+		log_error("Failed to read all memberships of " << uID << " to find groups which they administer");
+		expiration=std::chrono::steady_clock::time_point::min();
+		return closure;
+	}
+	//The closure is valid for as long as the cached list of memberships. 
+	//If there is no such list, because the user has no memberships, it is 
+	//only kept as long as the absence of a user would be. 
+	auto now=std::chrono::steady_clock::now();
+	expiration=groupMembershipByUserCache.find(uID).second;
+	if(expiration<=now)
+		expiration=now+negativeCacheValidity;
+	{
+		std::lock_guard<std::mutex> lock(adminClosureMutex);
+		if(adminClosureGeneration.load()==generation)
+			cacheRecord(adminClosureCache,uID,CacheRecord<std::shared_ptr<AdminClosure>>(closure,expiration));
+	}
+	return closure;
+}
+
+void PersistentStore::invalidateAuthorization(const std::string& uID){
+	{
+		std::lock_guard<std::mutex> lock(adminClosureMutex);
+		adminClosureGeneration++;
+		adminClosureCache.erase(uID);
+	}
+	//the closure must be gone before decisions can be remade from it
+	authorizer.invalidate(uID);
+}
+
+GroupMembership PersistentStore::loadUserStatusInGroup(const std::string& uID, const std::string& groupName){
 	//need to query the database
 	databaseQueries++;
 	log_info("Querying database for user " << uID << " membership in Group " << groupName);
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	auto outcome=getItem(Aws::DynamoDB::Model::GetItemRequest()
 								  .WithTableName(userTableName)
 								  .WithKey({{"unixName",AttributeValue(uID)},
 	                                        {"sortKey",AttributeValue(uID+":"+groupName)}}));
+	return finishLoadUserStatusInGroup(uID,groupName,outcome);
+}
+
+GroupMembership PersistentStore::finishLoadUserStatusInGroup(const std::string& uID, const std::string& groupName, 
+                                                             const Aws::DynamoDB::Model::GetItemOutcome& outcome){
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch user Group membership record: " << err.GetMessage());
@@ -1214,22 +2678,58 @@ GroupMembership PersistentStore::userStatusInGroup(const std::string& uID, std::
 		membership.stateSetBy=findOrThrow(item,"stateSetBy","membership record missing state set by attribute").GetS();
 	}
 	
+	//note the state previously cached, if any, so that a change found by 
+	//reloading the record can be detected
+	CacheRecord<GroupMembership> previous;
+	bool changed=groupMembershipCache.find(uID+":"+groupName,previous) 
+	             && previous.record.state!=membership.state;
+	
 	//update cache
 	CacheRecord<GroupMembership> record(membership,userCacheValidity);
-	replaceCacheRecord(groupMembershipCache,uID+":"+groupName,record);
-	groupMembershipByUserCache.insert_or_assign(uID,record);
-	groupMembershipByGroupCache.insert_or_assign(groupName,record);
+	cacheRecord(groupMembershipCache,uID+":"+groupName,record);
+	cacheRecord(groupMembershipByUserCache,uID,record);
+	cacheRecord(groupMembershipByGroupCache,groupName,record);
+	//decisions made from the old record must not outlive it, and this must 
+	//happen after the new record is in place so that they are not remade 
+	//from the old one
+	if(changed)
+		invalidateAuthorization(uID);
 	
 	return membership;
 }
 
+std::future<GroupMembership> PersistentStore::userStatusInGroupAsync(const std::string& uID, std::string groupName){
+	const std::string key=uID+":"+groupName;
+	{
+		CacheRecord<GroupMembership> record;
+		if(groupMembershipCache.find(key,record)){
+			auto load=[this,uID,groupName,key]{
+				return membershipLoads.run(key,[&]{ return loadUserStatusInGroup(uID,groupName); });
+			};
+			if(useCachedRecord(record.expirationTime,"membership:"+key,[load]{ load(); })){
+				cacheHits++;
+				return readyFuture<GroupMembership>(record);
+			}
+		}
+	}
+	log_info("Querying database for user " << uID << " membership in Group " << groupName);
+	using Aws::DynamoDB::Model::AttributeValue;
+	return getItemAsync<GroupMembership>(Aws::DynamoDB::Model::GetItemRequest()
+	                                     .WithTableName(userTableName)
+	                                     .WithKey({{"unixName",AttributeValue(uID)},
+	                                               {"sortKey",AttributeValue(uID+":"+groupName)}}),
+	                                     [this,uID,groupName](const Aws::DynamoDB::Model::GetItemOutcome& outcome){
+	                                     	return finishLoadUserStatusInGroup(uID,groupName,outcome);
+	                                     });
+}
+
 bool PersistentStore::setUserSecondaryAttribute(const std::string& uID, 
                                 const std::string& attributeName, 
                                 const std::string& attributeValue){
 	if(attributeValue.empty())
 		throw std::runtime_error("Attribute value must not be empty because Dynamo");
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	auto outcome=putItem(Aws::DynamoDB::Model::PutItemRequest()
 	                              .WithTableName(userTableName)
 	                              .WithItem({{"unixName",AV(uID)},
 	                                         {"sortKey",AV(uID+":attr:"+attributeName)},
@@ -1241,78 +2741,106 @@ bool PersistentStore::setUserSecondaryAttribute(const std::string& uID,
 		return false;
 	}
 	
-	//update caches
-	auto record=std::make_pair(attributeName,CacheRecord<std::string>(attributeValue,userCacheValidity));
-	std::map<std::string,CacheRecord<std::string>> m{record};
-	userAttributeCache.upsert(uID,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		auto it=attrs.find(record.first);
-		if(it==attrs.end())
-			attrs.insert(record);
-		else
-			it->second=record.second;
-	},m);
+	//update the cached set of attributes, if any; there is no point in 
+	//caching a set containing only this attribute, since it would not be 
+	//known to be complete
+	userAttributeCache.update_fn(uID,[&](AttributeRecord& record){
+		record.record=std::make_shared<const attribute_table>(record.record->with(attributeName,attributeValue));
+	});
+	announceChange(ChangeEvent::UserAttributeChanged,uID);
     
 	return true;
 }
 
 std::string PersistentStore::getUserSecondaryAttribute(const std::string& uID, const std::string& attributeName){
+	std::string value;
+	auto attributes=getSecondaryAttributes(userAttributeCache,userTableName,"unixName",uID,userCacheValidity);
+	if(attributes)
+		attributes->find(attributeName,value);
+	return value;
+}
+
+std::map<std::string,std::string> PersistentStore::getUserSecondaryAttributes(const std::string& uID){
+	std::map<std::string,std::string> result;
+	auto attributes=getSecondaryAttributes(userAttributeCache,userTableName,"unixName",uID,userCacheValidity);
+	if(attributes)
+		attributes->for_each([&result](const std::string& name, const std::string& value){ result.emplace(name,value); });
+	return result;
+}
+
+std::shared_ptr<const attribute_table> 
+PersistentStore::getSecondaryAttributes(bounded_cache<std::string,AttributeRecord>& cache, 
+                                        const std::string& tableName, const std::string& keyName, 
+                                        const std::string& owner, std::chrono::seconds validity){
+	const std::string flightKey=tableName+":"+owner;
+	auto load=[this,&cache,tableName,keyName,owner,validity,flightKey]{
+		return attributeLoads.run(flightKey,[&]{ return loadSecondaryAttributes(cache,tableName,keyName,owner,validity); });
+	};
 	//first see if we have this cached
 	{
-		CacheRecord<std::string> record;
-		if(userAttributeCache.find_fn(uID,[&](const std::map<std::string,CacheRecord<std::string>>& attrs){
-			auto it=attrs.find(attributeName);
-			if(it!=attrs.end())
-				record=it->second;
-		})){
-			//we have a cached record; is it still valid?
-			if(record){ //it is, just return it
+		AttributeRecord record;
+		if(cache.find(owner,record)){
+			//we have a cached record; is it still usable?
+			if(useCachedRecord(record.expirationTime,"attributes:"+flightKey,[load]{ load(); })){
 				cacheHits++;
-				return record;
+				return record.record;
 			}
 		}
 	}
-	//need to query the database
+	return load();
+}
+
+std::shared_ptr<const attribute_table> 
+PersistentStore::loadSecondaryAttributes(bounded_cache<std::string,AttributeRecord>& cache, 
+                                         const std::string& tableName, const std::string& keyName, 
+                                         const std::string& owner, std::chrono::seconds validity){
 	databaseQueries++;
-	log_info("Querying database for user secondary record " << uID << ':' << attributeName);
+	log_info("Querying database for secondary attributes of " << owner);
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
-								  .WithTableName(userTableName)
-								  .WithKey({{"unixName",AV(uID)},
-	                                        {"sortKey",AV(uID+":attr:"+attributeName)}}));
-	if(!outcome.IsSuccess()){
-		auto err=outcome.GetError();
-		log_error("Failed to user secondary record: " << err.GetMessage());
-		return std::string{};
-	}
-	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
-		return std::string{};
-	
-	std::string result=findOrThrow(item,"secondaryAttribute","user secondary record missing attribute").GetS();
-	
-	//update cache
-	auto record=std::make_pair(uID,CacheRecord<std::string>(result,userCacheValidity));
-	std::map<std::string,CacheRecord<std::string>> m{record};
-	userAttributeCache.upsert(uID,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		auto it=attrs.find(record.first);
-		if(it==attrs.end())
-			attrs.insert(record);
+	const std::string prefix=owner+":attr:";
+	auto request=Aws::DynamoDB::Model::QueryRequest()
+	.WithTableName(tableName)
+	.WithKeyConditionExpression("#key = :key AND begins_with(#sortKey,:prefix)")
+	.WithExpressionAttributeNames({
+		{"#key",keyName},
+		{"#sortKey","sortKey"}
+	})
+	.WithExpressionAttributeValues({
+		{":key",AV(owner)},
+		{":prefix",AV(prefix)}
+	});
+	std::vector<attribute_table::value_type> attributes;
+	bool keepGoing=false;
+	do{
+		auto outcome=query(request);
+		if(!outcome.IsSuccess()){
+			auto err=outcome.GetError();
+			log_error("Failed to fetch secondary attribute records: " << err.GetMessage());
+			return nullptr;
+		}
+		const auto& result=outcome.GetResult();
+		//set up fetching the next page if necessary
+		if(!result.GetLastEvaluatedKey().empty()){
+			keepGoing=true;
+			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
+		}
 		else
-			it->second=record.second;
-	},m);
+			keepGoing=false;
+		for(const auto& item : result.GetItems()){
+			std::string sortKey=findOrThrow(item,"sortKey","secondary record missing sortKey").GetS();
+			attributes.emplace_back(sortKey.substr(prefix.size()),
+			                        findOrThrow(item,"secondaryAttribute","secondary record missing attribute").GetS());
+		}
+	}while(keepGoing);
 	
-	return result;
+	auto table=std::make_shared<const attribute_table>(std::move(attributes));
+	cacheRecord(cache,owner,AttributeRecord(table,validity));
+	return table;
 }
 
 bool PersistentStore::removeUserSecondaryAttribute(const std::string& uID, const std::string& attributeName){
-	//remove from cache is present there
-	userAttributeCache.erase_fn(uID,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		attrs.erase(attributeName);
-		return attrs.empty(); //if the map for this user is empty, remove it entirely
-	});
-	
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
+	auto outcome=deleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
 								     .WithTableName(userTableName)
 								     .WithKey({{"unixName",AV(uID)},
 	                                           {"sortKey",AV(uID+":attr:"+attributeName)}}));
@@ -1321,6 +2849,10 @@ bool PersistentStore::removeUserSecondaryAttribute(const std::string& uID, const
 		log_error("Failed to delete secondary user record record: " << err.GetMessage());
 		return false;
 	}
+	userAttributeCache.update_fn(uID,[&](AttributeRecord& record){
+		record.record=std::make_shared<const attribute_table>(record.record->without(attributeName));
+	});
+	announceChange(ChangeEvent::UserAttributeChanged,uID);
 	return true;
 }
 
@@ -1329,7 +2861,7 @@ bool PersistentStore::unixNameInUse(const std::string& name){
 	//need to query the database
 	databaseQueries++;
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=query(Aws::DynamoDB::Model::QueryRequest()
 								.WithTableName(userTableName)
 								.WithKeyConditionExpression("#unixName = :name_val")
 								.WithExpressionAttributeNames({{"#unixName","unixName"}})
@@ -1343,7 +2875,7 @@ bool PersistentStore::unixNameInUse(const std::string& name){
 	return (queryResult.GetCount()>0);
 }
 
-std::vector<GroupMembership> PersistentStore::getUserGroupMemberships(const std::string& uID){
+std::vector<GroupMembership> PersistentStore::getUserGroupMemberships(const std::string& uID, bool* complete){
 	//first check if list of memberships is cached
 	auto cached = groupMembershipByUserCache.find(uID);
 	if (cached.second > std::chrono::steady_clock::now()) {
@@ -1353,11 +2885,18 @@ std::vector<GroupMembership> PersistentStore::getUserGroupMemberships(const std:
 			cacheHits++;
 			memberships.push_back(record);
 		}
+		if(complete)
+			*complete=true;
 		return memberships;
 	}
+	MembershipPage list=userMembershipListLoads.run("user:"+uID,[this,&uID]{ return loadUserGroupMemberships(uID); });
+	if(complete)
+		*complete=list.valid;
+	return list.memberships;
+}
 
+PersistentStore::MembershipPage PersistentStore::loadUserGroupMemberships(const std::string& uID){
 	using Aws::DynamoDB::Model::AttributeValue;
-	databaseQueries++;
 	log_info("Querying database for user " << uID << " Group memberships");
 	auto request=Aws::DynamoDB::Model::QueryRequest()
 	.WithTableName(userTableName)
@@ -1370,16 +2909,29 @@ std::vector<GroupMembership> PersistentStore::getUserGroupMemberships(const std:
 		{":id",AttributeValue(uID)},
 		{":prefix",AttributeValue(uID+":")}
 	});
-	auto outcome=dbClient.Query(request);
-	std::vector<GroupMembership> memberships;
-	if(!outcome.IsSuccess()){
-		auto err=outcome.GetError();
-		log_error("Failed to fetch user's Group membership records: " << err.GetMessage());
-		return memberships;
+	std::vector<DynamoItem> items;
+	MembershipPage list;
+	if(!queryAll(request,items)){
+		log_error("Failed to fetch user's Group membership records");
+		//an incomplete list must not be cached
+		for(const auto& item : items){
+			if(item.count("groupName"))
+				list.memberships.push_back(decodeMembership(item));
+		}
+		return list;
 	}
+	std::vector<GroupMembership>& memberships=list.memberships;
 	
-	const auto& queryResult=outcome.GetResult();
-	for(const auto& item : queryResult.GetItems()){
+	//note the states previously cached, so that changes found by reloading 
+	//the list can be detected
+	std::map<std::string,GroupMembership::Status> previousStates;
+	for(const auto& record : groupMembershipByUserCache.find(uID).first){
+		if(record.record.state!=GroupMembership::NonMember)
+			previousStates[record.record.groupName]=record.record.state;
+	}
+	bool changed=false;
+	
+	for(const auto& item : items){
 		if(item.count("groupName")){
 			GroupMembership membership;
 			membership.userName=uID;
@@ -1389,17 +2941,33 @@ std::vector<GroupMembership> PersistentStore::getUserGroupMemberships(const std:
 			membership.valid=true;
 			memberships.push_back(membership);
 			
+			CacheRecord<GroupMembership> previous;
+			if(groupMembershipCache.find(uID+":"+membership.groupName,previous) 
+			   && previous.record.state!=membership.state)
+				changed=true;
+			auto previousState=previousStates.find(membership.groupName);
+			if(previousState!=previousStates.end()){
+				if(previousState->second!=membership.state)
+					changed=true;
+				previousStates.erase(previousState);
+			}
+			
 			CacheRecord<GroupMembership> record(membership,userCacheValidity);
-			replaceCacheRecord(groupMembershipCache,uID+":"+membership.groupName,record);
-			groupMembershipByUserCache.insert_or_assign(uID,record);
-			groupMembershipByGroupCache.insert_or_assign(membership.groupName,record);
+			cacheRecord(groupMembershipCache,uID+":"+membership.groupName,record);
+			cacheRecord(groupMembershipByUserCache,uID,record);
+			cacheRecord(groupMembershipByGroupCache,membership.groupName,record);
 		}
 	}
 	
 	auto expirationTime = std::chrono::steady_clock::now() + userCacheValidity;
 	groupMembershipByUserCache.update_expiration(uID, expirationTime);
+	scheduleExpiry(groupMembershipByUserCache,uID,expirationTime);
+	//memberships which were cached but are no longer present have also changed
+	if(changed || !previousStates.empty())
+		invalidateAuthorization(uID);
 	
-	return memberships;
+	list.valid=true;
+	return list;
 }
 
 //----
@@ -1422,10 +2990,10 @@ bool PersistentStore::addGroup(Group& group){
 			log_fatal("Existing group ID (" << group.unixID << ") is already in use");
 	}
 	else
-		group.unixID=allocateUnixID(groupTableName, "name", minimumGroupID, maximumGroupID, group.name);
+		group.unixID=allocateUnixID(groupIDAllocator, groupTableName, "name", minimumGroupID, maximumGroupID, group.name);
 		
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	auto outcome=putItem(Aws::DynamoDB::Model::PutItemRequest()
 	                              .WithTableName(groupTableName)
 	                              .WithItem({{"name",AV(group.name)},
 	                                         {"sortKey",AV(group.name)},
@@ -1445,7 +3013,9 @@ bool PersistentStore::addGroup(Group& group){
 	
 	//update caches
 	CacheRecord<Group> record(group,groupCacheValidity);
-	replaceCacheRecord(groupCache,group.name,record);
+	cacheRecord(groupCache,group.name,record);
+	groupDirectory.upsert(group.name,group);
+	announceChange(ChangeEvent::GroupChanged,group.name);
         
 	return true;
 }
@@ -1461,14 +3031,14 @@ bool PersistentStore::addGroupRequest(GroupRequest& gr){
 		throw std::runtime_error("Group description must not be empty because Dynamo");
 	using AV=Aws::DynamoDB::Model::AttributeValue;
 	
-	gr.unixID=allocateUnixID(groupTableName, "name", minimumGroupID, maximumGroupID, gr.name);
+	gr.unixID=allocateUnixID(groupIDAllocator, groupTableName, "name", minimumGroupID, maximumGroupID, gr.name);
 	
 	AV secondary;
 	secondary.AddMEntry("dummy",std::make_shared<AV>("dummy"));
 	for(const auto& entry : gr.secondaryAttributes)
 		secondary.AddMEntry(entry.first,std::make_shared<AV>(entry.second));
 	
-	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	auto outcome=putItem(Aws::DynamoDB::Model::PutItemRequest()
 	                              .WithTableName(groupTableName)
 	                              .WithItem({{"name",AV(gr.name)},
 	                                         {"sortKey",AV(gr.name)},
@@ -1489,54 +3059,47 @@ bool PersistentStore::addGroupRequest(GroupRequest& gr){
 	
 	//update caches
 	CacheRecord<GroupRequest> record(gr,groupCacheValidity);
-	replaceCacheRecord(groupRequestCache,gr.name,record);
+	cacheRecord(groupRequestCache,gr.name,record);
+	groupRequestDirectory.upsert(gr.name,gr);
+	announceChange(ChangeEvent::GroupChanged,gr.name);
         
 	return true;
 }
 
-bool PersistentStore::removeGroup(const std::string& groupName){
-	using Aws::DynamoDB::Model::AttributeValue;
-	
-	//delete all memberships in the group
-	for(auto membership : getMembersOfGroup(groupName)){
-		if(!removeUserFromGroup(membership.userName,groupName))
-			return false;
-	}
-	
+bool PersistentStore::removeGroup(const std::string& groupName){
 	//erase cache entries
 	{
 		groupCache.erase(groupName);
 		groupRequestCache.erase(groupName);
 		groupMembershipByGroupCache.erase(groupName);
-	}
-	
-	//delete the Group record itself
-	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
-								     .WithTableName(groupTableName)
-								     .WithKey({{"name",AttributeValue(groupName)},
-	                                           {"sortKey",AttributeValue(groupName)}}));
-	if(!outcome.IsSuccess()){
-		auto err=outcome.GetError();
-		log_error("Failed to delete Group record: " << err.GetMessage());
-		return false;
-	}
-	
-	//clean up any secondary attribute records tied to the group
-	databaseScans++;
-	Aws::DynamoDB::Model::ScanRequest request;
-	request.SetTableName(groupTableName);
-	request.SetFilterExpression("attribute_exists(#extra) AND #name = :name");
-	request.SetExpressionAttributeNames({{"#extra", "secondaryAttribute"},{"#name", "name"}});
-	request.SetExpressionAttributeValues({{":name",AttributeValue(groupName)}});
+		groupAttributeCache.erase(groupName);
+		groupDirectory.erase(groupName);
+		groupRequestDirectory.erase(groupName);
+	}
+	
+	//delete the Group record, all secondary records, and all memberships
+	std::vector<std::pair<std::string,std::string>> memberships;
+	bool success=cascadeDelete(groupTableName,"name",groupName,"ByGroup",memberships);
+	for(const auto& membership : memberships){
+		forgetMembership(membership.first,membership.second);
+		announceChange(ChangeEvent::MembershipChanged,membership.first,membership.second);
+	}
+	groupMembershipByGroupCache.erase(groupName);
+	announceChange(ChangeEvent::GroupChanged,groupName);
+	announceChange(ChangeEvent::GroupAttributeChanged,groupName);
+	if(!success)
+		log_error("Failed to delete all records of Group " << groupName);
+	return success;
+}
+
+bool PersistentStore::queryAll(Aws::DynamoDB::Model::QueryRequest request, std::vector<BatchWriter::Item>& items){
 	bool keepGoing=false;
-	
-	std::vector<std::string> toDelete;
 	do{
-		auto outcome=dbClient.Scan(request);
+		databaseQueries++;
+		auto outcome=query(request);
 		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
 			auto err=outcome.GetError();
-			log_error("Failed to fetch Group secondary records: " << err.GetMessage());
+			log_error("Failed to query " << request.GetTableName() << ": " << err.GetMessage());
 			return false;
 		}
 		const auto& result=outcome.GetResult();
@@ -1547,87 +3110,179 @@ bool PersistentStore::removeGroup(const std::string& groupName){
 		}
 		else
 			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems())
-			toDelete.push_back(findOrThrow(item,"sortKey","Group secondary record missing sortKey attribute").GetS());
+		items.insert(items.end(),result.GetItems().begin(),result.GetItems().end());
 	}while(keepGoing);
+	return true;
+}
+
+bool PersistentStore::cascadeDelete(const std::string& tableName, const std::string& keyName,
+                                    const std::string& owner, const std::string& membershipIndex,
+                                    std::vector<std::pair<std::string,std::string>>& deletedMemberships){
+	using Aws::DynamoDB::Model::AttributeValue;
+	log_info("Querying database for all records of " << owner);
+	//Everything belonging to the entity is in its own partition, except, for 
+	//groups, memberships, which are found through the index on group name
+	std::vector<DynamoItem> items;
+	if(!queryAll(Aws::DynamoDB::Model::QueryRequest()
+	             .WithTableName(tableName)
+	             .WithKeyConditionExpression("#key = :owner")
+	             .WithProjectionExpression("#key, #sortKey, #groupName")
+	             .WithExpressionAttributeNames({{"#key",keyName},{"#sortKey","sortKey"},{"#groupName","groupName"}})
+	             .WithExpressionAttributeValues({{":owner",AttributeValue(owner)}}),items))
+		return false;
+	std::vector<DynamoItem> memberships;
+	if(!membershipIndex.empty() && 
+	   !queryAll(Aws::DynamoDB::Model::QueryRequest()
+	             .WithTableName(userTableName)
+	             .WithIndexName(membershipIndex)
+	             .WithKeyConditionExpression("#groupName = :owner")
+	             .WithProjectionExpression("#unixName, #sortKey")
+	             .WithExpressionAttributeNames({{"#unixName","unixName"},{"#sortKey","sortKey"},{"#groupName","groupName"}})
+	             .WithExpressionAttributeValues({{":owner",AttributeValue(owner)}}),memberships))
+		return false;
 	
-	for(const auto& sortKey : toDelete){
-		outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
-										 .WithTableName(groupTableName)
-										 .WithKey({{"name",AttributeValue(groupName)},
-												   {"sortKey",AttributeValue(sortKey)}}));
-		if(!outcome.IsSuccess()){
-			auto err=outcome.GetError();
-			log_error("Failed to delete Group record: " << err.GetMessage());
-			return false;
+	std::vector<DynamoItem> keys, membershipKeys;
+	std::vector<std::pair<std::string,std::string>> membershipNames;
+	keys.reserve(items.size());
+	for(const auto& item : items){
+		DynamoItem key={{keyName,findOrThrow(item,keyName,"record missing key attribute")},
+		                {"sortKey",findOrThrow(item,"sortKey","record missing sortKey attribute")}};
+		//membership records in the user's partition
+		if(item.count("groupName")){
+			membershipKeys.push_back(std::move(key));
+			membershipNames.emplace_back(owner,item.find("groupName")->second.GetS());
 		}
+		else
+			keys.push_back(std::move(key));
+	}
+	for(const auto& item : memberships){
+		const auto& uID=findOrThrow(item,"unixName","membership record missing unixName attribute");
+		membershipKeys.push_back({{"unixName",uID},
+		                          {"sortKey",findOrThrow(item,"sortKey","membership record missing sortKey attribute")}});
+		membershipNames.emplace_back(uID.GetS(),owner);
 	}
 	
-	return true;
+	BatchWriter writer=makeBatchWriter();
+	bool success=true;
+	auto deleted=writer.remove(userTableName,membershipKeys);
+	for(std::size_t i=0; i<deleted.size(); i++){
+		if(deleted[i])
+			deletedMemberships.push_back(membershipNames[i]);
+		else
+			success=false;
+	}
+	//only remove the entity itself once nothing refers to it
+	if(!success)
+		return false;
+	for(bool done : writer.remove(tableName,keys))
+		success&=done;
+	return success;
+}
+
+void PersistentStore::forgetMembership(const std::string& uID, const std::string& groupName){
+	//write non-member status to all caches
+	GroupMembership membership;
+	membership.valid=true;
+	membership.userName=uID;
+	membership.groupName=groupName;
+	membership.state=GroupMembership::NonMember;
+	CacheRecord<GroupMembership> record(membership,userCacheValidity);
+	cacheRecord(groupMembershipCache,uID+":"+groupName,record);
+	cacheRecord(groupMembershipByUserCache,uID,record);
+	cacheRecord(groupMembershipByGroupCache,groupName,record);
+	invalidateAuthorization(uID);
+
+	{
+		CacheRecord<GroupMembership> record;
+		bool cached=groupMembershipCache.find(groupName,record);
+		if (cached){
+			groupMembershipByUserCache.erase(uID,record);
+			groupMembershipByGroupCache.erase(groupName,record);
+			groupMembershipCache.erase(uID);
+		}
+	}
 }
 
-bool PersistentStore::updateGroup(const Group& group){
+bool PersistentStore::updateGroup(const Group& group, const std::set<std::string>& attributes){
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	using AVU=Aws::DynamoDB::Model::AttributeValueUpdate;
-	auto outcome=dbClient.UpdateItem(Aws::DynamoDB::Model::UpdateItemRequest()
-	                                 .WithTableName(groupTableName)
-	                                 .WithKey({{"name",AV(group.name)},
-	                                           {"sortKey",AV(group.name)}})
-	                                 .WithAttributeUpdates({
-	                                            {"displayName",AVU().WithValue(AV(group.displayName))},
-	                                            {"email",AVU().WithValue(AV(group.email))},
-	                                            {"phone",AVU().WithValue(AV(group.phone))},
-	                                            {"purpose",AVU().WithValue(AV(group.purpose))},
-	                                            {"description",AVU().WithValue(AV(group.description))},
-	                                            })
-	                                 );
+	AttributeChanges changes(attributes);
+	changes.offer("displayName",group.displayName);
+	changes.offer("email",group.email);
+	changes.offer("phone",group.phone);
+	changes.offer("purpose",group.purpose);
+	changes.offer("description",group.description);
+	if(changes.empty()){
+		log_info("Update to " << group << " changes nothing");
+		return true;
+	}
+	
+	Aws::DynamoDB::Model::UpdateItemRequest request;
+	request.SetTableName(groupTableName);
+	request.SetKey({{"name",AV(group.name)},
+	                {"sortKey",AV(group.name)}});
+	changes.applyTo(request,"name");
+	auto outcome=updateItem(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
-		log_error("Failed to update Group record: " << err.GetMessage());
+		if(err.GetErrorType()==Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED)
+			log_info("Not updating " << group << " because it no longer exists");
+		else
+			log_error("Failed to update Group record: " << err.GetMessage());
 		return false;
 	}
 	
 	//update caches
 	CacheRecord<Group> record(group,groupCacheValidity);
-	replaceCacheRecord(groupCache,group.name,record);
+	cacheRecord(groupCache,group.name,record);
+	groupDirectory.upsert(group.name,group);
+	announceChange(ChangeEvent::GroupChanged,group.name);
 	
 	return true;
 }
 
-bool PersistentStore::updateGroupRequest(const GroupRequest& request){
+bool PersistentStore::updateGroupRequest(const GroupRequest& request, const std::set<std::string>& attributes){
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	using AVU=Aws::DynamoDB::Model::AttributeValueUpdate;
-	
-	AV secondary;
-	secondary.AddMEntry("dummy",std::make_shared<AV>("dummy"));
-	for(const auto& entry : request.secondaryAttributes)
-		secondary.AddMEntry(entry.first,std::make_shared<AV>(entry.second));
-	
-	auto outcome=dbClient.UpdateItem(Aws::DynamoDB::Model::UpdateItemRequest()
-	                                 .WithTableName(groupTableName)
-	                                 .WithKey({{"name",AV(request.name)},
-	                                           {"sortKey",AV(request.name)}})
-	                                 .WithAttributeUpdates({
-	                                            {"displayName",AVU().WithValue(AV(request.displayName))},
-	                                            {"email",AVU().WithValue(AV(request.email))},
-	                                            {"phone",AVU().WithValue(AV(request.phone))},
-	                                            {"purpose",AVU().WithValue(AV(request.purpose))},
-	                                            {"description",AVU().WithValue(AV(request.description))},
-	                                            {"requester",AVU().WithValue(AV(request.requester))},
-	                                            {"secondaryAttributes",AVU().WithValue(secondary)}
-	                                            })
-	                                 );
+	AttributeChanges changes(attributes);
+	changes.offer("displayName",request.displayName);
+	changes.offer("email",request.email);
+	changes.offer("phone",request.phone);
+	changes.offer("purpose",request.purpose);
+	changes.offer("description",request.description);
+	changes.offer("requester",request.requester);
+	if(attributes.count("secondaryAttributes")){
+		//the map is written whole
+		AV secondary;
+		secondary.AddMEntry("dummy",std::make_shared<AV>("dummy"));
+		for(const auto& entry : request.secondaryAttributes)
+			secondary.AddMEntry(entry.first,std::make_shared<AV>(entry.second));
+		changes.set("secondaryAttributes",secondary);
+	}
+	if(changes.empty()){
+		log_info("Update to " << request << " changes nothing");
+		return true;
+	}
+	
+	Aws::DynamoDB::Model::UpdateItemRequest updateRequest;
+	updateRequest.SetTableName(groupTableName);
+	updateRequest.SetKey({{"name",AV(request.name)},
+	                      {"sortKey",AV(request.name)}});
+	changes.applyTo(updateRequest,"name");
+	auto outcome=updateItem(updateRequest);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
-		log_error("Failed to update Group Request record: " << err.GetMessage());
+		if(err.GetErrorType()==Aws::DynamoDB::DynamoDBErrors::CONDITIONAL_CHECK_FAILED)
+			log_info("Not updating " << request << " because it no longer exists");
+		else
+			log_error("Failed to update Group Request record: " << err.GetMessage());
 		return false;
 	}
 	
 	//update caches
 	groupCache.erase(request.name);
 	CacheRecord<GroupRequest> record(request,groupCacheValidity);
-	replaceCacheRecord(groupRequestCache,request.name,record);
+	cacheRecord(groupRequestCache,request.name,record);
+	groupRequestDirectory.upsert(request.name,request);
+	announceChange(ChangeEvent::GroupChanged,request.name);
 	
 	return true;
 }
@@ -1646,25 +3301,61 @@ std::vector<GroupMembership> PersistentStore::getMembersOfGroup(const std::strin
 		}
 		return memberships;
 	}
+	return membershipListLoads.run("group:"+groupName,[this,&groupName]{ return loadMembersOfGroup(groupName); });
+}
 
-	using Aws::DynamoDB::Model::AttributeValue;
-	databaseQueries++;
+std::vector<GroupMembership> PersistentStore::loadMembersOfGroup(const std::string& groupName){
 	log_info("Querying database for members of Group " << groupName);
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
-	                            .WithTableName(userTableName)
-	                            .WithIndexName("ByGroup")
-	                            .WithKeyConditionExpression("#groupName = :id_val")
-	                            .WithExpressionAttributeNames({{"#groupName","groupName"}})
-								.WithExpressionAttributeValues({{":id_val",AttributeValue(groupName)}})
-	                            );
 	std::vector<GroupMembership> memberships;
+	std::string cursor;
+	do{
+		auto page=getMembersOfGroupPage(groupName,0,cursor);
+		if(!page.valid)
+			return memberships; //an incomplete list must not be marked as cached
+		for(const auto& membership : page.memberships){
+			CacheRecord<GroupMembership> record(membership,userCacheValidity);
+			cacheRecord(groupMembershipByUserCache,membership.userName,record);
+			cacheRecord(groupMembershipByGroupCache,groupName,record);
+		}
+		std::move(page.memberships.begin(),page.memberships.end(),std::back_inserter(memberships));
+		cursor=std::move(page.cursor);
+	}while(!cursor.empty());
+	
+	auto expirationTime = std::chrono::steady_clock::now() + groupCacheValidity;
+	groupMembershipByGroupCache.update_expiration(groupName, expirationTime);
+	scheduleExpiry(groupMembershipByGroupCache,groupName,expirationTime);
+	
+	return memberships;
+}
+
+PersistentStore::MembershipPage PersistentStore::getMembersOfGroupPage(const std::string& groupName, unsigned int limit, 
+                                                                       const std::string& cursor){
+	using Aws::DynamoDB::Model::AttributeValue;
+	databaseQueries++;
+	auto request=Aws::DynamoDB::Model::QueryRequest()
+	             .WithTableName(userTableName)
+	             .WithIndexName("ByGroup")
+	             .WithKeyConditionExpression("#groupName = :id_val")
+	             .WithExpressionAttributeNames({{"#groupName","groupName"}})
+	             .WithExpressionAttributeValues({{":id_val",AttributeValue(groupName)}});
+	if(limit)
+		request.SetLimit(limit);
+	//The cursor is the name of the last user returned, from which the full 
+	//key of that user's membership record can be reconstructed
+	if(!cursor.empty())
+		request.SetExclusiveStartKey({{"groupName",AttributeValue(groupName)},
+		                              {"unixName",AttributeValue(cursor)},
+		                              {"sortKey",AttributeValue(cursor+":"+groupName)}});
+	
+	MembershipPage page;
+	auto outcome=query(request);
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch Group membership records: " << err.GetMessage());
-		return memberships;
+		return page;
 	}
 	const auto& queryResult=outcome.GetResult();
-	memberships.reserve(queryResult.GetCount());
+	page.memberships.reserve(queryResult.GetCount());
 	for(const auto& item : queryResult.GetItems()){
 		GroupMembership membership;
 		membership.userName=findOrThrow(item,"unixName","membership record missing user unixName attribute").GetS();
@@ -1672,168 +3363,330 @@ std::vector<GroupMembership> PersistentStore::getMembersOfGroup(const std::strin
 		membership.state=GroupMembership::from_string(findOrThrow(item,"state","membership record missing state attribute").GetS());
 		membership.stateSetBy=findOrThrow(item,"stateSetBy","membership record missing state set by attribute").GetS();
 		membership.valid=true;
-		memberships.push_back(membership);
+		page.memberships.push_back(membership);
 		
 		CacheRecord<GroupMembership> record(membership,userCacheValidity);
-		replaceCacheRecord(groupMembershipCache,membership.userName+":"+groupName,record);
-		groupMembershipByUserCache.insert_or_assign(membership.userName,record);
-		groupMembershipByGroupCache.insert_or_assign(groupName,record);
+		cacheRecord(groupMembershipCache,membership.userName+":"+groupName,record);
 	}
-	
-	auto expirationTime = std::chrono::steady_clock::now() + groupCacheValidity;
-	groupMembershipByGroupCache.update_expiration(groupName, expirationTime);
-	
-	return memberships;
+	const auto& lastKey=queryResult.GetLastEvaluatedKey();
+	if(!lastKey.empty())
+		page.cursor=findOrThrow(lastKey,"unixName","membership key missing unixName attribute").GetS();
+	page.valid=true;
+	return page;
+}
+
+bool PersistentStore::forEachMemberOfGroup(const std::string& groupName, 
+                                           const std::function<void(const GroupMembership&)>& visit){
+	{
+		auto cached = groupMembershipByGroupCache.find(groupName);
+		if (cached.second > std::chrono::steady_clock::now()) {
+			cacheHits++;
+			for (const auto& record : cached.first)
+				visit(record);
+			return true;
+		}
+	}
+	std::string cursor;
+	do{
+		auto page=getMembersOfGroupPage(groupName,0,cursor);
+		if(!page.valid)
+			return false;
+		for(const auto& membership : page.memberships)
+			visit(membership);
+		cursor=std::move(page.cursor);
+	}while(!cursor.empty());
+	return true;
 }
 
 std::vector<Group> PersistentStore::listGroups(){
 	//First check if groups are cached
-	std::vector<Group> collected;
-	if(groupCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-	    auto table = groupCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
+	{
+		auto snapshot=groupDirectory.get();
+		if(snapshot->valid()){
 			cacheHits++;
-			collected.push_back(itr->second);
+			return snapshot->values();
 		}
-	
-		table.unlock();
-		return collected;
-	}	
+	}
+	//all concurrent requests can share one scan
+	return groupScans.run("",[this]{ return scanGroups(); });
+}
 
+std::vector<Group> PersistentStore::scanGroups(){
+	std::vector<Group> collected;
+	auto rebuild=groupDirectory.begin_rebuild();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(groupTableName);
 	request.SetFilterExpression("attribute_not_exists(#requester) and attribute_not_exists(#secondAttr) and attribute_not_exists(#nextID)");
 	request.SetExpressionAttributeNames({{"#requester", "requester"},{"#secondAttr", "secondaryAttribute"},{"#nextID", "next_unixID"}});
-	bool keepGoing=false;
 	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch Group records: " << err.GetMessage());
-			return collected;
-		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
-		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			
-		
-			Group group;
-			group.valid=true;
-			group.name=findOrThrow(item,"name","Group record missing name attribute").GetS();
-			//try{
-			group.displayName=findOrThrow(item,"displayName","Group record missing displayName attribute").GetS();
-			/*}catch(std::exception& e){
-				std::cout << "Group " << group.name << " missing displayName" << std::endl;
-				for(const auto& entry : item){
-					std::cout << " attribute: " << entry.first << " -> ";
-					switch(entry.second.GetType()){
-						case Aws::DynamoDB::Model::ValueType::STRING:
-							std::cout << "[string]\"" << entry.second.GetS() << "\"\n";
-							break;
-						case Aws::DynamoDB::Model::ValueType::NUMBER:
-							std::cout << "[number]" << entry.second.GetN() << '\n';
-							break;
-						case Aws::DynamoDB::Model::ValueType::BOOL:
-							std::cout << "[bool]" << (entry.second.GetBool()?"true":"false") << '\n';
-							break;
-						default:
-							std::cout << "[something else]\n";
-							break;
-					}
-				}
-				continue;
-			}*/
-			group.email=findOrThrow(item,"email","Group record missing email attribute").GetS();
-			group.phone=findOrThrow(item,"phone","Group record missing phone attribute").GetS();
-			group.purpose=findOrThrow(item,"purpose","Group record missing purpose attribute").GetS();
-			group.description=findOrThrow(item,"description","Group record missing description attribute").GetS();
-			group.creationDate=findOrThrow(item,"creationDate","Group record missing creation date attribute").GetS();
-			group.unixID=std::stoul(findOrThrow(item,"unixID","Group record missing unixID attribute").GetN());
-			collected.push_back(group);
-
+	try{
+		collected=makeScan().collect<Group>(request,[this](const DynamoItem& item, std::vector<Group>& groups){
+			Group group=decodeGroup(item);
 			CacheRecord<Group> record(group,groupCacheValidity);
-			replaceCacheRecord(groupCache,group.name,record);
-		}
-	}while(keepGoing);
-	groupCacheExpirationTime=std::chrono::steady_clock::now()+groupCacheValidity;
+			cacheRecord(groupCache,group.name,record);
+			groups.push_back(std::move(group));
+		});
+	}catch(std::exception& ex){
+		//TODO: more principled logging or reporting of the nature of the error
+		log_error("Failed to fetch Group records: " << ex.what());
+		groupDirectory.abandon(rebuild);
+		return collected;
+	}
+	std::vector<std::pair<std::string,Group>> entries;
+	entries.reserve(collected.size());
+	for(const auto& group : collected)
+		entries.emplace_back(group.name,group);
+	groupDirectory.publish(rebuild,std::move(entries),std::chrono::steady_clock::now()+groupCacheValidity);
 	
 	return collected;
 }
 
 std::vector<GroupRequest> PersistentStore::listGroupRequests(){
 	//First check if group requests are cached
-	std::vector<GroupRequest> collected;
-	if(groupRequestCacheExpirationTime.load() > std::chrono::steady_clock::now()){
-	    auto table = groupRequestCache.lock_table();
-		for(auto itr = table.cbegin(); itr != table.cend(); itr++){
+	{
+		auto snapshot=groupRequestDirectory.get();
+		if(snapshot->valid()){
 			cacheHits++;
-			collected.push_back(itr->second);
+			return snapshot->values();
 		}
-	
-		table.unlock();
-		return collected;
-	}	
+	}
+	//all concurrent requests can share one scan
+	return groupRequestScans.run("",[this]{ return scanGroupRequests(); });
+}
 
+std::vector<GroupRequest> PersistentStore::scanGroupRequests(){
+	std::vector<GroupRequest> collected;
+	auto rebuild=groupRequestDirectory.begin_rebuild();
 	databaseScans++;
 	Aws::DynamoDB::Model::ScanRequest request;
 	request.SetTableName(groupTableName);
 	request.SetFilterExpression("attribute_exists(#requester) and attribute_not_exists(#secondAttr)");
 	request.SetExpressionAttributeNames({{"#requester", "requester"},{"#secondAttr", "secondaryAttribute"}});
-	bool keepGoing=false;
 	
-	do{
-		auto outcome=dbClient.Scan(request);
-		if(!outcome.IsSuccess()){
-			//TODO: more principled logging or reporting of the nature of the error
-			auto err=outcome.GetError();
-			log_error("Failed to fetch Group records: " << err.GetMessage());
-			return collected;
+	try{
+		collected=makeScan().collect<GroupRequest>(request,[this](const DynamoItem& item, std::vector<GroupRequest>& requests){
+			GroupRequest gr=decodeGroupRequest(item);
+			CacheRecord<GroupRequest> record(gr,groupCacheValidity);
+			cacheRecord(groupRequestCache,gr.name,record);
+			requests.push_back(std::move(gr));
+		});
+	}catch(std::exception& ex){
+		//TODO: more principled logging or reporting of the nature of the error
+		log_error("Failed to fetch Group records: " << ex.what());
+		groupRequestDirectory.abandon(rebuild);
+		return collected;
+	}
+	std::vector<std::pair<std::string,GroupRequest>> entries;
+	entries.reserve(collected.size());
+	for(const auto& gr : collected)
+		entries.emplace_back(gr.name,gr);
+	groupRequestDirectory.publish(rebuild,std::move(entries),std::chrono::steady_clock::now()+groupCacheValidity);
+	
+	return collected;
+}
+
+std::vector<Group> PersistentStore::listSubgroups(const std::string& groupName, unsigned int maxDepth){
+	if(groupDirectory.get()->valid()){
+		cacheHits++;
+		return groupTree.descendants(groupName,maxDepth);
+	}
+	//reading all groups fills the directory, and with it the tree
+	std::vector<Group> groups=listGroups();
+	if(groupDirectory.get()->valid())
+		return groupTree.descendants(groupName,maxDepth);
+	//if the scan failed, search whatever it did find
+	group_tree<Group> partial;
+	for(const Group& group : groups)
+		partial.insert(group.name,group);
+	return partial.descendants(groupName,maxDepth);
+}
+
+std::vector<GroupRequest> PersistentStore::listSubgroupRequests(const std::string& groupName){
+	if(groupRequestDirectory.get()->valid()){
+		cacheHits++;
+		return groupRequestTree.descendants(groupName);
+	}
+	std::vector<GroupRequest> requests=listGroupRequests();
+	if(groupRequestDirectory.get()->valid())
+		return groupRequestTree.descendants(groupName);
+	group_tree<GroupRequest> partial;
+	for(const GroupRequest& gr : requests)
+		partial.insert(gr.name,gr);
+	return partial.descendants(groupName);
+}
+
+bool PersistentStore::prewarmCaches(unsigned int segments){
+	if(!segments)
+		segments=1;
+	log_info("Prewarming caches using " << segments << " scan segments per table");
+	auto start=std::chrono::steady_clock::now();
+	const std::vector<std::string> tables={userTableName,groupTableName};
+	prewarmSegments=tables.size()*segments;
+	prewarmSegmentsDone=0;
+	prewarmedItems=0;
+	prewarmMilliseconds=-1;
+	prewarmFailed=false;
+	
+	auto userRebuild=userDirectory.begin_rebuild();
+	auto groupRebuild=groupDirectory.begin_rebuild();
+	auto requestRebuild=groupRequestDirectory.begin_rebuild();
+	PrewarmBatch all;
+	bool success=true;
+	{
+		//both tables are scanned at once, each on its own set of threads
+		ThreadPool pool(tables.size()*segments);
+		std::vector<std::future<std::vector<PrewarmBatch>>> pending;
+		for(const auto& table : tables){
+			databaseScans++;
+			ParallelScan scan(*engine,pool,segments);
+			auto readTable=[this,&table,scan,segments]() mutable{
+				Aws::DynamoDB::Model::ScanRequest request;
+				request.SetTableName(table);
+				return scan.accumulate<PrewarmBatch>(request,
+					[this,&table](const DynamoItem& item, PrewarmBatch& batch){ prewarmItem(table,item,batch); },
+					[this,&table,segments](unsigned int segment, std::size_t items){
+						log_info("Prewarmed segment " << (segment+1) << " of " << segments << " of " 
+						         << table << ": " << items << " items (" << ++prewarmSegmentsDone 
+						         << " of " << prewarmSegments.load() << " segments done)");
+					});
+			};
+			pending.push_back(std::async(std::launch::async,readTable));
 		}
-		const auto& result=outcome.GetResult();
-		//set up fetching the next page if necessary
-		if(!result.GetLastEvaluatedKey().empty()){
-			keepGoing=true;
-			request.SetExclusiveStartKey(result.GetLastEvaluatedKey());
+		for(auto& result : pending){
+			try{
+				for(auto& batch : result.get()){
+				std::move(batch.users.begin(),batch.users.end(),std::back_inserter(all.users));
+				std::move(batch.memberships.begin(),batch.memberships.end(),std::back_inserter(all.memberships));
+				std::move(batch.groups.begin(),batch.groups.end(),std::back_inserter(all.groups));
+				std::move(batch.groupRequests.begin(),batch.groupRequests.end(),std::back_inserter(all.groupRequests));
+				std::move(batch.userAttributes.begin(),batch.userAttributes.end(),std::back_inserter(all.userAttributes));
+				std::move(batch.groupAttributes.begin(),batch.groupAttributes.end(),std::back_inserter(all.groupAttributes));
+				}
+			}catch(std::exception& ex){
+				log_error("Cache prewarm scan failed: " << ex.what());
+				success=false;
+			}
 		}
-		else
-			keepGoing=false;
-		//collect results from this page
-		for(const auto& item : result.GetItems()){
-			GroupRequest gr;
-			gr.valid=true;
-			gr.name=findOrThrow(item,"name","Group request record missing name attribute").GetS();
-			gr.displayName=findOrThrow(item,"displayName","Group request record missing displayName attribute").GetS();
-			gr.email=findOrThrow(item,"email","Group request record missing email attribute").GetS();
-			gr.phone=findOrThrow(item,"phone","Group request record missing phone attribute").GetS();
-			gr.purpose=findOrThrow(item,"purpose","Group request record missing purpose attribute").GetS();
-			gr.description=findOrThrow(item,"description","Group request record missing description attribute").GetS();
-			gr.requester=findOrThrow(item,"requester","Group request record missing requester attribute").GetS();
-			gr.unixID=std::stoul(findOrThrow(item,"unixID","Group request record missing unixID attribute").GetN());
-			auto extra=findOrThrow(item,"secondaryAttributes","Group Request record missing secondary attributes").GetM();
-			for(const auto& attr : extra){
-				if(attr.first=="dummy")
-					continue;
-				gr.secondaryAttributes[attr.first]=attr.second->GetS();
+	}
+	
+	if(!success){
+		userDirectory.abandon(userRebuild);
+		groupDirectory.abandon(groupRebuild);
+		groupRequestDirectory.abandon(requestRebuild);
+		prewarmFailed=true;
+	}
+	else{
+		auto userExpiration=std::chrono::steady_clock::now()+userCacheValidity;
+		auto groupExpiration=std::chrono::steady_clock::now()+groupCacheValidity;
+		std::vector<std::pair<std::string,UserSummary>> users;
+		users.reserve(all.users.size());
+		for(const auto& user : all.users)
+			users.emplace_back(user.unixName,UserSummary(user));
+		userDirectory.publish(userRebuild,std::move(users),userExpiration);
+		std::vector<std::pair<std::string,Group>> groups;
+		groups.reserve(all.groups.size());
+		for(const auto& group : all.groups)
+			groups.emplace_back(group.name,group);
+		groupDirectory.publish(groupRebuild,std::move(groups),groupExpiration);
+		std::vector<std::pair<std::string,GroupRequest>> requests;
+		requests.reserve(all.groupRequests.size());
+		for(const auto& gr : all.groupRequests)
+			requests.emplace_back(gr.name,gr);
+		groupRequestDirectory.publish(requestRebuild,std::move(requests),groupExpiration);
+		
+		//Every attribute has been seen, so each user's and group's set is 
+		//complete, even if it is empty
+		auto userAttributes=attributesByOwner(all.userAttributes);
+		for(const auto& user : all.users)
+			userAttributes[user.unixName];
+		for(auto& owner : userAttributes)
+			cacheRecord(userAttributeCache,owner.first,AttributeRecord(std::make_shared<const attribute_table>(std::move(owner.second)),userCacheValidity));
+		auto groupAttributes=attributesByOwner(all.groupAttributes);
+		for(const auto& group : all.groups)
+			groupAttributes[group.name];
+		for(auto& owner : groupAttributes)
+			cacheRecord(groupAttributeCache,owner.first,AttributeRecord(std::make_shared<const attribute_table>(std::move(owner.second)),groupCacheValidity));
+		
+		//Since every membership has been seen, each user's and each group's 
+		//list of memberships is known to be complete
+		std::set<std::string> userLists, groupLists;
+		for(const auto& membership : all.memberships){
+			CacheRecord<GroupMembership> record(membership,userCacheValidity);
+			if(userLists.insert(membership.userName).second){
+				groupMembershipByUserCache.erase(membership.userName);
+				invalidateAuthorization(membership.userName);
 			}
-			collected.push_back(gr);
-
-			CacheRecord<GroupRequest> record(gr,groupCacheValidity);
-			replaceCacheRecord(groupRequestCache,gr.name,record);
+			if(groupLists.insert(membership.groupName).second)
+				groupMembershipByGroupCache.erase(membership.groupName);
+			replaceCacheRecord(groupMembershipByUserCache,membership.userName,record);
+			replaceCacheRecord(groupMembershipByGroupCache,membership.groupName,record);
 		}
-	}while(keepGoing);
-	groupRequestCacheExpirationTime=std::chrono::steady_clock::now()+groupCacheValidity;
+		for(const auto& name : userLists){
+			groupMembershipByUserCache.update_expiration(name,userExpiration);
+			scheduleExpiry(groupMembershipByUserCache,name,userExpiration);
+		}
+		for(const auto& name : groupLists){
+			groupMembershipByGroupCache.update_expiration(name,userExpiration);
+			scheduleExpiry(groupMembershipByGroupCache,name,userExpiration);
+		}
+	}
 	
-	return collected;
+	prewarmMilliseconds=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+	if(success)
+		log_info("Prewarmed caches with " << all.users.size() << " users, " 
+		         << all.groups.size() << " groups, " << all.groupRequests.size() 
+		         << " group requests, and " << all.memberships.size() 
+		         << " memberships in " << prewarmMilliseconds.load() << " ms");
+	else
+		log_error("Cache prewarm was incomplete after " << prewarmMilliseconds.load() << " ms");
+	return success;
+}
+
+void PersistentStore::prewarmItem(const std::string& tableName, const ParallelScan::Item& item, PrewarmBatch& batch){
+	prewarmedItems++;
+	if(item.count("next_unixID"))
+		return;
+	if(tableName==userTableName){
+		if(item.count("groupName")){
+			GroupMembership membership=decodeMembership(item);
+			CacheRecord<GroupMembership> record(membership,userCacheValidity);
+			cacheRecord(groupMembershipCache,membership.userName+":"+membership.groupName,record);
+			batch.memberships.push_back(std::move(membership));
+		}
+		else if(item.count("secondaryAttribute")){
+			std::string uID=findOrThrow(item,"unixName","user secondary record missing unixName").GetS();
+			std::string sortKey=findOrThrow(item,"sortKey","user secondary record missing sortKey").GetS();
+			batch.userAttributes.emplace_back(uID,sortKey.substr(uID.size()+6), //strip uID+":attr:"
+			                                  item.find("secondaryAttribute")->second.GetS());
+		}
+		else{
+			User user=decodeUser(item);
+			CacheRecord<User> record(user,userCacheValidity);
+			cacheRecord(userCache,user.unixName,record);
+			cacheRecord(userByTokenCache,user.token,record);
+			cacheRecord(userByGlobusIDCache,user.globusID,record);
+			batch.users.push_back(std::move(user));
+		}
+	}
+	else{
+		if(item.count("secondaryAttribute")){
+			std::string groupName=findOrThrow(item,"name","group secondary record missing name").GetS();
+			std::string sortKey=findOrThrow(item,"sortKey","group secondary record missing sortKey").GetS();
+			batch.groupAttributes.emplace_back(groupName,sortKey.substr(groupName.size()+6), //strip groupName+":attr:"
+			                                   item.find("secondaryAttribute")->second.GetS());
+		}
+		else if(item.count("requester")){
+			GroupRequest gr=decodeGroupRequest(item);
+			cacheRecord(groupRequestCache,gr.name,CacheRecord<GroupRequest>(gr,groupCacheValidity));
+			batch.groupRequests.push_back(std::move(gr));
+		}
+		else{
+			Group group=decodeGroup(item);
+			cacheRecord(groupCache,group.name,CacheRecord<Group>(group,groupCacheValidity));
+			batch.groups.push_back(std::move(group));
+		}
+	}
 }
 
 std::vector<GroupRequest> PersistentStore::listGroupRequestsByRequester(const std::string& requester){
@@ -1842,7 +3695,7 @@ std::vector<GroupRequest> PersistentStore::listGroupRequestsByRequester(const st
 	using Aws::DynamoDB::Model::AttributeValue;
 	databaseQueries++;
 	log_info("Querying database for group requests by " << requester);
-	auto outcome=dbClient.Query(Aws::DynamoDB::Model::QueryRequest()
+	auto outcome=query(Aws::DynamoDB::Model::QueryRequest()
 	                            .WithTableName(groupTableName)
 	                            .WithIndexName("ByRequester")
 	                            .WithKeyConditionExpression("#requester = :id_val")
@@ -1864,7 +3717,7 @@ std::vector<GroupRequest> PersistentStore::listGroupRequestsByRequester(const st
 			requests.push_back(gr);
 
 		CacheRecord<GroupRequest> record(gr,groupCacheValidity);
-		replaceCacheRecord(groupRequestCache,gr.name,record);
+		cacheRecord(groupRequestCache,gr.name,record);
 	}
 	
 	return requests;
@@ -1886,10 +3739,14 @@ Group PersistentStore::getGroup(const std::string& groupName){
 	databaseQueries++;
 	log_info("Querying database for Group " << groupName);
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	auto outcome=getItem(Aws::DynamoDB::Model::GetItemRequest()
 	                              .WithTableName(groupTableName)
 	                              .WithKey({{"name",AttributeValue(groupName)},
 	                                        {"sortKey",AttributeValue(groupName)}}));
+	return finishLoadGroup(groupName,outcome);
+}
+
+Group PersistentStore::finishLoadGroup(const std::string& groupName, const Aws::DynamoDB::Model::GetItemOutcome& outcome){
 	if(!outcome.IsSuccess()){
 		auto err=outcome.GetError();
 		log_error("Failed to fetch Group record: " << err.GetMessage());
@@ -1915,11 +3772,32 @@ Group PersistentStore::getGroup(const std::string& groupName){
 	
 	//update caches
 	CacheRecord<Group> record(group,groupCacheValidity);
-	replaceCacheRecord(groupCache,groupName,record);
+	cacheRecord(groupCache,groupName,record);
+	if(!group.pending)
+		groupDirectory.upsert(groupName,group);
 	
 	return group;
 }
 
+std::future<Group> PersistentStore::getGroupAsync(const std::string& groupName){
+	{
+		CacheRecord<Group> record;
+		if(groupCache.find(groupName,record) && record){
+			cacheHits++;
+			return readyFuture<Group>(record);
+		}
+	}
+	log_info("Querying database for Group " << groupName);
+	using Aws::DynamoDB::Model::AttributeValue;
+	return getItemAsync<Group>(Aws::DynamoDB::Model::GetItemRequest()
+	                           .WithTableName(groupTableName)
+	                           .WithKey({{"name",AttributeValue(groupName)},
+	                                     {"sortKey",AttributeValue(groupName)}}),
+	                           [this,groupName](const Aws::DynamoDB::Model::GetItemOutcome& outcome){
+	                           	return finishLoadGroup(groupName,outcome);
+	                           });
+}
+
 GroupRequest PersistentStore::getGroupRequest(const std::string& groupName){
 	//first see if we have this cached
 	{
@@ -1936,7 +3814,7 @@ GroupRequest PersistentStore::getGroupRequest(const std::string& groupName){
 	databaseQueries++;
 	log_info("Querying database for Group " << groupName);
 	using Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
+	auto outcome=getItem(Aws::DynamoDB::Model::GetItemRequest()
 	                              .WithTableName(groupTableName)
 	                              .WithKey({{"name",AttributeValue(groupName)},
 	                                        {"sortKey",AttributeValue(groupName)}}));
@@ -1968,7 +3846,8 @@ GroupRequest PersistentStore::getGroupRequest(const std::string& groupName){
 	
 	//update caches
 	CacheRecord<GroupRequest> record(gr,groupCacheValidity);
-	replaceCacheRecord(groupRequestCache,groupName,record);
+	cacheRecord(groupRequestCache,groupName,record);
+	groupRequestDirectory.upsert(groupName,gr);
 	
 	return gr;
 }
@@ -1984,7 +3863,7 @@ bool PersistentStore::approveGroupRequest(const std::string& groupName){
 	std::string creationDate=timestamp();
 	using AV=Aws::DynamoDB::Model::AttributeValue;
 	using AVU=Aws::DynamoDB::Model::AttributeValueUpdate;
-	auto outcome=dbClient.UpdateItem(Aws::DynamoDB::Model::UpdateItemRequest()
+	auto outcome=updateItem(Aws::DynamoDB::Model::UpdateItemRequest()
 	                                 .WithTableName(groupTableName)
 	                                 .WithKey({{"name",AV(groupName)},
 	                                           {"sortKey",AV(groupName)}})
@@ -2014,8 +3893,11 @@ bool PersistentStore::approveGroupRequest(const std::string& groupName){
 	{ //update the group cache
 		CacheRecord<Group> record(Group(gr,creationDate),groupCacheValidity);
 		record.record.pending=false; //explicitly mark as no longer pending
-		replaceCacheRecord(groupCache,gr.name,record);
+		cacheRecord(groupCache,gr.name,record);
+		groupRequestDirectory.erase(gr.name);
+		groupDirectory.upsert(gr.name,record.record);
 	}
+	announceChange(ChangeEvent::GroupChanged,groupName);
 	
 	return true;
 }
@@ -2026,7 +3908,7 @@ bool PersistentStore::setGroupSecondaryAttribute(const std::string& groupName,
 	if(attributeValue.empty())
 		throw std::runtime_error("Attribute value must not be empty because Dynamo");
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.PutItem(Aws::DynamoDB::Model::PutItemRequest()
+	auto outcome=putItem(Aws::DynamoDB::Model::PutItemRequest()
 	                              .WithTableName(groupTableName)
 	                              .WithItem({{"name",AV(groupName)},
 	                                         {"sortKey",AV(groupName+":attr:"+attributeName)},
@@ -2038,78 +3920,34 @@ bool PersistentStore::setGroupSecondaryAttribute(const std::string& groupName,
 		return false;
 	}
 	
-	//update caches
-	auto record=std::make_pair(attributeName,CacheRecord<std::string>(attributeValue,groupCacheValidity));
-	std::map<std::string,CacheRecord<std::string>> m{record};
-	groupAttributeCache.upsert(groupName,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		auto it=attrs.find(record.first);
-		if(it==attrs.end())
-			attrs.insert(record);
-		else
-			it->second=record.second;
-	},m);
+	//update the cached set of attributes, if any
+	groupAttributeCache.update_fn(groupName,[&](AttributeRecord& record){
+		record.record=std::make_shared<const attribute_table>(record.record->with(attributeName,attributeValue));
+	});
+	announceChange(ChangeEvent::GroupAttributeChanged,groupName);
     
 	return true;
 }
 
 std::string PersistentStore::getGroupSecondaryAttribute(const std::string& groupName, const std::string& attributeName){
-	//first see if we have this cached
-	{
-		CacheRecord<std::string> record;
-		if(groupAttributeCache.find_fn(groupName,[&](const std::map<std::string,CacheRecord<std::string>>& attrs){
-			auto it=attrs.find(attributeName);
-			if(it!=attrs.end())
-				record=it->second;
-		})){
-			//we have a cached record; is it still valid?
-			if(record){ //it is, just return it
-				cacheHits++;
-				return record;
-			}
-		}
-	}
-	//need to query the database
-	databaseQueries++;
-	log_info("Querying database for group secondary record " << groupName << ':' << attributeName);
-	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.GetItem(Aws::DynamoDB::Model::GetItemRequest()
-								  .WithTableName(groupTableName)
-								  .WithKey({{"name",AV(groupName)},
-	                                        {"sortKey",AV(groupName+":attr:"+attributeName)}}));
-	if(!outcome.IsSuccess()){
-		auto err=outcome.GetError();
-		log_error("Failed to group secondary record: " << err.GetMessage());
-		return std::string{};
-	}
-	const auto& item=outcome.GetResult().GetItem();
-	if(item.empty()) //no match found
-		return std::string{};
-	
-	std::string result=findOrThrow(item,"secondaryAttribute","group secondary record missing attribute").GetS();
-	
-	//update cache
-	auto record=std::make_pair(groupName,CacheRecord<std::string>(result,groupCacheValidity));
-	std::map<std::string,CacheRecord<std::string>> m{record};
-	groupAttributeCache.upsert(groupName,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		auto it=attrs.find(record.first);
-		if(it==attrs.end())
-			attrs.insert(record);
-		else
-			it->second=record.second;
-	},m);
-	
+	std::string value;
+	auto attributes=getSecondaryAttributes(groupAttributeCache,groupTableName,"name",groupName,groupCacheValidity);
+	if(attributes)
+		attributes->find(attributeName,value);
+	return value;
+}
+
+std::map<std::string,std::string> PersistentStore::getGroupSecondaryAttributes(const std::string& groupName){
+	std::map<std::string,std::string> result;
+	auto attributes=getSecondaryAttributes(groupAttributeCache,groupTableName,"name",groupName,groupCacheValidity);
+	if(attributes)
+		attributes->for_each([&result](const std::string& name, const std::string& value){ result.emplace(name,value); });
 	return result;
 }
 
 bool PersistentStore::removeGroupSecondaryAttribute(const std::string& groupName, const std::string& attributeName){
-	//remove from cache is present there
-	groupAttributeCache.erase_fn(groupName,[&](std::map<std::string,CacheRecord<std::string>>& attrs){
-		attrs.erase(attributeName);
-		return attrs.empty(); //if the map for this group is empty, remove it entirely
-	});
-	
 	using AV=Aws::DynamoDB::Model::AttributeValue;
-	auto outcome=dbClient.DeleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
+	auto outcome=deleteItem(Aws::DynamoDB::Model::DeleteItemRequest()
 								     .WithTableName(groupTableName)
 								     .WithKey({{"name",AV(groupName)},
 	                                           {"sortKey",AV(groupName+":attr:"+attributeName)}}));
@@ -2118,17 +3956,122 @@ bool PersistentStore::removeGroupSecondaryAttribute(const std::string& groupName
 		log_error("Failed to delete secondary group record record: " << err.GetMessage());
 		return false;
 	}
+	groupAttributeCache.update_fn(groupName,[&](AttributeRecord& record){
+		record.record=std::make_shared<const attribute_table>(record.record->without(attributeName));
+	});
+	announceChange(ChangeEvent::GroupAttributeChanged,groupName);
 	return true;
 }
 
 std::string PersistentStore::getStatistics() const{
 	std::ostringstream os;
+	os << "Storage engine: " << engine->describe() << "\n";
 	os << "Cache hits: " << cacheHits.load() << "\n";
 	os << "Database queries: " << databaseQueries.load() << "\n";
 	os << "Database scans: " << databaseScans.load() << "\n";
+	os << "Negative cache hits: " << negativeCacheHits.load() << "\n";
+	os << "Background refreshes: " << backgroundRefreshes.load() << "\n";
+	os << "Stale cache hits: " << staleHits.load() << "\n";
+	os << "Coalesced database reads: " 
+	   << (userLoads.shared()+membershipLoads.shared()+membershipListLoads.shared()+userMembershipListLoads.shared()+attributeLoads.shared()) << "\n";
+	os << "Coalesced database scans: " 
+	   << (userScans.shared()+groupScans.shared()+groupRequestScans.shared()) << "\n";
+	{
+		std::lock_guard<std::mutex> lock(knownUserFilterMutex);
+		if(knownUserFilter)
+			os << "Known user filter: " << knownUserFilter->insertions() << " insertions, " 
+			   << knownUserFilter->size_bytes() << " bytes" 
+			   << (knownUserFilterExpiration<std::chrono::steady_clock::now()?" (expired)":"") << "\n";
+	}
+	std::size_t totalResident=0;
+	for(const auto& cache : cacheHandles){
+		std::size_t resident=cache.residentBytes(), budget=cache.budget();
+		totalResident+=resident;
+		os << "Cache " << cache.name << ": " << cache.size() << " entries, " 
+		   << resident << " bytes";
+		if(budget)
+			os << " of " << budget << " allowed, " << cache.evictions() << " evictions";
+		os << "\n";
+	}
+	os << "Total cache memory: " << totalResident << " bytes\n";
+	os << "Authorization checks: " << authorizer.hits() << " remembered, " 
+	   << authorizer.misses() << " decided\n";
+	os << "Expiring cache entries: " << expiryWheel.size() << " tracked, " 
+	   << sweptEntries.load() << " removed\n";
+	if(changeFeed)
+		os << "Change feed: " << changeFeed->describe() << ", " 
+		   << appliedChanges.load() << " applied\n";
+	if(prewarmSegments.load()){
+		os << "Cache prewarm: " << prewarmSegmentsDone.load() << " of " 
+		   << prewarmSegments.load() << " segments, " << prewarmedItems.load() << " items";
+		long elapsed=prewarmMilliseconds.load();
+		if(elapsed>=0)
+			os << ", " << (prewarmFailed.load()?"failed":"finished") << " after " << elapsed << " ms";
+		os << "\n";
+	}
+	if(!cacheSnapshotPath.empty())
+		os << "Cache snapshot: " << restoredRecords.load() << " records restored, " 
+		   << savedSnapshots.load() << " snapshots saved\n";
+	{
+		std::lock_guard<std::mutex> lock(lastUseMutex);
+		os << "Last use times: " << recordedLastUses.load() << " recorded, " 
+		   << writtenLastUses.load() << " written, " << pendingLastUseTimes.size() << " pending\n";
+	}
+	auto describe=[&os](const std::string& name, uint64_t version, std::size_t size, bool valid){
+		os << name << " directory: " << size << " records, version " << version 
+		   << (valid?"":" (incomplete)") << "\n";
+	};
+	auto users=userDirectory.get();
+	describe("User",users->version(),users->size(),users->valid());
+	auto groups=groupDirectory.get();
+	describe("Group",groups->version(),groups->size(),groups->valid());
+	auto requests=groupRequestDirectory.get();
+	describe("Group request",requests->version(),requests->size(),requests->valid());
 	return os.str();
 }
 
+template<typename Cache>
+PersistentStore::CacheHandle PersistentStore::makeCacheHandle(const std::string& name, unsigned int share, Cache& cache){
+	CacheHandle handle;
+	handle.name=name;
+	handle.share=share;
+	handle.size=[&cache](){ return cache.size(); };
+	handle.residentBytes=[&cache](){ return cache.resident_bytes(); };
+	handle.budget=[&cache](){ return cache.get_budget(); };
+	handle.evictions=[&cache](){ return cache.evictions(); };
+	handle.setBudget=[&cache](std::size_t bytes){ cache.set_budget(bytes); };
+	handle.sweep=[&cache](const std::string& key, std::chrono::steady_clock::time_point cutoff){
+		bool erased=false;
+		cache.erase_fn(key,ExpiredEntryEraser{cutoff,&erased});
+		return erased;
+	};
+	handle.address=&cache;
+	return handle;
+}
+
+void PersistentStore::setCacheMemoryLimit(std::size_t bytes){
+	for(auto& cache : cacheHandles)
+		cache.setBudget(bytes/100*cache.share);
+	if(bytes)
+		log_info("Limiting cache memory use to " << bytes << " bytes");
+}
+
+bool PersistentStore::setCacheMemoryBudget(const std::string& cacheName, std::size_t bytes){
+	for(auto& cache : cacheHandles){
+		if(cache.name==cacheName){
+			cache.setBudget(bytes);
+			log_info("Limiting " << cacheName << " cache memory use to " << bytes << " bytes");
+			return true;
+		}
+	}
+	return false;
+}
+
+void PersistentStore::setCacheRefreshPolicy(std::chrono::seconds refreshAhead, std::chrono::seconds staleGrace){
+	refreshAheadWindow.store(refreshAhead);
+	staleGracePeriod.store(staleGrace);
+}
+
 const User authenticateUser(PersistentStore& store, const char* token){
 	if(token==nullptr) //no token => no way of identifying a valid user
 		return User{};
@@ -0,0 +1,130 @@
+#include <RateLimiter.h>
+
+#include <algorithm>
+
+const unsigned int RateLimiter::attemptLimit=8;
+
+namespace{
+///The lowest rate to which throttling can reduce a bucket, so that a table
+///is never shut off entirely
+const double minimumRate=1;
+///The fraction of its ceiling by which a bucket's rate grows with each success
+const double increaseFraction=0.01;
+///The fraction of the ceiling allowed for scan pages
+const double scanShare=0.1;
+///The base and maximum of the range from which retry delays are drawn
+const std::chrono::milliseconds retryBase(25);
+const std::chrono::milliseconds retryCap(2000);
+}
+
+RateLimiter::RateLimiter(double ceiling):
+ceiling(std::max(ceiling,minimumRate)),rng(std::random_device{}()){}
+
+void RateLimiter::setCeiling(double newCeiling){
+	std::lock_guard<std::mutex> lock(mutex);
+	ceiling=std::max(newCeiling,minimumRate);
+	for(auto& entry : tables){
+		Table& table=*entry.second;
+		std::lock_guard<std::mutex> tableLock(table.mutex);
+		for(unsigned int i=0; i<operationCount; i++){
+			Bucket& bucket=table.buckets[i];
+			bucket.ceiling=ceilingFor((Operation)i);
+			bucket.rate=std::min(bucket.rate,bucket.ceiling);
+		}
+	}
+}
+
+RateLimiter::Table& RateLimiter::getTable(const std::string& name){
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it=tables.find(name);
+	if(it!=tables.end())
+		return *it->second;
+	std::unique_ptr<Table> table(new Table);
+	auto now=std::chrono::steady_clock::now();
+	for(unsigned int i=0; i<operationCount; i++){
+		Bucket& bucket=table->buckets[i];
+		bucket.ceiling=bucket.rate=bucket.tokens=ceilingFor((Operation)i);
+		bucket.lastRefill=now;
+	}
+	return *(tables[name]=std::move(table));
+}
+
+double RateLimiter::ceilingFor(Operation op) const{
+	if(op==Scan)
+		return std::max(ceiling*scanShare,minimumRate);
+	return ceiling;
+}
+
+void RateLimiter::refill(Bucket& bucket, std::chrono::steady_clock::time_point now){
+	double elapsed=std::chrono::duration_cast<std::chrono::duration<double>>(now-bucket.lastRefill).count();
+	//allow bursts of up to one second's worth of requests
+	bucket.tokens=std::min(bucket.tokens+elapsed*bucket.rate,std::max(bucket.rate,1.0));
+	bucket.lastRefill=now;
+}
+
+void RateLimiter::decrease(Bucket& bucket){
+	bucket.rate=std::max(bucket.rate/2,minimumRate);
+	bucket.tokens=std::min(bucket.tokens,std::max(bucket.rate,1.0));
+}
+
+void RateLimiter::acquire(const std::string& tableName, Operation op){
+	Table& table=getTable(tableName);
+	std::unique_lock<std::mutex> lock(table.mutex);
+	Bucket& bucket=table.buckets[op];
+	const bool interactive=(op!=Scan);
+	if(interactive)
+		table.interactiveWaiting++;
+	while(true){
+		refill(bucket,std::chrono::steady_clock::now());
+		bool yielding=!interactive && table.interactiveWaiting;
+		if(bucket.tokens>=1 && !yielding){
+			bucket.tokens-=1;
+			break;
+		}
+		if(yielding) //woken when the other requests are done waiting
+			table.wakeup.wait(lock);
+		else{
+			std::chrono::duration<double> untilToken((1-bucket.tokens)/bucket.rate);
+			table.wakeup.wait_for(lock,untilToken);
+		}
+	}
+	if(interactive && --table.interactiveWaiting==0)
+		table.wakeup.notify_all();
+}
+
+void RateLimiter::succeeded(const std::string& tableName, Operation op){
+	Table& table=getTable(tableName);
+	std::lock_guard<std::mutex> lock(table.mutex);
+	Bucket& bucket=table.buckets[op];
+	bucket.rate=std::min(bucket.rate+bucket.ceiling*increaseFraction,bucket.ceiling);
+}
+
+void RateLimiter::throttled(const std::string& tableName, Operation op){
+	Table& table=getTable(tableName);
+	std::lock_guard<std::mutex> lock(table.mutex);
+	decrease(table.buckets[op]);
+	//scans draw on the same read capacity, so they must give way
+	if(op==PointRead || op==Query)
+		decrease(table.buckets[Scan]);
+}
+
+std::chrono::milliseconds RateLimiter::retryDelay(unsigned int attempt){
+	auto limit=retryBase*(1u<<std::min(attempt,10u));
+	limit=std::min(limit,retryCap);
+	std::lock_guard<std::mutex> lock(mutex);
+	std::uniform_int_distribution<long> distribution(0,limit.count());
+	return std::chrono::milliseconds(distribution(rng));
+}
+
+double RateLimiter::currentRate(const std::string& tableName, Operation op){
+	Table& table=getTable(tableName);
+	std::lock_guard<std::mutex> lock(table.mutex);
+	return table.buckets[op].rate;
+}
+
+bool RateLimiter::isThrottling(Aws::DynamoDB::DynamoDBErrors error){
+	using Aws::DynamoDB::DynamoDBErrors;
+	return error==DynamoDBErrors::PROVISIONED_THROUGHPUT_EXCEEDED
+	    || error==DynamoDBErrors::THROTTLING
+	    || error==DynamoDBErrors::REQUEST_LIMIT_EXCEEDED;
+}
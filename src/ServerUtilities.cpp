@@ -1,5 +1,7 @@
 #include "ServerUtilities.h"
 
+#include <boost/lexical_cast.hpp>
+
 #include "Logging.h"
 
 std::string generateError(const std::string& message){
@@ -96,3 +98,27 @@ bool silentMode(const crow::request& req) {
 	}
 	return silent;
 }
+
+bool unsignedQueryParam(const crow::request& req, const std::string& name, 
+                        unsigned int& value, unsigned int minimum, 
+                        crow::response& error){
+	const char* param=req.url_params.get(name);
+	if(!param)
+		return true;
+	const std::string paramStr=param;
+	unsigned int result=0;
+	try{
+		if(paramStr.empty() || paramStr.find_first_not_of("0123456789")!=std::string::npos)
+			throw boost::bad_lexical_cast();
+		result=boost::lexical_cast<unsigned int>(paramStr);
+	}catch(boost::bad_lexical_cast&){
+		error=crow::response(400,generateError("Invalid "+name));
+		return false;
+	}
+	if(result<minimum){
+		error=crow::response(400,generateError("Invalid "+name));
+		return false;
+	}
+	value=result;
+	return true;
+}
@@ -0,0 +1,141 @@
+#include <StorageEngine.h>
+
+#include <thread>
+
+#include <aws/core/client/RetryStrategy.h>
+#include <aws/core/utils/Outcome.h>
+
+void StorageEngine::getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, GetItemHandler handler){
+	handler(getItem(request));
+}
+
+//----
+
+namespace{
+///\return a copy of a client configuration with the client's own retries
+///        disabled, leaving retrying to the rate limiter
+Aws::Client::ClientConfiguration withoutRetries(Aws::Client::ClientConfiguration clientConfig){
+	clientConfig.retryStrategy=Aws::MakeShared<Aws::Client::DefaultRetryStrategy>("DynamoDBStorageEngine",0);
+	return clientConfig;
+}
+}
+
+DynamoDBStorageEngine::DynamoDBStorageEngine(const Aws::Auth::AWSCredentials& credentials,
+                                             const Aws::Client::ClientConfiguration& clientConfig,
+                                             double rateLimit):
+client(credentials,withoutRetries(clientConfig)),
+limiter(rateLimit),
+endpoint(clientConfig.endpointOverride){}
+
+Aws::DynamoDB::Model::GetItemOutcome DynamoDBStorageEngine::getItem(const Aws::DynamoDB::Model::GetItemRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::PointRead,
+	                    [&]{ return client.GetItem(request); });
+}
+
+void DynamoDBStorageEngine::getItemAsync(const Aws::DynamoDB::Model::GetItemRequest& request, GetItemHandler handler){
+	limiter.acquire(request.GetTableName(),RateLimiter::PointRead);
+	client.GetItemAsync(request,
+		[this,handler](const Aws::DynamoDB::DynamoDBClient*,
+		               const Aws::DynamoDB::Model::GetItemRequest& request,
+		               const Aws::DynamoDB::Model::GetItemOutcome& outcome,
+		               const std::shared_ptr<const Aws::Client::AsyncCallerContext>&){
+			if(outcome.IsSuccess()){
+				limiter.succeeded(request.GetTableName(),RateLimiter::PointRead);
+				handler(outcome);
+				return;
+			}
+			const auto& err=outcome.GetError();
+			bool throttling=RateLimiter::isThrottling(err.GetErrorType());
+			if(throttling)
+				limiter.throttled(request.GetTableName(),RateLimiter::PointRead);
+			if(throttling || err.ShouldRetry()){
+				//retry on this thread, with the usual backoff
+				std::this_thread::sleep_for(limiter.retryDelay(1));
+				handler(getItem(request));
+			}
+			else
+				handler(outcome);
+		});
+}
+
+Aws::DynamoDB::Model::BatchGetItemOutcome DynamoDBStorageEngine::batchGetItem(const Aws::DynamoDB::Model::BatchGetItemRequest& request){
+	//all of the store's batches read from a single table
+	const std::string tableName=request.GetRequestItems().empty()?"":request.GetRequestItems().begin()->first;
+	return limiter.call(tableName,RateLimiter::PointRead,
+	                    [&]{ return client.BatchGetItem(request); });
+}
+
+Aws::DynamoDB::Model::QueryOutcome DynamoDBStorageEngine::query(const Aws::DynamoDB::Model::QueryRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::Query,
+	                    [&]{ return client.Query(request); });
+}
+
+Aws::DynamoDB::Model::ScanOutcome DynamoDBStorageEngine::scan(const Aws::DynamoDB::Model::ScanRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::Scan,
+	                    [&]{ return client.Scan(request); });
+}
+
+Aws::DynamoDB::Model::PutItemOutcome DynamoDBStorageEngine::putItem(const Aws::DynamoDB::Model::PutItemRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::Write,
+	                    [&]{ return client.PutItem(request); });
+}
+
+Aws::DynamoDB::Model::UpdateItemOutcome DynamoDBStorageEngine::updateItem(const Aws::DynamoDB::Model::UpdateItemRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::Write,
+	                    [&]{ return client.UpdateItem(request); });
+}
+
+Aws::DynamoDB::Model::DeleteItemOutcome DynamoDBStorageEngine::deleteItem(const Aws::DynamoDB::Model::DeleteItemRequest& request){
+	return limiter.call(request.GetTableName(),RateLimiter::Write,
+	                    [&]{ return client.DeleteItem(request); });
+}
+
+Aws::DynamoDB::Model::BatchWriteItemOutcome DynamoDBStorageEngine::batchWriteItem(const Aws::DynamoDB::Model::BatchWriteItemRequest& request){
+	const std::string tableName=request.GetRequestItems().empty()?"":request.GetRequestItems().begin()->first;
+	return limiter.call(tableName,RateLimiter::Write,
+	                    [&]{ return client.BatchWriteItem(request); });
+}
+
+Aws::DynamoDB::Model::TransactWriteItemsOutcome DynamoDBStorageEngine::transactWriteItems(const Aws::DynamoDB::Model::TransactWriteItemsRequest& request){
+	//the store's transactions write to a single table, so charge the first
+	//item's table
+	std::string tableName;
+	if(!request.GetTransactItems().empty()){
+		const auto& item=request.GetTransactItems().front();
+		if(item.UpdateHasBeenSet())
+			tableName=item.GetUpdate().GetTableName();
+		else if(item.PutHasBeenSet())
+			tableName=item.GetPut().GetTableName();
+		else if(item.DeleteHasBeenSet())
+			tableName=item.GetDelete().GetTableName();
+		else
+			tableName=item.GetConditionCheck().GetTableName();
+	}
+	return limiter.call(tableName,RateLimiter::Write,
+	                    [&]{ return client.TransactWriteItems(request); });
+}
+
+Aws::DynamoDB::Model::DescribeTableOutcome DynamoDBStorageEngine::describeTable(const Aws::DynamoDB::Model::DescribeTableRequest& request){
+	return client.DescribeTable(request);
+}
+
+Aws::DynamoDB::Model::CreateTableOutcome DynamoDBStorageEngine::createTable(const Aws::DynamoDB::Model::CreateTableRequest& request){
+	return client.CreateTable(request);
+}
+
+Aws::DynamoDB::Model::UpdateTableOutcome DynamoDBStorageEngine::updateTable(const Aws::DynamoDB::Model::UpdateTableRequest& request){
+	return client.UpdateTable(request);
+}
+
+Aws::DynamoDB::Model::DeleteTableOutcome DynamoDBStorageEngine::deleteTable(const Aws::DynamoDB::Model::DeleteTableRequest& request){
+	return client.DeleteTable(request);
+}
+
+void DynamoDBStorageEngine::waitToRetry(const std::string& tableName, unsigned int attempt){
+	limiter.throttled(tableName,RateLimiter::Write);
+	std::this_thread::sleep_for(limiter.retryDelay(attempt));
+}
+
+std::string DynamoDBStorageEngine::describe() const{
+	return "DynamoDB at "+endpoint;
+}
@@ -0,0 +1,60 @@
+#include <UnixIDAllocator.h>
+
+#include <Logging.h>
+
+unsigned int UnixIDAllocator::next(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if(freeList.empty()){
+		unsigned int first, end;
+		if(!source.lease(blockSize,first,end) || first>=end){
+			log_error("Unable to lease a block of unix IDs");
+			return 0;
+		}
+		freeList.emplace_back(first,end);
+		lastLeaseEnd=end;
+	}
+	auto& range=freeList.front();
+	unsigned int id=range.first++;
+	if(range.first==range.second)
+		freeList.pop_front();
+	return id;
+}
+
+void UnixIDAllocator::release(unsigned int id){
+	if(!id)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!freeList.empty() && freeList.front().first==id+1)
+		freeList.front().first=id;
+	else
+		freeList.emplace_front(id,id+1);
+}
+
+unsigned int UnixIDAllocator::returnUnused(){
+	std::lock_guard<std::mutex> lock(mutex);
+	for(auto it=freeList.begin(); it!=freeList.end(); it++){
+		if(it->second!=lastLeaseEnd)
+			continue;
+		unsigned int count=it->second-it->first;
+		if(!source.giveBack(it->first,it->second))
+			return 0;
+		log_info("Returned unix IDs " << it->first << " to " << (it->second-1));
+		lastLeaseEnd=it->first;
+		freeList.erase(it);
+		return count;
+	}
+	return 0;
+}
+
+void UnixIDAllocator::setBlockSize(unsigned int size){
+	std::lock_guard<std::mutex> lock(mutex);
+	blockSize=size?size:1;
+}
+
+unsigned int UnixIDAllocator::available() const{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int count=0;
+	for(const auto& range : freeList)
+		count+=range.second-range.first;
+	return count;
+}
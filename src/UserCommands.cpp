@@ -4,20 +4,6 @@
 #include "ServerUtilities.h"
 #include "GroupCommands.h"
 
-std::string adminInAnyEnclosingGroup(PersistentStore& store, const std::string& userID, std::string groupName){
-	while(!groupName.empty()){
-		auto sepPos=groupName.rfind('.');
-		if(sepPos==std::string::npos)
-			return ""; //no farther up to walk
-		groupName=groupName.substr(0,sepPos);
-		if(groupName.empty())
-			return "";
-		if(store.userStatusInGroup(userID,groupName).state==GroupMembership::Admin)
-			return groupName;
-	}
-	return "";
-}
-
 crow::response listUsers(PersistentStore& store, const crow::request& req){
 	const User user=authenticateUser(store, req.url_params.get("token"));
 	log_info(user << " requested to list users from " << req.remote_endpoint);
@@ -25,7 +11,7 @@ crow::response listUsers(PersistentStore& store, const crow::request& req){
 		return crow::response(403,generateError("Not authorized"));
 	//TODO: Are all users are allowed to list all users?
 
-	std::vector<User> users;
+	std::vector<UserSummary> users;
 	users = store.listUsers();
 
 	rapidjson::Document result(rapidjson::kObjectType);
@@ -34,7 +20,7 @@ crow::response listUsers(PersistentStore& store, const crow::request& req){
 	result.AddMember("apiVersion", "v1alpha1", alloc);
 	rapidjson::Value resultItems(rapidjson::kArrayType);
 	resultItems.Reserve(users.size(), alloc);
-	for(const User& user : users){
+	for(const UserSummary& user : users){
 		rapidjson::Value userResult(rapidjson::kObjectType);
 		userResult.AddMember("kind", "User", alloc);
 		rapidjson::Value userData(rapidjson::kObjectType);
@@ -487,28 +473,14 @@ crow::response createUser(PersistentStore& store, const crow::request& req){
 	return crow::response(to_string(result));
 }
 
-crow::response getUserInfo(PersistentStore& store, const crow::request& req, const std::string uID){
-	//important: user is the user issuing the command, not the user being modified
-	const User user=authenticateUser(store, req.url_params.get("token"));
-	//log_info(user << " requested information about " << uID << " from " << req.remote_endpoint);
-	if(!user)
-		return crow::response(403,generateError("Not authorized"));
-	//For now, allow all users to query all other users' data
-	////users can only be examined by admins or themselves
-	//if(!user.superuser && user.unixName!=uID)
-	//	return crow::response(403,generateError("Not authorized"));
-	
-	User targetUser=store.getUser(uID);
-	if(!targetUser)
-		return crow::response(404,generateError("Not found"));
-		
-	bool omitGroups=req.url_params.get("omit_groups")!=nullptr;
-
-	rapidjson::Document result(rapidjson::kObjectType);
-	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
-	
-	result.AddMember("apiVersion", "v1alpha1", alloc);
-	result.AddMember("kind", "User", alloc);
+namespace{
+///Describe a user in the form used by getUserInfo
+///\param user the user who requested the information, who may see secrets 
+///            only if they are the target user or a superuser
+///\param targetUser the user to describe
+///\param omitGroups whether to leave out the user's group memberships
+rapidjson::Value userMetadata(PersistentStore& store, const User& user, const User& targetUser,
+                              bool omitGroups, rapidjson::Document::AllocatorType& alloc){
 	rapidjson::Value metadata(rapidjson::kObjectType);
 	metadata.AddMember("name", targetUser.name, alloc);
 	metadata.AddMember("email", targetUser.email, alloc);
@@ -542,7 +514,7 @@ crow::response getUserInfo(PersistentStore& store, const crow::request& req, con
 	metadata.AddMember("service_account", targetUser.serviceAccount, alloc);
 	if(!omitGroups){
 		rapidjson::Value groupMemberships(rapidjson::kArrayType);
-		std::vector<GroupMembership> groupMembershipList = store.getUserGroupMemberships(uID);
+		std::vector<GroupMembership> groupMembershipList = store.getUserGroupMemberships(targetUser.unixName);
 		for (auto group : groupMembershipList) {
 			if(group.state==GroupMembership::NonMember)
 				continue; //don't report any group of which the user is _not_ a member
@@ -554,11 +526,99 @@ crow::response getUserInfo(PersistentStore& store, const crow::request& req, con
 		}
 		metadata.AddMember("group_memberships", groupMemberships, alloc);
 	}
+	return metadata;
+}
+}
+
+crow::response getUserInfo(PersistentStore& store, const crow::request& req, const std::string uID){
+	//important: user is the user issuing the command, not the user being modified
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	//log_info(user << " requested information about " << uID << " from " << req.remote_endpoint);
+	if(!user)
+		return crow::response(403,generateError("Not authorized"));
+	//For now, allow all users to query all other users' data
+	////users can only be examined by admins or themselves
+	//if(!user.superuser && user.unixName!=uID)
+	//	return crow::response(403,generateError("Not authorized"));
+	
+	User targetUser=store.getUser(uID);
+	if(!targetUser)
+		return crow::response(404,generateError("Not found"));
+		
+	bool omitGroups=req.url_params.get("omit_groups")!=nullptr;
+
+	rapidjson::Document result(rapidjson::kObjectType);
+	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	
+	result.AddMember("apiVersion", "v1alpha1", alloc);
+	result.AddMember("kind", "User", alloc);
+	rapidjson::Value metadata=userMetadata(store,user,targetUser,omitGroups,alloc);
 	result.AddMember("metadata", metadata, alloc);
 	
 	return crow::response(to_string(result));
 }
 
+crow::response getUsersInfo(PersistentStore& store, const crow::request& req){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested information about multiple users from " << req.remote_endpoint);
+	if(!user)
+		return crow::response(403,generateError("Not authorized"));
+	//As for getUserInfo, all users may query all other users' data
+	
+	rapidjson::Document body;
+	try{
+		body.Parse(req.body.c_str());
+	}catch(std::runtime_error& err){
+		log_warn("Batch user request body was not valid JSON");
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	}
+	if(body.IsNull() || !body.IsObject()){
+		log_warn("Batch user request body was not an object");
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	}
+	if(!body.HasMember("users") || !body["users"].IsArray()){
+		log_warn("Batch user request body was missing a list of users");
+		return crow::response(400,generateError("Missing list of users in request"));
+	}
+	std::vector<std::string> uIDs;
+	uIDs.reserve(body["users"].Size());
+	for(const auto& entry : body["users"].GetArray()){
+		if(!entry.IsString()){
+			log_warn("Batch user request contained a user name which was not a string");
+			return crow::response(400,generateError("Incorrect type for user name"));
+		}
+		uIDs.push_back(entry.GetString());
+	}
+	
+	bool omitGroups=req.url_params.get("omit_groups")!=nullptr;
+	bool complete=false;
+	std::vector<User> targetUsers=store.getUsers(uIDs,&complete);
+	//users which could not be read must not be reported as nonexistent
+	if(!complete)
+		return crow::response(500,generateError("Failed to look up all users"));
+	
+	rapidjson::Document result(rapidjson::kObjectType);
+	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	
+	result.AddMember("apiVersion", "v1alpha1", alloc);
+	rapidjson::Value items(rapidjson::kArrayType);
+	rapidjson::Value missing(rapidjson::kArrayType);
+	for(std::size_t i=0; i<uIDs.size(); i++){
+		if(!targetUsers[i]){
+			missing.PushBack(rapidjson::Value(uIDs[i],alloc), alloc);
+			continue;
+		}
+		rapidjson::Value item(rapidjson::kObjectType);
+		item.AddMember("kind", "User", alloc);
+		item.AddMember("metadata", userMetadata(store,user,targetUsers[i],omitGroups,alloc), alloc);
+		items.PushBack(item, alloc);
+	}
+	result.AddMember("items", items, alloc);
+	result.AddMember("missing", missing, alloc);
+	
+	return crow::response(to_string(result));
+}
+
 crow::response updateUser(PersistentStore& store, const crow::request& req, const std::string uID){
 	//important: user is the user issuing the command, not the user being modified
 	const User user=authenticateUser(store, req.url_params.get("token"));
@@ -589,26 +649,32 @@ crow::response updateUser(PersistentStore& store, const crow::request& req, cons
 		return crow::response(400,generateError("Incorrect type for user metadata"));
 	
 	User updatedUser=targetUser;
+	//the database attributes which the request supplies
+	std::set<std::string> updatedAttributes;
 	
 	if(body["metadata"].HasMember("name")){
 		if(!body["metadata"]["name"].IsString())
 			return crow::response(400,generateError("Incorrect type for user name"));
 		updatedUser.name=body["metadata"]["name"].GetString();
+		updatedAttributes.insert("name");
 	}
 	if(body["metadata"].HasMember("email")){
 		if(!body["metadata"]["email"].IsString())
 			return crow::response(400,generateError("Incorrect type for user email"));
 		updatedUser.email=body["metadata"]["email"].GetString();
+		updatedAttributes.insert("email");
 	}
 	if(body["metadata"].HasMember("phone")){
 		if(!body["metadata"]["phone"].IsString())
 			return crow::response(400,generateError("Incorrect type for user phone"));
 		updatedUser.phone=body["metadata"]["phone"].GetString();
+		updatedAttributes.insert("phone");
 	}
 	if(body["metadata"].HasMember("institution")){
 		if(!body["metadata"]["institution"].IsString())
 			return crow::response(400,generateError("Incorrect type for user institution"));
 		updatedUser.institution=body["metadata"]["institution"].GetString();
+		updatedAttributes.insert("institution");
 	}
 	if(body["metadata"].HasMember("public_key")){
 		if(!body["metadata"]["public_key"].IsString())
@@ -620,6 +686,7 @@ crow::response updateUser(PersistentStore& store, const crow::request& req, cons
 			log_warn("Malformed SSH key(s)");
 			return crow::response(400,generateError("Malformed SSH key(s)"));
 		}
+		updatedAttributes.insert("sshKey");
 	}
 	if(body["metadata"].HasMember("X.509_DN")){
 		if(!body["metadata"]["X.509_DN"].IsString())
@@ -631,30 +698,36 @@ crow::response updateUser(PersistentStore& store, const crow::request& req, cons
 			log_warn("Malformed X.509 DN(s)");
 			return crow::response(400,generateError("Malformed X.509 DN(s)"));
 		}*/
+		updatedAttributes.insert("x509DN");
 	}
 	if(body["metadata"].HasMember("superuser")){
 		if(!body["metadata"]["superuser"].IsBool())
 			return crow::response(400,generateError("Incorrect type for user superuser flag"));
 		if(!user.superuser && body["metadata"]["superuser"].GetBool()!=targetUser.superuser) //only admins can alter admin rights
 			return crow::response(403,generateError("Not authorized"));
-		if(user.superuser)
+		if(user.superuser){
 			updatedUser.superuser=body["metadata"]["superuser"].GetBool();
+			updatedAttributes.insert("superuser");
+		}
 	}
 	if(body["metadata"].HasMember("globusID")){
 		if(!body["metadata"]["globusID"].IsString())
 			return crow::response(400,generateError("Incorrect type for user globus ID"));
 		updatedUser.globusID=body["metadata"]["globusID"].GetString();
+		updatedAttributes.insert("globusID");
 	}
 	// Allow users to (re)generate their TOTP secret. 
 	if(body["metadata"].HasMember("create_totp_secret")){
 		if(!body["metadata"]["create_totp_secret"].IsBool())
 			return crow::response(400,generateError("Incorrect type for TOTP secret"));
-		if(body["metadata"]["create_totp_secret"].GetBool())
+		if(body["metadata"]["create_totp_secret"].GetBool()){
 			updatedUser.totpSecret = totpGenerator.generateTOTPSecret();
+			updatedAttributes.insert("totpSecret");
+		}
 	}
 	
 	log_info("Updating " << targetUser << " info");
-	bool updated=store.updateUser(updatedUser,targetUser);
+	bool updated=store.updateUser(updatedUser,targetUser,updatedAttributes);
 	
 	if(!updated)
 		return crow::response(500,generateError("User account update failed"));
@@ -680,10 +753,7 @@ crow::response deleteUser(PersistentStore& store, const crow::request& req, cons
 	}
 	
 	log_info("Deleting " << targetUser);
-	//Remove the user from any groups
-	std::vector<GroupMembership> groupMembershipList = store.getUserGroupMemberships(uID);
-	for(auto& membership : groupMembershipList)
-		store.removeUserFromGroup(uID,membership.groupName);
+	//This also removes the user from any groups
 	bool deleted=store.removeUser(uID);
 	
 	if(!deleted)
@@ -817,135 +887,77 @@ namespace{
 	}*/
 }
 
-crow::response setUserStatusInGroup(PersistentStore& store, const crow::request& req, 
-						   const std::string& uID, std::string groupName){
-	const User user=authenticateUser(store, req.url_params.get("token"));
-	log_info(user << " requested to add " << uID << " to " << groupName << " from " << req.remote_endpoint);
-	if(!user){
-		log_warn(user << " does not exist");
-		return crow::response(403,generateError("Not authorized"));
-	}
-	
-	User targetUser=store.getUser(uID);
-	if(!targetUser){
-		log_warn(targetUser << " does not exist");
-		return crow::response(404,generateError("User not found"));
-	}
-	
-	groupName=canonicalizeGroupName(groupName);
-	Group group=store.getGroup(groupName);
-	if(!group){
-		log_warn(group << " does not exist");
-		return(crow::response(404,generateError("Group not found")));
-	}
-		
-	rapidjson::Document body;
-	try{
-		body.Parse(req.body.c_str());
-	}catch(std::runtime_error& err){
-		return crow::response(400,generateError("Invalid JSON in request body"));
-	}
-	if(body.IsNull())
-		return crow::response(400,generateError("Invalid JSON in request body"));
-	if(!body.HasMember("group_membership"))
-		return crow::response(400,generateError("Missing group_membership in request"));
-	if(!body["group_membership"].IsObject())
-		return crow::response(400,generateError("Incorrect type for group_membership"));
-	
-	GroupMembership membership;
-	membership.userName=targetUser.unixName;
-	membership.groupName=group.name;
-	membership.stateSetBy="user:"+user.unixName;
-	
-	if(body["group_membership"].HasMember("state")){
-		if(!body["group_membership"]["state"].IsString())
-			return crow::response(400,generateError("Incorrect type for membership state"));
-		membership.state=GroupMembership::from_string(body["group_membership"]["state"].GetString());
-	}
-	
-	std::string comment;
-	if(body.HasMember("comment")){
-		if(!body["comment"].IsString())
-			return crow::response(400,generateError("Incorrect type for comment"));
-		comment=body["comment"].GetString();
-	}
-	
-	auto currentStatus=store.userStatusInGroup(targetUser.unixName,group.name);
-	if(membership.state==currentStatus.state) //no-op
-		return(crow::response(200));
-	bool selfRequest=(user==targetUser);
-	bool requesterIsGroupAdmin=(store.userStatusInGroup(user.unixName,groupName).state==GroupMembership::Admin);
-	bool requesterIsEnclosingGroupAdmin=false;
-	std::string adminGroup;
-	if(requesterIsGroupAdmin)
-		adminGroup=groupName;
-	else{
-		adminGroup=adminInAnyEnclosingGroup(store,user.unixName,group.name);
-		if(!adminGroup.empty())
-			requesterIsEnclosingGroupAdmin=true;
-	}
-	
-	//check whether the target user belongs to the enclosing group
-	std::string enclosingGroupName=enclosingGroup(group.name);
-	if(enclosingGroupName!=group.name &&
-	   !store.userStatusInGroup(targetUser.unixName,enclosingGroupName).isMember())
-		return crow::response(400,generateError("Cannot modify user status in group: Target user ("+targetUser.name+") is not a member of the enclosing group ("+enclosingGroupName+")"));
-	
-	//Figure out whether the requested transition is allowed
+namespace{
+///Check whether a change to a user's membership status in a group is allowed
+///\param requester the user making the change
+///\param requesterIsGroupAdmin whether the requester is an admin of the group
+///\param adminGroup the group, either this one or an enclosing one, in which 
+///                  the requester is an admin, or empty if none
+///\param currentState the target user's current status in the group
+///\param membership the requested membership. Its stateSetBy may be changed.
+///\return zero if the change is allowed, otherwise the HTTP status and error 
+///        message with which to reject it
+std::pair<int,std::string> checkStatusTransition(const User& requester, bool requesterIsGroupAdmin, 
+                                                 const std::string& adminGroup, 
+                                                 GroupMembership::Status currentState, 
+                                                 GroupMembership& membership){
+	bool requesterIsEnclosingGroupAdmin=!requesterIsGroupAdmin && !adminGroup.empty();
 	switch(membership.state){
 		case GroupMembership::NonMember:
-			return crow::response(400,generateError("User status cannot be explicitly set to non-member"));
+			return std::make_pair(400,std::string("User status cannot be explicitly set to non-member"));
 		case GroupMembership::Pending:
-			if(currentStatus.state!=GroupMembership::NonMember)
-				return crow::response(400,generateError("Only non-members can be placed in pending membership status"));
-			//if(!user.superuser && !requesterIsGroupAdmin && !requesterIsEnclosingGroupAdmin)
-			//	return crow::response(403,generateError("Not authorized"));
+			if(currentState!=GroupMembership::NonMember)
+				return std::make_pair(400,std::string("Only non-members can be placed in pending membership status"));
+			//if(!requester.superuser && !requesterIsGroupAdmin && !requesterIsEnclosingGroupAdmin)
+			//	return std::make_pair(403,std::string("Not authorized"));
 			break; //allowed
 		case GroupMembership::Active: //fallthrough
 		case GroupMembership::Admin:
-			if(currentStatus.state==GroupMembership::Disabled){
-				if(!user.superuser && !requesterIsGroupAdmin)
-					return crow::response(403,generateError("Not authorized"));
+			if(currentState==GroupMembership::Disabled){
+				if(!requester.superuser && !requesterIsGroupAdmin)
+					return std::make_pair(403,std::string("Not authorized"));
 				break; //allowed
 			}
 			else{
-				if(!user.superuser && !requesterIsGroupAdmin &&!requesterIsEnclosingGroupAdmin)
-					return crow::response(403,generateError("Not authorized"));
+				if(!requester.superuser && !requesterIsGroupAdmin && !requesterIsEnclosingGroupAdmin)
+					return std::make_pair(403,std::string("Not authorized"));
 				break; //allowed
 			}
 		case GroupMembership::Disabled:
-			if(currentStatus.state==GroupMembership::NonMember ||
-			   currentStatus.state==GroupMembership::Pending)
-				return crow::response(400,generateError("Only members can be placed in disabled membership status"));
-			if(!user.superuser && !requesterIsGroupAdmin && !requesterIsEnclosingGroupAdmin)
-				return crow::response(403,generateError("Not authorized"));
+			if(currentState==GroupMembership::NonMember ||
+			   currentState==GroupMembership::Pending)
+				return std::make_pair(400,std::string("Only members can be placed in disabled membership status"));
+			if(!requester.superuser && !requesterIsGroupAdmin && !requesterIsEnclosingGroupAdmin)
+				return std::make_pair(403,std::string("Not authorized"));
 			membership.stateSetBy="group:"+adminGroup;
 			break; //allowed
 	}
-	
-	log_info("Setting " << targetUser << " status in " << groupName << " to " << GroupMembership::to_string(membership.state));
-	
-	membership.valid=true;
-	bool success=store.setUserStatusInGroup(membership);
-	if(!success)
-		return crow::response(500,generateError("User addition to Group failed"));
-	
-	//if(membership.isMember())
-	//	ensureEnclosingMembership(store,membership.userName,membership.groupName,membership.stateSetBy);	
-	
+	return std::make_pair(0,std::string());
+}
+
+///Send the notifications for a change to a user's membership status in a group
+///\param group the group whose membership changed
+///\param targetUser the user whose status changed
+///\param previousState the user's status before the change
+///\param membership the new membership
+///\param comment the comment, if any, which the user made on a request to join
+void notifyStatusChange(PersistentStore& store, const crow::request& req, const Group& group, 
+                        const User& targetUser, GroupMembership::Status previousState, 
+                        const GroupMembership& membership, const std::string& comment){
 	//If the user is requesting to join a group, notify the group admins. 
 	//Note that silent mode isn't used here, admins should always get emails
-	if(currentStatus.state==GroupMembership::NonMember && membership.state==GroupMembership::Pending){
+	if(previousState==GroupMembership::NonMember && membership.state==GroupMembership::Pending){
 		EmailClient::Email adminMessage;
 		adminMessage.fromAddress="noreply@api.ci-connect.net";
 		adminMessage.toAddresses={group.email};
 		adminMessage.replyTo=targetUser.email;
+		std::vector<std::string> adminNames;
 		for(const auto& membership : store.getMembersOfGroup(group.name)){
-			if(membership.state==GroupMembership::Admin){
-				User admin=store.getUser(membership.userName);
-				adminMessage.bccAddresses.push_back(admin.email);
-			}
+			if(membership.state==GroupMembership::Admin)
+				adminNames.push_back(membership.userName);
 		}
+		for(const User& admin : store.getUsers(adminNames))
+			adminMessage.bccAddresses.push_back(admin.email);
 		adminMessage.subject="CI-Connect group membership request";
 		adminMessage.body="This is an automatic notification that "+targetUser.name+
 		" ("+targetUser.unixName+") has requested to join the "+group.displayName+" group.";
@@ -1005,10 +1017,266 @@ crow::response setUserStatusInGroup(PersistentStore& store, const crow::request&
 			store.getEmailClient().sendEmail(message);
 		}
 	}
+}
+}
+
+crow::response setUserStatusInGroup(PersistentStore& store, const crow::request& req, 
+						   const std::string& uID, std::string groupName){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested to add " << uID << " to " << groupName << " from " << req.remote_endpoint);
+	if(!user){
+		log_warn(user << " does not exist");
+		return crow::response(403,generateError("Not authorized"));
+	}
+	
+	groupName=canonicalizeGroupName(groupName);
+	std::string enclosingGroupName=enclosingGroup(groupName);
+	//These lookups are independent, so make them all at once
+	auto targetUserLookup=store.getUserAsync(uID);
+	auto groupLookup=store.getGroupAsync(groupName);
+	auto currentStatusLookup=store.userStatusInGroupAsync(uID,groupName);
+	std::future<GroupMembership> enclosingStatusLookup;
+	if(enclosingGroupName!=groupName)
+		enclosingStatusLookup=store.userStatusInGroupAsync(uID,enclosingGroupName);
+	
+	User targetUser=targetUserLookup.get();
+	if(!targetUser){
+		log_warn(targetUser << " does not exist");
+		return crow::response(404,generateError("User not found"));
+	}
+	
+	Group group=groupLookup.get();
+	if(!group){
+		log_warn(group << " does not exist");
+		return(crow::response(404,generateError("Group not found")));
+	}
+		
+	rapidjson::Document body;
+	try{
+		body.Parse(req.body.c_str());
+	}catch(std::runtime_error& err){
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	}
+	if(body.IsNull())
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	if(!body.HasMember("group_membership"))
+		return crow::response(400,generateError("Missing group_membership in request"));
+	if(!body["group_membership"].IsObject())
+		return crow::response(400,generateError("Incorrect type for group_membership"));
+	
+	GroupMembership membership;
+	membership.userName=targetUser.unixName;
+	membership.groupName=group.name;
+	membership.stateSetBy="user:"+user.unixName;
+	
+	if(body["group_membership"].HasMember("state")){
+		if(!body["group_membership"]["state"].IsString())
+			return crow::response(400,generateError("Incorrect type for membership state"));
+		membership.state=GroupMembership::from_string(body["group_membership"]["state"].GetString());
+	}
+	
+	std::string comment;
+	if(body.HasMember("comment")){
+		if(!body["comment"].IsString())
+			return crow::response(400,generateError("Incorrect type for comment"));
+		comment=body["comment"].GetString();
+	}
+	
+	auto currentStatus=currentStatusLookup.get();
+	if(membership.state==currentStatus.state) //no-op
+		return(crow::response(200));
+	bool selfRequest=(user==targetUser);
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,group.name,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	std::string adminGroup=authorization.adminGroup;
+	bool requesterIsGroupAdmin=(adminGroup==group.name);
+	
+	//check whether the target user belongs to the enclosing group
+	if(enclosingStatusLookup.valid() && !enclosingStatusLookup.get().isMember())
+		return crow::response(400,generateError("Cannot modify user status in group: Target user ("+targetUser.name+") is not a member of the enclosing group ("+enclosingGroupName+")"));
+	
+	//Figure out whether the requested transition is allowed
+	auto check=checkStatusTransition(user,requesterIsGroupAdmin,adminGroup,currentStatus.state,membership);
+	if(check.first)
+		return crow::response(check.first,generateError(check.second));
+	
+	log_info("Setting " << targetUser << " status in " << groupName << " to " << GroupMembership::to_string(membership.state));
+	
+	membership.valid=true;
+	bool success=store.setUserStatusInGroup(membership);
+	if(!success)
+		return crow::response(500,generateError("User addition to Group failed"));
+	
+	//if(membership.isMember())
+	//	ensureEnclosingMembership(store,membership.userName,membership.groupName,membership.stateSetBy);	
+	
+	notifyStatusChange(store,req,group,targetUser,currentStatus.state,membership,comment);
 	
 	return(crow::response(200));
 }
 
+crow::response setGroupMemberStatuses(PersistentStore& store, const crow::request& req, 
+                                      std::string groupName){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested to set multiple users' statuses in " << groupName << " from " << req.remote_endpoint);
+	if(!user)
+		return crow::response(403,generateError("Not authorized"));
+	
+	groupName=canonicalizeGroupName(groupName);
+	Group group=store.getGroup(groupName);
+	if(!group){
+		log_warn(group << " does not exist");
+		return(crow::response(404,generateError("Group not found")));
+	}
+	
+	//Only superusers and admins of the group or an enclosing group may make 
+	//bulk changes, so authorization is checked once for all of them
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,group.name,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
+		return crow::response(403,generateError("Not authorized"));
+	const std::string& adminGroup=authorization.adminGroup;
+	bool requesterIsGroupAdmin=(adminGroup==group.name);
+	
+	rapidjson::Document body;
+	try{
+		body.Parse(req.body.c_str());
+	}catch(std::runtime_error& err){
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	}
+	if(body.IsNull() || !body.IsObject())
+		return crow::response(400,generateError("Invalid JSON in request body"));
+	if(!body.HasMember("group_memberships"))
+		return crow::response(400,generateError("Missing group_memberships in request"));
+	if(!body["group_memberships"].IsArray())
+		return crow::response(400,generateError("Incorrect type for group_memberships"));
+	
+	//Validate all entries against the (likely cached) current memberships of 
+	//this group and its enclosing group
+	std::map<std::string,GroupMembership::Status> currentStates;
+	for(const auto& membership : store.getMembersOfGroup(group.name))
+		currentStates[membership.userName]=membership.state;
+	std::string enclosingGroupName=enclosingGroup(group.name);
+	std::set<std::string> enclosingMembers;
+	if(enclosingGroupName!=group.name){
+		for(const auto& membership : store.getMembersOfGroup(enclosingGroupName)){
+			if(membership.isMember())
+				enclosingMembers.insert(membership.userName);
+		}
+	}
+	
+	struct Entry{
+		std::string userName;
+		int status;
+		std::string message;
+		GroupMembership membership;
+		GroupMembership::Status previousState;
+	};
+	std::vector<Entry> entries;
+	std::vector<std::string> userNames;
+	for(const auto& item : body["group_memberships"].GetArray()){
+		if(!item.IsObject() || !item.HasMember("user_name") || !item["user_name"].IsString())
+			return crow::response(400,generateError("Group membership entries must be objects with user_name properties"));
+		Entry entry;
+		entry.userName=item["user_name"].GetString();
+		entry.status=0;
+		entry.previousState=GroupMembership::NonMember;
+		entry.membership.userName=entry.userName;
+		entry.membership.groupName=group.name;
+		entry.membership.stateSetBy="user:"+user.unixName;
+		if(!item.HasMember("state") || !item["state"].IsString()){
+			entry.status=400;
+			entry.message="Missing or incorrect type for membership state";
+		}
+		else{
+			try{
+				entry.membership.state=GroupMembership::from_string(item["state"].GetString());
+			}catch(std::runtime_error& err){
+				entry.status=400;
+				entry.message="Invalid membership state";
+			}
+		}
+		entries.push_back(entry);
+		userNames.push_back(entry.userName);
+	}
+	bool usersComplete=false;
+	std::vector<User> targetUsers=store.getUsers(userNames,&usersComplete);
+	
+	std::set<std::string> seen;
+	std::vector<GroupMembership> toStore;
+	std::vector<std::size_t> storedEntries;
+	for(std::size_t i=0; i<entries.size(); i++){
+		Entry& entry=entries[i];
+		if(!seen.insert(entry.userName).second){
+			entry.status=400;
+			entry.message="Duplicate entry for user";
+		}
+		if(entry.status)
+			continue;
+		if(!targetUsers[i]){
+			//a user which could not be read may nonetheless exist
+			entry.status=usersComplete?404:500;
+			entry.message=usersComplete?"User not found":"Failed to look up user";
+			continue;
+		}
+		auto current=currentStates.find(entry.userName);
+		if(current!=currentStates.end())
+			entry.previousState=current->second;
+		if(entry.membership.state==entry.previousState){ //no-op
+			entry.status=200;
+			continue;
+		}
+		if(enclosingGroupName!=group.name && !enclosingMembers.count(entry.userName)){
+			entry.status=400;
+			entry.message="Target user is not a member of the enclosing group ("+enclosingGroupName+")";
+			continue;
+		}
+		auto check=checkStatusTransition(user,requesterIsGroupAdmin,adminGroup,entry.previousState,entry.membership);
+		if(check.first){
+			entry.status=check.first;
+			entry.message=check.second;
+			continue;
+		}
+		entry.membership.valid=true;
+		toStore.push_back(entry.membership);
+		storedEntries.push_back(i);
+	}
+	
+	log_info("Setting status of " << toStore.size() << " users in " << groupName);
+	auto stored=store.setUserStatusesInGroups(toStore);
+	for(std::size_t i=0; i<storedEntries.size(); i++){
+		Entry& entry=entries[storedEntries[i]];
+		if(stored[i]){
+			entry.status=200;
+			notifyStatusChange(store,req,group,targetUsers[storedEntries[i]],entry.previousState,entry.membership,"");
+		}
+		else{
+			entry.status=500;
+			entry.message="User addition to Group failed";
+		}
+	}
+	
+	rapidjson::Document result(rapidjson::kObjectType);
+	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	
+	result.AddMember("apiVersion", "v1alpha1", alloc);
+	rapidjson::Value results(rapidjson::kArrayType);
+	results.Reserve(entries.size(), alloc);
+	for(const auto& entry : entries){
+		rapidjson::Value item(rapidjson::kObjectType);
+		item.AddMember("user_name", entry.userName, alloc);
+		item.AddMember("status", entry.status, alloc);
+		if(!entry.message.empty())
+			item.AddMember("message", entry.message, alloc);
+		results.PushBack(item, alloc);
+	}
+	result.AddMember("results", results, alloc);
+	
+	return crow::response(to_string(result));
+}
+
 crow::response removeUserFromGroup(PersistentStore& store, const crow::request& req, 
 								   const std::string& uID, std::string groupID){
 	const User user=authenticateUser(store, req.url_params.get("token"));
@@ -1023,9 +1291,10 @@ crow::response removeUserFromGroup(PersistentStore& store, const crow::request&
 	groupID=canonicalizeGroupName(groupID);
 	
 	//Only allow superusers and admins of the Group to remove user from it
-	if(!user.superuser && 
-	   store.userStatusInGroup(user.unixName,groupID).state!=GroupMembership::Admin &&
-	   adminInAnyEnclosingGroup(store,user.unixName,groupID).empty())
+	Authorizer::Decision authorization=store.getAuthorizer().check(user,groupID,Authorizer::Administer);
+	if(!authorization.complete)
+		return crow::response(500,generateError("Failed to look up group memberships"));
+	if(!authorization)
 		return crow::response(403,generateError("Not authorized"));
 	
 	rapidjson::Document body;
@@ -1110,6 +1379,29 @@ crow::response getUserAttribute(PersistentStore& store, const crow::request& req
 	return crow::response(to_string(result));
 }
 
+crow::response listUserAttributes(PersistentStore& store, const crow::request& req, std::string uID){
+	const User user=authenticateUser(store, req.url_params.get("token"));
+	log_info(user << " requested to fetch all secondary attributes of user " << uID << " from " << req.remote_endpoint);
+	if(!user)
+		return crow::response(403,generateError("Not authorized"));
+
+	//Any user can query any user property?
+	
+	if(!store.getUser(uID))
+		return crow::response(404,generateError("User not found"));
+	
+	rapidjson::Document result(rapidjson::kObjectType);
+	rapidjson::Document::AllocatorType& alloc = result.GetAllocator();
+	
+	result.AddMember("apiVersion", "v1alpha1", alloc);
+	rapidjson::Value data(rapidjson::kObjectType);
+	for(const auto& attribute : store.getUserSecondaryAttributes(uID))
+		data.AddMember(rapidjson::Value(attribute.first,alloc), rapidjson::Value(attribute.second,alloc), alloc);
+	result.AddMember("data", data, alloc);
+	
+	return crow::response(to_string(result));
+}
+
 crow::response setUserAttribute(PersistentStore& store, const crow::request& req, 
                                 std::string uID, std::string attributeName){
 	const User user=authenticateUser(store, req.url_params.get("token"));
@@ -1233,7 +1525,7 @@ crow::response replaceUserToken(PersistentStore& store, const crow::request& req
 	log_info("Updating " << targetUser << " access token");
 	User updatedUser=targetUser;
 	updatedUser.token=idGenerator.generateUserToken();
-	bool updated=store.updateUser(updatedUser,targetUser);
+	bool updated=store.updateUser(updatedUser,targetUser,{"token"});
 	
 	if(!updated)
 		return crow::response(500,generateError("User account update failed"));
@@ -1269,9 +1561,7 @@ crow::response updateLastUseTime(PersistentStore& store, const crow::request& re
 	User updatedUser=targetUser;
 	updatedUser.lastUseTime=timestamp();
 	log_info("Updating " << updatedUser << " last use time to " << updatedUser.lastUseTime);
-	bool updated=store.updateUser(updatedUser,targetUser);
-	
-	if(!updated)
-		return crow::response(500,generateError("User account update failed"));
+	//written to the database in the background
+	store.updateLastUseTime(updatedUser);
 	return crow::response(200);
 }
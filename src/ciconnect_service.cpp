@@ -7,8 +7,11 @@
 #define CROW_ENABLE_SSL
 #include <crow.h>
 
+#include <aws/core/utils/threading/Executor.h>
+
 #include "Entities.h"
 #include "Logging.h"
+#include "LocalStorageEngine.h"
 #include "PersistentStore.h"
 // #include "Process.h"
 #include "ServerUtilities.h"
@@ -65,6 +68,23 @@ struct Configuration{
 	std::string mailgunEndpoint;
 	std::string mailgunKey;
 	std::string emailDomain;
+	std::string cacheMemoryLimit;
+	std::string cacheMemoryBudgets;
+	std::string cacheRefreshAhead;
+	std::string cacheStaleGrace;
+	std::string changeFeed;
+	std::string changeFeedInterval;
+	std::string cachePrewarmSegments;
+	std::string cacheSnapshotFile;
+	std::string cacheSnapshotInterval;
+	std::string scanSegments;
+	std::string dbRequestThreads;
+	std::string unixIDBlockSize;
+	std::string dbRateLimit;
+	std::string lastUseFlushInterval;
+	std::string storageEngine;
+	std::string localStoragePath;
+	bool localStorageSync;
 	
 	std::map<std::string,ParamRef> options;
 	
@@ -78,6 +98,21 @@ struct Configuration{
 	bootstrapUserFile("base_connect_user"),
 	mailgunEndpoint("api.mailgun.net"),
 	emailDomain("api.ci-connect.net"),
+	cacheMemoryLimit("0"),
+	cacheRefreshAhead("300"),
+	cacheStaleGrace("30"),
+	changeFeed("none"),
+	changeFeedInterval("1000"),
+	cachePrewarmSegments("0"),
+	cacheSnapshotInterval("600"),
+	scanSegments("4"),
+	dbRequestThreads("16"),
+	unixIDBlockSize("16"),
+	dbRateLimit("1000"),
+	lastUseFlushInterval("10"),
+	storageEngine("dynamodb"),
+	localStoragePath("ciconnect.db"),
+	localStorageSync(true),
 	options{
 		{"awsAccessKey",awsAccessKey},
 		{"awsSecretKey",awsSecretKey},
@@ -90,7 +125,24 @@ struct Configuration{
 		{"bootstrapUserFile",bootstrapUserFile},
 		{"mailgunEndpoint",mailgunEndpoint},
 		{"mailgunKey",mailgunKey},
-		{"emailDomain",emailDomain}
+		{"emailDomain",emailDomain},
+		{"cacheMemoryLimit",cacheMemoryLimit},
+		{"cacheMemoryBudgets",cacheMemoryBudgets},
+		{"cacheRefreshAhead",cacheRefreshAhead},
+		{"cacheStaleGrace",cacheStaleGrace},
+		{"changeFeed",changeFeed},
+		{"changeFeedInterval",changeFeedInterval},
+		{"cachePrewarmSegments",cachePrewarmSegments},
+		{"cacheSnapshotFile",cacheSnapshotFile},
+		{"cacheSnapshotInterval",cacheSnapshotInterval},
+		{"scanSegments",scanSegments},
+		{"dbRequestThreads",dbRequestThreads},
+		{"unixIDBlockSize",unixIDBlockSize},
+		{"dbRateLimit",dbRateLimit},
+		{"lastUseFlushInterval",lastUseFlushInterval},
+		{"storageEngine",storageEngine},
+		{"localStoragePath",localStoragePath},
+		{"localStorageSync",localStorageSync}
 	}
 	{
 		//check for environment variables
@@ -313,13 +365,119 @@ int main(int argc, char* argv[]){
 	else
 		log_fatal("Unrecognized URL scheme for AWS: '" << config.awsURLScheme << '\'');
 	clientConfig.endpointOverride=config.awsEndpoint;
+	{
+		//threads on which asynchronous database requests are performed
+		std::istringstream is(config.dbRequestThreads);
+		std::size_t threads=0;
+		is >> threads;
+		if(is.fail() || threads==0)
+			log_fatal("Unable to parse \"" << config.dbRequestThreads << "\" as a number of database request threads");
+		clientConfig.executor=Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>("ciconnect-service",threads);
+	}
 	
 	EmailClient emailClient(config.mailgunEndpoint,config.mailgunKey,config.emailDomain);
 	
-	PersistentStore store(credentials,clientConfig,
+	std::shared_ptr<StorageEngine> engine;
+	if(config.storageEngine=="dynamodb"){
+		std::istringstream is(config.dbRateLimit);
+		double rateLimit=0;
+		is >> rateLimit;
+		if(is.fail() || rateLimit<=0)
+			log_fatal("Unable to parse \"" << config.dbRateLimit << "\" as a number of requests per second");
+		engine=std::make_shared<DynamoDBStorageEngine>(credentials,clientConfig,rateLimit);
+	}
+	else if(config.storageEngine=="local"){
+		try{
+			engine=std::make_shared<LocalStorageEngine>(config.localStoragePath,config.localStorageSync);
+		}catch(std::runtime_error& err){
+			log_fatal("Unable to open local storage: " << err.what());
+		}
+	}
+	else
+		log_fatal("Unknown storage engine type: \"" << config.storageEngine << '"');
+	
+	PersistentStore store(engine,
 	                      config.bootstrapUserFile,
 	                      emailClient);
 	
+	{
+		const std::size_t megabyte=1024*1024;
+		std::istringstream is(config.cacheMemoryLimit);
+		std::size_t limit=0;
+		is >> limit;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.cacheMemoryLimit << "\" as a cache memory limit");
+		store.setCacheMemoryLimit(limit*megabyte);
+		//individual budgets are a comma separated list of cacheName=megabytes
+		std::istringstream budgets(config.cacheMemoryBudgets);
+		std::string budget;
+		while(std::getline(budgets,budget,',')){
+			auto eqPos=budget.find('=');
+			if(eqPos==std::string::npos)
+				log_fatal("Malformed cache memory budget: \"" << budget << '"');
+			std::istringstream is(budget.substr(eqPos+1));
+			std::size_t limit=0;
+			is >> limit;
+			if(is.fail())
+				log_fatal("Unable to parse \"" << budget.substr(eqPos+1) << "\" as a cache memory budget");
+			if(!store.setCacheMemoryBudget(budget.substr(0,eqPos),limit*megabyte))
+				log_fatal("Unknown cache name in memory budget: \"" << budget.substr(0,eqPos) << '"');
+		}
+	}
+	{
+		auto parseSeconds=[](const std::string& value, const std::string& what){
+			std::istringstream is(value);
+			unsigned long seconds=0;
+			is >> seconds;
+			if(is.fail())
+				log_fatal("Unable to parse \"" << value << "\" as " << what);
+			return std::chrono::seconds(seconds);
+		};
+		std::istringstream scanIs(config.scanSegments);
+		unsigned int scanSegments=0;
+		scanIs >> scanSegments;
+		if(scanIs.fail() || scanSegments==0)
+			log_fatal("Unable to parse \"" << config.scanSegments << "\" as a number of scan segments");
+		store.setScanParallelism(scanSegments);
+		std::istringstream blockIs(config.unixIDBlockSize);
+		unsigned int blockSize=0;
+		blockIs >> blockSize;
+		if(blockIs.fail() || blockSize==0)
+			log_fatal("Unable to parse \"" << config.unixIDBlockSize << "\" as a number of unix IDs");
+		store.setUnixIDBlockSize(blockSize);
+		store.setCacheRefreshPolicy(parseSeconds(config.cacheRefreshAhead,"a cache refresh-ahead window"),
+		                            parseSeconds(config.cacheStaleGrace,"a cache stale grace period"));
+		store.setLastUseFlushInterval(parseSeconds(config.lastUseFlushInterval,"a last use flush interval"));
+		std::istringstream is(config.cachePrewarmSegments);
+		unsigned int segments=0;
+		is >> segments;
+		if(is.fail())
+			log_fatal("Unable to parse \"" << config.cachePrewarmSegments << "\" as a number of cache prewarm segments");
+		//fresh data from the database takes precedence over a snapshot
+		if(segments)
+			store.prewarmCaches(segments);
+		if(!config.cacheSnapshotFile.empty())
+			store.enableCacheSnapshots(config.cacheSnapshotFile,
+			                           parseSeconds(config.cacheSnapshotInterval,"a cache snapshot interval"));
+	}
+	if(config.changeFeed!="none"){
+		std::istringstream is(config.changeFeedInterval);
+		unsigned long interval=0;
+		is >> interval;
+		if(is.fail() || interval==0)
+			log_fatal("Unable to parse \"" << config.changeFeedInterval << "\" as a change feed polling interval");
+		std::shared_ptr<ChangeFeed> feed;
+		if(config.changeFeed=="dynamodb"){
+			//the stream belongs to the DynamoDB tables
+			if(config.storageEngine!="dynamodb")
+				log_fatal("The dynamodb change feed requires the dynamodb storage engine");
+			feed=std::make_shared<DynamoDBChangeFeed>(credentials,clientConfig);
+		}
+		else
+			log_fatal("Unknown change feed type: \"" << config.changeFeed << '"');
+		store.setChangeFeed(feed,std::chrono::milliseconds(interval));
+	}
+	
 	// REST server initialization
 	crow::SimpleApp server;
 	
@@ -331,6 +489,8 @@ int main(int argc, char* argv[]){
 	  [&](const crow::request& req){ return listUsers(store,req); });
 	CROW_ROUTE(server, "/v1alpha1/users").methods("POST"_method)(
 	  [&](const crow::request& req){ return createUser(store,req); });
+	CROW_ROUTE(server, "/v1alpha1/users/batch_get").methods("POST"_method)(
+	  [&](const crow::request& req){ return getUsersInfo(store,req); });
 	CROW_ROUTE(server, "/v1alpha1/users/<string>").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& uID){ return getUserInfo(store,req,uID); });
 	CROW_ROUTE(server, "/v1alpha1/users/<string>").methods("PUT"_method)(
@@ -347,6 +507,8 @@ int main(int argc, char* argv[]){
 	  [&](const crow::request& req, const std::string& uID, const std::string groupID){ return removeUserFromGroup(store,req,uID,groupID); });
 	CROW_ROUTE(server, "/v1alpha1/users/<string>/group_requests").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& uID){ return listUserGroupRequests(store,req,uID); });
+	CROW_ROUTE(server, "/v1alpha1/users/<string>/attributes").methods("GET"_method)(
+	  [&](const crow::request& req, const std::string& uID){ return listUserAttributes(store,req,uID); });
 	CROW_ROUTE(server, "/v1alpha1/users/<string>/attributes/<string>").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& uID, const std::string& attr){ return getUserAttribute(store,req,uID,attr); });
 	CROW_ROUTE(server, "/v1alpha1/users/<string>/attributes/<string>").methods("PUT"_method)(
@@ -373,6 +535,8 @@ int main(int argc, char* argv[]){
 	  [&](const crow::request& req, const std::string& groupID){ return deleteGroup(store,req,groupID); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/members").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& groupID){ return listGroupMembers(store,req,groupID); });
+	CROW_ROUTE(server, "/v1alpha1/groups/<string>/members").methods("PUT"_method)(
+	  [&](const crow::request& req, const std::string& groupID){ return setGroupMemberStatuses(store,req,groupID); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/members/<string>").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& groupID, const std::string& userID){ return getGroupMemberStatus(store,req,userID,groupID); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/members/<string>").methods("PUT"_method)(
@@ -391,6 +555,8 @@ int main(int argc, char* argv[]){
 	  [&](const crow::request& req, const std::string& pGroup, const std::string& cGroup){ return denySubgroupRequest(store,req,pGroup,cGroup); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/subgroup_requests/<string>/approve").methods("PUT"_method)(
 	  [&](const crow::request& req, const std::string& pGroup, const std::string& cGroup){ return approveSubgroupRequest(store,req,pGroup,cGroup); });
+	CROW_ROUTE(server, "/v1alpha1/groups/<string>/attributes").methods("GET"_method)(
+	  [&](const crow::request& req, const std::string& group){ return listGroupAttributes(store,req,group); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/attributes/<string>").methods("GET"_method)(
 	  [&](const crow::request& req, const std::string& group, const std::string& attr){ return getGroupAttribute(store,req,group,attr); });
 	CROW_ROUTE(server, "/v1alpha1/groups/<string>/attributes/<string>").methods("PUT"_method)(